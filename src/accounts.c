@@ -29,9 +29,14 @@
 #include "files.h"
 #include "log.h"
 #include "prof_autocomplete.h"
+#include "prof_file_writer.h"
+
+// changes made within this many milliseconds are saved together
+#define ACCOUNTS_SAVE_DELAY 500
 
 static gchar *accounts_loc;
 static GKeyFile *accounts;
+static PFileWriter accounts_writer;
 
 static PAutocomplete all_ac;
 static PAutocomplete enabled_ac;
@@ -49,6 +54,8 @@ accounts_load(void)
     accounts = g_key_file_new();
     g_key_file_load_from_file(accounts, accounts_loc, G_KEY_FILE_KEEP_COMMENTS,
         NULL);
+    accounts_writer = p_file_writer_new(accounts_loc, 0600,
+        ACCOUNTS_SAVE_DELAY);
 
     // create the logins searchable list for autocompletion
     gsize njids;
@@ -74,6 +81,11 @@ accounts_close(void)
 {
     p_autocomplete_free(all_ac);
     p_autocomplete_free(enabled_ac);
+    if (!p_file_writer_flush(accounts_writer)) {
+        log_error("Could not save accounts to %s", accounts_loc);
+    }
+    p_file_writer_free(accounts_writer);
+    accounts_writer = NULL;
     g_key_file_free(accounts);
 }
 
@@ -268,10 +280,11 @@ accounts_set_server(const char * const account_name, const char * const value)
     }
 }
 
+// the file is written in the background, see prof_file_writer.c
 static void
 _save_accounts(void)
 {
     gsize g_data_size;
     char *g_accounts_data = g_key_file_to_data(accounts, &g_data_size, NULL);
-    g_file_set_contents(accounts_loc, g_accounts_data, g_data_size, NULL);
+    p_file_writer_write(accounts_writer, g_accounts_data, g_data_size);
 }
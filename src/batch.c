@@ -0,0 +1,338 @@
+/*
+ * batch.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "batch.h"
+#include "log.h"
+
+#define READ_SIZE 4096
+
+static gboolean active = FALSE;
+
+// where commands are read from, -1 when there is nothing to read
+static int input_fd = -1;
+
+// listening socket when reading from a UNIX socket, -1 otherwise
+static int listen_fd = -1;
+static char *socket_path = NULL;
+
+// input read but not yet returned as a line
+static GString *pending = NULL;
+
+static gboolean _read_input(void);
+static void _close_input(void);
+static char * _take_line(void);
+static void _json_append_string(GString *json, const char * const str);
+
+/*
+ * Read commands from the file at path, or standard input if path is "-"
+ */
+gboolean
+batch_open_file(const char * const path)
+{
+    if (strcmp(path, "-") == 0) {
+        input_fd = STDIN_FILENO;
+    } else {
+        input_fd = open(path, O_RDONLY);
+        if (input_fd == -1) {
+            log_error("Could not open batch file %s: %s", path, strerror(errno));
+            return FALSE;
+        }
+    }
+
+    pending = g_string_new("");
+    active = TRUE;
+
+    return TRUE;
+}
+
+/*
+ * Read commands from clients connecting to a UNIX socket at path, one
+ * client at a time
+ */
+gboolean
+batch_open_socket(const char * const path)
+{
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_error("Batch socket path too long: %s", path);
+        return FALSE;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd == -1) {
+        log_error("Could not create batch socket: %s", strerror(errno));
+        return FALSE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if ((bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) ||
+            (listen(listen_fd, 5) == -1)) {
+        log_error("Could not listen on batch socket %s: %s", path,
+            strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return FALSE;
+    }
+
+    socket_path = strdup(path);
+    pending = g_string_new("");
+    active = TRUE;
+
+    return TRUE;
+}
+
+gboolean
+batch_active(void)
+{
+    return active;
+}
+
+/*
+ * Return the next line of input, waiting up to timeout_ms for one, or
+ * forever if timeout_ms is -1.  Returns NULL if no full line arrived,
+ * otherwise a new string which the caller must free.
+ */
+char *
+batch_read_line(int timeout_ms)
+{
+    char *line = _take_line();
+    if (line != NULL) {
+        return line;
+    }
+
+    struct pollfd fds[1];
+    int nfds = 0;
+    if (input_fd != -1) {
+        fds[0].fd = input_fd;
+        nfds = 1;
+    } else if (listen_fd != -1) {
+        fds[0].fd = listen_fd;
+        nfds = 1;
+    } else if (timeout_ms == -1) {
+        // nothing left to read
+        return NULL;
+    }
+    fds[0].events = POLLIN;
+
+    while (poll(fds, nfds, timeout_ms) > 0) {
+        if (input_fd != -1) {
+            if (!_read_input()) {
+                // end of input, return what is left as the last line
+                _close_input();
+                if (pending->len > 0) {
+                    line = strdup(pending->str);
+                    g_string_truncate(pending, 0);
+                }
+                return line;
+            }
+
+            line = _take_line();
+            if ((line != NULL) || (timeout_ms != -1)) {
+                return line;
+            }
+        } else {
+            input_fd = accept(listen_fd, NULL, NULL);
+            if (input_fd == -1) {
+                log_error("Could not accept batch client: %s", strerror(errno));
+                return NULL;
+            }
+            log_info("Batch client connected");
+            fds[0].fd = input_fd;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Password prompts take the next line of input, truncated to 20 characters
+ * as when typed
+ */
+void
+batch_get_password(char *passwd)
+{
+    char *line = batch_read_line(-1);
+
+    if (line == NULL) {
+        passwd[0] = '\0';
+    } else {
+        g_strlcpy(passwd, line, 21);
+        free(line);
+    }
+}
+
+/*
+ * Write an event to standard output as a single line JSON object, the
+ * arguments after the event name are pairs of field name and string value
+ * ending with NULL, fields with a NULL value are left out e.g.
+ *
+ * batch_event("message", "from", "bob@server.org", "body", "hi", NULL);
+ *
+ * writes {"event":"message","from":"bob@server.org","body":"hi"}
+ */
+void
+batch_event(const char * const event, ...)
+{
+    GString *json = g_string_new("{\"event\":");
+    _json_append_string(json, event);
+
+    va_list arg;
+    va_start(arg, event);
+    const char *name = va_arg(arg, const char *);
+    while (name != NULL) {
+        const char *value = va_arg(arg, const char *);
+        if (value != NULL) {
+            g_string_append_c(json, ',');
+            _json_append_string(json, name);
+            g_string_append_c(json, ':');
+            _json_append_string(json, value);
+        }
+        name = va_arg(arg, const char *);
+    }
+    va_end(arg);
+
+    g_string_append(json, "}\n");
+    fwrite(json->str, 1, json->len, stdout);
+    fflush(stdout);
+    g_string_free(json, TRUE);
+}
+
+void
+batch_close(void)
+{
+    if (!active) {
+        return;
+    }
+
+    _close_input();
+    if (listen_fd != -1) {
+        close(listen_fd);
+        listen_fd = -1;
+        unlink(socket_path);
+        free(socket_path);
+        socket_path = NULL;
+    }
+    g_string_free(pending, TRUE);
+    pending = NULL;
+    active = FALSE;
+}
+
+// append what is available to the pending input, FALSE at end of input
+static gboolean
+_read_input(void)
+{
+    char buf[READ_SIZE];
+    ssize_t len = read(input_fd, buf, READ_SIZE);
+
+    if (len > 0) {
+        g_string_append_len(pending, buf, len);
+        return TRUE;
+    } else if ((len == -1) && ((errno == EINTR) || (errno == EAGAIN))) {
+        return TRUE;
+    } else {
+        return FALSE;
+    }
+}
+
+static void
+_close_input(void)
+{
+    if (input_fd != -1) {
+        if (input_fd != STDIN_FILENO) {
+            close(input_fd);
+        }
+        input_fd = -1;
+
+        if (listen_fd != -1) {
+            log_info("Batch client disconnected");
+        }
+    }
+}
+
+// remove the first complete line from the pending input
+static char *
+_take_line(void)
+{
+    char *newline = memchr(pending->str, '\n', pending->len);
+    if (newline == NULL) {
+        return NULL;
+    }
+
+    gsize len = newline - pending->str;
+    char *line = strndup(pending->str, len);
+    g_string_erase(pending, 0, len + 1);
+
+    return line;
+}
+
+static void
+_json_append_string(GString *json, const char * const str)
+{
+    const char *curr;
+
+    g_string_append_c(json, '"');
+    for (curr = str; *curr != '\0'; curr++) {
+        switch (*curr) {
+        case '"':
+            g_string_append(json, "\\\"");
+            break;
+        case '\\':
+            g_string_append(json, "\\\\");
+            break;
+        case '\n':
+            g_string_append(json, "\\n");
+            break;
+        case '\r':
+            g_string_append(json, "\\r");
+            break;
+        case '\t':
+            g_string_append(json, "\\t");
+            break;
+        default:
+            if ((unsigned char)*curr < 0x20) {
+                g_string_append_printf(json, "\\u%04x", *curr);
+            } else {
+                g_string_append_c(json, *curr);
+            }
+            break;
+        }
+    }
+    g_string_append_c(json, '"');
+}
@@ -0,0 +1,36 @@
+/*
+ * batch.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <glib.h>
+
+gboolean batch_open_file(const char * const path);
+gboolean batch_open_socket(const char * const path);
+gboolean batch_active(void);
+char * batch_read_line(int timeout_ms);
+void batch_get_password(char *passwd);
+void batch_event(const char * const event, ...);
+void batch_close(void);
+
+#endif
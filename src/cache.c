@@ -0,0 +1,95 @@
+/*
+ * cache.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "cache.h"
+#include "files.h"
+#include "log.h"
+#include "prof_cache.h"
+#include "prof_file_writer.h"
+
+// results of network requests, kept between runs in
+// $XDG_DATA_HOME/profanity/cache
+
+#define CACHE_SIZE 200
+
+// changes made within this many milliseconds are saved together
+#define CACHE_SAVE_DELAY 500
+
+static gchar *cache_loc;
+static PCache cache;
+static PFileWriter cache_writer;
+
+void
+cache_init(void)
+{
+    log_info("Loading cache");
+    cache_loc = files_get_cache_file();
+    cache = p_cache_new(CACHE_SIZE);
+
+    gchar *data = NULL;
+    if (g_file_get_contents(cache_loc, &data, NULL, NULL)) {
+        p_cache_load(cache, data);
+        g_free(data);
+    }
+
+    cache_writer = p_file_writer_new(cache_loc, 0600, CACHE_SAVE_DELAY);
+}
+
+void
+cache_close(void)
+{
+    if (!p_file_writer_flush(cache_writer)) {
+        log_error("Could not save cache to %s", cache_loc);
+    }
+    p_file_writer_free(cache_writer);
+    cache_writer = NULL;
+    p_cache_free(cache);
+    cache = NULL;
+    g_free(cache_loc);
+    cache_loc = NULL;
+}
+
+/*
+ * The value stored for key, or NULL if there is none or it has expired,
+ * valid until the next cache_put()
+ */
+const char *
+cache_get(const char * const key)
+{
+    return p_cache_get(cache, key);
+}
+
+/*
+ * Store value for key for ttl seconds, and save the cache in the background
+ */
+void
+cache_put(const char * const key, const char * const value, gint64 ttl)
+{
+    p_cache_put(cache, key, value, ttl);
+
+    gchar *data = p_cache_serialise(cache);
+    p_file_writer_write(cache_writer, data, strlen(data));
+}
@@ -42,7 +42,8 @@ struct dated_chat_log {
 };
 
 static gboolean _log_roll_needed(struct dated_chat_log *dated_log);
-static struct dated_chat_log *_create_log(char *other, const  char * const login);
+static struct dated_chat_log *_create_log(const char * const other,
+    const char * const login);
 static void _free_chat_log(struct dated_chat_log *dated_log);
 static gboolean _key_equals(void *key1, void *key2);
 static char * _get_log_filename(const char * const other, const char * const login,
@@ -58,40 +59,40 @@ chat_log_init(void)
 }
 
 void
-chat_log_chat(const gchar * const login, gchar *other,
-    const gchar * const msg, chat_log_direction_t direction, GTimeVal *tv_stamp)
+chat_log_chat(const gchar * const login, const gchar * const other,
+    const gchar * const msg, chat_log_direction_t direction,
+    GDateTime *timestamp)
 {
-    gchar *other_copy = strdup(other);
-    struct dated_chat_log *dated_log = g_hash_table_lookup(logs, other_copy);
+    struct dated_chat_log *dated_log = g_hash_table_lookup(logs, other);
 
     // no log for user
     if (dated_log == NULL) {
-        dated_log = _create_log(other_copy, login);
-        g_hash_table_insert(logs, other_copy, dated_log);
+        dated_log = _create_log(other, login);
+        g_hash_table_insert(logs, strdup(other), dated_log);
 
     // log exists but needs rolling
     } else if (_log_roll_needed(dated_log)) {
-        dated_log = _create_log(other_copy, login);
-        g_hash_table_replace(logs, other_copy, dated_log);
+        dated_log = _create_log(other, login);
+        g_hash_table_replace(logs, strdup(other), dated_log);
     }
 
-    gchar *date_fmt = NULL;
+    // now if no time is given
     GDateTime *dt = NULL;
-    if (tv_stamp == NULL) {
+    if (timestamp == NULL) {
         dt = g_date_time_new_now_local();
     } else {
-        dt = g_date_time_new_from_timeval_utc(tv_stamp);
+        dt = g_date_time_ref(timestamp);
     }
 
-    date_fmt = g_date_time_format(dt, "%H:%M:%S");
+    gchar *date_fmt = g_date_time_format(dt, "%H:%M:%S");
 
     FILE *logp = fopen(dated_log->filename, "a");
 
     if (direction == PROF_IN_LOG) {
         if (strncmp(msg, "/me ", 4) == 0) {
-            fprintf(logp, "%s - *%s %s\n", date_fmt, other_copy, msg + 4);
+            fprintf(logp, "%s - *%s %s\n", date_fmt, other, msg + 4);
         } else {
-            fprintf(logp, "%s - %s: %s\n", date_fmt, other_copy, msg);
+            fprintf(logp, "%s - %s: %s\n", date_fmt, other, msg);
         }
     } else {
         if (strncmp(msg, "/me ", 4) == 0) {
@@ -167,7 +168,7 @@ chat_log_close(void)
 }
 
 static struct dated_chat_log *
-_create_log(char *other, const char * const login)
+_create_log(const char * const other, const char * const login)
 {
     GDateTime *now = g_date_time_new_now_local();
     char *filename = _get_log_filename(other, login, now, TRUE);
@@ -31,8 +31,9 @@ typedef enum {
 } chat_log_direction_t;
 
 void chat_log_init(void);
-void chat_log_chat(const gchar * const login, gchar *other,
-    const gchar * const msg, chat_log_direction_t direction, GTimeVal *tv_stamp);
+void chat_log_chat(const gchar * const login, const gchar * const other,
+    const gchar * const msg, chat_log_direction_t direction,
+    GDateTime *timestamp);
 void chat_log_close(void);
 GSList * chat_log_get_previous(const gchar * const login,
     const gchar * const recipient, GSList *history);
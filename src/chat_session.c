@@ -32,35 +32,42 @@
 #define PAUSED_TIMOUT 10.0
 #define INACTIVE_TIMOUT 30.0
 
-
-typedef enum {
-    CHAT_STATE_STARTED,
-    CHAT_STATE_ACTIVE,
-    CHAT_STATE_PAUSED,
-    CHAT_STATE_COMPOSING,
-    CHAT_STATE_INACTIVE,
-    CHAT_STATE_GONE
-} chat_state_t;
+// no transition scheduled
+#define NEVER -1.0
 
 struct chat_session_t {
     char *recipient;
     gboolean recipient_supports;
     chat_state_t state;
-    GTimer *active_timer;
-    gboolean sent;
+    gdouble last_activity;
+    gdouble next_transition;
 };
 
 typedef struct chat_session_t *ChatSession;
 
 static GHashTable *sessions;
 
+// all session times are seconds on this clock
+static GTimer *session_clock;
+
+// no session changes state before this time, it may be earlier than needed
+// but is never later
+static gdouble next_due = NEVER;
+
 static void _chat_session_free(ChatSession session);
+static void _schedule(ChatSession session);
+static chat_state_t _next_state(ChatSession session, gdouble now);
 
+/*
+ * Called once at startup, each login starts with chat_sessions_clear
+ */
 void
 chat_sessions_init(void)
 {
     sessions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
         (GDestroyNotify)_chat_session_free);
+    session_clock = g_timer_new();
+    next_due = NEVER;
 }
 
 void
@@ -68,6 +75,21 @@ chat_sessions_clear(void)
 {
     if (sessions != NULL)
         g_hash_table_remove_all(sessions);
+    next_due = NEVER;
+}
+
+void
+chat_sessions_close(void)
+{
+    if (sessions != NULL) {
+        g_hash_table_destroy(sessions);
+        sessions = NULL;
+    }
+    if (session_clock != NULL) {
+        g_timer_destroy(session_clock);
+        session_clock = NULL;
+    }
+    next_due = NEVER;
 }
 
 void
@@ -77,8 +99,8 @@ chat_session_start(const char * const recipient, gboolean recipient_supports)
     new_session->recipient = strdup(recipient);
     new_session->recipient_supports = recipient_supports;
     new_session->state = CHAT_STATE_STARTED;
-    new_session->active_timer = g_timer_new();
-    new_session->sent = FALSE;
+    new_session->last_activity = g_timer_elapsed(session_clock, NULL);
+    _schedule(new_session);
     g_hash_table_insert(sessions, strdup(recipient), new_session);
 }
 
@@ -94,71 +116,64 @@ chat_session_exists(const char * const recipient)
     }
 }
 
-void
-chat_session_set_composing(const char * const recipient)
+/*
+ * Record that the user is typing to the recipient, returns TRUE if this
+ * changed the state to composing and so a notification should be sent
+ */
+gboolean
+chat_session_on_activity(const char * const recipient)
 {
     ChatSession session = g_hash_table_lookup(sessions, recipient);
 
-    if (session != NULL) {
-        if (session->state != CHAT_STATE_COMPOSING) {
-            session->sent = FALSE;
-        }
-        session->state = CHAT_STATE_COMPOSING;
-        g_timer_start(session->active_timer);
+    if (session == NULL) {
+        return FALSE;
     }
-}
 
-void
-chat_session_no_activity(const char * const recipient)
-{
-    ChatSession session = g_hash_table_lookup(sessions, recipient);
+    gboolean changed = (session->state != CHAT_STATE_COMPOSING);
+    session->state = CHAT_STATE_COMPOSING;
+    session->last_activity = g_timer_elapsed(session_clock, NULL);
+    _schedule(session);
 
-    if (session != NULL) {
-        if (session->active_timer != NULL) {
-            gdouble elapsed = g_timer_elapsed(session->active_timer, NULL);
-
-            if ((prefs_get_gone() != 0) && (elapsed > (prefs_get_gone() * 60.0))) {
-                if (session->state != CHAT_STATE_GONE) {
-                    session->sent = FALSE;
-                }
-                session->state = CHAT_STATE_GONE;
-
-            } else if (elapsed > INACTIVE_TIMOUT) {
-                if (session->state != CHAT_STATE_INACTIVE) {
-                    session->sent = FALSE;
-                }
-                session->state = CHAT_STATE_INACTIVE;
-
-            } else if (elapsed > PAUSED_TIMOUT) {
-
-                if (session->state == CHAT_STATE_COMPOSING) {
-                    session->sent = FALSE;
-                    session->state = CHAT_STATE_PAUSED;
-                }
-            }
-        }
-    }
+    return changed;
 }
 
+/*
+ * Move on any sessions whose next state is due, calling send_func once for
+ * each session that changed, with the state it ended up in
+ * Returns straight away if nothing is due
+ */
 void
-chat_session_set_sent(const char * const recipient)
+chat_sessions_check(void (*send_func)(const char * const recipient,
+    chat_state_t state))
 {
-    ChatSession session = g_hash_table_lookup(sessions, recipient);
+    if (next_due == NEVER) {
+        return;
+    }
 
-    if (session != NULL) {
-        session->sent = TRUE;
+    gdouble now = g_timer_elapsed(session_clock, NULL);
+    if (now < next_due) {
+        return;
     }
-}
 
-gboolean
-chat_session_get_sent(const char * const recipient)
-{
-    ChatSession session = g_hash_table_lookup(sessions, recipient);
+    next_due = NEVER;
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, sessions);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        ChatSession session = value;
+
+        if ((session->next_transition != NEVER) &&
+                (session->next_transition <= now)) {
+            // several states may have passed, only the last is sent
+            chat_state_t state = _next_state(session, now);
+            if (state != session->state) {
+                session->state = state;
+                send_func(session->recipient, state);
+            }
+        }
 
-    if (session == NULL) {
-        return FALSE;
-    } else {
-        return session->sent;
+        _schedule(session);
     }
 }
 
@@ -168,30 +183,6 @@ chat_session_end(const char * const recipient)
     g_hash_table_remove(sessions, recipient);
 }
 
-gboolean
-chat_session_is_inactive(const char * const recipient)
-{
-    ChatSession session = g_hash_table_lookup(sessions, recipient);
-
-    if (session == NULL) {
-        return FALSE;
-    } else {
-        return (session->state == CHAT_STATE_INACTIVE);
-    }
-}
-
-gboolean
-chat_session_is_active(const char * const recipient)
-{
-    ChatSession session = g_hash_table_lookup(sessions, recipient);
-
-    if (session == NULL) {
-        return FALSE;
-    } else {
-        return (session->state == CHAT_STATE_ACTIVE);
-    }
-}
-
 void
 chat_session_set_active(const char * const recipient)
 {
@@ -199,65 +190,83 @@ chat_session_set_active(const char * const recipient)
 
     if (session != NULL) {
         session->state = CHAT_STATE_ACTIVE;
-        g_timer_start(session->active_timer);
-        session->sent = TRUE;
-    }
-}
-
-gboolean
-chat_session_is_paused(const char * const recipient)
-{
-    ChatSession session = g_hash_table_lookup(sessions, recipient);
-
-    if (session == NULL) {
-        return FALSE;
-    } else {
-        return (session->state == CHAT_STATE_PAUSED);
+        session->last_activity = g_timer_elapsed(session_clock, NULL);
+        _schedule(session);
     }
 }
 
 gboolean
-chat_session_is_gone(const char * const recipient)
+chat_session_get_recipient_supports(const char * const recipient)
 {
     ChatSession session = g_hash_table_lookup(sessions, recipient);
 
     if (session == NULL) {
         return FALSE;
     } else {
-        return (session->state == CHAT_STATE_GONE);
+        return session->recipient_supports;
     }
 }
 
 void
-chat_session_set_gone(const char * const recipient)
+chat_session_set_recipient_supports(const char * const recipient,
+    gboolean recipient_supports)
 {
     ChatSession session = g_hash_table_lookup(sessions, recipient);
 
     if (session != NULL) {
-        session->state = CHAT_STATE_GONE;
+        session->recipient_supports = recipient_supports;
     }
 }
 
-gboolean
-chat_session_get_recipient_supports(const char * const recipient)
+// the state the session will be in at time now if there is no activity
+static chat_state_t
+_next_state(ChatSession session, gdouble now)
 {
-    ChatSession session = g_hash_table_lookup(sessions, recipient);
-
-    if (session == NULL) {
-        return FALSE;
+    gdouble elapsed = now - session->last_activity;
+    gint gone = prefs_get_gone();
+
+    if ((gone != 0) && (elapsed > (gone * 60.0))) {
+        return CHAT_STATE_GONE;
+    } else if (elapsed > INACTIVE_TIMOUT) {
+        return CHAT_STATE_INACTIVE;
+    } else if ((elapsed > PAUSED_TIMOUT) &&
+            (session->state == CHAT_STATE_COMPOSING)) {
+        return CHAT_STATE_PAUSED;
     } else {
-        return session->recipient_supports;
+        return session->state;
     }
 }
 
-void
-chat_session_set_recipient_supports(const char * const recipient,
-    gboolean recipient_supports)
+// work out when the session next changes state without any activity
+static void
+_schedule(ChatSession session)
 {
-    ChatSession session = g_hash_table_lookup(sessions, recipient);
+    gint gone = prefs_get_gone();
+
+    switch (session->state) {
+    case CHAT_STATE_COMPOSING:
+        session->next_transition = session->last_activity + PAUSED_TIMOUT;
+        break;
+    case CHAT_STATE_STARTED:
+    case CHAT_STATE_ACTIVE:
+    case CHAT_STATE_PAUSED:
+        session->next_transition = session->last_activity + INACTIVE_TIMOUT;
+        break;
+    case CHAT_STATE_INACTIVE:
+        if (gone != 0) {
+            session->next_transition = session->last_activity + (gone * 60.0);
+        } else {
+            session->next_transition = NEVER;
+        }
+        break;
+    default:
+        session->next_transition = NEVER;
+        break;
+    }
 
-    if (session != NULL) {
-        session->recipient_supports = recipient_supports;
+    if ((session->next_transition != NEVER) &&
+            ((next_due == NEVER) || (session->next_transition < next_due))) {
+        next_due = session->next_transition;
     }
 }
 
@@ -269,10 +278,6 @@ _chat_session_free(ChatSession session)
             g_free(session->recipient);
             session->recipient = NULL;
         }
-        if (session->active_timer != NULL) {
-            g_timer_destroy(session->active_timer);
-            session->active_timer = NULL;
-        }
         g_free(session);
     }
     session = NULL;
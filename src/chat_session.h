@@ -25,8 +25,18 @@
 
 #include <glib.h>
 
+typedef enum {
+    CHAT_STATE_STARTED,
+    CHAT_STATE_ACTIVE,
+    CHAT_STATE_PAUSED,
+    CHAT_STATE_COMPOSING,
+    CHAT_STATE_INACTIVE,
+    CHAT_STATE_GONE
+} chat_state_t;
+
 void chat_sessions_init(void);
 void chat_sessions_clear(void);
+void chat_sessions_close(void);
 void chat_session_start(const char * const recipient,
     gboolean recipient_supports);
 gboolean chat_session_exists(const char * const recipient);
@@ -35,15 +45,9 @@ gboolean chat_session_get_recipient_supports(const char * const recipient);
 void chat_session_set_recipient_supports(const char * const recipient,
     gboolean recipient_supports);
 
-void chat_session_set_composing(const char * const recipient);
-void chat_session_no_activity(const char * const recipient);
-gboolean chat_session_is_inactive(const char * const recipient);
-gboolean chat_session_is_active(const char * const recipient);
+gboolean chat_session_on_activity(const char * const recipient);
 void chat_session_set_active(const char * const recipient);
-gboolean chat_session_is_paused(const char * const recipient);
-gboolean chat_session_is_gone(const char * const recipient);
-void chat_session_set_gone(const char * const recipient);
-void chat_session_set_sent(const char * const recipient);
-gboolean chat_session_get_sent(const char * const recipient);
+void chat_sessions_check(void (*send_func)(const char * const recipient,
+    chat_state_t state));
 
 #endif
@@ -28,6 +28,7 @@
 #include <glib.h>
 
 #include "accounts.h"
+#include "batch.h"
 #include "chat_session.h"
 #include "command.h"
 #include "common.h"
@@ -41,6 +42,7 @@
 #include "preferences.h"
 #include "prof_autocomplete.h"
 #include "profanity.h"
+#include "reconnect.h"
 #include "muc.h"
 #include "theme.h"
 #include "tinyurl.h"
@@ -64,6 +66,7 @@ struct cmd_t {
     gchar** (*parser)(const char * const inp, int min, int max);
     int min_args;
     int max_args;
+    void (*autocomplete)(char *input, int *size, const char * const command);
     struct cmd_help_t help;
 };
 
@@ -75,17 +78,41 @@ static gboolean _cmd_set_boolean_preference(gchar *arg, struct cmd_help_t help,
     void (*set_func)(gboolean));
 
 static void _cmd_complete_parameters(char *input, int *size);
-static void _notify_autocomplete(char *input, int *size);
-static void _titlebar_autocomplete(char *input, int *size);
-static void _theme_autocomplete(char *input, int *size);
-static void _autoaway_autocomplete(char *input, int *size);
-static void _account_autocomplete(char *input, int *size);
-static void _parameter_autocomplete(char *input, int *size, char *command,
-    autocomplete_func func);
-static void _parameter_autocomplete_with_ac(char *input, int *size, char *command,
-    PAutocomplete ac);
+static void _parameter_autocomplete(char *input, int *size,
+    const char * const command, autocomplete_func func);
+static void _parameter_autocomplete_with_ac(char *input, int *size,
+    const char * const command, PAutocomplete ac);
+
+// parameter completers, called with the whole input line and the command
+static void _boolean_autocomplete(char *input, int *size,
+    const char * const command);
+static void _roster_autocomplete(char *input, int *size,
+    const char * const command);
+static void _connect_autocomplete(char *input, int *size,
+    const char * const command);
+static void _sub_autocomplete(char *input, int *size,
+    const char * const command);
+static void _help_autocomplete(char *input, int *size,
+    const char * const command);
+static void _who_autocomplete(char *input, int *size,
+    const char * const command);
+static void _prefs_autocomplete(char *input, int *size,
+    const char * const command);
+static void _log_autocomplete(char *input, int *size,
+    const char * const command);
+static void _notify_autocomplete(char *input, int *size,
+    const char * const command);
+static void _titlebar_autocomplete(char *input, int *size,
+    const char * const command);
+static void _theme_autocomplete(char *input, int *size,
+    const char * const command);
+static void _autoaway_autocomplete(char *input, int *size,
+    const char * const command);
+static void _account_autocomplete(char *input, int *size,
+    const char * const command);
 
 static int _strtoi(char *str, int *saveptr, int min, int max);
+static void _tiny_done(const char * const tiny, void *userdata);
 gchar** _cmd_parse_args(const char * const inp, int min, int max, int *num);
 
 // command prototypes
@@ -109,9 +136,11 @@ static gboolean _cmd_set_priority(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_set_reconnect(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_set_intype(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_set_flash(gchar **args, struct cmd_help_t help);
+static gboolean _cmd_set_multiline(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_set_splash(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_set_chlog(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_set_history(gchar **args, struct cmd_help_t help);
+static gboolean _cmd_set_histsize(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_set_states(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_set_outtype(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_set_gone(gchar **args, struct cmd_help_t help);
@@ -127,6 +156,7 @@ static gboolean _cmd_chat(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_xa(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_info(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_wins(gchar **args, struct cmd_help_t help);
+static gboolean _cmd_win(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_nick(gchar **args, struct cmd_help_t help);
 static gboolean _cmd_theme(gchar **args, struct cmd_help_t help);
 
@@ -139,7 +169,7 @@ static gboolean _cmd_theme(gchar **args, struct cmd_help_t help);
 static struct cmd_t main_commands[] =
 {
     { "/help",
-        _cmd_help, parse_args, 0, 1,
+        _cmd_help, parse_args, 0, 1, _help_autocomplete,
         { "/help [list|area|command]", "Get help on using Profanity",
         { "/help [list|area|command]",
           "-------------------------",
@@ -153,7 +183,7 @@ static struct cmd_t main_commands[] =
           NULL } } },
 
     { "/about",
-        _cmd_about, parse_args, 0, 0,
+        _cmd_about, parse_args, 0, 0, NULL,
         { "/about", "About Profanity",
         { "/about",
           "------",
@@ -161,7 +191,7 @@ static struct cmd_t main_commands[] =
           NULL  } } },
 
     { "/connect",
-        _cmd_connect, parse_args, 1, 2,
+        _cmd_connect, parse_args, 1, 2, _connect_autocomplete,
         { "/connect account [server]", "Login to a chat service.",
         { "/connect account [server]",
           "-------------------------",
@@ -174,7 +204,7 @@ static struct cmd_t main_commands[] =
           NULL  } } },
 
     { "/disconnect",
-        _cmd_disconnect, parse_args, 0, 0,
+        _cmd_disconnect, parse_args, 0, 0, NULL,
         { "/disconnect", "Logout of current session.",
         { "/disconnect",
           "------------------",
@@ -182,7 +212,7 @@ static struct cmd_t main_commands[] =
           NULL  } } },
 
     { "/account",
-        _cmd_account, parse_args, 1, 4,
+        _cmd_account, parse_args, 1, 4, _account_autocomplete,
         { "/account command [account] [property] [value]", "Manage accounts.",
         { "/account command [account] [property] [value]",
           "---------------------------------------------",
@@ -208,7 +238,7 @@ static struct cmd_t main_commands[] =
           NULL  } } },
 
     { "/prefs",
-        _cmd_prefs, parse_args, 0, 1,
+        _cmd_prefs, parse_args, 0, 1, _prefs_autocomplete,
         { "/prefs [area]", "Show configuration.",
         { "/prefs [area]",
           "-------------",
@@ -224,7 +254,7 @@ static struct cmd_t main_commands[] =
           NULL } } },
 
     { "/theme",
-        _cmd_theme, parse_args, 1, 2,
+        _cmd_theme, parse_args, 1, 2, _theme_autocomplete,
         { "/theme command [theme-name]", "Change colour theme.",
         { "/theme command [theme-name]",
           "---------------------------",
@@ -239,7 +269,7 @@ static struct cmd_t main_commands[] =
           NULL } } },
 
     { "/msg",
-        _cmd_msg, parse_args_with_freetext, 1, 2,
+        _cmd_msg, parse_args_with_freetext, 1, 2, _roster_autocomplete,
         { "/msg jid [message]", "Start chat with user.",
         { "/msg jid [message]",
           "------------------",
@@ -252,7 +282,7 @@ static struct cmd_t main_commands[] =
           NULL } } },
 
     { "/info",
-        _cmd_info, parse_args, 1, 1,
+        _cmd_info, parse_args, 1, 1, _roster_autocomplete,
         { "/info jid", "Find out a contacts presence information.",
         { "/info jid",
           "---------",
@@ -260,7 +290,7 @@ static struct cmd_t main_commands[] =
           NULL } } },
 
     { "/join",
-        _cmd_join, parse_args_with_freetext, 1, 2,
+        _cmd_join, parse_args_with_freetext, 1, 2, NULL,
         { "/join room [nick]", "Join a chat room.",
         { "/join room [nick]",
           "-----------------",
@@ -274,7 +304,7 @@ static struct cmd_t main_commands[] =
           NULL } } },
 
     { "/nick",
-        _cmd_nick, parse_args_with_freetext, 1, 1,
+        _cmd_nick, parse_args_with_freetext, 1, 1, NULL,
         { "/nick nickname", "Change nickname in chat room.",
         { "/nick nickname",
           "--------------",
@@ -286,15 +316,26 @@ static struct cmd_t main_commands[] =
           NULL } } },
 
     { "/wins",
-        _cmd_wins, parse_args, 0, 0,
+        _cmd_wins, parse_args, 0, 0, NULL,
         { "/wins", "List active windows.",
         { "/wins",
           "-----",
           "List all currently active windows and information about their usage.",
           NULL } } },
 
+    { "/win",
+        _cmd_win, parse_args, 1, 1, NULL,
+        { "/win num", "View a window.",
+        { "/win num",
+          "--------",
+          "Show the window with the given number, as listed by /wins.",
+          "Windows above 10 have no F-key or Alt-number shortcut.",
+          "",
+          "Example : /win 12",
+          NULL } } },
+
     { "/sub",
-        _cmd_sub, parse_args, 1, 2,
+        _cmd_sub, parse_args, 1, 2, _sub_autocomplete,
         { "/sub command [jid]", "Manage subscriptions.",
         { "/sub command [jid]",
           "------------------",
@@ -317,7 +358,7 @@ static struct cmd_t main_commands[] =
           NULL  } } },
 
     { "/tiny",
-        _cmd_tiny, parse_args, 1, 1,
+        _cmd_tiny, parse_args, 1, 1, NULL,
         { "/tiny url", "Send url as tinyurl in current chat.",
         { "/tiny url",
           "---------",
@@ -328,7 +369,7 @@ static struct cmd_t main_commands[] =
           NULL } } },
 
     { "/who",
-        _cmd_who, parse_args, 0, 1,
+        _cmd_who, parse_args, 0, 1, _who_autocomplete,
         { "/who [status]", "Show contacts with chosen status.",
         { "/who [status]",
           "-------------",
@@ -343,7 +384,7 @@ static struct cmd_t main_commands[] =
           NULL } } },
 
     { "/close",
-        _cmd_close, parse_args, 0, 0,
+        _cmd_close, parse_args, 0, 0, NULL,
         { "/close", "Close current chat window.",
         { "/close",
           "------",
@@ -353,7 +394,7 @@ static struct cmd_t main_commands[] =
           NULL } } },
 
     { "/quit",
-        _cmd_quit, parse_args, 0, 0,
+        _cmd_quit, parse_args, 0, 0, NULL,
         { "/quit", "Quit Profanity.",
         { "/quit",
           "-----",
@@ -364,7 +405,7 @@ static struct cmd_t main_commands[] =
 static struct cmd_t setting_commands[] =
 {
     { "/beep",
-        _cmd_set_beep, parse_args, 1, 1,
+        _cmd_set_beep, parse_args, 1, 1, _boolean_autocomplete,
         { "/beep on|off", "Terminal beep on new messages.",
         { "/beep on|off",
           "------------",
@@ -374,7 +415,7 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/notify",
-        _cmd_set_notify, parse_args, 2, 2,
+        _cmd_set_notify, parse_args, 2, 2, _notify_autocomplete,
         { "/notify type value", "Control various desktop noficiations.",
         { "/notify type value",
           "------------------",
@@ -394,7 +435,7 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/flash",
-        _cmd_set_flash, parse_args, 1, 1,
+        _cmd_set_flash, parse_args, 1, 1, _boolean_autocomplete,
         { "/flash on|off", "Terminal flash on new messages.",
         { "/flash on|off",
           "-------------",
@@ -403,8 +444,18 @@ static struct cmd_t setting_commands[] =
           "If the terminal doesn't support flashing, it may attempt to beep.",
           NULL } } },
 
+    { "/multiline",
+        _cmd_set_multiline, parse_args, 1, 1, _boolean_autocomplete,
+        { "/multiline on|off", "Keep line breaks in pasted messages.",
+        { "/multiline on|off",
+          "-----------------",
+          "When text containing line breaks is pasted into the input line, keep them and send the message as several lines.",
+          "Line breaks are shown in the input line as a highlighted pilcrow.",
+          "When off, line breaks are replaced with spaces. Pasted commands are always a single line.",
+          NULL } } },
+
     { "/intype",
-        _cmd_set_intype, parse_args, 1, 1,
+        _cmd_set_intype, parse_args, 1, 1, _boolean_autocomplete,
         { "/intype on|off", "Show when contact is typing.",
         { "/intype on|off",
           "--------------",
@@ -412,7 +463,7 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/splash",
-        _cmd_set_splash, parse_args, 1, 1,
+        _cmd_set_splash, parse_args, 1, 1, _boolean_autocomplete,
         { "/splash on|off", "Splash logo on startup.",
         { "/splash on|off",
           "--------------",
@@ -420,16 +471,19 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/vercheck",
-        _cmd_vercheck, parse_args, 0, 1,
-        { "/vercheck [on|off]", "Check for a new release.",
-        { "/vercheck [on|off]",
-          "------------------",
+        _cmd_vercheck, parse_args, 0, 2, _boolean_autocomplete,
+        { "/vercheck [on|off|interval hours]", "Check for a new release.",
+        { "/vercheck [on|off|interval hours]",
+          "---------------------------------",
           "Without a parameter will check for a new release.",
           "Switching on or off will enable/disable a version check when Profanity starts, and each time the /about command is run.",
+          "The interval sets how many hours the result of that check is remembered for, 0 checks every time.",
+          "",
+          "Example : /vercheck interval 168",
           NULL  } } },
 
     { "/titlebar",
-        _cmd_set_titlebar, parse_args, 2, 2,
+        _cmd_set_titlebar, parse_args, 2, 2, _titlebar_autocomplete,
         { "/titlebar property on|off", "Show various properties in the window title bar.",
         { "/titlebar property on|off",
           "-------------------------",
@@ -438,7 +492,7 @@ static struct cmd_t setting_commands[] =
           NULL  } } },
 
     { "/chlog",
-        _cmd_set_chlog, parse_args, 1, 1,
+        _cmd_set_chlog, parse_args, 1, 1, _boolean_autocomplete,
         { "/chlog on|off", "Chat logging to file",
         { "/chlog on|off",
           "-------------",
@@ -446,7 +500,7 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/states",
-        _cmd_set_states, parse_args, 1, 1,
+        _cmd_set_states, parse_args, 1, 1, _boolean_autocomplete,
         { "/states on|off", "Send chat states during a chat session.",
         { "/states on|off",
           "--------------",
@@ -455,7 +509,7 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/outtype",
-        _cmd_set_outtype, parse_args, 1, 1,
+        _cmd_set_outtype, parse_args, 1, 1, _boolean_autocomplete,
         { "/outtype on|off", "Send typing notification to recipient.",
         { "/outtype on|off",
           "--------------",
@@ -464,7 +518,7 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/gone",
-        _cmd_set_gone, parse_args, 1, 1,
+        _cmd_set_gone, parse_args, 1, 1, NULL,
         { "/gone minutes", "Send 'gone' state to recipient after a period.",
         { "/gone minutes",
           "--------------",
@@ -475,7 +529,7 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/history",
-        _cmd_set_history, parse_args, 1, 1,
+        _cmd_set_history, parse_args, 1, 1, _boolean_autocomplete,
         { "/history on|off", "Chat history in message windows.",
         { "/history on|off",
           "---------------",
@@ -483,8 +537,20 @@ static struct cmd_t setting_commands[] =
           "When history is enabled, previous messages are shown in chat windows.",
           NULL } } },
 
+    { "/histsize",
+        _cmd_set_histsize, parse_args, 1, 1, NULL,
+        { "/histsize lines", "Input history size.",
+        { "/histsize lines",
+          "---------------",
+          "Set the number of input lines remembered, and saved between sessions.",
+          "Each window has its own history, the console history holds all input.",
+          "Use the up and down arrows to move through the input history, and",
+          "ctrl-r to search backwards through it.",
+          "The default is 1000 lines.",
+          NULL } } },
+
     { "/log",
-        _cmd_set_log, parse_args, 2, 2,
+        _cmd_set_log, parse_args, 2, 2, _log_autocomplete,
         { "/log maxsize value", "Manage system logging settings.",
         { "/log maxsize value",
           "------------------",
@@ -493,16 +559,18 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/reconnect",
-        _cmd_set_reconnect, parse_args, 1, 1,
-        { "/reconnect seconds", "Set reconnect interval.",
+        _cmd_set_reconnect, parse_args, 1, 1, NULL,
+        { "/reconnect seconds", "Set the longest wait between reconnect attempts.",
         { "/reconnect seconds",
           "--------------------",
-          "Set the reconnect attempt interval in seconds for when the connection is lost.",
+          "Set the longest wait in seconds between reconnect attempts for when the connection is lost.",
+          "The first attempt is made within a second, and the wait doubles after each failed attempt up to this value.",
+          "Each wait is chosen at random up to its limit, so clients that lost the same server do not all return at once.",
           "A value of 0 will switch of reconnect attempts.",
           NULL } } },
 
     { "/autoping",
-        _cmd_set_autoping, parse_args, 1, 1,
+        _cmd_set_autoping, parse_args, 1, 1, NULL,
         { "/autoping seconds", "Server ping interval.",
         { "/autoping seconds",
           "-----------------",
@@ -511,7 +579,7 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/autoaway",
-        _cmd_set_autoaway, parse_args_with_freetext, 2, 2,
+        _cmd_set_autoaway, parse_args_with_freetext, 2, 2, _autoaway_autocomplete,
         { "/autoaway setting value", "Set auto idle/away properties.",
         { "/autoaway setting value",
           "-----------------------",
@@ -532,7 +600,7 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/priority",
-        _cmd_set_priority, parse_args, 1, 1,
+        _cmd_set_priority, parse_args, 1, 1, NULL,
         { "/priority value", "Set priority for connection.",
         { "/priority value",
           "---------------",
@@ -541,7 +609,7 @@ static struct cmd_t setting_commands[] =
           NULL } } },
 
     { "/statuses",
-        _cmd_set_statuses, parse_args, 1, 1,
+        _cmd_set_statuses, parse_args, 1, 1, _boolean_autocomplete,
         { "/statuses on|off", "Set notifications for status messages.",
         { "/statuses on|off",
           "---------------",
@@ -553,7 +621,7 @@ static struct cmd_t setting_commands[] =
 static struct cmd_t presence_commands[] =
 {
     { "/away",
-        _cmd_away, parse_args_with_freetext, 0, 1,
+        _cmd_away, parse_args_with_freetext, 0, 1, NULL,
         { "/away [msg]", "Set status to away.",
         { "/away [msg]",
           "-----------",
@@ -564,7 +632,7 @@ static struct cmd_t presence_commands[] =
           NULL } } },
 
     { "/chat",
-        _cmd_chat, parse_args_with_freetext, 0, 1,
+        _cmd_chat, parse_args_with_freetext, 0, 1, NULL,
         { "/chat [msg]", "Set status to chat (available for chat).",
         { "/chat [msg]",
           "-----------",
@@ -575,7 +643,7 @@ static struct cmd_t presence_commands[] =
           NULL } } },
 
     { "/dnd",
-        _cmd_dnd, parse_args_with_freetext, 0, 1,
+        _cmd_dnd, parse_args_with_freetext, 0, 1, NULL,
         { "/dnd [msg]", "Set status to dnd (do not disturb).",
         { "/dnd [msg]",
           "----------",
@@ -586,7 +654,7 @@ static struct cmd_t presence_commands[] =
           NULL } } },
 
     { "/online",
-        _cmd_online, parse_args_with_freetext, 0, 1,
+        _cmd_online, parse_args_with_freetext, 0, 1, NULL,
         { "/online [msg]", "Set status to online.",
         { "/online [msg]",
           "-------------",
@@ -597,7 +665,7 @@ static struct cmd_t presence_commands[] =
           NULL } } },
 
     { "/xa",
-        _cmd_xa, parse_args_with_freetext, 0, 1,
+        _cmd_xa, parse_args_with_freetext, 0, 1, NULL,
         { "/xa [msg]", "Set status to xa (extended away).",
         { "/xa [msg]",
           "---------",
@@ -608,6 +676,9 @@ static struct cmd_t presence_commands[] =
           NULL } } },
 };
 
+// all commands by name, e.g. "/msg"
+static GHashTable *commands;
+
 static PAutocomplete commands_ac;
 static PAutocomplete who_ac;
 static PAutocomplete help_ac;
@@ -630,6 +701,7 @@ cmd_init(void)
 {
     log_info("Initialising commands");
 
+    commands = g_hash_table_new(g_str_hash, g_str_equal);
     commands_ac = p_autocomplete_new();
     who_ac = p_autocomplete_new();
 
@@ -697,18 +769,21 @@ cmd_init(void)
     unsigned int i;
     for (i = 0; i < ARRAY_SIZE(main_commands); i++) {
         struct cmd_t *pcmd = main_commands+i;
+        g_hash_table_insert(commands, (gpointer)pcmd->cmd, pcmd);
         p_autocomplete_add(commands_ac, (gchar *)strdup(pcmd->cmd));
         p_autocomplete_add(help_ac, (gchar *)strdup(pcmd->cmd+1));
     }
 
     for (i = 0; i < ARRAY_SIZE(setting_commands); i++) {
         struct cmd_t *pcmd = setting_commands+i;
+        g_hash_table_insert(commands, (gpointer)pcmd->cmd, pcmd);
         p_autocomplete_add(commands_ac, (gchar *)strdup(pcmd->cmd));
         p_autocomplete_add(help_ac, (gchar *)strdup(pcmd->cmd+1));
     }
 
     for (i = 0; i < ARRAY_SIZE(presence_commands); i++) {
         struct cmd_t *pcmd = presence_commands+i;
+        g_hash_table_insert(commands, (gpointer)pcmd->cmd, pcmd);
         p_autocomplete_add(commands_ac, (gchar *)strdup(pcmd->cmd));
         p_autocomplete_add(help_ac, (gchar *)strdup(pcmd->cmd+1));
         p_autocomplete_add(who_ac, (gchar *)strdup(pcmd->cmd+1));
@@ -724,6 +799,7 @@ cmd_init(void)
 void
 cmd_close(void)
 {
+    g_hash_table_destroy(commands);
     p_autocomplete_free(commands_ac);
     p_autocomplete_free(who_ac);
     p_autocomplete_free(help_ac);
@@ -738,6 +814,7 @@ cmd_close(void)
         p_autocomplete_free(theme_load_ac);
     }
     p_autocomplete_free(account_ac);
+    history_close();
 }
 
 // Command autocompletion functions
@@ -759,7 +836,7 @@ cmd_autocomplete(char *input, int *size)
         if (found != NULL) {
             auto_msg = (char *) malloc((strlen(found) + 1) * sizeof(char));
             strcpy(auto_msg, found);
-            inp_replace_input(input, auto_msg, size);
+            inp_replace_input(auto_msg);
             free(auto_msg);
             free(found);
         }
@@ -883,7 +960,11 @@ cmd_execute_default(const char * const inp)
         }
     } else if (win_current_is_chat() || win_current_is_private()) {
         jabber_conn_status_t status = jabber_get_connection_status();
-        if (status != JABBER_CONNECTED) {
+
+        // only messages to contacts are kept while reconnecting
+        if ((status != JABBER_CONNECTED) &&
+                ((reconnect_get_state() == RECONNECT_IDLE) ||
+                win_current_is_private())) {
             win_current_show("You are not currently connected.");
         } else {
             char *recipient = win_current_get_recipient();
@@ -895,6 +976,9 @@ cmd_execute_default(const char * const inp)
             }
 
             win_show_outgoing_msg("me", recipient, inp);
+            if (status != JABBER_CONNECTED) {
+                win_current_show("Reconnecting, the message will be sent when connected.");
+            }
             free(recipient);
         }
     } else {
@@ -904,56 +988,24 @@ cmd_execute_default(const char * const inp)
     return TRUE;
 }
 
+// complete the arguments using the completer for the command typed
 static void
 _cmd_complete_parameters(char *input, int *size)
 {
-    _parameter_autocomplete(input, size, "/beep",
-        prefs_autocomplete_boolean_choice);
-    _parameter_autocomplete(input, size, "/intype",
-        prefs_autocomplete_boolean_choice);
-    _parameter_autocomplete(input, size, "/states",
-        prefs_autocomplete_boolean_choice);
-    _parameter_autocomplete(input, size, "/outtype",
-        prefs_autocomplete_boolean_choice);
-    _parameter_autocomplete(input, size, "/flash",
-        prefs_autocomplete_boolean_choice);
-    _parameter_autocomplete(input, size, "/splash",
-        prefs_autocomplete_boolean_choice);
-    _parameter_autocomplete(input, size, "/chlog",
-        prefs_autocomplete_boolean_choice);
-    _parameter_autocomplete(input, size, "/history",
-        prefs_autocomplete_boolean_choice);
-    _parameter_autocomplete(input, size, "/vercheck",
-        prefs_autocomplete_boolean_choice);
-    _parameter_autocomplete(input, size, "/statuses",
-        prefs_autocomplete_boolean_choice);
-
-    if (win_current_is_groupchat()) {
-        PAutocomplete nick_ac = muc_get_roster_ac(win_current_get_recipient());
-        if (nick_ac != NULL) {
-            _parameter_autocomplete_with_ac(input, size, "/msg", nick_ac);
-            _parameter_autocomplete_with_ac(input, size, "/info", nick_ac);
-        }
-    } else {
-        _parameter_autocomplete(input, size, "/msg",
-            contact_list_find_contact);
-        _parameter_autocomplete(input, size, "/info",
-            contact_list_find_contact);
+    char *space = memchr(input, ' ', *size);
+    if (space == NULL) {
+        return;
     }
 
-    _parameter_autocomplete(input, size, "/connect",
-        accounts_find_enabled);
-    _parameter_autocomplete_with_ac(input, size, "/sub", sub_ac);
-    _parameter_autocomplete_with_ac(input, size, "/help", help_ac);
-    _parameter_autocomplete_with_ac(input, size, "/who", who_ac);
-    _parameter_autocomplete_with_ac(input, size, "/prefs", prefs_ac);
-    _parameter_autocomplete_with_ac(input, size, "/log", log_ac);
+    int len = space - input;
+    char command[len + 1];
+    strncpy(command, input, len);
+    command[len] = '\0';
 
-    _notify_autocomplete(input, size);
-    _autoaway_autocomplete(input, size);
-    _titlebar_autocomplete(input, size);
-    _theme_autocomplete(input, size);
-    _account_autocomplete(input, size);
+    struct cmd_t *cmd = _cmd_get_command(command);
+    if ((cmd != NULL) && (cmd->autocomplete != NULL)) {
+        cmd->autocomplete(input, size, cmd->cmd);
+    }
 }
 
 // The command functions
@@ -974,12 +1026,16 @@ _cmd_connect(gchar **args, struct cmd_help_t help)
         char *lower = g_utf8_strdown(user, -1);
         char *jid;
 
-        status_bar_get_password();
-        status_bar_refresh();
         char passwd[21];
-        inp_block();
-        inp_get_password(passwd);
-        inp_non_block();
+        if (batch_active()) {
+            batch_get_password(passwd);
+        } else {
+            status_bar_get_password();
+            status_bar_refresh();
+            inp_block();
+            inp_get_password(passwd);
+            inp_non_block();
+        }
 
         ProfAccount *account = accounts_get_account(lower);
         if (account != NULL) {
@@ -1244,7 +1300,9 @@ _cmd_sub(gchar **args, struct cmd_help_t help)
 static gboolean
 _cmd_disconnect(gchar **args, struct cmd_help_t help)
 {
-    if (jabber_get_connection_status() == JABBER_CONNECTED) {
+    if ((jabber_get_connection_status() == JABBER_CONNECTED) ||
+            (jabber_get_connection_status() == JABBER_CONNECTING) ||
+            (reconnect_get_state() == RECONNECT_WAITING)) {
         char *jid = strdup(jabber_get_jid());
         prof_handle_disconnect(jid);
         free(jid);
@@ -1270,6 +1328,21 @@ _cmd_wins(gchar **args, struct cmd_help_t help)
     return TRUE;
 }
 
+static gboolean
+_cmd_win(gchar **args, struct cmd_help_t help)
+{
+    int num = 0;
+    if (_strtoi(args[0], &num, 1, INT_MAX) == 0) {
+        if (ui_win_exists(num - 1)) {
+            ui_switch_win(num - 1);
+        } else {
+            cons_show("Window %d does not exist.", num);
+        }
+    }
+
+    return TRUE;
+}
+
 static gboolean
 _cmd_help(gchar **args, struct cmd_help_t help)
 {
@@ -1535,16 +1608,14 @@ _cmd_msg(gchar **args, struct cmd_help_t help)
 
     jabber_conn_status_t conn_status = jabber_get_connection_status();
 
-    if (conn_status != JABBER_CONNECTED) {
+    // messages to contacts are queued while reconnecting
+    if ((conn_status != JABBER_CONNECTED) &&
+            ((reconnect_get_state() == RECONNECT_IDLE) ||
+            win_current_is_groupchat() || muc_room_is_active(usr))) {
         cons_show("You are not currently connected.");
         return TRUE;
     }
 
-    if (ui_windows_full()) {
-        cons_bad_show("Windows all used, close a window and try again.");
-        return TRUE;
-    }
-
     if (win_current_is_groupchat()) {
         char *room_name = win_current_get_recipient();
         if (muc_nick_in_roster(room_name, usr)) {
@@ -1572,6 +1643,9 @@ _cmd_msg(gchar **args, struct cmd_help_t help)
         if (msg != NULL) {
             jabber_send(msg, usr);
             win_show_outgoing_msg("me", usr, msg);
+            if (conn_status != JABBER_CONNECTED) {
+                cons_show("Reconnecting, the message will be sent when connected.");
+            }
 
             if (prefs_get_chlog()) {
                 const char *jid = jabber_get_jid();
@@ -1617,8 +1691,6 @@ _cmd_join(gchar **args, struct cmd_help_t help)
 
     if (conn_status != JABBER_CONNECTED) {
         cons_show("You are not currently connected.");
-    } else if (ui_windows_full()) {
-        cons_bad_show("Windows all used, close a window and try again.");
     } else {
         // if no nick, set to first part of jid
         if (nick == NULL) {
@@ -1671,28 +1743,36 @@ _cmd_tiny(gchar **args, struct cmd_help_t help)
         }
         g_string_free(error, TRUE);
     } else if (win_current_is_chat()) {
-        char *tiny = tinyurl_get(url);
+        char *recipient = win_current_get_recipient();
+        tinyurl_get(url, _tiny_done, recipient);
+    } else {
+        cons_show("/tiny can only be used in chat windows");
+    }
 
-        if (tiny != NULL) {
-            char *recipient = win_current_get_recipient();
-            jabber_send(tiny, recipient);
+    return TRUE;
+}
 
-            if (prefs_get_chlog()) {
-                const char *jid = jabber_get_jid();
-                chat_log_chat(jid, recipient, tiny, PROF_OUT_LOG, NULL);
-            }
+static void
+_tiny_done(const char * const tiny, void *userdata)
+{
+    char *recipient = userdata;
 
-            win_show_outgoing_msg("me", recipient, tiny);
-            free(recipient);
-            free(tiny);
-        } else {
-            cons_bad_show("Couldn't get tinyurl.");
-        }
+    if (tiny == NULL) {
+        cons_bad_show("Couldn't get tinyurl.");
+    } else if (jabber_get_connection_status() != JABBER_CONNECTED) {
+        cons_show("You are not currently connected.");
     } else {
-        cons_show("/tiny can only be used in chat windows");
+        jabber_send(tiny, recipient);
+
+        if (prefs_get_chlog()) {
+            const char *jid = jabber_get_jid();
+            chat_log_chat(jid, recipient, tiny, PROF_OUT_LOG, NULL);
+        }
+
+        win_show_outgoing_msg("me", recipient, tiny);
     }
 
-    return TRUE;
+    free(recipient);
 }
 
 static gboolean
@@ -1718,10 +1798,9 @@ _cmd_close(gchar **args, struct cmd_help_t help)
 
                 // send <gone/> chat state before closing
                 if (chat_session_get_recipient_supports(recipient)) {
-                    chat_session_set_gone(recipient);
                     jabber_send_gone(recipient);
-                    chat_session_end(recipient);
                 }
+                chat_session_end(recipient);
             }
         }
     }
@@ -1869,7 +1948,7 @@ _cmd_set_reconnect(gchar **args, struct cmd_help_t help)
         if (intval == 0) {
             cons_show("Reconnect disabled.", intval);
         } else {
-            cons_show("Reconnect interval set to %d seconds.", intval);
+            cons_show("Longest wait between reconnect attempts set to %d seconds.", intval);
         }
     } else {
         cons_show("Usage: %s", help.usage);
@@ -1886,7 +1965,6 @@ _cmd_set_autoping(gchar **args, struct cmd_help_t help)
 
     if (_strtoi(value, &intval, 0, INT_MAX) == 0) {
         prefs_set_autoping(intval);
-        jabber_set_autoping(intval);
         if (intval == 0) {
             cons_show("Autoping disabled.", intval);
         } else {
@@ -1987,6 +2065,19 @@ _cmd_vercheck(gchar **args, struct cmd_help_t help)
     if (num_args == 0) {
         cons_check_version(TRUE);
         return TRUE;
+    } else if (strcmp(args[0], "interval") == 0) {
+        int intval;
+        if (num_args != 2) {
+            cons_show("Usage: %s", help.usage);
+        } else if (_strtoi(args[1], &intval, 0,
+                PREFS_MAX_VERCHECK_INTERVAL) == 0) {
+            prefs_set_vercheck_interval(intval);
+            cons_show("Version check interval set to %d hours.", intval);
+        }
+        return TRUE;
+    } else if (num_args != 1) {
+        cons_show("Usage: %s", help.usage);
+        return TRUE;
     } else {
         return _cmd_set_boolean_preference(args[0], help,
             "Version checking", prefs_set_vercheck);
@@ -2000,6 +2091,13 @@ _cmd_set_flash(gchar **args, struct cmd_help_t help)
         "Screen flash", prefs_set_flash);
 }
 
+static gboolean
+_cmd_set_multiline(gchar **args, struct cmd_help_t help)
+{
+    return _cmd_set_boolean_preference(args[0], help,
+        "Multi line paste", prefs_set_multiline);
+}
+
 static gboolean
 _cmd_set_intype(gchar **args, struct cmd_help_t help)
 {
@@ -2028,6 +2126,22 @@ _cmd_set_history(gchar **args, struct cmd_help_t help)
         "Chat history", prefs_set_history);
 }
 
+static gboolean
+_cmd_set_histsize(gchar **args, struct cmd_help_t help)
+{
+    char *value = args[0];
+    int intval;
+
+    if (_strtoi(value, &intval, 1, PREFS_MAX_HISTSIZE) == 0) {
+        prefs_set_histsize(intval);
+        cons_show("Input history size set to %d lines.", intval);
+    } else {
+        cons_show("Usage: %s", help.usage);
+    }
+
+    return TRUE;
+}
+
 static gboolean
 _cmd_away(gchar **args, struct cmd_help_t help)
 {
@@ -2127,33 +2241,11 @@ _cmd_set_boolean_preference(gchar *arg, struct cmd_help_t help,
 static struct cmd_t *
 _cmd_get_command(const char * const command)
 {
-    unsigned int i;
-    for (i = 0; i < ARRAY_SIZE(main_commands); i++) {
-        struct cmd_t *pcmd = main_commands+i;
-        if (strcmp(pcmd->cmd, command) == 0) {
-            return pcmd;
-        }
-    }
-
-    for (i = 0; i < ARRAY_SIZE(setting_commands); i++) {
-        struct cmd_t *pcmd = setting_commands+i;
-        if (strcmp(pcmd->cmd, command) == 0) {
-            return pcmd;
-        }
-    }
-
-    for (i = 0; i < ARRAY_SIZE(presence_commands); i++) {
-        struct cmd_t *pcmd = presence_commands+i;
-        if (strcmp(pcmd->cmd, command) == 0) {
-            return pcmd;
-        }
-    }
-
-    return NULL;
+    return g_hash_table_lookup(commands, command);
 }
 
 static void
-_parameter_autocomplete(char *input, int *size, char *command,
+_parameter_autocomplete(char *input, int *size, const char * const command,
     autocomplete_func func)
 {
     char *found = NULL;
@@ -2173,7 +2265,7 @@ _parameter_autocomplete(char *input, int *size, char *command,
             auto_msg = (char *) malloc((len + (strlen(found) + 1)) * sizeof(char));
             strcpy(auto_msg, command_cpy);
             strcat(auto_msg, found);
-            inp_replace_input(input, auto_msg, size);
+            inp_replace_input(auto_msg);
             free(auto_msg);
             free(found);
         }
@@ -2182,8 +2274,8 @@ _parameter_autocomplete(char *input, int *size, char *command,
 }
 
 static void
-_parameter_autocomplete_with_ac(char *input, int *size, char *command,
-    PAutocomplete ac)
+_parameter_autocomplete_with_ac(char *input, int *size,
+    const char * const command, PAutocomplete ac)
 {
     char *found = NULL;
     char *auto_msg = NULL;
@@ -2202,7 +2294,7 @@ _parameter_autocomplete_with_ac(char *input, int *size, char *command,
             auto_msg = (char *) malloc((len + (strlen(found) + 1)) * sizeof(char));
             strcpy(auto_msg, command_cpy);
             strcat(auto_msg, found);
-            inp_replace_input(input, auto_msg, size);
+            inp_replace_input(auto_msg);
             free(auto_msg);
             free(found);
         }
@@ -2211,7 +2303,65 @@ _parameter_autocomplete_with_ac(char *input, int *size, char *command,
 }
 
 static void
-_notify_autocomplete(char *input, int *size)
+_boolean_autocomplete(char *input, int *size, const char * const command)
+{
+    _parameter_autocomplete(input, size, command,
+        prefs_autocomplete_boolean_choice);
+}
+
+// room members when in a room, otherwise contacts
+static void
+_roster_autocomplete(char *input, int *size, const char * const command)
+{
+    if (win_current_is_groupchat()) {
+        PAutocomplete nick_ac = muc_get_roster_ac(win_current_get_recipient());
+        if (nick_ac != NULL) {
+            _parameter_autocomplete_with_ac(input, size, command, nick_ac);
+        }
+    } else {
+        _parameter_autocomplete(input, size, command,
+            contact_list_find_contact);
+    }
+}
+
+static void
+_connect_autocomplete(char *input, int *size, const char * const command)
+{
+    _parameter_autocomplete(input, size, command, accounts_find_enabled);
+}
+
+static void
+_sub_autocomplete(char *input, int *size, const char * const command)
+{
+    _parameter_autocomplete_with_ac(input, size, command, sub_ac);
+}
+
+static void
+_help_autocomplete(char *input, int *size, const char * const command)
+{
+    _parameter_autocomplete_with_ac(input, size, command, help_ac);
+}
+
+static void
+_who_autocomplete(char *input, int *size, const char * const command)
+{
+    _parameter_autocomplete_with_ac(input, size, command, who_ac);
+}
+
+static void
+_prefs_autocomplete(char *input, int *size, const char * const command)
+{
+    _parameter_autocomplete_with_ac(input, size, command, prefs_ac);
+}
+
+static void
+_log_autocomplete(char *input, int *size, const char * const command)
+{
+    _parameter_autocomplete_with_ac(input, size, command, log_ac);
+}
+
+static void
+_notify_autocomplete(char *input, int *size, const char * const command)
 {
     char *found = NULL;
     char *auto_msg = NULL;
@@ -2228,7 +2378,7 @@ _notify_autocomplete(char *input, int *size)
             auto_msg = (char *) malloc((16 + (strlen(found) + 1)) * sizeof(char));
             strcpy(auto_msg, "/notify message ");
             strcat(auto_msg, found);
-            inp_replace_input(input, auto_msg, size);
+            inp_replace_input(auto_msg);
             free(auto_msg);
             free(found);
         }
@@ -2242,7 +2392,7 @@ _notify_autocomplete(char *input, int *size)
             auto_msg = (char *) malloc((15 + (strlen(found) + 1)) * sizeof(char));
             strcpy(auto_msg, "/notify typing ");
             strcat(auto_msg, found);
-            inp_replace_input(input, auto_msg, size);
+            inp_replace_input(auto_msg);
             free(auto_msg);
             free(found);
         }
@@ -2252,7 +2402,7 @@ _notify_autocomplete(char *input, int *size)
 }
 
 static void
-_titlebar_autocomplete(char *input, int *size)
+_titlebar_autocomplete(char *input, int *size, const char * const command)
 {
     char *found = NULL;
     char *auto_msg = NULL;
@@ -2269,7 +2419,7 @@ _titlebar_autocomplete(char *input, int *size)
             auto_msg = (char *) malloc((18 + (strlen(found) + 1)) * sizeof(char));
             strcpy(auto_msg, "/titlebar version ");
             strcat(auto_msg, found);
-            inp_replace_input(input, auto_msg, size);
+            inp_replace_input(auto_msg);
             free(auto_msg);
             free(found);
         }
@@ -2279,7 +2429,7 @@ _titlebar_autocomplete(char *input, int *size)
 }
 
 static void
-_autoaway_autocomplete(char *input, int *size)
+_autoaway_autocomplete(char *input, int *size, const char * const command)
 {
     char *found = NULL;
     char *auto_msg = NULL;
@@ -2298,7 +2448,7 @@ _autoaway_autocomplete(char *input, int *size)
             auto_msg = (char *) malloc((16 + (strlen(found) + 1)) * sizeof(char));
             strcpy(auto_msg, "/autoaway check ");
             strcat(auto_msg, found);
-            inp_replace_input(input, auto_msg, size);
+            inp_replace_input(auto_msg);
             free(auto_msg);
             free(found);
         }
@@ -2308,7 +2458,7 @@ _autoaway_autocomplete(char *input, int *size)
 }
 
 static void
-_theme_autocomplete(char *input, int *size)
+_theme_autocomplete(char *input, int *size, const char * const command)
 {
     if ((strncmp(input, "/theme set ", 11) == 0) && (*size > 11)) {
         if (theme_load_ac == NULL) {
@@ -2328,7 +2478,7 @@ _theme_autocomplete(char *input, int *size)
 }
 
 static void
-_account_autocomplete(char *input, int *size)
+_account_autocomplete(char *input, int *size, const char * const command)
 {
     if ((strncmp(input, "/account set ", 13) == 0) && (*size > 13)) {
         _parameter_autocomplete(input, size, "/account set", accounts_find_all);
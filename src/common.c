@@ -33,6 +33,11 @@
 // and page size is at least 4KB
 #define READ_BUF_SIZE 4088
 
+// the characters encode_xml escapes
+#define XML_SPECIAL_CHARS "&<>"
+
+static const char * _xml_entity(char ch);
+
 // backwards compatibility for GLib version < 2.28
 void
 p_slist_free_full(GSList *items, GDestroyNotify free_func)
@@ -53,15 +58,14 @@ create_dir(char *name)
             e = mkdir(name, S_IRWXU);
 }
 
+/*
+ * Replace every occurrence of substr in string.  The occurrences are
+ * counted first so the result is allocated and written once
+ */
 char *
 str_replace(const char *string, const char *substr,
     const char *replacement)
 {
-    char *tok = NULL;
-    char *newstr = NULL;
-    char *oldstr = NULL;
-    char *head = NULL;
-
     if (string == NULL)
         return NULL;
 
@@ -70,30 +74,31 @@ str_replace(const char *string, const char *substr,
          (strcmp(substr, "") == 0))
         return strdup (string);
 
-    newstr = strdup (string);
-    head = newstr;
-
-    while ( (tok = strstr ( head, substr ))) {
-        oldstr = newstr;
-        newstr = malloc ( strlen ( oldstr ) - strlen ( substr ) +
-            strlen ( replacement ) + 1 );
+    size_t sub_len = strlen(substr);
+    size_t rep_len = strlen(replacement);
 
-        if ( newstr == NULL ) {
-            free (oldstr);
-            return NULL;
-        }
+    size_t count = 0;
+    const char *tok = string;
+    while ((tok = strstr(tok, substr)) != NULL) {
+        count++;
+        tok += sub_len;
+    }
 
-        memcpy ( newstr, oldstr, tok - oldstr );
-        memcpy ( newstr + (tok - oldstr), replacement, strlen ( replacement ) );
-        memcpy ( newstr + (tok - oldstr) + strlen( replacement ),
-            tok + strlen ( substr ),
-            strlen ( oldstr ) - strlen ( substr ) - ( tok - oldstr ) );
-        memset ( newstr + strlen ( oldstr ) - strlen ( substr ) +
-            strlen ( replacement ) , 0, 1 );
+    size_t len = strlen(string);
+    char *newstr = malloc(len - (count * sub_len) + (count * rep_len) + 1);
+    if (newstr == NULL)
+        return NULL;
 
-        head = newstr + (tok - oldstr) + strlen( replacement );
-        free (oldstr);
+    char *out = newstr;
+    const char *head = string;
+    while ((tok = strstr(head, substr)) != NULL) {
+        memcpy(out, head, tok - head);
+        out += tok - head;
+        memcpy(out, replacement, rep_len);
+        out += rep_len;
+        head = tok + sub_len;
     }
+    strcpy(out, head);
 
     return newstr;
 }
@@ -110,17 +115,51 @@ str_contains(char str[], int size, char ch)
     return 0;
 }
 
+/*
+ * Escape &, < and > in xml.  strcspn finds the next special character,
+ * which the C library does a word or vector at a time, so plain text is
+ * copied in runs.  The first pass sizes the result, the second fills it
+ */
 char *
 encode_xml(const char * const xml)
 {
-    char *coded_msg = str_replace(xml, "&", "&amp;");
-    char *coded_msg2 = str_replace(coded_msg, "<", "&lt;");
-    char *coded_msg3 = str_replace(coded_msg2, ">", "&gt;");
+    if (xml == NULL)
+        return NULL;
 
-    free(coded_msg);
-    free(coded_msg2);
+    size_t size = 0;
+    const char *curr = xml;
+    while (TRUE) {
+        size_t run = strcspn(curr, XML_SPECIAL_CHARS);
+        size += run;
+        curr += run;
+        if (*curr == '\0')
+            break;
+        size += strlen(_xml_entity(*curr));
+        curr++;
+    }
+
+    char *result = malloc(size + 1);
+    if (result == NULL)
+        return NULL;
+
+    char *out = result;
+    curr = xml;
+    while (TRUE) {
+        size_t run = strcspn(curr, XML_SPECIAL_CHARS);
+        memcpy(out, curr, run);
+        out += run;
+        curr += run;
+        if (*curr == '\0')
+            break;
+        const char *entity = _xml_entity(*curr);
+        size_t entity_len = strlen(entity);
+        memcpy(out, entity, entity_len);
+        out += entity_len;
+        curr++;
+    }
+    *out = '\0';
 
-    return coded_msg3;
+    return result;
 }
 
 char *
@@ -167,3 +206,16 @@ prof_getline(FILE *stream)
     free(buf);
     return s;
 }
+
+static const char *
+_xml_entity(char ch)
+{
+    switch (ch) {
+    case '&':
+        return "&amp;";
+    case '<':
+        return "&lt;";
+    default:
+        return "&gt;";
+    }
+}
@@ -114,6 +114,24 @@ contact_list_update_contact(const char * const jid, const char * const presence,
     return changed;
 }
 
+/*
+ * Keep the contacts but mark them all offline, used while reconnecting
+ */
+void
+contact_list_set_all_offline(void)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, contacts);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        PContact contact = value;
+        p_contact_set_presence(contact, "offline");
+        p_contact_set_status(contact, NULL);
+        p_contact_set_last_activity(contact, NULL);
+    }
+}
+
 void
 contact_list_update_subscription(const char * const jid,
     const char * const subscription, gboolean pending_out)
@@ -0,0 +1,206 @@
+/*
+ * dispatch.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "dispatch.h"
+
+// handlers for inbound stanzas, found by the stanza name, its type and the
+// namespace of one of its children, e.g. an iq of type get holding a
+// urn:xmpp:ping element.  The three are joined into one key so a stanza
+// costs a hash lookup per namespaced child rather than a comparison per
+// handler.  Each handler is counted and timed under its label
+
+#define DISPATCH_KEY_MAX 256
+
+// matches any type, including none
+#define DISPATCH_ANY_TYPE "*"
+
+typedef struct dispatch_entry_t {
+    char *label;
+    dispatch_handler_t handler;
+    guint count;
+    gint64 total;
+    gint64 max;
+} DispatchEntry;
+
+static GHashTable *entries = NULL;
+
+static gboolean _make_key(char *key, const char * const name,
+    const char * const type, const char * const ns);
+static DispatchEntry * _lookup(const char * const name,
+    const char * const type, const char * const ns);
+static void _entry_free(DispatchEntry *entry);
+
+/*
+ * Call handler for stanzas called name of the given type, with a child in
+ * namespace ns.  A NULL type matches stanzas of any type, a NULL ns those
+ * not matched by a child's namespace
+ */
+void
+dispatch_add(const char * const label, const char * const name,
+    const char * const type, const char * const ns,
+    dispatch_handler_t handler)
+{
+    char key[DISPATCH_KEY_MAX];
+    if (!_make_key(key, name, type != NULL ? type : DISPATCH_ANY_TYPE, ns)) {
+        return;
+    }
+
+    if (entries == NULL) {
+        entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            (GDestroyNotify)_entry_free);
+    }
+
+    DispatchEntry *entry = malloc(sizeof(DispatchEntry));
+    entry->label = strdup(label);
+    entry->handler = handler;
+    entry->count = 0;
+    entry->total = 0;
+    entry->max = 0;
+    g_hash_table_replace(entries, strdup(key), entry);
+}
+
+/*
+ * Pass stanza to the handler for its name, type and ns, preferring one
+ * added for the type over one for any type.  Returns FALSE if there is
+ * no handler
+ */
+gboolean
+dispatch_call(const char * const name, const char * const type,
+    const char * const ns, xmpp_stanza_t * const stanza)
+{
+    DispatchEntry *entry = _lookup(name, type != NULL ? type : "", ns);
+    if (entry == NULL) {
+        entry = _lookup(name, DISPATCH_ANY_TYPE, ns);
+    }
+    if (entry == NULL) {
+        return FALSE;
+    }
+
+    gint64 start = g_get_monotonic_time();
+    entry->handler(stanza);
+    gint64 elapsed = g_get_monotonic_time() - start;
+
+    entry->count++;
+    entry->total += elapsed;
+    if (elapsed > entry->max) {
+        entry->max = elapsed;
+    }
+
+    return TRUE;
+}
+
+/*
+ * The number of stanzas passed to handlers added under label
+ */
+guint
+dispatch_get_count(const char * const label)
+{
+    guint result = 0;
+    if (entries == NULL) {
+        return result;
+    }
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        DispatchEntry *entry = value;
+        if (strcmp(entry->label, label) == 0) {
+            result += entry->count;
+        }
+    }
+
+    return result;
+}
+
+void
+dispatch_report(FILE *stream)
+{
+    if (entries == NULL) {
+        return;
+    }
+
+    GList *keys = g_list_sort(g_hash_table_get_keys(entries),
+        (GCompareFunc)g_strcmp0);
+
+    fprintf(stream, "%-24s %-40s %8s %10s %9s %9s\n", "dispatch", "stanza",
+        "count", "total ms", "mean us", "max us");
+
+    GList *curr = keys;
+    while (curr != NULL) {
+        DispatchEntry *entry = g_hash_table_lookup(entries, curr->data);
+        if (entry->count > 0) {
+            fprintf(stream, "%-24s %-40s %8u %10.2f %9.1f %9.1f\n",
+                entry->label, (char *)curr->data, entry->count,
+                entry->total / 1e3, (gdouble)entry->total / entry->count,
+                (gdouble)entry->max);
+        }
+        curr = g_list_next(curr);
+    }
+
+    g_list_free(keys);
+}
+
+void
+dispatch_close(void)
+{
+    if (entries != NULL) {
+        g_hash_table_destroy(entries);
+        entries = NULL;
+    }
+}
+
+// name, type and ns joined into key, FALSE if they don't fit
+static gboolean
+_make_key(char *key, const char * const name, const char * const type,
+    const char * const ns)
+{
+    int len = snprintf(key, DISPATCH_KEY_MAX, "%s %s %s", name, type,
+        ns != NULL ? ns : "");
+
+    return (len >= 0) && (len < DISPATCH_KEY_MAX);
+}
+
+static DispatchEntry *
+_lookup(const char * const name, const char * const type,
+    const char * const ns)
+{
+    char key[DISPATCH_KEY_MAX];
+    if ((entries == NULL) || !_make_key(key, name, type, ns)) {
+        return NULL;
+    }
+
+    return g_hash_table_lookup(entries, key);
+}
+
+static void
+_entry_free(DispatchEntry *entry)
+{
+    free(entry->label);
+    free(entry);
+}
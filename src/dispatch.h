@@ -0,0 +1,42 @@
+/*
+ * dispatch.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stdio.h>
+
+#include <glib.h>
+#include <strophe.h>
+
+typedef int (*dispatch_handler_t)(xmpp_stanza_t * const stanza);
+
+void dispatch_add(const char * const label, const char * const name,
+    const char * const type, const char * const ns,
+    dispatch_handler_t handler);
+gboolean dispatch_call(const char * const name, const char * const type,
+    const char * const ns, xmpp_stanza_t * const stanza);
+guint dispatch_get_count(const char * const label);
+void dispatch_report(FILE *stream);
+void dispatch_close(void);
+
+#endif
@@ -99,6 +99,32 @@ files_get_accounts_file(void)
     return result;
 }
 
+gchar *
+files_get_history_file(void)
+{
+    gchar *xdg_data = xdg_get_data_home();
+    GString *history_file = g_string_new(xdg_data);
+    g_string_append(history_file, "/profanity/inputhistory");
+    gchar *result = strdup(history_file->str);
+    g_free(xdg_data);
+    g_string_free(history_file, TRUE);
+
+    return result;
+}
+
+gchar *
+files_get_cache_file(void)
+{
+    gchar *xdg_data = xdg_get_data_home();
+    GString *cache_file = g_string_new(xdg_data);
+    g_string_append(cache_file, "/profanity/cache");
+    gchar *result = strdup(cache_file->str);
+    g_free(xdg_data);
+    g_string_free(cache_file, TRUE);
+
+    return result;
+}
+
 gchar *
 files_get_themes_dir(void)
 {
@@ -29,5 +29,7 @@ gchar* files_get_preferences_file(void);
 gchar* files_get_log_file(void);
 gchar* files_get_themes_dir(void);
 gchar* files_get_accounts_file(void);
+gchar* files_get_history_file(void);
+gchar* files_get_cache_file(void);
 
 #endif
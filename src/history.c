@@ -19,51 +19,264 @@
  * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <glib.h>
+
+#include "common.h"
+#include "files.h"
+#include "log.h"
+#include "preferences.h"
 #include "prof_history.h"
+#include "ui.h"
 
-#define MAX_HISTORY 100
+// input history is kept in a file with one line per entry, new entries are
+// appended as they are typed and the file is rewritten with only the
+// remembered entries on close
 
+// the saved history holds input from every window, it is the one navigated
+// in the console and the one searched, other windows have their own
+// history, kept by recipient so it is still there if the window is reopened
 static PHistory history;
+static GHashTable *window_histories;
+static FILE *history_file;
 
-void _stringify_input(char *inp, int size, char *string);
+static PHistory _current_history(void);
+static void _prefs_changed(preference_t pref);
+static void _resize_window_history(gpointer key, gpointer value,
+    gpointer size);
+static void _load(void);
+static void _save(void);
+static FILE * _open_file(const char * const path, int flags,
+    const char * const mode);
+static void _write_line(FILE *stream, const char * const line);
+static char * _read_line(const char * const line);
 
 void
 history_init(void)
 {
-    history = p_history_new(MAX_HISTORY);
+    history = p_history_new(prefs_get_histsize());
+    window_histories = g_hash_table_new_full(g_str_hash, g_str_equal, free,
+        (GDestroyNotify)p_history_free);
+    _load();
+    prefs_add_listener(_prefs_changed);
+}
+
+void
+history_close(void)
+{
+    prefs_remove_listener(_prefs_changed);
+    if (history_file != NULL) {
+        fclose(history_file);
+        history_file = NULL;
+    }
+    _save();
+    p_history_free(history);
+    history = NULL;
+    g_hash_table_destroy(window_histories);
+    window_histories = NULL;
 }
 
 void
 history_append(char *inp)
 {
-    p_history_append(history, inp);
+    PHistory current = _current_history();
+    p_history_append(current, inp);
+
+    // any navigation in the saved history was left behind in the console
+    if (current != history) {
+        p_history_end_session(history);
+        p_history_append(history, inp);
+    }
+
+    if (history_file != NULL) {
+        _write_line(history_file, inp);
+        fflush(history_file);
+    }
 }
 
 char *
-history_previous(char *inp, int *size)
+history_previous(char *inp)
 {
-    char inp_str[*size + 1];
-    _stringify_input(inp, *size, inp_str);
-
-    return p_history_previous(history, inp_str);
+    return p_history_previous(_current_history(), inp);
 }
 
 char *
-history_next(char *inp, int *size)
+history_next(char *inp)
 {
-    char inp_str[*size + 1];
-    _stringify_input(inp, *size, inp_str);
+    return p_history_next(_current_history(), inp);
+}
 
-    return p_history_next(history, inp_str);
+int
+history_search(const char * const query, int from)
+{
+    return p_history_search(history, query, from);
 }
 
-void
-_stringify_input(char *inp, int size, char *string)
+const char *
+history_get(int index)
 {
-    int i;
-    for (i = 0; i < size; i++) {
-        string[i] = inp[i];
+    return p_history_get(history, index);
+}
+
+static PHistory
+_current_history(void)
+{
+    if (win_current_is_console()) {
+        return history;
+    }
+
+    char *recipient = win_current_get_recipient();
+    PHistory result = g_hash_table_lookup(window_histories, recipient);
+    if (result == NULL) {
+        result = p_history_new(prefs_get_histsize());
+        g_hash_table_insert(window_histories, recipient, result);
+    } else {
+        free(recipient);
+    }
+
+    return result;
+}
+
+static void
+_prefs_changed(preference_t pref)
+{
+    if (pref == PREF_HISTSIZE) {
+        int size = prefs_get_histsize();
+        p_history_resize(history, size);
+        g_hash_table_foreach(window_histories, _resize_window_history,
+            GINT_TO_POINTER(size));
     }
-    string[size] = '\0';
+}
+
+static void
+_resize_window_history(gpointer key, gpointer value, gpointer size)
+{
+    p_history_resize(value, GPOINTER_TO_INT(size));
+}
+
+static void
+_load(void)
+{
+    gchar *path = files_get_history_file();
+    FILE *stream = fopen(path, "r");
+    guint lines = 0;
+
+    if (stream != NULL) {
+        char *line;
+        while ((line = prof_getline(stream)) != NULL) {
+            char *item = _read_line(line);
+            if (strlen(item) > 0) {
+                p_history_append(history, item);
+                lines++;
+            }
+            free(item);
+            free(line);
+        }
+        fclose(stream);
+    }
+
+    // drop entries that no longer fit before appending to the file
+    if (lines > p_history_length(history)) {
+        _save();
+    }
+
+    history_file = _open_file(path, O_WRONLY | O_CREAT | O_APPEND, "a");
+    if (history_file == NULL) {
+        log_error("Could not open input history file: %s", path);
+    }
+    g_free(path);
+}
+
+static void
+_save(void)
+{
+    if (history == NULL) {
+        return;
+    }
+
+    gchar *path = files_get_history_file();
+    GString *tmp_path = g_string_new(path);
+    g_string_append(tmp_path, ".tmp");
+
+    FILE *stream = _open_file(tmp_path->str, O_WRONLY | O_CREAT | O_TRUNC, "w");
+    if (stream == NULL) {
+        log_error("Could not write input history file: %s", tmp_path->str);
+    } else {
+        guint i;
+        for (i = 0; i < p_history_length(history); i++) {
+            _write_line(stream, p_history_get(history, i));
+        }
+        if ((fclose(stream) != 0) || (rename(tmp_path->str, path) != 0)) {
+            log_error("Could not write input history file: %s", path);
+            unlink(tmp_path->str);
+        }
+    }
+
+    g_string_free(tmp_path, TRUE);
+    g_free(path);
+}
+
+// the history may hold what was typed into private chats, so only the user
+// can read it
+static FILE *
+_open_file(const char * const path, int flags, const char * const mode)
+{
+    int fd = open(path, flags, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    FILE *stream = fdopen(fd, mode);
+    if (stream == NULL) {
+        close(fd);
+    }
+
+    return stream;
+}
+
+// entries can span lines when multi line paste is on, so newlines and
+// backslashes are escaped
+static void
+_write_line(FILE *stream, const char * const line)
+{
+    const char *curr;
+    for (curr = line; *curr != '\0'; curr++) {
+        if (*curr == '\\') {
+            fputs("\\\\", stream);
+        } else if (*curr == '\n') {
+            fputs("\\n", stream);
+        } else {
+            fputc(*curr, stream);
+        }
+    }
+    fputc('\n', stream);
+}
+
+static char *
+_read_line(const char * const line)
+{
+    char *result = malloc(strlen(line) + 1);
+    char *out = result;
+    const char *curr;
+
+    for (curr = line; *curr != '\0'; curr++) {
+        if ((*curr == '\\') && (curr[1] == 'n')) {
+            *out++ = '\n';
+            curr++;
+        } else if ((*curr == '\\') && (curr[1] == '\\')) {
+            *out++ = '\\';
+            curr++;
+        } else {
+            *out++ = *curr;
+        }
+    }
+    *out = '\0';
+
+    return result;
 }
@@ -24,8 +24,11 @@
 #define HISTORY_H
 
 void history_init(void);
+void history_close(void);
 void history_append(char *inp);
-char *history_previous(char *inp, int *size);
-char *history_next(char *inp, int *size);
+char *history_previous(char *inp);
+char *history_next(char *inp);
+int history_search(const char * const query, int from);
+const char *history_get(int index);
 
 #endif
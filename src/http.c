@@ -0,0 +1,171 @@
+/*
+ * http.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <curl/curl.h>
+
+#include "http.h"
+
+// requests run on a curl multi handle, which is moved along a little each
+// time http_process_events is called from the main loop, so a slow server
+// never holds up input or the XMPP connection
+
+// connecting gives up sooner than the whole request
+#define HTTP_CONNECT_TIMEOUT 5
+
+typedef struct http_request_t {
+    CURL *handle;
+    GString *body;
+    http_callback_t callback;
+    void *userdata;
+} HttpRequest;
+
+static CURLM *multi = NULL;
+static GSList *requests = NULL;
+
+static size_t _data_callback(void *ptr, size_t size, size_t nmemb, void *data);
+static void _request_free(HttpRequest *request);
+
+void
+http_init(void)
+{
+    curl_global_init(CURL_GLOBAL_ALL);
+    multi = curl_multi_init();
+}
+
+/*
+ * Cancel any requests still running, their callbacks are called with NULL
+ * so they can free their userdata
+ */
+void
+http_close(void)
+{
+    while (requests != NULL) {
+        HttpRequest *request = requests->data;
+        curl_multi_remove_handle(multi, request->handle);
+        requests = g_slist_delete_link(requests, requests);
+        request->callback(NULL, request->userdata);
+        _request_free(request);
+    }
+
+    if (multi != NULL) {
+        curl_multi_cleanup(multi);
+        multi = NULL;
+        curl_global_cleanup();
+    }
+}
+
+/*
+ * Start fetching url, callback is called from http_process_events when the
+ * request completes, fails or has taken longer than timeout seconds
+ */
+void
+http_get(const char * const url, long timeout, http_callback_t callback,
+    void *userdata)
+{
+    HttpRequest *request = malloc(sizeof(HttpRequest));
+    request->handle = curl_easy_init();
+    request->body = g_string_new("");
+    request->callback = callback;
+    request->userdata = userdata;
+
+    curl_easy_setopt(request->handle, CURLOPT_URL, url);
+    curl_easy_setopt(request->handle, CURLOPT_WRITEFUNCTION, _data_callback);
+    curl_easy_setopt(request->handle, CURLOPT_WRITEDATA, (void *)request);
+    curl_easy_setopt(request->handle, CURLOPT_PRIVATE, (void *)request);
+    curl_easy_setopt(request->handle, CURLOPT_TIMEOUT, timeout);
+    curl_easy_setopt(request->handle, CURLOPT_CONNECTTIMEOUT,
+        MIN(timeout, HTTP_CONNECT_TIMEOUT));
+    curl_easy_setopt(request->handle, CURLOPT_NOSIGNAL, 1L);
+
+    curl_multi_add_handle(multi, request->handle);
+    requests = g_slist_append(requests, request);
+
+    // start connecting now rather than on the next loop
+    http_process_events();
+}
+
+/*
+ * Move any running requests along without blocking, and call the callbacks
+ * of those that have finished
+ */
+void
+http_process_events(void)
+{
+    if (requests == NULL) {
+        return;
+    }
+
+    int running;
+    curl_multi_perform(multi, &running);
+
+    CURLMsg *msg;
+    int msgs_left;
+    while ((msg = curl_multi_info_read(multi, &msgs_left)) != NULL) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+
+        HttpRequest *request = NULL;
+        long status = 0;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &request);
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+        gboolean ok = (msg->data.result == CURLE_OK) &&
+            (status >= 200) && (status < 300);
+
+        curl_multi_remove_handle(multi, request->handle);
+        requests = g_slist_remove(requests, request);
+
+        if (ok) {
+            request->callback(request->body->str, request->userdata);
+        } else {
+            request->callback(NULL, request->userdata);
+        }
+        _request_free(request);
+    }
+}
+
+guint
+http_pending(void)
+{
+    return g_slist_length(requests);
+}
+
+static size_t
+_data_callback(void *ptr, size_t size, size_t nmemb, void *data)
+{
+    size_t realsize = size * nmemb;
+    HttpRequest *request = data;
+    g_string_append_len(request->body, ptr, realsize);
+
+    return realsize;
+}
+
+static void
+_request_free(HttpRequest *request)
+{
+    curl_easy_cleanup(request->handle);
+    g_string_free(request->body, TRUE);
+    free(request);
+}
@@ -0,0 +1,39 @@
+/*
+ * http.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <glib.h>
+
+// called once with the body of a successful response, or NULL if the
+// request failed, timed out, was cancelled by http_close or the server did
+// not return 2xx, the body is freed when the callback returns
+typedef void (*http_callback_t)(const char * const body, void *userdata);
+
+void http_init(void);
+void http_close(void);
+void http_get(const char * const url, long timeout, http_callback_t callback,
+    void *userdata);
+void http_process_events(void);
+guint http_pending(void);
+
+#endif
@@ -39,20 +39,46 @@
 #include "history.h"
 #include "log.h"
 #include "preferences.h"
+#include "prof_gap_buffer.h"
 #include "profanity.h"
 #include "theme.h"
 #include "ui.h"
 
 #define _inp_win_refresh() prefresh(inp_win, 0, pad_start, rows-1, 0, rows-1, cols-1)
 
+// initial width of the input pad, it grows to fit longer input
+#define INP_WIN_COLS 1000
+
+// how long to wait for the rest of a paste before giving up on the end marker
+#define PASTE_TIMEOUT 100
+
 static WINDOW *inp_win;
+static PGapBuffer input;
 static int pad_start = 0;
 static int rows, cols;
 
-static int _handle_edit(const wint_t ch, char *input, int *size);
+// reverse search through the input history, started with ctrl-r
+static gboolean searching = FALSE;
+static gboolean search_failed = FALSE;
+static GString *search_query = NULL;
+static int search_match = -1;
+
+static int _handle_edit(int result, const wint_t ch);
+static gboolean _handle_search(int result, const wint_t ch);
+static void _search_start(void);
+static void _search_update(int from);
+static void _search_backspace(void);
+static void _search_end(gboolean accept);
+static void _draw_search(void);
+static gboolean _read_sequence(const char * const seq);
+static void _handle_paste(void);
+static void _draw(const char * const bytes, gsize len);
 static int _printable(const wint_t ch);
+static void _insert(const char * const bytes, gsize len);
+static void _redraw_tail(void);
+static void _ensure_pad_cols(void);
+static void _follow_cursor(void);
 static void _clear_input(void);
-static void _go_to_end(int display_size);
 
 void
 create_input_window(void)
@@ -63,15 +89,31 @@ create_input_window(void)
     ESCDELAY = 25;
 #endif
     getmaxyx(stdscr, rows, cols);
-    inp_win = newpad(1, INP_WIN_MAX);
+    inp_win = newpad(1, INP_WIN_COLS);
     wbkgd(inp_win, COLOUR_INPUT_TEXT);
     keypad(inp_win, TRUE);
     wmove(inp_win, 0, 0);
+    input = p_gap_buffer_new();
+
+    // ask the terminal to mark pasted text, so it can be read in one go
+    putp("\033[?2004h");
     _inp_win_refresh();
 }
 
 void
-inp_win_resize(const char * const input, const int size)
+inp_close(void)
+{
+    putp("\033[?2004l");
+    p_gap_buffer_free(input);
+    input = NULL;
+    if (search_query != NULL) {
+        g_string_free(search_query, TRUE);
+        search_query = NULL;
+    }
+}
+
+void
+inp_win_resize(void)
 {
     int inp_x;
     getmaxyx(stdscr, rows, cols);
@@ -101,24 +143,17 @@ inp_block(void)
 }
 
 wint_t
-inp_get_char(char *input, int *size)
+inp_get_char(void)
 {
-    int inp_x = 0;
-    int i;
     wint_t ch;
-    int display_size = 0;
-
-    if (*size != 0) {
-        display_size = g_utf8_strlen(input, *size);
-    }
 
     // echo off, and get some more input
     noecho();
     int result = wget_wch(inp_win, &ch);
 
     gboolean in_command = FALSE;
-    if ((display_size > 0 && input[0] == '/') ||
-            (display_size == 0 && ch == '/')) {
+    if (p_gap_buffer_has_prefix(input, "/") ||
+            (p_gap_buffer_size(input) == 0 && ch == '/')) {
         in_command = TRUE;
     }
 
@@ -132,59 +167,15 @@ inp_get_char(char *input, int *size)
         }
     }
 
-    // if it wasn't an arrow key etc
-    if (!_handle_edit(ch, input, size)) {
+    // if it wasn't part of a search, an arrow key etc
+    if (!_handle_search(result, ch) && !_handle_edit(result, ch)) {
         if (_printable(ch) && result != KEY_CODE_YES) {
-            inp_x = getcurx(inp_win);
-
-            // handle insert if not at end of input
-            if (inp_x < display_size) {
-                char bytes[MB_CUR_MAX];
-                size_t utf_len = wcrtomb(bytes, ch, NULL);
-
-                char *next_ch = g_utf8_offset_to_pointer(input, inp_x);
-                char *offset;
-                for (offset = &input[*size - 1]; offset >= next_ch; offset--) {
-                    *(offset + utf_len) = *offset;
-                }
-                for (i = 0; i < utf_len; i++) {
-                     *(next_ch + i) = bytes[i];
-                }
-
-                *size += utf_len;
-                input[*size] = '\0';
-                wprintw(inp_win, next_ch);
-                wmove(inp_win, 0, inp_x + 1);
-
-                if (inp_x - pad_start > cols-3) {
-                    pad_start++;
-                    _inp_win_refresh();
-                }
-
-            // otherwise just append
-            } else {
-                char bytes[MB_CUR_MAX+1];
-                size_t utf_len = wcrtomb(bytes, ch, NULL);
-
-                // wcrtomb can return (size_t) -1
-                if (utf_len < MB_CUR_MAX) {
-                    for (i = 0 ; i < utf_len; i++) {
-                        input[(*size)++] = bytes[i];
-                    }
-                    input[*size] = '\0';
-
-                    bytes[utf_len] = '\0';
-                    wprintw(inp_win, bytes);
-                    display_size++;
-
-                    // if gone over screen size follow input
-                    int rows, cols;
-                    getmaxyx(stdscr, rows, cols);
-                    if (display_size - pad_start > cols-2) {
-                        pad_start++;
-                        _inp_win_refresh();
-                    }
-                }
+            char bytes[MB_CUR_MAX];
+            size_t utf_len = wcrtomb(bytes, ch, NULL);
+
+            // wcrtomb can return (size_t) -1
+            if (utf_len != (size_t) -1) {
+                _insert(bytes, utf_len);
             }
 
             cmd_reset_autocomplete();
@@ -196,6 +187,15 @@ inp_get_char(char *input, int *size)
     return ch;
 }
 
+/*
+ * Return a copy of the current input line, which the caller must free
+ */
+char *
+inp_get_line(void)
+{
+    return strdup(p_gap_buffer_contents(input));
+}
+
 void
 inp_get_password(char *passwd)
 {
@@ -215,21 +215,20 @@ inp_put_back(void)
 }
 
 void
-inp_replace_input(char *input, const char * const new_input, int *size)
+inp_replace_input(const char * const new_input)
 {
-    int display_size;
-    strcpy(input, new_input);
-    *size = strlen(input);
-    display_size = g_utf8_strlen(input, *size);
-    inp_win_reset();
-    input[*size] = '\0';
-    wprintw(inp_win, input);
-    _go_to_end(display_size);
+    p_gap_buffer_set(input, new_input);
+    _ensure_pad_cols();
+    _clear_input();
+    pad_start = 0;
+    _draw(p_gap_buffer_contents(input), p_gap_buffer_size(input));
+    _follow_cursor();
 }
 
 void
 inp_win_reset(void)
 {
+    p_gap_buffer_clear(input);
     _clear_input();
     pad_start = 0;
     _inp_win_refresh();
@@ -242,26 +241,277 @@ _clear_input(void)
     wmove(inp_win, 0, 0);
 }
 
+// insert at the cursor, only the cells from the cursor on are redrawn
+static void
+_insert(const char * const bytes, gsize len)
+{
+    gboolean at_end = (p_gap_buffer_cursor(input) == p_gap_buffer_width(input));
+
+    wmove(inp_win, 0, p_gap_buffer_cursor(input));
+    p_gap_buffer_insert(input, bytes, len);
+    _ensure_pad_cols();
+    _draw(bytes, len);
+
+    if (!at_end) {
+        _redraw_tail();
+    }
+
+    _follow_cursor();
+}
+
+// redraw the input from the cursor to the end of the line
+static void
+_redraw_tail(void)
+{
+    gsize len;
+    const char *tail = p_gap_buffer_tail(input, &len);
+    int inp_x = p_gap_buffer_cursor(input);
+
+    wmove(inp_win, 0, inp_x);
+    wclrtoeol(inp_win);
+    _draw(tail, len);
+    wmove(inp_win, 0, inp_x);
+}
+
+// draw text at the pad cursor, newlines from a multi line paste are shown
+// as a single highlighted pilcrow so the input stays on one line
+static void
+_draw(const char * const bytes, gsize len)
+{
+    const char *curr = bytes;
+    const char *end = bytes + len;
+
+    while (curr < end) {
+        const char *newline = memchr(curr, '\n', end - curr);
+        if (newline == NULL) {
+            waddnstr(inp_win, curr, end - curr);
+            return;
+        }
+
+        waddnstr(inp_win, curr, newline - curr);
+        wattron(inp_win, A_REVERSE);
+        waddstr(inp_win, "\xc2\xb6");
+        wattroff(inp_win, A_REVERSE);
+        curr = newline + 1;
+    }
+}
+
+static void
+_ensure_pad_cols(void)
+{
+    int pad_cols = getmaxx(inp_win);
+    if (p_gap_buffer_width(input) + 1 >= pad_cols) {
+        while (p_gap_buffer_width(input) + 1 >= pad_cols) {
+            pad_cols *= 2;
+        }
+        wresize(inp_win, 1, pad_cols);
+    }
+}
+
+// move the cursor to its position in the buffer, scrolling the pad so it
+// stays on screen
+static void
+_follow_cursor(void)
+{
+    int inp_x = p_gap_buffer_cursor(input);
+    int old_start = pad_start;
+
+    // if gone off screen to left, jump left (half a screen worth)
+    if (inp_x < pad_start) {
+        pad_start = inp_x - (cols / 2);
+        if (pad_start < 0) {
+            pad_start = 0;
+        }
+
+    // if gone over screen size follow input
+    } else if (inp_x - pad_start > cols - 2) {
+        pad_start = inp_x - cols + 2;
+    }
+
+    wmove(inp_win, 0, inp_x);
+
+    if (pad_start != old_start) {
+        _inp_win_refresh();
+    }
+}
+
+/*
+ * Deal with reverse history search, return TRUE if ch was used by the
+ * search.  Keys that are not search keys accept the match and are then
+ * handled as usual, so enter submits the match.
+ */
+static gboolean
+_handle_search(int result, const wint_t ch)
+{
+    // nothing was read
+    if (result == ERR) {
+        return FALSE;
+    }
+
+    if (!searching) {
+        if ((result != KEY_CODE_YES) && (ch == 18)) { // ctrl-r
+            _search_start();
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    if (result == KEY_CODE_YES) {
+        if (ch == KEY_BACKSPACE) {
+            _search_backspace();
+            return TRUE;
+        }
+        _search_end(TRUE);
+        return FALSE;
+    }
+
+    switch (ch) {
+
+    case 18: // ctrl-r, older match
+        if (search_match > 0) {
+            _search_update(search_match - 1);
+        }
+        return TRUE;
+
+    case 7: // ctrl-g
+    case 27: // ESC
+        _search_end(FALSE);
+        return TRUE;
+
+    case 127:
+        _search_backspace();
+        return TRUE;
+
+    default:
+        if (_printable(ch)) {
+            char bytes[MB_CUR_MAX];
+            size_t utf_len = wcrtomb(bytes, ch, NULL);
+            if (utf_len != (size_t) -1) {
+                g_string_append_len(search_query, bytes, utf_len);
+            }
+            // the current match may still match the longer query
+            _search_update(search_match);
+            return TRUE;
+        }
+        _search_end(TRUE);
+        return FALSE;
+    }
+}
+
+static void
+_search_start(void)
+{
+    searching = TRUE;
+    search_failed = FALSE;
+    search_match = -1;
+    if (search_query == NULL) {
+        search_query = g_string_new("");
+    } else {
+        g_string_truncate(search_query, 0);
+    }
+    _draw_search();
+}
+
+// find the newest match at or before from, -1 searches all of the history,
+// the last match is kept when nothing matches
+static void
+_search_update(int from)
+{
+    if (search_query->len == 0) {
+        search_match = -1;
+        search_failed = FALSE;
+    } else {
+        int match = history_search(search_query->str, from);
+        if (match == -1) {
+            search_failed = TRUE;
+        } else {
+            search_match = match;
+            search_failed = FALSE;
+        }
+    }
+    _draw_search();
+}
+
+// a shorter query can match newer items, so search all of the history again
+static void
+_search_backspace(void)
+{
+    if (search_query->len > 0) {
+        const char *last = g_utf8_prev_char(search_query->str +
+            search_query->len);
+        g_string_truncate(search_query, last - search_query->str);
+    }
+    _search_update(-1);
+}
+
+static void
+_search_end(gboolean accept)
+{
+    searching = FALSE;
+
+    const char *match = NULL;
+    if (accept && (search_match != -1)) {
+        match = history_get(search_match);
+    }
+
+    if (match != NULL) {
+        inp_replace_input(match);
+    } else {
+        // the input was not changed, just shown again
+        char *line = inp_get_line();
+        inp_replace_input(line);
+        free(line);
+    }
+    _inp_win_refresh();
+}
+
+static void
+_draw_search(void)
+{
+    const char *match = NULL;
+    if (search_match != -1) {
+        match = history_get(search_match);
+    }
+
+    gsize needed = search_query->len + (match != NULL ? strlen(match) : 0) + 32;
+    if (needed >= getmaxx(inp_win)) {
+        wresize(inp_win, 1, needed * 2);
+    }
+
+    _clear_input();
+    pad_start = 0;
+    if (search_failed) {
+        waddstr(inp_win, "(failed reverse-i-search)`");
+    } else {
+        waddstr(inp_win, "(reverse-i-search)`");
+    }
+    waddnstr(inp_win, search_query->str, search_query->len);
+    waddstr(inp_win, "': ");
+    int query_end = getcurx(inp_win) - 3;
+    if (match != NULL) {
+        _draw(match, strlen(match));
+    }
+    wmove(inp_win, 0, query_end);
+    _inp_win_refresh();
+}
+
 /*
  * Deal with command editing, return 1 if ch was an edit
  * key press: up, down, left, right or backspace
  * return 0 if it wasnt
  */
 static int
-_handle_edit(const wint_t ch, char *input, int *size)
+_handle_edit(int result, const wint_t ch)
 {
     char *prev = NULL;
     char *next = NULL;
-    int inp_x = 0;
     int next_ch;
-    int display_size = 0;
 
-    if (*size != 0) {
-        display_size = g_utf8_strlen(input, *size);
+    // nothing was read
+    if (result == ERR) {
+        return 0;
     }
 
-    inp_x = getcurx(inp_win);
-
     switch(ch) {
 
     case 27: // ESC
@@ -270,6 +520,11 @@ _handle_edit(const wint_t ch, char *input, int *size)
         if (next_ch != ERR) {
             switch (next_ch)
             {
+                case '[':
+                    if (_read_sequence("200~")) {
+                        _handle_paste();
+                    }
+                    break;
                 case '1':
                     ui_switch_win(0);
                     break;
@@ -305,7 +560,6 @@ _handle_edit(const wint_t ch, char *input, int *size)
             }
             return 1;
         } else {
-            *size = 0;
             inp_win_reset();
             return 1;
         }
@@ -313,152 +567,140 @@ _handle_edit(const wint_t ch, char *input, int *size)
     case 127:
     case KEY_BACKSPACE:
         contact_list_reset_search_attempts();
-        if (display_size > 0) {
-
-            // if at end, delete last char
-            if (inp_x >= display_size) {
-                gchar *start = g_utf8_substring(input, 0, inp_x-1);
-                for (*size = 0; *size < strlen(start); (*size)++) {
-                    input[*size] = start[*size];
-                }
-                input[*size] = '\0';
-
-                g_free(start);
-
-                _clear_input();
-                wprintw(inp_win, input);
-                wmove(inp_win, 0, inp_x -1);
-
-            // if in middle, delete and shift chars left
-            } else if (inp_x > 0 && inp_x < display_size) {
-                gchar *start = g_utf8_substring(input, 0, inp_x - 1);
-                gchar *end = g_utf8_substring(input, inp_x, *size);
-                GString *new = g_string_new(start);
-                g_string_append(new, end);
-
-                for (*size = 0; *size < strlen(new->str); (*size)++) {
-                    input[*size] = new->str[*size];
-                }
-                input[*size] = '\0';
-
-                g_free(start);
-                g_free(end);
-                g_string_free(new, FALSE);
-
-                _clear_input();
-                wprintw(inp_win, input);
-                wmove(inp_win, 0, inp_x -1);
-            }
-
-            // if gone off screen to left, jump left (half a screen worth)
-            if (inp_x <= pad_start) {
-                pad_start = pad_start - (cols / 2);
-                if (pad_start < 0) {
-                    pad_start = 0;
-                }
-
-                _inp_win_refresh();
-            }
+        if (p_gap_buffer_backspace(input)) {
+            _redraw_tail();
+            _follow_cursor();
         }
         return 1;
 
     case KEY_DC: // DEL
-        if (inp_x == display_size-1) {
-            gchar *start = g_utf8_substring(input, 0, inp_x);
-            for (*size = 0; *size < strlen(start); (*size)++) {
-                input[*size] = start[*size];
-            }
-            input[*size] = '\0';
-
-            g_free(start);
-
-            _clear_input();
-            wprintw(inp_win, input);
-        } else if (inp_x < display_size-1) {
-            gchar *start = g_utf8_substring(input, 0, inp_x);
-            gchar *end = g_utf8_substring(input, inp_x+1, *size);
-            GString *new = g_string_new(start);
-            g_string_append(new, end);
-
-            for (*size = 0; *size < strlen(new->str); (*size)++) {
-                input[*size] = new->str[*size];
-            }
-            input[*size] = '\0';
-
-            g_free(start);
-            g_free(end);
-            g_string_free(new, FALSE);
-
-            _clear_input();
-            wprintw(inp_win, input);
-            wmove(inp_win, 0, inp_x);
+        if (p_gap_buffer_delete(input)) {
+            _redraw_tail();
         }
         return 1;
 
     case KEY_LEFT:
-        if (inp_x > 0)
-            wmove(inp_win, 0, inp_x-1);
-
-        // current position off screen to left
-        if (inp_x - 1 < pad_start) {
-            pad_start--;
-            _inp_win_refresh();
+        if (p_gap_buffer_left(input)) {
+            _follow_cursor();
         }
         return 1;
 
     case KEY_RIGHT:
-        if (inp_x < display_size) {
-            wmove(inp_win, 0, inp_x+1);
-
-            // current position off screen to right
-            if ((inp_x + 1 - pad_start) >= cols) {
-                pad_start++;
-                _inp_win_refresh();
-            }
+        if (p_gap_buffer_right(input)) {
+            _follow_cursor();
         }
         return 1;
 
     case KEY_UP:
-        prev = history_previous(input, size);
+        prev = history_previous((char *)p_gap_buffer_contents(input));
         if (prev) {
-            inp_replace_input(input, prev, size);
+            inp_replace_input(prev);
+            free(prev);
         }
         return 1;
 
     case KEY_DOWN:
-        next = history_next(input, size);
+        next = history_next((char *)p_gap_buffer_contents(input));
         if (next) {
-            inp_replace_input(input, next, size);
+            inp_replace_input(next);
+            free(next);
         }
         return 1;
 
     case KEY_HOME:
-        wmove(inp_win, 0, 0);
-        pad_start = 0;
-        _inp_win_refresh();
+        p_gap_buffer_home(input);
+        _follow_cursor();
         return 1;
 
     case KEY_END:
-        _go_to_end(display_size);
+        p_gap_buffer_end(input);
+        _follow_cursor();
         return 1;
 
     case 9: // tab
-        cmd_autocomplete(input, size);
+    {
+        // autocomplete works on a copy, as completing replaces the input
+        char *line = inp_get_line();
+        int size = strlen(line);
+        cmd_autocomplete(line, &size);
+        free(line);
         return 1;
+    }
 
     default:
         return 0;
     }
 }
 
+// consume seq from the input if it is next, returns FALSE on the first
+// character that does not match
+static gboolean
+_read_sequence(const char * const seq)
+{
+    const char *curr = seq;
+    while (*curr != '\0') {
+        if (wgetch(inp_win) != *curr) {
+            return FALSE;
+        }
+        curr++;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Read a bracketed paste up to the end marker and insert it as one edit,
+ * rather than echoing, sending typing notifications and resetting
+ * autocomplete for every character
+ */
 static void
-_go_to_end(int display_size)
+_handle_paste(void)
 {
-    wmove(inp_win, 0, display_size);
-    if (display_size > cols-2) {
-        pad_start = display_size - cols + 1;
-        _inp_win_refresh();
+    GString *paste = g_string_new("");
+    wint_t ch;
+    int result;
+
+    wtimeout(inp_win, PASTE_TIMEOUT);
+    while ((result = wget_wch(inp_win, &ch)) != ERR) {
+        if (result == KEY_CODE_YES) {
+            continue;
+        }
+
+        if (ch == 27) {
+            if (wgetch(inp_win) == '[' && _read_sequence("201~")) {
+                break;
+            }
+        } else if (ch == '\r' || ch == '\n') {
+            g_string_append_c(paste, '\n');
+        } else if (ch == '\t') {
+            g_string_append_c(paste, ' ');
+        } else if (_printable(ch)) {
+            char bytes[MB_CUR_MAX];
+            size_t utf_len = wcrtomb(bytes, ch, NULL);
+            if (utf_len != (size_t) -1) {
+                g_string_append_len(paste, bytes, utf_len);
+            }
+        }
+    }
+    inp_non_block();
+
+    gboolean in_command = p_gap_buffer_has_prefix(input, "/") ||
+        (p_gap_buffer_size(input) == 0 && paste->str[0] == '/');
+
+    // commands are single line, and so are messages unless asked for
+    if (in_command || !prefs_get_multiline()) {
+        g_strdelimit(paste->str, "\n", ' ');
     }
+
+    if (paste->len > 0) {
+        _insert(paste->str, paste->len);
+        if (prefs_get_states() && prefs_get_outtype() && !in_command) {
+            prof_handle_activity();
+        }
+        cmd_reset_autocomplete();
+    }
+
+    g_string_free(paste, TRUE);
 }
 
 static int
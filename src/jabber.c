@@ -22,30 +22,61 @@
 
 #include <string.h>
 #include <stdlib.h>
-#include <assert.h>
 
 #include <strophe.h>
 
 #include "chat_session.h"
 #include "common.h"
 #include "contact_list.h"
+#include "dispatch.h"
 #include "jabber.h"
 #include "jid.h"
 #include "log.h"
 #include "preferences.h"
 #include "profanity.h"
+#include "reconnect.h"
 #include "muc.h"
 #include "stanza.h"
+#include "send_queue.h"
+#include "stream_mgmt.h"
+#include "trace.h"
+#include "worker.h"
+
+// from resolving the server to binding a resource a connection is set up
+// by a worker, so a slow DNS server or a server that never answers doesn't
+// stop the UI.  The worker runs the attempt's context until libstrophe
+// reports the outcome and then returns, and the main thread takes the
+// connection over and handles the outcome.  Until then the context is only
+// used on the worker's thread
+typedef struct connect_attempt_t {
+    Worker *worker;
+    xmpp_ctx_t *ctx;
+    xmpp_conn_t *conn;
+    char *altdomain;
+    xmpp_log_t log;
+    gboolean finished;
+    gboolean handed_over;
+    xmpp_conn_event_t status;
+    int error;
+    gboolean sm_supported;
+    gboolean rosterver_supported;
+} ConnectAttempt;
+
+#define CONNECT_POLL_MS 50
 
 static struct _jabber_conn_t {
     xmpp_log_t *log;
     xmpp_ctx_t *ctx;
     xmpp_conn_t *conn;
+    ConnectAttempt *attempt;
     jabber_conn_status_t conn_status;
     jabber_presence_t presence;
     char *status;
     int tls_disabled;
     int priority;
+    gboolean sm_supported;
+    gboolean sm_requested;
+    gboolean rosterver_supported;
 } jabber_conn;
 
 static GHashTable *sub_requests;
@@ -58,7 +89,15 @@ static struct {
     char *altdomain;
 } saved_user;
 
-static GTimer *reconnect_timer;
+// kept across a reconnect, the roster version last received
+static char *roster_ver;
+
+// stanzas made on the main thread while an attempt's context is its
+// worker's, their text is queued until the attempt is handed over
+static xmpp_ctx_t *stanza_ctx = NULL;
+
+// xmpp_initialize calls not yet matched by xmpp_shutdown
+static int xmpp_users = 0;
 
 static log_level_t _get_log_level(xmpp_log_level_t xmpp_level);
 static xmpp_log_level_t _get_xmpp_log_level();
@@ -67,26 +106,54 @@ static void _xmpp_file_logger(void * const userdata,
     const char * const msg);
 static xmpp_log_t * _xmpp_get_file_logger();
 
+static jabber_conn_status_t _jabber_connect(void);
+static void _connect_run(Worker *worker, void *data);
+static void _connect_handler(xmpp_conn_t * const conn,
+    const xmpp_conn_event_t status, const int error,
+    xmpp_stream_error_t * const stream_error, void * const userdata);
+static void _connect_logger(void * const userdata,
+    const xmpp_log_level_t level, const char * const area,
+    const char * const msg);
+static void _connect_finish(void);
+static void _connect_attempt_free(void *data);
+static void _connection_release(void);
+static void _xmpp_init(void);
+static void _xmpp_shutdown(void);
+static void _jabber_forget_session(void);
 static void _jabber_roster_request(void);
+static void _send_stanza(xmpp_stanza_t * const stanza,
+    send_priority_t priority);
+static void _send_queued(void);
+static void _sm_request_ack(void);
+static void _stream_features(xmpp_ctx_t * const ctx, const char * const text,
+    gboolean *sm_supported, gboolean *rosterver_supported);
 
 // XMPP event handlers
 static void _connection_handler(xmpp_conn_t * const conn,
     const xmpp_conn_event_t status, const int error,
     xmpp_stream_error_t * const stream_error, void * const userdata);
 
-static int _message_handler(xmpp_conn_t * const conn,
+static int _stanza_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata);
+static gboolean _dispatch(xmpp_stanza_t * const stanza);
+static void _dispatch_init(void);
+
+// handlers found by _dispatch
 static int _groupchat_message_handler(xmpp_stanza_t * const stanza);
 static int _error_handler(xmpp_stanza_t * const stanza);
 static int _chat_message_handler(xmpp_stanza_t * const stanza);
-
-static int _iq_handler(xmpp_conn_t * const conn,
-    xmpp_stanza_t * const stanza, void * const userdata);
-static int _roster_handler(xmpp_conn_t * const conn,
+static int _iq_result_handler(xmpp_stanza_t * const stanza);
+static int _roster_handler(xmpp_stanza_t * const stanza);
+static int _roster_push_handler(xmpp_stanza_t * const stanza);
+static int _ping_handler(xmpp_stanza_t * const stanza);
+static int _presence_handler(xmpp_stanza_t * const stanza);
+static int _subscription_handler(xmpp_stanza_t * const stanza);
+static int _sm_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata);
-static int _presence_handler(xmpp_conn_t * const conn,
+static int _sm_count_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata);
 static int _ping_timed_handler(xmpp_conn_t * const conn, void * const userdata);
+static void _prefs_changed(preference_t pref);
 
 void
 jabber_init(const int disable_tls)
@@ -96,7 +163,12 @@ jabber_init(const int disable_tls)
     jabber_conn.presence = PRESENCE_OFFLINE;
     jabber_conn.status = NULL;
     jabber_conn.tls_disabled = disable_tls;
+    jabber_conn.attempt = NULL;
     sub_requests = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    chat_sessions_init();
+    reconnect_set_max((gint64)prefs_get_reconnect() * 1000);
+    prefs_add_listener(_prefs_changed);
+    _dispatch_init();
 }
 
 void
@@ -136,36 +208,193 @@ jabber_connect(const char * const jid,
     if (altdomain != NULL)
         saved_user.altdomain = strdup(altdomain);
 
-    log_info("Connecting as %s", jid);
-    xmpp_initialize();
+    // a new login, nothing to carry over from a lost connection
+    _jabber_forget_session();
+    reconnect_stop();
 
-    jabber_conn.log = _xmpp_get_file_logger();
-    jabber_conn.ctx = xmpp_ctx_new(NULL, jabber_conn.log);
-    jabber_conn.conn = xmpp_conn_new(jabber_conn.ctx);
+    return _jabber_connect();
+}
+
+static jabber_conn_status_t
+_jabber_connect(void)
+{
+    log_info("Connecting as %s", saved_user.jid);
+
+    // the connection lost before a reconnect
+    _connection_release();
+
+    _xmpp_init();
+
+    ConnectAttempt *attempt = malloc(sizeof(ConnectAttempt));
+    attempt->log.handler = _connect_logger;
+    attempt->log.userdata = attempt;
+    attempt->altdomain = NULL;
+    if (saved_user.altdomain != NULL)
+        attempt->altdomain = strdup(saved_user.altdomain);
+    attempt->finished = FALSE;
+    attempt->handed_over = FALSE;
+    attempt->sm_supported = FALSE;
+    attempt->rosterver_supported = FALSE;
 
-    xmpp_conn_set_jid(jabber_conn.conn, jid);
-    xmpp_conn_set_pass(jabber_conn.conn, passwd);
+    attempt->ctx = xmpp_ctx_new(NULL, &attempt->log);
+    attempt->conn = xmpp_conn_new(attempt->ctx);
+    xmpp_conn_set_jid(attempt->conn, saved_user.jid);
+    xmpp_conn_set_pass(attempt->conn, saved_user.passwd);
 
     if (jabber_conn.tls_disabled)
-        xmpp_conn_disable_tls(jabber_conn.conn);
+        xmpp_conn_disable_tls(attempt->conn);
 
-    int connect_status = xmpp_connect_client(jabber_conn.conn, altdomain, 0,
-        _connection_handler, jabber_conn.ctx);
+    jabber_conn.sm_supported = FALSE;
+    jabber_conn.sm_requested = FALSE;
+    jabber_conn.rosterver_supported = FALSE;
 
-    if (connect_status == 0)
-        jabber_conn.conn_status = JABBER_CONNECTING;
-    else
+    // messages typed meanwhile are made with a context of our own
+    if (stanza_ctx == NULL) {
+        stanza_ctx = xmpp_ctx_new(NULL, NULL);
+    }
+    jabber_conn.ctx = stanza_ctx;
+
+    attempt->worker = worker_start("connect", _connect_run, attempt,
+        _connect_attempt_free);
+    if (attempt->worker == NULL) {
+        log_error("Could not start the connection thread");
+        _connect_attempt_free(attempt);
         jabber_conn.conn_status = JABBER_DISCONNECTED;
+    } else {
+        jabber_conn.attempt = attempt;
+        jabber_conn.conn_status = JABBER_CONNECTING;
+    }
 
     return jabber_conn.conn_status;
 }
 
+static void
+_connect_run(Worker *worker, void *data)
+{
+    ConnectAttempt *attempt = data;
+
+    int result = xmpp_connect_client(attempt->conn, attempt->altdomain, 0,
+        _connect_handler, attempt);
+    if (result != 0) {
+        attempt->status = XMPP_CONN_DISCONNECT;
+        attempt->error = result;
+        attempt->finished = TRUE;
+    }
+
+    while (!attempt->finished && !worker_cancelled(worker)) {
+        xmpp_run_once(attempt->ctx, CONNECT_POLL_MS);
+    }
+}
+
+// libstrophe's handler for the connection, called on the worker's thread
+// until the main thread takes over
+static void
+_connect_handler(xmpp_conn_t * const conn,
+    const xmpp_conn_event_t status, const int error,
+    xmpp_stream_error_t * const stream_error, void * const userdata)
+{
+    ConnectAttempt *attempt = userdata;
+
+    if (attempt->handed_over) {
+        _connection_handler(conn, status, error, stream_error, attempt->ctx);
+    } else {
+        attempt->status = status;
+        attempt->error = error;
+        attempt->finished = TRUE;
+    }
+}
+
+// libstrophe's logger for the connection, until the main thread takes over
+// only the attempt itself is touched, it may have been cancelled
+static void
+_connect_logger(void * const userdata, const xmpp_log_level_t level,
+    const char * const area, const char * const msg)
+{
+    ConnectAttempt *attempt = userdata;
+
+    if (attempt->handed_over) {
+        _xmpp_file_logger(NULL, level, area, msg);
+        return;
+    }
+
+    log_msg(_get_log_level(level), area, msg);
+
+    if ((strcmp(area, "xmpp") == 0) && (strncmp(msg, "RECV: ", 6) == 0)) {
+        const char *stanza = msg + 6;
+        if (g_str_has_prefix(stanza, "<stream:features") ||
+                g_str_has_prefix(stanza, "<features")) {
+            _stream_features(attempt->ctx, stanza, &attempt->sm_supported,
+                &attempt->rosterver_supported);
+        }
+    }
+}
+
+// take over the connection if its thread has finished setting it up
+static void
+_connect_finish(void)
+{
+    ConnectAttempt *attempt = jabber_conn.attempt;
+    if (!worker_finished(attempt->worker)) {
+        return;
+    }
+
+    attempt->handed_over = TRUE;
+    jabber_conn.ctx = attempt->ctx;
+    jabber_conn.conn = attempt->conn;
+    jabber_conn.sm_supported = attempt->sm_supported;
+    jabber_conn.rosterver_supported = attempt->rosterver_supported;
+
+    _connection_handler(attempt->conn, attempt->status, attempt->error, NULL,
+        attempt->ctx);
+}
+
+// the worker's free function, called on the main thread
+static void
+_connect_attempt_free(void *data)
+{
+    ConnectAttempt *attempt = data;
+    xmpp_conn_release(attempt->conn);
+    xmpp_ctx_free(attempt->ctx);
+    free(attempt->altdomain);
+    free(attempt);
+    _xmpp_shutdown();
+}
+
+// release the connection and its context, cancelling the set up if it is
+// still running
+static void
+_connection_release(void)
+{
+    ConnectAttempt *attempt = jabber_conn.attempt;
+
+    if (attempt != NULL) {
+        if (attempt->handed_over) {
+            worker_free(attempt->worker);
+        } else {
+            // freed by worker_reap once it notices, which may be after a
+            // slow DNS lookup
+            worker_cancel(attempt->worker);
+        }
+
+    // a replay connection
+    } else if (jabber_conn.conn != NULL) {
+        xmpp_conn_release(jabber_conn.conn);
+        xmpp_ctx_free(jabber_conn.ctx);
+        _xmpp_shutdown();
+    }
+
+    jabber_conn.attempt = NULL;
+    jabber_conn.conn = NULL;
+    jabber_conn.ctx = NULL;
+}
+
 void
 jabber_disconnect(void)
 {
     // if connected, send end stream and wait for response
     if (jabber_conn.conn_status == JABBER_CONNECTED) {
         log_info("Closing connection");
+        _send_queued();
         jabber_conn.conn_status = JABBER_DISCONNECTING;
         xmpp_disconnect(jabber_conn.conn);
 
@@ -173,29 +402,71 @@ jabber_disconnect(void)
             jabber_process_events();
         }
         jabber_free_resources();
+
+    // still being set up on its thread
+    } else if (jabber_conn.conn_status == JABBER_CONNECTING) {
+        log_info("Cancelling connection");
+        jabber_free_resources();
+        jabber_conn.conn_status = JABBER_DISCONNECTED;
+
+    // lost and waiting to reconnect
+    } else if (reconnect_get_state() == RECONNECT_WAITING) {
+        log_info("Cancelling reconnect");
+        jabber_free_resources();
+    }
+
+    reconnect_stop();
+}
+
+/*
+ * Wait for cancelled connection attempts and free what is left, before
+ * the log is closed
+ */
+void
+jabber_shutdown(void)
+{
+    if (worker_reap(FALSE) > 0) {
+        log_info("Waiting for cancelled connections");
+        worker_reap(TRUE);
+    }
+
+    if (stanza_ctx != NULL) {
+        xmpp_ctx_free(stanza_ctx);
+        stanza_ctx = NULL;
     }
+
+    chat_sessions_close();
 }
 
 void
 jabber_process_events(void)
 {
+    worker_reap(FALSE);
+
+    // the worker runs the context until the set up is done
+    if ((jabber_conn.attempt != NULL) && !jabber_conn.attempt->handed_over) {
+        _connect_finish();
+
     // run xmpp event loop if connected, connecting or disconnecting
-    if (jabber_conn.conn_status == JABBER_CONNECTED
+    } else if (jabber_conn.conn_status == JABBER_CONNECTED
             || jabber_conn.conn_status == JABBER_CONNECTING
             || jabber_conn.conn_status == JABBER_DISCONNECTING) {
+        if (jabber_conn.conn_status == JABBER_CONNECTED) {
+            _send_queued();
+        }
         xmpp_run_once(jabber_conn.ctx, 10);
 
-    // check timer and reconnect if disconnected and timer set
-    } else if (prefs_get_reconnect() != 0) {
-        if ((jabber_conn.conn_status == JABBER_DISCONNECTED) &&
-            (reconnect_timer != NULL)) {
-            if (g_timer_elapsed(reconnect_timer, NULL) > prefs_get_reconnect()) {
-                log_debug("Attempting reconnect as %s", saved_user.jid);
-                jabber_connect(saved_user.jid, saved_user.passwd, saved_user.altdomain);
+    // reconnect if the connection was lost and the next attempt is due
+    } else if (jabber_conn.conn_status == JABBER_DISCONNECTED) {
+        gint64 now = g_get_monotonic_time() / 1000;
+        if (reconnect_due(now)) {
+            log_debug("Attempting reconnect %d as %s",
+                reconnect_get_attempts(), saved_user.jid);
+            if (_jabber_connect() == JABBER_DISCONNECTED) {
+                reconnect_failed(now);
             }
         }
     }
-
 }
 
 void
@@ -217,7 +488,7 @@ jabber_send(const char * const msg, const char * const recipient)
             msg, NULL);
     }
 
-    xmpp_send(jabber_conn.conn, message);
+    _send_stanza(message, SEND_PRIORITY_STANZA);
     xmpp_stanza_release(message);
 }
 
@@ -227,7 +498,7 @@ jabber_send_groupchat(const char * const msg, const char * const recipient)
     xmpp_stanza_t *message = stanza_create_message(jabber_conn.ctx, recipient,
         STANZA_TYPE_GROUPCHAT, msg, NULL);
 
-    xmpp_send(jabber_conn.conn, message);
+    _send_stanza(message, SEND_PRIORITY_STANZA);
     xmpp_stanza_release(message);
 }
 
@@ -237,9 +508,8 @@ jabber_send_composing(const char * const recipient)
     xmpp_stanza_t *stanza = stanza_create_chat_state(jabber_conn.ctx, recipient,
         STANZA_NAME_COMPOSING);
 
-    xmpp_send(jabber_conn.conn, stanza);
+    _send_stanza(stanza, SEND_PRIORITY_CHAT_STATE);
     xmpp_stanza_release(stanza);
-    chat_session_set_sent(recipient);
 }
 
 void
@@ -248,9 +518,8 @@ jabber_send_paused(const char * const recipient)
     xmpp_stanza_t *stanza = stanza_create_chat_state(jabber_conn.ctx, recipient,
         STANZA_NAME_PAUSED);
 
-    xmpp_send(jabber_conn.conn, stanza);
+    _send_stanza(stanza, SEND_PRIORITY_CHAT_STATE);
     xmpp_stanza_release(stanza);
-    chat_session_set_sent(recipient);
 }
 
 void
@@ -259,9 +528,8 @@ jabber_send_inactive(const char * const recipient)
     xmpp_stanza_t *stanza = stanza_create_chat_state(jabber_conn.ctx, recipient,
         STANZA_NAME_INACTIVE);
 
-    xmpp_send(jabber_conn.conn, stanza);
+    _send_stanza(stanza, SEND_PRIORITY_CHAT_STATE);
     xmpp_stanza_release(stanza);
-    chat_session_set_sent(recipient);
 }
 
 void
@@ -270,9 +538,8 @@ jabber_send_gone(const char * const recipient)
     xmpp_stanza_t *stanza = stanza_create_chat_state(jabber_conn.ctx, recipient,
         STANZA_NAME_GONE);
 
-    xmpp_send(jabber_conn.conn, stanza);
+    _send_stanza(stanza, SEND_PRIORITY_CHAT_STATE);
     xmpp_stanza_release(stanza);
-    chat_session_set_sent(recipient);
 }
 
 void
@@ -301,7 +568,7 @@ jabber_subscription(const char * const jid, jabber_subscr_t action)
     xmpp_stanza_set_name(presence, STANZA_NAME_PRESENCE);
     xmpp_stanza_set_type(presence, type);
     xmpp_stanza_set_attribute(presence, STANZA_ATTR_TO, bare_jid);
-    xmpp_send(jabber_conn.conn, presence);
+    _send_stanza(presence, SEND_PRIORITY_STANZA);
     xmpp_stanza_release(presence);
     free(jid_cpy);
 }
@@ -318,7 +585,7 @@ jabber_join(const char * const room, const char * const nick)
     char *full_room_jid = create_full_room_jid(room, nick);
     xmpp_stanza_t *presence = stanza_create_room_join_presence(jabber_conn.ctx,
         full_room_jid);
-    xmpp_send(jabber_conn.conn, presence);
+    _send_stanza(presence, SEND_PRIORITY_STANZA);
     xmpp_stanza_release(presence);
 
     muc_join_room(room, nick);
@@ -332,7 +599,7 @@ jabber_change_room_nick(const char * const room, const char * const nick)
     char *full_room_jid = create_full_room_jid(room, nick);
     xmpp_stanza_t *presence = stanza_create_room_newnick_presence(jabber_conn.ctx,
         full_room_jid);
-    xmpp_send(jabber_conn.conn, presence);
+    _send_stanza(presence, SEND_PRIORITY_STANZA);
     xmpp_stanza_release(presence);
 
     free(full_room_jid);
@@ -345,7 +612,7 @@ jabber_leave_chat_room(const char * const room_jid)
 
     xmpp_stanza_t *presence = stanza_create_room_leave_presence(jabber_conn.ctx,
         room_jid, nick);
-    xmpp_send(jabber_conn.conn, presence);
+    _send_stanza(presence, SEND_PRIORITY_STANZA);
     xmpp_stanza_release(presence);
 }
 
@@ -417,7 +684,7 @@ jabber_update_presence(jabber_presence_t status, const char * const msg,
         xmpp_stanza_add_child(presence, query);
     }
 
-    xmpp_send(jabber_conn.conn, presence);
+    _send_stanza(presence, SEND_PRIORITY_STANZA);
 
     // send presence for each room
     GList *rooms = muc_get_active_room_list();
@@ -427,7 +694,7 @@ jabber_update_presence(jabber_presence_t status, const char * const msg,
         char *full_room_jid = create_full_room_jid(room, nick);
 
         xmpp_stanza_set_attribute(presence, STANZA_ATTR_TO, full_room_jid);
-        xmpp_send(jabber_conn.conn, presence);
+        _send_stanza(presence, SEND_PRIORITY_STANZA);
 
         rooms = g_list_next(rooms);
     }
@@ -450,6 +717,24 @@ jabber_set_autoping(int seconds)
     }
 }
 
+static void
+_prefs_changed(preference_t pref)
+{
+    if (pref == PREF_AUTOPING) {
+        jabber_set_autoping(prefs_get_autoping());
+    } else if (pref == PREF_RECONNECT) {
+        gboolean waiting = (reconnect_get_state() == RECONNECT_WAITING);
+        reconnect_set_max((gint64)prefs_get_reconnect() * 1000);
+
+        // reconnecting turned off while waiting, give up the lost connection
+        if (waiting && (reconnect_get_state() == RECONNECT_IDLE)) {
+            log_info("Reconnect disabled, not reconnecting");
+            contact_list_clear();
+            jabber_free_resources();
+        }
+    }
+}
+
 jabber_conn_status_t
 jabber_get_connection_status(void)
 {
@@ -459,6 +744,15 @@ jabber_get_connection_status(void)
 const char *
 jabber_get_jid(void)
 {
+    // libstrophe changes it on the worker's thread when binding
+    if ((jabber_conn.attempt != NULL) && !jabber_conn.attempt->handed_over) {
+        return saved_user.jid;
+    }
+
+    if (jabber_conn.conn == NULL) {
+        return NULL;
+    }
+
     return xmpp_conn_get_jid(jabber_conn.conn);
 }
 
@@ -483,6 +777,70 @@ jabber_get_status(void)
         return strdup(jabber_conn.status);
 }
 
+/*
+ * Set up a connection that is never connected, so recorded stanzas can be
+ * passed to the handlers with jabber_replay_stanza.  Anything the handlers
+ * try to send is dropped by libstrophe.
+ */
+void
+jabber_replay_start(void)
+{
+    _xmpp_init();
+
+    jabber_conn.log = _xmpp_get_file_logger();
+    jabber_conn.ctx = xmpp_ctx_new(NULL, jabber_conn.log);
+    jabber_conn.conn = xmpp_conn_new(jabber_conn.ctx);
+
+    chat_sessions_clear();
+    jabber_conn.conn_status = JABBER_CONNECTED;
+    jabber_conn.presence = PRESENCE_ONLINE;
+}
+
+/*
+ * Pass a recorded stanza for jid to the handler it would have been
+ * dispatched to, timing the handler under its name and the stanza type.
+ * Returns FALSE if the stanza could not be parsed or has no handler.
+ */
+gboolean
+jabber_replay_stanza(const char * const jid, const char * const text)
+{
+    if ((jid != NULL) &&
+            (g_strcmp0(jid, xmpp_conn_get_jid(jabber_conn.conn)) != 0)) {
+        xmpp_conn_set_jid(jabber_conn.conn, jid);
+    }
+
+    xmpp_stanza_t *stanza = stanza_from_text(jabber_conn.ctx, text);
+    if (stanza == NULL) {
+        return FALSE;
+    }
+
+    // the handlers may change attributes in place, so name it first
+    char *name = xmpp_stanza_get_name(stanza);
+    char *type = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_TYPE);
+    char *stat_name = g_strdup_printf("%s %s", name,
+        type != NULL ? type : "-");
+
+    trace_stat_start();
+    gboolean handled = _dispatch(stanza);
+    _send_queued();
+    if (handled) {
+        trace_stat_end(stat_name);
+    }
+
+    g_free(stat_name);
+    xmpp_stanza_release(stanza);
+
+    return handled;
+}
+
+void
+jabber_replay_end(void)
+{
+    jabber_conn.conn_status = JABBER_DISCONNECTED;
+    jabber_conn.presence = PRESENCE_OFFLINE;
+    jabber_free_resources();
+}
+
 void
 jabber_free_resources(void)
 {
@@ -493,62 +851,230 @@ jabber_free_resources(void)
     chat_sessions_clear();
     if (sub_requests != NULL)
         g_hash_table_remove_all(sub_requests);
-    xmpp_conn_release(jabber_conn.conn);
-    xmpp_ctx_free(jabber_conn.ctx);
-    xmpp_shutdown();
+    _jabber_forget_session();
+    _connection_release();
+}
+
+static void
+_jabber_forget_session(void)
+{
+    stream_mgmt_stop();
+    send_queue_clear();
+    FREE_SET_NULL(roster_ver);
 }
 
 static void
 _jabber_roster_request(void)
 {
-    xmpp_stanza_t *iq = stanza_create_roster_iq(jabber_conn.ctx);
-    xmpp_send(jabber_conn.conn, iq);
+    // XEP-0237, when reconnecting only ask for changes, the contacts are
+    // still known
+    const char *ver = NULL;
+    if (jabber_conn.rosterver_supported) {
+        ver = (roster_ver != NULL) ? roster_ver : "";
+    }
+
+    xmpp_stanza_t *iq = stanza_create_roster_iq(jabber_conn.ctx, ver);
+    _send_stanza(iq, SEND_PRIORITY_STANZA);
     xmpp_stanza_release(iq);
 }
 
+/*
+ * Queue a stanza to be written with the others queued in this pass of the
+ * main loop.  Chat messages to contacts are kept while reconnecting and
+ * sent after, other stanzas are dropped if the connection is not up.  Room
+ * messages, private ones included, need the room joined again first
+ */
+static void
+_send_stanza(xmpp_stanza_t * const stanza, send_priority_t priority)
+{
+    char *name = xmpp_stanza_get_name(stanza);
+    char *type = xmpp_stanza_get_type(stanza);
+    gboolean persist = (priority == SEND_PRIORITY_STANZA) &&
+        (g_strcmp0(name, STANZA_NAME_MESSAGE) == 0) &&
+        (g_strcmp0(type, STANZA_TYPE_CHAT) == 0) &&
+        !muc_room_is_active(xmpp_stanza_get_attribute(stanza, STANZA_ATTR_TO));
+
+    if ((jabber_conn.conn_status != JABBER_CONNECTED) &&
+            !(persist && (reconnect_get_state() != RECONNECT_IDLE))) {
+        return;
+    }
+
+    char *buf;
+    size_t len;
+    if (xmpp_stanza_to_text(stanza, &buf, &len) == 0) {
+        char *text = g_strndup(buf, len);
+        send_queue_add(priority, text, persist);
+        g_free(text);
+        xmpp_free(jabber_conn.ctx, buf);
+    }
+}
+
+/*
+ * Write everything queued in one go, highest priority first.  With stream
+ * management, messages are kept until the server acknowledges them, so
+ * they can be sent again after a reconnect
+ */
+static void
+_send_queued(void)
+{
+    if (send_queue_length() == 0) {
+        return;
+    }
+
+    GString *data = g_string_new("");
+    gboolean messages = FALSE;
+    gboolean persist;
+    char *text;
+
+    while ((text = send_queue_pop(&persist)) != NULL) {
+        g_string_append(data, text);
+        stream_mgmt_sent(persist ? text : NULL);
+        messages = messages || persist;
+        free(text);
+    }
+
+    xmpp_send_raw(jabber_conn.conn, data->str, data->len);
+    g_string_free(data, TRUE);
+
+    if (messages) {
+        _sm_request_ack();
+    }
+}
+
+// ask the server which stanzas it has handled, unless already asked
+static void
+_sm_request_ack(void)
+{
+    if (stream_mgmt_is_enabled() && !jabber_conn.sm_requested) {
+        xmpp_stanza_t *request = stanza_create_sm_request(jabber_conn.ctx);
+        xmpp_send(jabber_conn.conn, request);
+        xmpp_stanza_release(request);
+        jabber_conn.sm_requested = TRUE;
+    }
+}
+
+// the features the server offers are only seen by libstrophe, so they are
+// read from its log
+static void
+_stream_features(xmpp_ctx_t * const ctx, const char * const text,
+    gboolean *sm_supported, gboolean *rosterver_supported)
+{
+    xmpp_stanza_t *features = stanza_from_text(ctx, text);
+    if (features == NULL) {
+        return;
+    }
+
+    xmpp_stanza_t *feature = xmpp_stanza_get_children(features);
+    while (feature != NULL) {
+        char *xmlns = xmpp_stanza_get_attribute(feature, STANZA_ATTR_XMLNS);
+        if (g_strcmp0(xmlns, STANZA_NS_SM) == 0) {
+            *sm_supported = TRUE;
+        } else if (g_strcmp0(xmlns, STANZA_NS_ROSTERVER) == 0) {
+            *rosterver_supported = TRUE;
+        }
+        feature = xmpp_stanza_get_next(feature);
+    }
+
+    xmpp_stanza_release(features);
+}
+
+static void
+_dispatch_init(void)
+{
+    dispatch_close();
+
+    dispatch_add("error", STANZA_NAME_MESSAGE, STANZA_TYPE_ERROR, NULL,
+        _error_handler);
+    dispatch_add("groupchat", STANZA_NAME_MESSAGE, STANZA_TYPE_GROUPCHAT,
+        NULL, _groupchat_message_handler);
+    dispatch_add("chat", STANZA_NAME_MESSAGE, STANZA_TYPE_CHAT, NULL,
+        _chat_message_handler);
+
+    dispatch_add("error", STANZA_NAME_PRESENCE, STANZA_TYPE_ERROR, NULL,
+        _error_handler);
+    dispatch_add("subscription", STANZA_NAME_PRESENCE, STANZA_TYPE_SUBSCRIBE,
+        NULL, _subscription_handler);
+    dispatch_add("subscription", STANZA_NAME_PRESENCE,
+        STANZA_TYPE_SUBSCRIBED, NULL, _subscription_handler);
+    dispatch_add("subscription", STANZA_NAME_PRESENCE,
+        STANZA_TYPE_UNSUBSCRIBED, NULL, _subscription_handler);
+    dispatch_add("presence", STANZA_NAME_PRESENCE, NULL, NULL,
+        _presence_handler);
+
+    dispatch_add("roster", STANZA_NAME_IQ, STANZA_TYPE_RESULT,
+        XMPP_NS_ROSTER, _roster_handler);
+    dispatch_add("iq result", STANZA_NAME_IQ, STANZA_TYPE_RESULT, NULL,
+        _iq_result_handler);
+    dispatch_add("iq result", STANZA_NAME_IQ, STANZA_TYPE_ERROR, NULL,
+        _iq_result_handler);
+    dispatch_add("roster push", STANZA_NAME_IQ, STANZA_TYPE_SET,
+        XMPP_NS_ROSTER, _roster_push_handler);
+    dispatch_add("ping", STANZA_NAME_IQ, STANZA_TYPE_GET, STANZA_NS_PING,
+        _ping_handler);
+}
+
 static int
-_message_handler(xmpp_conn_t * const conn,
+_stanza_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata)
 {
-    gchar *type = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_TYPE);
+    _dispatch(stanza);
 
-    if (type == NULL) {
-        log_error("Message stanza received with no type attribute");
-        return 1;
-    } else if (strcmp(type, STANZA_TYPE_ERROR) == 0) {
-        return _error_handler(stanza);
-    } else if (strcmp(type, STANZA_TYPE_GROUPCHAT) == 0) {
-        return _groupchat_message_handler(stanza);
-    } else if (strcmp(type, STANZA_TYPE_CHAT) == 0) {
-        return _chat_message_handler(stanza);
-    } else {
-        log_error("Message stanza received with unknown type: %s", type);
-        return 1;
+    return 1;
+}
+
+// find the handler from the namespaces of the children first, then the
+// stanza name and type alone
+static gboolean
+_dispatch(xmpp_stanza_t * const stanza)
+{
+    char *name = xmpp_stanza_get_name(stanza);
+    char *type = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_TYPE);
+    if (name == NULL) {
+        return FALSE;
     }
+
+    xmpp_stanza_t *child = xmpp_stanza_get_children(stanza);
+    while (child != NULL) {
+        char *ns = xmpp_stanza_get_attribute(child, STANZA_ATTR_XMLNS);
+        if ((ns != NULL) && dispatch_call(name, type, ns, stanza)) {
+            return TRUE;
+        }
+        child = xmpp_stanza_get_next(child);
+    }
+
+    if (dispatch_call(name, type, NULL, stanza)) {
+        return TRUE;
+    }
+
+    log_debug("No handler for %s stanza with type %s", name,
+        type != NULL ? type : "none");
+
+    return FALSE;
 }
 
 static int
 _groupchat_message_handler(xmpp_stanza_t * const stanza)
 {
-    char *room = NULL;
-    char *nick = NULL;
     char *message = NULL;
     char *room_jid = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
+    Jid *jid = jid_lookup(room_jid);
+
+    if (jid == NULL) {
+        log_error("Could not parse room jid: %s", room_jid);
+        return 1;
+    }
 
     // handle room broadcasts
-    if (jid_is_room(room_jid)) {
+    if (jid->resourcepart == NULL) {
         xmpp_stanza_t *subject = xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_SUBJECT);
 
         // handle subject
         if (subject != NULL) {
             message = xmpp_stanza_get_text(subject);
             if (message != NULL) {
-                room = get_room_from_full_jid(room_jid);
-                prof_handle_room_subject(room, message);
+                prof_handle_room_subject(jid->barejid, message);
             }
 
-            return 1;
-
         // handle other room broadcasts
         } else {
             xmpp_stanza_t *body = xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_BODY);
@@ -558,23 +1084,16 @@ _groupchat_message_handler(xmpp_stanza_t * const stanza)
                     prof_handle_room_broadcast(room_jid, message);
                 }
             }
-
-            return 1;
         }
-    }
 
-    // room jid not of form room/nick
-    if (!parse_room_jid(room_jid, &room, &nick)) {
-        log_error("Could not parse room jid: %s", room_jid);
+        jid_destroy(jid);
         return 1;
     }
 
     // room not active in profanity
     if (!muc_room_is_active(room_jid)) {
         log_error("Message recieved for inactive groupchat: %s", room_jid);
-        free(room);
-        free(nick);
-
+        jid_destroy(jid);
         return 1;
     }
 
@@ -587,14 +1106,14 @@ _groupchat_message_handler(xmpp_stanza_t * const stanza)
     if (body != NULL) {
         char *message = xmpp_stanza_get_text(body);
         if (delayed) {
-            prof_handle_room_history(room, nick, tv_stamp, message);
+            prof_handle_room_history(jid->barejid, jid->resourcepart, tv_stamp,
+                message);
         } else {
-            prof_handle_room_message(room, nick, message);
+            prof_handle_room_message(jid->barejid, jid->resourcepart, message);
         }
     }
 
-    free(room);
-    free(nick);
+    jid_destroy(jid);
 
     return 1;
 }
@@ -643,25 +1162,29 @@ _chat_message_handler(xmpp_stanza_t * const stanza)
 {
     gboolean priv = FALSE;
     gchar *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
+    Jid *from_jid = jid_lookup(from);
+    const char *jid = NULL;
 
-    char from_cpy[strlen(from) + 1];
-    strcpy(from_cpy, from);
-    char *short_from = strtok(from_cpy, "/");
-    char *jid = NULL;
+    if (from_jid == NULL) {
+        log_error("Could not parse message sender: %s", from);
+        return 1;
+    }
 
     // private message from chat room use full jid (room/nick)
-    if (muc_room_is_active(short_from)) {
-        jid = strdup(from);
+    if (muc_room_is_active(from_jid->barejid) &&
+            (from_jid->resourcepart != NULL)) {
+        jid = from_jid->fulljid;
         priv = TRUE;
     // standard chat message, use jid without resource
     } else {
-        jid = strdup(short_from);
+        jid = from_jid->barejid;
         priv = FALSE;
     }
 
     // determine chatstate support of recipient
+    char *state = stanza_get_chat_state(stanza);
     gboolean recipient_supports = FALSE;
-    if (stanza_contains_chat_state(stanza)) {
+    if (state != NULL) {
         recipient_supports = TRUE;
     }
 
@@ -677,34 +1200,43 @@ _chat_message_handler(xmpp_stanza_t * const stanza)
     gboolean delayed = stanza_get_delay(stanza, &tv_stamp);
 
     // deal with chat states if recipient supports them
+    // paused, inactive and active are not shown
     if (recipient_supports && (!delayed)) {
-        if (xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_COMPOSING) != NULL) {
+        if (strcmp(state, STANZA_NAME_COMPOSING) == 0) {
             if (prefs_get_notify_typing() || prefs_get_intype()) {
                 prof_handle_typing(jid);
             }
-        } else if (xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_GONE) != NULL) {
+        } else if (strcmp(state, STANZA_NAME_GONE) == 0) {
             prof_handle_gone(jid);
-        } else if (xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_PAUSED) != NULL) {
-            // do something
-        } else if (xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_INACTIVE) != NULL) {
-            // do something
-        } else { // handle <active/>
-            // do something
         }
     }
 
     // check for and deal with message
     xmpp_stanza_t *body = xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_BODY);
+    char *text = NULL;
     if (body != NULL) {
-        char *message = xmpp_stanza_get_text(body);
+        text = xmpp_stanza_get_text(body);
+    }
+    if (text != NULL) {
+        ProfMessage message;
+        message.from_jid = from_jid;
+        message.from = jid;
+        message.body = text;
+        message.delayed = delayed;
+        message.priv = priv;
         if (delayed) {
-            prof_handle_delayed_message(jid, message, tv_stamp, priv);
+            message.timestamp = g_date_time_new_from_timeval_utc(&tv_stamp);
         } else {
-            prof_handle_incoming_message(jid, message, priv);
+            message.timestamp = g_date_time_new_now_local();
         }
+
+        prof_handle_incoming_message(&message);
+
+        g_date_time_unref(message.timestamp);
+        xmpp_free(jabber_conn.ctx, text);
     }
 
-    free(jid);
+    jid_destroy(from_jid);
 
     return 1;
 }
@@ -725,52 +1257,65 @@ _connection_handler(xmpp_conn_t * const conn,
             prof_handle_login_success(jid, saved_user.altdomain);
         }
 
-        chat_sessions_init();
+        chat_sessions_clear();
 
-        xmpp_handler_add(conn, _message_handler, NULL, STANZA_NAME_MESSAGE, NULL, ctx);
-        xmpp_handler_add(conn, _presence_handler, NULL, STANZA_NAME_PRESENCE, NULL, ctx);
-        xmpp_handler_add(conn, _iq_handler, NULL, STANZA_NAME_IQ, NULL, ctx);
+        xmpp_handler_add(conn, _sm_count_handler, NULL, NULL, NULL, ctx);
+        xmpp_handler_add(conn, _sm_handler, STANZA_NS_SM, NULL, NULL, ctx);
+        xmpp_handler_add(conn, _stanza_handler, NULL, STANZA_NAME_MESSAGE, NULL, ctx);
+        xmpp_handler_add(conn, _stanza_handler, NULL, STANZA_NAME_PRESENCE, NULL, ctx);
+        xmpp_handler_add(conn, _stanza_handler, NULL, STANZA_NAME_IQ, NULL, ctx);
 
         if (prefs_get_autoping() != 0) {
             int millis = prefs_get_autoping() * 1000;
             xmpp_timed_handler_add(conn, _ping_timed_handler, millis, ctx);
         }
 
-        _jabber_roster_request();
+        // XEP-0198, counting starts when enable is sent
+        if (jabber_conn.sm_supported) {
+            xmpp_stanza_t *enable = stanza_create_sm_enable(ctx);
+            xmpp_send(conn, enable);
+            xmpp_stanza_release(enable);
+            stream_mgmt_start();
+        }
+
         jabber_conn.conn_status = JABBER_CONNECTED;
         jabber_conn.presence = PRESENCE_ONLINE;
+        _jabber_roster_request();
 
-        if (prefs_get_reconnect() != 0) {
-            if (reconnect_timer != NULL) {
-                g_timer_destroy(reconnect_timer);
-                reconnect_timer = NULL;
-            }
+        // messages queued while reconnecting go out on the next pass
+        if (send_queue_length() > 0) {
+            log_info("Sending %d queued messages", send_queue_length());
         }
 
+        reconnect_connected();
+
     } else if (status == XMPP_CONN_DISCONNECT) {
 
         // lost connection for unkown reason
         if (jabber_conn.conn_status == JABBER_CONNECTED) {
             prof_handle_lost_connection();
-            if (prefs_get_reconnect() != 0) {
-                assert(reconnect_timer == NULL);
-                reconnect_timer = g_timer_new();
-                // TODO: free resources but leave saved_user untouched
+            reconnect_lost(g_get_monotonic_time() / 1000);
+            if (reconnect_get_state() == RECONNECT_WAITING) {
+                // messages the server did not acknowledge go out again,
+                // before any typed while reconnecting
+                send_queue_drop_transient();
+                send_queue_requeue(stream_mgmt_take_unacked());
             } else {
                 jabber_free_resources();
             }
 
         // login attempt failed
         } else if (jabber_conn.conn_status != JABBER_DISCONNECTING) {
-            if (reconnect_timer == NULL) {
+            if (reconnect_get_state() == RECONNECT_CONNECTING) {
+                reconnect_failed(g_get_monotonic_time() / 1000);
+            } else {
                 prof_handle_failed_login();
                 jabber_free_resources();
-            } else {
-                if (prefs_get_reconnect() != 0) {
-                    g_timer_start(reconnect_timer);
-                }
-                // TODO: free resources but leave saved_user untouched
             }
+
+        // disconnected on request
+        } else {
+            stream_mgmt_stop();
         }
 
         // close stream response from server after disconnect is handled too
@@ -779,107 +1324,85 @@ _connection_handler(xmpp_conn_t * const conn,
     }
 }
 
+// the initial roster request, if the server sent no roster
 static int
-_iq_handler(xmpp_conn_t * const conn,
-    xmpp_stanza_t * const stanza, void * const userdata)
+_iq_result_handler(xmpp_stanza_t * const stanza)
 {
     char *id = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_ID);
 
-    // handle the initial roster request
     if ((id != NULL) && (strcmp(id, "roster") == 0)) {
-        return _roster_handler(conn, stanza, userdata);
-
-    // handle iq
-    } else {
-        char *type = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_TYPE);
-        if (type == NULL) {
-            return TRUE;
-        }
-
-        // handle roster update
-        if (strcmp(type, STANZA_TYPE_SET) == 0) {
-
-            xmpp_stanza_t *query =
-                xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_QUERY);
-            if (query == NULL) {
-                return TRUE;
-            }
-
-            char *xmlns = xmpp_stanza_get_attribute(query, STANZA_ATTR_XMLNS);
-            if (xmlns == NULL) {
-                return TRUE;
-            }
-            if (strcmp(xmlns, XMPP_NS_ROSTER) != 0) {
-                return TRUE;
-            }
+        return _roster_handler(stanza);
+    }
 
-            xmpp_stanza_t *item =
-                xmpp_stanza_get_child_by_name(query, STANZA_NAME_ITEM);
-            if (item == NULL) {
-                return TRUE;
-            }
+    return 1;
+}
 
-            const char *jid = xmpp_stanza_get_attribute(item, STANZA_ATTR_JID);
-            const char *sub = xmpp_stanza_get_attribute(item, STANZA_ATTR_SUBSCRIPTION);
-            if (g_strcmp0(sub, "remove") == 0) {
-                contact_list_remove(jid);
-                return TRUE;
-            }
+static int
+_roster_push_handler(xmpp_stanza_t * const stanza)
+{
+    xmpp_stanza_t *query =
+        xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_QUERY);
+    if (query == NULL) {
+        return 1;
+    }
 
-            gboolean pending_out = FALSE;
-            const char *ask = xmpp_stanza_get_attribute(item, STANZA_ATTR_ASK);
-            if ((ask != NULL) && (strcmp(ask, "subscribe") == 0)) {
-                pending_out = TRUE;
-            }
+    char *ver = xmpp_stanza_get_attribute(query, STANZA_ATTR_VER);
+    if (ver != NULL) {
+        FREE_SET_NULL(roster_ver);
+        roster_ver = strdup(ver);
+    }
 
-            contact_list_update_subscription(jid, sub, pending_out);
+    xmpp_stanza_t *item =
+        xmpp_stanza_get_child_by_name(query, STANZA_NAME_ITEM);
+    if (item == NULL) {
+        return 1;
+    }
 
-            return TRUE;
+    const char *jid = xmpp_stanza_get_attribute(item, STANZA_ATTR_JID);
+    const char *sub = xmpp_stanza_get_attribute(item, STANZA_ATTR_SUBSCRIPTION);
+    if (g_strcmp0(sub, "remove") == 0) {
+        contact_list_remove(jid);
+        return 1;
+    }
 
-        // handle server ping
-        } else if (strcmp(type, STANZA_TYPE_GET) == 0) {
-            xmpp_stanza_t *ping = xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_PING);
-            if (ping == NULL) {
-                return TRUE;
-            }
+    gboolean pending_out = FALSE;
+    const char *ask = xmpp_stanza_get_attribute(item, STANZA_ATTR_ASK);
+    if ((ask != NULL) && (strcmp(ask, "subscribe") == 0)) {
+        pending_out = TRUE;
+    }
 
-            char *xmlns = xmpp_stanza_get_attribute(ping, STANZA_ATTR_XMLNS);
-            if (xmlns == NULL) {
-                return TRUE;
-            }
+    contact_list_update_subscription(jid, sub, pending_out);
 
-            if (strcmp(xmlns, STANZA_NS_PING) != 0) {
-                return TRUE;
-            }
+    return 1;
+}
 
-            char *to = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_TO);
-            char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
-            if ((from == NULL) || (to == NULL)) {
-                return TRUE;
-            }
+static int
+_ping_handler(xmpp_stanza_t * const stanza)
+{
+    char *id = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_ID);
+    char *to = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_TO);
+    char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
+    if ((from == NULL) || (to == NULL)) {
+        return 1;
+    }
 
-            xmpp_stanza_t *pong = xmpp_stanza_new(jabber_conn.ctx);
-            xmpp_stanza_set_name(pong, STANZA_NAME_IQ);
-            xmpp_stanza_set_attribute(pong, STANZA_ATTR_TO, from);
-            xmpp_stanza_set_attribute(pong, STANZA_ATTR_FROM, to);
-            xmpp_stanza_set_attribute(pong, STANZA_ATTR_TYPE, STANZA_TYPE_RESULT);
-            if (id != NULL) {
-                xmpp_stanza_set_attribute(pong, STANZA_ATTR_ID, id);
-            }
+    xmpp_stanza_t *pong = xmpp_stanza_new(jabber_conn.ctx);
+    xmpp_stanza_set_name(pong, STANZA_NAME_IQ);
+    xmpp_stanza_set_attribute(pong, STANZA_ATTR_TO, from);
+    xmpp_stanza_set_attribute(pong, STANZA_ATTR_FROM, to);
+    xmpp_stanza_set_attribute(pong, STANZA_ATTR_TYPE, STANZA_TYPE_RESULT);
+    if (id != NULL) {
+        xmpp_stanza_set_attribute(pong, STANZA_ATTR_ID, id);
+    }
 
-            xmpp_send(jabber_conn.conn, pong);
-            xmpp_stanza_release(pong);
+    _send_stanza(pong, SEND_PRIORITY_PING);
+    xmpp_stanza_release(pong);
 
-            return TRUE;
-        } else {
-            return TRUE;
-        }
-    }
+    return 1;
 }
 
 static int
-_roster_handler(xmpp_conn_t * const conn,
-    xmpp_stanza_t * const stanza, void * const userdata)
+_roster_handler(xmpp_stanza_t * const stanza)
 {
     xmpp_stanza_t *query, *item;
     char *type = xmpp_stanza_get_type(stanza);
@@ -888,7 +1411,19 @@ _roster_handler(xmpp_conn_t * const conn,
         log_error("Roster query failed");
     else {
         query = xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_QUERY);
-        item = xmpp_stanza_get_children(query);
+
+        // an empty result means the roster has not changed since roster_ver,
+        // otherwise it replaces the contacts kept from before a reconnect
+        item = NULL;
+        if (query != NULL) {
+            char *ver = xmpp_stanza_get_attribute(query, STANZA_ATTR_VER);
+            FREE_SET_NULL(roster_ver);
+            if (ver != NULL) {
+                roster_ver = strdup(ver);
+            }
+            contact_list_clear();
+            item = xmpp_stanza_get_children(query);
+        }
 
         while (item != NULL) {
             const char *jid = xmpp_stanza_get_attribute(item, STANZA_ATTR_JID);
@@ -928,21 +1463,75 @@ _ping_timed_handler(xmpp_conn_t * const conn, void * const userdata)
         xmpp_ctx_t *ctx = (xmpp_ctx_t *)userdata;
 
         xmpp_stanza_t *iq = stanza_create_ping_iq(ctx);
-        xmpp_send(conn, iq);
+        _send_stanza(iq, SEND_PRIORITY_PING);
         xmpp_stanza_release(iq);
+        _sm_request_ack();
+    }
+
+    return 1;
+}
+
+static int
+_sm_handler(xmpp_conn_t * const conn,
+    xmpp_stanza_t * const stanza, void * const userdata)
+{
+    char *name = xmpp_stanza_get_name(stanza);
+
+    if (strcmp(name, STANZA_NAME_ENABLED) == 0) {
+        log_info("Stream management enabled");
+        stream_mgmt_enabled();
+
+    } else if (strcmp(name, STANZA_NAME_FAILED) == 0) {
+        log_warning("Server refused stream management");
+        stream_mgmt_stop();
+
+    // the server asks which stanzas we have handled
+    } else if (strcmp(name, STANZA_NAME_R) == 0) {
+        xmpp_stanza_t *ack = stanza_create_sm_ack(jabber_conn.ctx,
+            stream_mgmt_get_handled());
+        xmpp_send(conn, ack);
+        xmpp_stanza_release(ack);
+
+    // the server says which of ours it has handled
+    } else if (strcmp(name, STANZA_NAME_A) == 0) {
+        char *h = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_H);
+        jabber_conn.sm_requested = FALSE;
+        if (h != NULL) {
+            guint32 handled = (guint32)strtoul(h, NULL, 10);
+            if (!stream_mgmt_acked(handled)) {
+                log_warning("Server acknowledged %s stanzas, more than sent",
+                    h);
+            }
+        }
+    }
+
+    return 1;
+}
+
+// XEP-0198 counts every message, presence and iq received
+static int
+_sm_count_handler(xmpp_conn_t * const conn,
+    xmpp_stanza_t * const stanza, void * const userdata)
+{
+    char *name = xmpp_stanza_get_name(stanza);
+
+    if ((g_strcmp0(name, STANZA_NAME_MESSAGE) == 0) ||
+            (g_strcmp0(name, STANZA_NAME_PRESENCE) == 0) ||
+            (g_strcmp0(name, STANZA_NAME_IQ) == 0)) {
+        stream_mgmt_received();
     }
 
     return 1;
 }
 
 static int
-_room_presence_handler(const char * const jid, xmpp_stanza_t * const stanza)
+_room_presence_handler(Jid * const jid, xmpp_stanza_t * const stanza)
 {
-    char *room = NULL;
-    char *nick = NULL;
+    char *room = jid->barejid;
+    char *nick = jid->resourcepart;
 
-    if (!parse_room_jid(jid, &room, &nick)) {
-        log_error("Could not parse room jid: %s", room);
+    if (nick == NULL) {
+        log_error("Could not parse room jid: %s", jid->barejid);
         return 1;
     }
 
@@ -1018,35 +1607,53 @@ _room_presence_handler(const char * const jid, xmpp_stanza_t * const stanza)
         }
     }
 
-    free(room);
-    free(nick);
-
     return 1;
 }
 
 static int
-_presence_handler(xmpp_conn_t * const conn,
-    xmpp_stanza_t * const stanza, void * const userdata)
+_subscription_handler(xmpp_stanza_t * const stanza)
 {
-    const char *jid = xmpp_conn_get_jid(jabber_conn.conn);
-    char jid_cpy[strlen(jid) + 1];
-    strcpy(jid_cpy, jid);
-    char *short_jid = strtok(jid_cpy, "/");
-
-    char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
     char *type = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_TYPE);
+    Jid *from = jid_lookup(xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM));
+    if (from == NULL) {
+        return 1;
+    }
 
-    if ((type != NULL) && (strcmp(type, STANZA_TYPE_ERROR) == 0)) {
-        return _error_handler(stanza);
+    char *short_from = from->barejid;
+
+    if (strcmp(type, STANZA_TYPE_SUBSCRIBE) == 0) {
+        prof_handle_subscription(short_from, PRESENCE_SUBSCRIBE);
+        g_hash_table_insert(sub_requests, strdup(short_from), strdup(short_from));
+    } else if (strcmp(type, STANZA_TYPE_SUBSCRIBED) == 0) {
+        prof_handle_subscription(short_from, PRESENCE_SUBSCRIBED);
+        g_hash_table_remove(sub_requests, short_from);
+    } else {
+        prof_handle_subscription(short_from, PRESENCE_UNSUBSCRIBED);
+        g_hash_table_remove(sub_requests, short_from);
+    }
+
+    jid_destroy(from);
+
+    return 1;
+}
+
+static int
+_presence_handler(xmpp_stanza_t * const stanza)
+{
+    Jid *from = jid_lookup(xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM));
+    if (from == NULL) {
+        return 1;
     }
 
     // handle chat room presence
-    if (muc_room_is_active(from)) {
-        return _room_presence_handler(from, stanza);
+    if (muc_room_is_active(from->barejid)) {
+        _room_presence_handler(from, stanza);
 
     // handle regular presence
     } else {
-        char *short_from = strtok(from, "/");
+        Jid *my_jid = jid_lookup(xmpp_conn_get_jid(jabber_conn.conn));
+        char *short_jid = my_jid->barejid;
+        char *short_from = from->barejid;
         char *type = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_TYPE);
         char *show_str, *status_str;
         int idle_seconds = stanza_get_idle_time(stanza);
@@ -1078,26 +1685,19 @@ _presence_handler(xmpp_conn_t * const conn,
             if (strcmp(short_jid, short_from) !=0) {
                 prof_handle_contact_offline(short_from, "offline", status_str);
             }
+        } else { /* unknown type */
+            log_debug("Received presence with unknown type '%s'", type);
+        }
 
         if (last_activity != NULL) {
             g_date_time_unref(last_activity);
         }
 
-        // subscriptions
-        } else if (strcmp(type, STANZA_TYPE_SUBSCRIBE) == 0) {
-            prof_handle_subscription(short_from, PRESENCE_SUBSCRIBE);
-            g_hash_table_insert(sub_requests, strdup(short_from), strdup(short_from));
-        } else if (strcmp(type, STANZA_TYPE_SUBSCRIBED) == 0) {
-            prof_handle_subscription(short_from, PRESENCE_SUBSCRIBED);
-            g_hash_table_remove(sub_requests, short_from);
-        } else if (strcmp(type, STANZA_TYPE_UNSUBSCRIBED) == 0) {
-            prof_handle_subscription(short_from, PRESENCE_UNSUBSCRIBED);
-            g_hash_table_remove(sub_requests, short_from);
-        } else { /* unknown type */
-            log_debug("Received presence with unknown type '%s'", type);
-        }
+        jid_destroy(my_jid);
     }
 
+    jid_destroy(from);
+
     return 1;
 }
 
@@ -1137,6 +1737,21 @@ _xmpp_file_logger(void * const userdata, const xmpp_log_level_t level,
 {
     log_level_t prof_level = _get_log_level(level);
     log_msg(prof_level, area, msg);
+
+    // libstrophe logs each stanza it receives in full
+    if ((strcmp(area, "xmpp") == 0) && (strncmp(msg, "RECV: ", 6) == 0)) {
+        const char *stanza = msg + 6;
+
+        if (trace_recording()) {
+            trace_record(xmpp_conn_get_jid(jabber_conn.conn), stanza);
+        }
+
+        if (g_str_has_prefix(stanza, "<stream:features") ||
+                g_str_has_prefix(stanza, "<features")) {
+            _stream_features(jabber_conn.ctx, stanza,
+                &jabber_conn.sm_supported, &jabber_conn.rosterver_supported);
+        }
+    }
 }
 
 static xmpp_log_t *
@@ -1151,3 +1766,19 @@ _xmpp_get_file_logger()
     return file_log;
 }
 
+static void
+_xmpp_init(void)
+{
+    if (xmpp_users++ == 0) {
+        xmpp_initialize();
+    }
+}
+
+// a cancelled attempt can be freed while the next is connecting
+static void
+_xmpp_shutdown(void)
+{
+    if (--xmpp_users == 0) {
+        xmpp_shutdown();
+    }
+}
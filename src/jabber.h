@@ -23,7 +23,10 @@
 #ifndef JABBER_H
 #define JABBER_H
 
+#include <glib.h>
+
 #include "accounts.h"
+#include "jid.h"
 
 typedef enum {
     JABBER_UNDEFINED,
@@ -49,6 +52,21 @@ typedef enum {
     PRESENCE_UNSUBSCRIBED
 } jabber_subscr_t;
 
+/*
+ * An incoming chat or private message, made once by the stanza handler and
+ * read by everything that shows or logs it.  The strings belong to the
+ * stanza and the Jid, so it is only valid during the handler.  from is the
+ * bare JID, or room/nick for a private message
+ */
+typedef struct prof_message_t {
+    Jid *from_jid;
+    const char *from;
+    const char *body;
+    GDateTime *timestamp;
+    gboolean delayed;
+    gboolean priv;
+} ProfMessage;
+
 #define JABBER_PRIORITY_MIN -128
 #define JABBER_PRIORITY_MAX 127
 
@@ -58,6 +76,7 @@ jabber_conn_status_t jabber_connect(const char * const jid,
 jabber_conn_status_t jabber_connect_with_account(ProfAccount *account,
     const char * const passwd);
 void jabber_disconnect(void);
+void jabber_shutdown(void);
 void jabber_process_events(void);
 void jabber_join(const char * const room, const char * const nick);
 void jabber_change_room_nick(const char * const room, const char * const nick);
@@ -80,5 +99,8 @@ char * jabber_get_status(void);
 void jabber_free_resources(void);
 void jabber_restart(void);
 void jabber_set_autoping(int seconds);
+void jabber_replay_start(void);
+gboolean jabber_replay_stanza(const char * const jid, const char * const text);
+void jabber_replay_end(void);
 
 #endif
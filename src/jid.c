@@ -28,98 +28,111 @@
 #include "common.h"
 #include "jid.h"
 
+// a Jid and its strings are one allocation, the parts pointing into data:
+//
+//     data = "user@domain/resource\0user@domain\0user\0"
+//
+// the resourcepart and domainpart are the tails of the full and bare
+// copies.  jid_lookup() shares the Jids of recently seen JIDs, so a
+// stanza handler doesn't parse the same sender again for each stanza
+
+#define JID_CACHE_SIZE 64
+
+static GHashTable *cache = NULL;
+static GQueue cache_order = G_QUEUE_INIT;
+
+static Jid * _jid_new(const char * const str);
+
 Jid *
 jid_create(const gchar * const str)
 {
-    Jid *result = NULL;
-
     if (str == NULL) {
         return NULL;
     }
-    if (strlen(str) == 0) {
-        return NULL;
-    }
 
-    gchar *trimmed = g_strdup(str);
+    return _jid_new(str);
+}
 
-    if (g_str_has_prefix(trimmed, "/") || g_str_has_prefix(trimmed, "@")) {
-        g_free(trimmed);
-        return NULL;
-    } else if (g_str_has_suffix(trimmed, "/") || g_str_has_suffix(trimmed, "@")) {
-        g_free(trimmed);
-        return NULL;
-    }
+Jid *
+jid_create_room_jid(const char * const room, const char * const nick)
+{
+    Jid *result;
+    char *jid = create_full_room_jid(room, nick);
+    result = jid_create(jid);
+    free(jid);
 
-    gchar *slashp = g_strrstr(trimmed, "/");
+    return result;
+}
 
-    // has resourcepart
-    if (slashp != NULL) {
-        result = malloc(sizeof(struct jid_t));
-        result->resourcepart = g_strdup(slashp + 1);
-        result->barejid = g_strndup(trimmed, strlen(trimmed) - strlen(result->resourcepart) - 1);
-        result->fulljid = g_strdup(trimmed);
-
-        gchar *atp = g_strrstr(result->barejid, "@");
-
-        // has domain and local parts
-        if (atp != NULL) {
-            result->domainpart = g_strndup(atp + 1, strlen(trimmed));
-            result->localpart = g_strndup(trimmed, strlen(trimmed) - (strlen(result->resourcepart) + strlen(result->domainpart) + 2));
-
-        // only domain part
-        } else {
-            result->domainpart = strdup(result->barejid);
-            result->localpart = NULL;
-        }
+/*
+ * Like jid_create, but the Jid may be shared with earlier callers, so it
+ * must not be changed.  Release it with jid_destroy
+ */
+Jid *
+jid_lookup(const char * const str)
+{
+    if (str == NULL) {
+        return NULL;
+    }
 
-        g_free(trimmed);
-        return result;
+    if (cache == NULL) {
+        cache = g_hash_table_new(g_str_hash, g_str_equal);
+    }
 
-    // no resourcepart
-    } else {
-        result = malloc(sizeof(struct jid_t));
-        result->resourcepart = NULL;
-        result->barejid = g_strdup(trimmed);
-        result->fulljid = NULL;
+    // most recently used at the head
+    GList *link = g_hash_table_lookup(cache, str);
+    if (link != NULL) {
+        g_queue_unlink(&cache_order, link);
+        g_queue_push_head_link(&cache_order, link);
+        Jid *jid = link->data;
+        jid->refs++;
+        return jid;
+    }
 
-        gchar *atp = g_strrstr(trimmed, "@");
+    Jid *jid = _jid_new(str);
+    if (jid == NULL) {
+        return NULL;
+    }
 
-        // has local and domain parts
-        if (atp != NULL) {
-            result->domainpart = g_strdup(atp + 1);
-            result->localpart = g_strndup(trimmed, strlen(trimmed) - strlen(result->domainpart) - 1);
+    if (g_queue_get_length(&cache_order) == JID_CACHE_SIZE) {
+        Jid *oldest = g_queue_pop_tail(&cache_order);
+        g_hash_table_remove(cache, oldest->data);
+        jid_destroy(oldest);
+    }
 
-        // only domain part
-        } else {
-            result->domainpart = g_strdup(trimmed);
-            result->localpart = NULL;
-        }
+    // the cache holds a reference, keyed by the string as given
+    jid->refs++;
+    g_queue_push_head(&cache_order, jid);
+    g_hash_table_insert(cache, jid->data, cache_order.head);
 
-        g_free(trimmed);
-        return result;
-    }
+    return jid;
 }
 
-Jid *
-jid_create_room_jid(const char * const room, const char * const nick)
+void
+jid_cache_clear(void)
 {
-    Jid *result;
-    char *jid = create_full_room_jid(room, nick);
-    result = jid_create(jid);
-    free(jid);
+    Jid *jid;
+    while ((jid = g_queue_pop_head(&cache_order)) != NULL) {
+        jid_destroy(jid);
+    }
 
-    return result;
+    if (cache != NULL) {
+        g_hash_table_destroy(cache);
+        cache = NULL;
+    }
 }
 
 void
 jid_destroy(Jid *jid)
 {
-    FREE_SET_NULL(jid->localpart);
-    FREE_SET_NULL(jid->domainpart);
-    FREE_SET_NULL(jid->resourcepart);
-    FREE_SET_NULL(jid->barejid);
-    FREE_SET_NULL(jid->fulljid);
-    FREE_SET_NULL(jid);
+    if (jid == NULL) {
+        return;
+    }
+
+    jid->refs--;
+    if (jid->refs == 0) {
+        free(jid);
+    }
 }
 
 /*
@@ -224,3 +237,61 @@ get_nick_from_full_jid(const char * const full_room_jid)
     }
 }
 
+static Jid *
+_jid_new(const char * const str)
+{
+    size_t len = strlen(str);
+    if (len == 0) {
+        return NULL;
+    }
+    if ((str[0] == '/') || (str[0] == '@') ||
+            (str[len - 1] == '/') || (str[len - 1] == '@')) {
+        return NULL;
+    }
+
+    // the resourcepart is everything after the first slash, the localpart
+    // everything before the last @ in the rest
+    const char *slashp = strchr(str, '/');
+    size_t bare_len = (slashp != NULL) ? (size_t)(slashp - str) : len;
+    const char *atp = NULL;
+    size_t i;
+    for (i = 0; i < bare_len; i++) {
+        if (str[i] == '@') {
+            atp = &str[i];
+        }
+    }
+    size_t local_len = (atp != NULL) ? (size_t)(atp - str) : 0;
+
+    size_t size = (len + 1) + (bare_len + 1) + (local_len + 1);
+    Jid *result = malloc(sizeof(Jid) + size);
+    result->refs = 1;
+
+    char *full = result->data;
+    memcpy(full, str, len + 1);
+
+    char *bare = full + len + 1;
+    memcpy(bare, str, bare_len);
+    bare[bare_len] = '\0';
+
+    char *local = bare + bare_len + 1;
+    memcpy(local, str, local_len);
+    local[local_len] = '\0';
+
+    result->barejid = bare;
+    if (slashp != NULL) {
+        result->fulljid = full;
+        result->resourcepart = full + bare_len + 1;
+    } else {
+        result->fulljid = NULL;
+        result->resourcepart = NULL;
+    }
+    if (atp != NULL) {
+        result->localpart = local;
+        result->domainpart = bare + local_len + 1;
+    } else {
+        result->localpart = NULL;
+        result->domainpart = bare;
+    }
+
+    return result;
+}
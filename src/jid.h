@@ -31,12 +31,17 @@ struct jid_t {
     char *resourcepart;
     char *barejid;
     char *fulljid;
+    guint refs;
+    char data[];
 };
 
 typedef struct jid_t Jid;
 
 Jid * jid_create(const gchar * const str);
 Jid * jid_create_room_jid(const char * const room, const char * const nick);
+Jid * jid_lookup(const char * const str);
+void jid_cache_clear(void);
+void jid_destroy(Jid *jid);
 
 gboolean jid_is_room(const char * const room_jid);
 char * create_full_room_jid(const char * const room,
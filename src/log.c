@@ -43,9 +43,15 @@
 static FILE *logp;
 
 static GTimeZone *tz;
-static GDateTime *dt;
 static log_level_t level_filter;
 
+// libstrophe logs from the connection thread while connecting, the log
+// file is only opened, written and closed with the lock held
+static GMutex log_mutex;
+
+static void _log_open(void);
+static void _log_close(void);
+static void _log_write(const char * const area, const char * const msg);
 static void _rotate_log_file(void);
 
 void
@@ -100,10 +106,9 @@ void
 log_init(log_level_t filter)
 {
     level_filter = filter;
-    tz = g_time_zone_new_local();
-    gchar *log_file = files_get_log_file();
-    logp = fopen(log_file, "a");
-    g_free(log_file);
+    g_mutex_lock(&log_mutex);
+    _log_open();
+    g_mutex_unlock(&log_mutex);
 }
 
 log_level_t
@@ -115,8 +120,9 @@ log_get_filter(void)
 void
 log_close(void)
 {
-    g_time_zone_unref(tz);
-    fclose(logp);
+    g_mutex_lock(&log_mutex);
+    _log_close();
+    g_mutex_unlock(&log_mutex);
 }
 
 void
@@ -125,25 +131,65 @@ log_msg(log_level_t level, const char * const area, const char * const msg)
     if (level >= level_filter) {
         struct stat st;
         int result;
-        gchar *log_file = files_get_log_file();
-        dt = g_date_time_new_now(tz);
+        g_mutex_lock(&log_mutex);
 
-        gchar *date_fmt = g_date_time_format(dt, "%d/%m/%Y %H:%M:%S");
-        fprintf(logp, "%s: %s: %s\n", date_fmt, area, msg);
-        g_date_time_unref(dt);
+        // nothing is written once the log is closed
+        if (logp != NULL) {
+            gchar *log_file = files_get_log_file();
+            _log_write(area, msg);
 
-        fflush(logp);
-        g_free(date_fmt);
+            result = stat(log_file, &st);
+            if (result == 0 && st.st_size >= prefs_get_max_log_size()) {
+                _rotate_log_file();
+                _log_write(PROF, "Log has been rotated");
+            }
 
-        result = stat(log_file, &st);
-        if (result == 0 && st.st_size >= prefs_get_max_log_size()) {
-            _rotate_log_file();
+            g_free(log_file);
         }
 
-        g_free(log_file);
+        g_mutex_unlock(&log_mutex);
+    }
+}
+
+static void
+_log_open(void)
+{
+    tz = g_time_zone_new_local();
+    gchar *log_file = files_get_log_file();
+    logp = fopen(log_file, "a");
+    g_free(log_file);
+}
+
+static void
+_log_close(void)
+{
+    if (tz != NULL) {
+        g_time_zone_unref(tz);
+        tz = NULL;
+    }
+    if (logp != NULL) {
+        fclose(logp);
+        logp = NULL;
     }
 }
 
+static void
+_log_write(const char * const area, const char * const msg)
+{
+    if (logp == NULL) {
+        return;
+    }
+
+    GDateTime *dt = g_date_time_new_now(tz);
+    gchar *date_fmt = g_date_time_format(dt, "%d/%m/%Y %H:%M:%S");
+    fprintf(logp, "%s: %s: %s\n", date_fmt, area, msg);
+    g_date_time_unref(dt);
+
+    fflush(logp);
+    g_free(date_fmt);
+}
+
+// called with the lock held
 static void
 _rotate_log_file(void)
 {
@@ -156,11 +202,10 @@ _rotate_log_file(void)
     log_file_new[len+1] = '1';
     log_file_new[len+2] = 0;
 
-    log_close();
+    _log_close();
     rename(log_file, log_file_new);
-    log_init(log_get_filter());
+    _log_open();
 
     free(log_file_new);
     g_free(log_file);
-    log_info("Log has been rotated");
 }
@@ -25,10 +25,16 @@
 #include <glib.h>
 
 #include "profanity.h"
+#include "trace.h"
 
 static gboolean disable_tls = FALSE;
 static gboolean version = FALSE;
 static char *log = "INFO";
+static char *batch = NULL;
+static char *socket_path = NULL;
+static char *trace = NULL;
+static char *replay = NULL;
+static gboolean fast = FALSE;
 
 int
 main(int argc, char **argv)
@@ -38,6 +44,11 @@ main(int argc, char **argv)
         { "version", 'v', 0, G_OPTION_ARG_NONE, &version, "Show version information", NULL },
         { "disable-tls", 'd', 0, G_OPTION_ARG_NONE, &disable_tls, "Disable TLS", NULL },
         { "log",'l', 0, G_OPTION_ARG_STRING, &log, "Set logging levels, DEBUG, INFO (default), WARN, ERROR", "LEVEL" },
+        { "batch", 'b', 0, G_OPTION_ARG_FILENAME, &batch, "Run without a terminal, reading commands from FILE, - for stdin", "FILE" },
+        { "socket", 's', 0, G_OPTION_ARG_FILENAME, &socket_path, "Run without a terminal, reading commands from a UNIX socket", "PATH" },
+        { "trace", 't', 0, G_OPTION_ARG_FILENAME, &trace, "Record incoming stanzas to FILE", "FILE" },
+        { "replay", 'r', 0, G_OPTION_ARG_FILENAME, &replay, "Replay stanzas recorded with --trace and report handler timings", "FILE" },
+        { "fast", 'f', 0, G_OPTION_ARG_NONE, &fast, "With --replay, do not wait between stanzas", NULL },
         { NULL }
     };
 
@@ -64,7 +75,21 @@ main(int argc, char **argv)
         return 0;
     }
 
-    prof_run(disable_tls, log);
+    if (replay != NULL) {
+        prof_run_replay(log, replay, fast);
+        return 0;
+    }
+
+    if ((trace != NULL) && !trace_record_open(trace)) {
+        g_print("Could not open trace file %s\n", trace);
+        return 1;
+    }
+
+    if ((batch != NULL) || (socket_path != NULL)) {
+        prof_run_batch(disable_tls, log, batch, socket_path);
+    } else {
+        prof_run(disable_tls, log);
+    }
 
     return 0;
 }
@@ -26,6 +26,7 @@
 #include <glib.h>
 
 #include "contact.h"
+#include "jid.h"
 #include "prof_autocomplete.h"
 
 typedef struct _muc_room_t {
@@ -84,20 +85,19 @@ muc_leave_room(const char * const room)
 gboolean
 muc_room_is_active(const char * const full_room_jid)
 {
-    char **tokens = g_strsplit(full_room_jid, "/", 0);
-    char *room_part = tokens[0];
-
-    if (rooms != NULL) {
-        ChatRoom *chat_room = g_hash_table_lookup(rooms, room_part);
+    if (rooms == NULL) {
+        return FALSE;
+    }
 
-        if (chat_room != NULL) {
-            return TRUE;
-        } else {
-            return FALSE;
-        }
-    } else {
+    Jid *jid = jid_lookup(full_room_jid);
+    if (jid == NULL) {
         return FALSE;
     }
+
+    gboolean result = (g_hash_table_lookup(rooms, jid->barejid) != NULL);
+    jid_destroy(jid);
+
+    return result;
 }
 
 /*
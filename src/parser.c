@@ -25,6 +25,14 @@
 
 #include <glib.h>
 
+// inputs shorter than this are tokenized without allocating
+#define STACK_BUF_SIZE 256
+
+static gchar ** _parse_args(const char * const inp, int min, int max,
+    gboolean freetext);
+static int _tokenize(const char * const inp, char *buf, char **tokens,
+    int max_tokens, gboolean freetext);
+
 /*
  * Take a full line of input and return an array of strings representing
  * the arguments of a command.
@@ -46,81 +54,18 @@
  *
  * { "arg1", "arg2", NULL }
  *
+ * Arguments containing spaces can be wrapped in double quotes, and \" or \\
+ * give a literal quote or backslash, e.g.
+ *
+ * /cmd "arg one" arg\"2
+ *
+ * Will return { "arg one", "arg\"2", NULL }
+ *
  */
 gchar **
 parse_args(const char * const inp, int min, int max)
 {
-    if (inp == NULL) {
-        return NULL;
-    }
-
-    // copy and strip input of leading/trailing whitepsace
-    char *copy = strdup(inp);
-    g_strstrip(copy);
-
-    int inp_size = strlen(copy);
-    gboolean in_token = FALSE;
-    char *token_start = &copy[0];
-    int token_size = 0;
-    GSList *tokens = NULL;
-
-    // add tokens to GSList
-    int i;
-    for (i = 0; i <= inp_size; i++) {
-        if (!in_token) {
-            if (copy[i] == ' ') {
-                continue;
-            } else {
-                in_token = TRUE;
-                token_start = &copy[i];
-                token_size++;
-            }
-        } else {
-            if (copy[i] == ' ' || copy[i] == '\0') {
-                tokens = g_slist_append(tokens, g_strndup(token_start,
-                    token_size));
-                token_size = 0;
-                in_token = FALSE;
-            } else {
-                token_size++;
-            }
-        }
-    }
-
-    int num = g_slist_length(tokens) - 1;
-
-    // if num args not valid return NULL
-    if ((num < min) || (num > max)) {
-        g_slist_free_full(tokens, free);
-        g_free(copy);
-        return NULL;
-
-    // if min allowed is 0 and 0 found, return empty char* array
-    } else if (min == 0 && num == 0) {
-        g_slist_free_full(tokens, free);
-        gchar **args = malloc((num + 1) * sizeof(*args));
-        args[0] = NULL;
-        g_free(copy);
-        return args;
-
-    // otherwise return args array
-    } else {
-        gchar **args = malloc((num + 1) * sizeof(*args));
-        GSList *token = tokens;
-        token = g_slist_next(token);
-        int arg_count = 0;
-
-        while (token != NULL) {
-            args[arg_count++] = strdup(token->data);
-            token = g_slist_next(token);
-        }
-
-        args[arg_count] = NULL;
-        g_slist_free_full(tokens, free);
-        g_free(copy);
-
-        return args;
-    }
+    return _parse_args(inp, min, max, FALSE);
 }
 
 /*
@@ -148,83 +93,116 @@ parse_args(const char * const inp, int min, int max)
  *
  * { "arg1", "arg2", "some free text", NULL }
  *
+ * Quotes are handled as for parse_args, except in the free text which is
+ * returned as typed.
+ *
  */
 gchar **
 parse_args_with_freetext(const char * const inp, int min, int max)
+{
+    return _parse_args(inp, min, max, TRUE);
+}
+
+static gchar **
+_parse_args(const char * const inp, int min, int max, gboolean freetext)
 {
     if (inp == NULL) {
         return NULL;
     }
 
-    // copy and strip input of leading/trailing whitepsace
-    char *copy = strdup(inp);
-    g_strstrip(copy);
+    // the tokens are written to buf and never longer than the input
+    char stack_buf[STACK_BUF_SIZE];
+    size_t inp_size = strlen(inp);
+    char *buf = stack_buf;
+    if (inp_size >= STACK_BUF_SIZE) {
+        buf = malloc(inp_size + 1);
+    }
 
-    int inp_size = strlen(copy);
-    gboolean in_token = FALSE;
-    gboolean in_freetext = FALSE;
-    char *token_start = &copy[0];
-    int token_size = 0;
-    int num_tokens = 0;
-    GSList *tokens = NULL;
-
-    // add tokens to GSList
-    int i;
-    for (i = 0; i <= inp_size; i++) {
-        if (!in_token) {
-            if (copy[i] == ' ') {
-                continue;
-            } else {
-                in_token = TRUE;
-                num_tokens++;
-                if (num_tokens == max + 1) {
-                    in_freetext = TRUE;
-                }
-                token_start = &copy[i];
-                token_size++;
-            }
-        } else {
-            if ((!in_freetext && copy[i] == ' ') || copy[i] == '\0') {
-                tokens = g_slist_append(tokens, g_strndup(token_start,
-                    token_size));
-                token_size = 0;
-                in_token = FALSE;
-            } else {
-                token_size++;
-            }
+    // the command and its arguments
+    char *tokens[max + 1];
+    int num = _tokenize(inp, buf, tokens, max + 1, freetext) - 1;
+
+    gchar **args = NULL;
+
+    // if num args valid, copy out the args, skipping the command
+    if ((num >= min) && (num <= max)) {
+        args = malloc((num + 1) * sizeof(*args));
+        int i;
+        for (i = 0; i < num; i++) {
+            args[i] = strdup(tokens[i + 1]);
         }
+        args[num] = NULL;
     }
 
-    int num = g_slist_length(tokens) - 1;
+    if (buf != stack_buf) {
+        free(buf);
+    }
 
-    // if num args not valid return NULL
-    if ((num < min) || (num > max)) {
-        g_slist_free_full(tokens, free);
-        free(copy);
-        return NULL;
+    return args;
+}
 
-    // if min allowed is 0 and 0 found, return empty char* array
-    } else if (min == 0 && num == 0) {
-        gchar **args = malloc((num + 1) * sizeof(*args));
-        args[0] = NULL;
-        return args;
-
-    // otherwise return args array
-    } else {
-        gchar **args = malloc((num + 1) * sizeof(*args));
-        GSList *token = tokens;
-        token = g_slist_next(token);
-        int arg_count = 0;
-
-        while (token != NULL) {
-            args[arg_count++] = strdup(token->data);
-            token = g_slist_next(token);
+/*
+ * Split the input into at most max_tokens space separated tokens in a
+ * single pass. Each token is unquoted into buf, which must hold at least
+ * strlen(inp) + 1 bytes, and tokens is set to point at them.
+ * With freetext, the last token is the rest of the line as typed.
+ * Returns the number of tokens, or -1 if there are too many or a quote is
+ * not closed.
+ */
+static int
+_tokenize(const char * const inp, char *buf, char **tokens, int max_tokens,
+    gboolean freetext)
+{
+    const char *curr = inp;
+    const char *end = inp + strlen(inp);
+    char *out = buf;
+    int num_tokens = 0;
+
+    // ignore leading and trailing whitespace
+    while ((curr < end) && g_ascii_isspace(*curr)) {
+        curr++;
+    }
+    while ((end > curr) && g_ascii_isspace(*(end - 1))) {
+        end--;
+    }
+
+    while (curr < end) {
+        if (*curr == ' ') {
+            curr++;
+            continue;
         }
 
-        args[arg_count] = NULL;
-        g_slist_free_full(tokens, free);
-        free(copy);
+        if (num_tokens == max_tokens) {
+            return -1;
+        }
+        tokens[num_tokens++] = out;
+
+        if (freetext && (num_tokens == max_tokens)) {
+            memcpy(out, curr, end - curr);
+            out += end - curr;
+            *out++ = '\0';
+            break;
+        }
 
-        return args;
+        gboolean quoted = FALSE;
+        while ((curr < end) && (quoted || (*curr != ' '))) {
+            if (*curr == '"') {
+                quoted = !quoted;
+                curr++;
+            } else if ((*curr == '\\') && (curr + 1 < end) &&
+                    ((curr[1] == '"') || (curr[1] == '\\'))) {
+                *out++ = curr[1];
+                curr += 2;
+            } else {
+                *out++ = *curr++;
+            }
+        }
+
+        if (quoted) {
+            return -1;
+        }
+        *out++ = '\0';
     }
+
+    return num_tokens;
 }
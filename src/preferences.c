@@ -36,33 +36,74 @@
 #include "log.h"
 #include "preferences.h"
 #include "prof_autocomplete.h"
+#include "prof_file_writer.h"
+
+#define PREFS_DEF_AUTOAWAY_TIME 15
+
+// changes made within this many milliseconds are saved together
+#define PREFS_SAVE_DELAY 500
 
 static gchar *prefs_loc;
 static GKeyFile *prefs;
-gint log_maxsize = 0;
+static PFileWriter prefs_writer;
+
+// typed copy of the preferences, read when the file is loaded and kept up
+// to date by the setters, so getters do not go through the key file
+static struct prefs_values_t {
+    gboolean beep;
+    gboolean flash;
+    gboolean multiline;
+    gboolean chlog;
+    gboolean history;
+    gint histsize;
+    gboolean splash;
+    gboolean vercheck;
+    gint vercheck_interval;
+    gboolean titlebarversion;
+    gboolean intype;
+    gboolean states;
+    gboolean outtype;
+    gint gone;
+    gchar *theme;
+    gboolean statuses;
+    gboolean notify_message;
+    gboolean notify_typing;
+    gint notify_remind;
+    gint max_log_size;
+    gint priority;
+    gint reconnect;
+    gint autoping;
+    gchar *autoaway_mode;
+    gint autoaway_time;
+    gchar *autoaway_message;
+    gboolean autoaway_check;
+} values;
+
+static GSList *listeners;
 
 static PAutocomplete boolean_choice_ac;
 
+static void _load_values(void);
+static void _free_values(void);
+static gboolean _get_boolean(const char * const group, const char * const key,
+    gboolean def);
+static gint _get_integer(const char * const group, const char * const key,
+    gint def);
+static void _changed(preference_t pref);
 static void _save_prefs(void);
 
 void
 prefs_load(void)
 {
-    GError *err;
-
     log_info("Loading preferences");
     prefs_loc = files_get_preferences_file();
 
     prefs = g_key_file_new();
     g_key_file_load_from_file(prefs, prefs_loc, G_KEY_FILE_KEEP_COMMENTS,
         NULL);
+    prefs_writer = p_file_writer_new(prefs_loc, 0644, PREFS_SAVE_DELAY);
 
-    err = NULL;
-    log_maxsize = g_key_file_get_integer(prefs, "logging", "maxsize", &err);
-    if (err != NULL) {
-        log_maxsize = 0;
-        g_error_free(err);
-    }
+    _load_values();
 
     boolean_choice_ac = p_autocomplete_new();
     p_autocomplete_add(boolean_choice_ac, strdup("on"));
@@ -73,7 +114,30 @@ void
 prefs_close(void)
 {
     p_autocomplete_free(boolean_choice_ac);
+    if (!p_file_writer_flush(prefs_writer)) {
+        log_error("Could not save preferences to %s", prefs_loc);
+    }
+    p_file_writer_free(prefs_writer);
+    prefs_writer = NULL;
     g_key_file_free(prefs);
+    _free_values();
+    g_slist_free(listeners);
+    listeners = NULL;
+}
+
+/*
+ * Call listener with the preference each time one is set
+ */
+void
+prefs_add_listener(prefs_listener_t listener)
+{
+    listeners = g_slist_append(listeners, listener);
+}
+
+void
+prefs_remove_listener(prefs_listener_t listener)
+{
+    listeners = g_slist_remove(listeners, listener);
 }
 
 char *
@@ -91,346 +155,510 @@ prefs_reset_boolean_choice(void)
 gboolean
 prefs_get_beep(void)
 {
-    return g_key_file_get_boolean(prefs, "ui", "beep", NULL);
+    return values.beep;
 }
 
 void
 prefs_set_beep(gboolean value)
 {
+    values.beep = value;
     g_key_file_set_boolean(prefs, "ui", "beep", value);
-    _save_prefs();
+    _changed(PREF_BEEP);
 }
 
 gchar *
 prefs_get_theme(void)
 {
-    return g_key_file_get_string(prefs, "ui", "theme", NULL);
+    return g_strdup(values.theme);
 }
 
 void
 prefs_set_theme(gchar *value)
 {
+    g_free(values.theme);
+    values.theme = g_strdup(value);
     g_key_file_set_string(prefs, "ui", "theme", value);
-    _save_prefs();
+    _changed(PREF_THEME);
 }
 
 gboolean
 prefs_get_states(void)
 {
-    return g_key_file_get_boolean(prefs, "chatstates", "enabled", NULL);
+    return values.states;
 }
 
 void
 prefs_set_states(gboolean value)
 {
+    values.states = value;
     g_key_file_set_boolean(prefs, "chatstates", "enabled", value);
-    _save_prefs();
+    _changed(PREF_STATES);
 }
 
 gboolean
 prefs_get_outtype(void)
 {
-    return g_key_file_get_boolean(prefs, "chatstates", "outtype", NULL);
+    return values.outtype;
 }
 
 void
 prefs_set_outtype(gboolean value)
 {
+    values.outtype = value;
     g_key_file_set_boolean(prefs, "chatstates", "outtype", value);
-    _save_prefs();
+    _changed(PREF_OUTTYPE);
 }
 
 gint
 prefs_get_gone(void)
 {
-    return g_key_file_get_integer(prefs, "chatstates", "gone", NULL);
+    return values.gone;
 }
 
 void
 prefs_set_gone(gint value)
 {
+    values.gone = value;
     g_key_file_set_integer(prefs, "chatstates", "gone", value);
-    _save_prefs();
+    _changed(PREF_GONE);
 }
 
 gboolean
 prefs_get_notify_typing(void)
 {
-    return g_key_file_get_boolean(prefs, "notifications", "typing", NULL);
+    return values.notify_typing;
 }
 
 void
 prefs_set_notify_typing(gboolean value)
 {
+    values.notify_typing = value;
     g_key_file_set_boolean(prefs, "notifications", "typing", value);
-    _save_prefs();
+    _changed(PREF_NOTIFY_TYPING);
 }
 
 gboolean
 prefs_get_notify_message(void)
 {
-    return g_key_file_get_boolean(prefs, "notifications", "message", NULL);
+    return values.notify_message;
 }
 
 void
 prefs_set_notify_message(gboolean value)
 {
+    values.notify_message = value;
     g_key_file_set_boolean(prefs, "notifications", "message", value);
-    _save_prefs();
+    _changed(PREF_NOTIFY_MESSAGE);
 }
 
 gint
 prefs_get_notify_remind(void)
 {
-    return g_key_file_get_integer(prefs, "notifications", "remind", NULL);
+    return values.notify_remind;
 }
 
 void
 prefs_set_notify_remind(gint value)
 {
+    values.notify_remind = value;
     g_key_file_set_integer(prefs, "notifications", "remind", value);
-    _save_prefs();
+    _changed(PREF_NOTIFY_REMIND);
 }
 
 gint
 prefs_get_max_log_size(void)
 {
-    if (log_maxsize < PREFS_MIN_LOG_SIZE)
-        return PREFS_MAX_LOG_SIZE;
-    else
-        return log_maxsize;
+    return values.max_log_size;
 }
 
 void
 prefs_set_max_log_size(gint value)
 {
-    log_maxsize = value;
+    if (value < PREFS_MIN_LOG_SIZE)
+        values.max_log_size = PREFS_MAX_LOG_SIZE;
+    else
+        values.max_log_size = value;
     g_key_file_set_integer(prefs, "logging", "maxsize", value);
-    _save_prefs();
+    _changed(PREF_MAX_LOG_SIZE);
 }
 
 gint
 prefs_get_priority(void)
 {
-    return g_key_file_get_integer(prefs, "presence", "priority", NULL);
+    return values.priority;
 }
 
 void
 prefs_set_priority(gint value)
 {
+    values.priority = value;
     g_key_file_set_integer(prefs, "presence", "priority", value);
-    _save_prefs();
+    _changed(PREF_PRIORITY);
 }
 
 gint
 prefs_get_reconnect(void)
 {
-    return g_key_file_get_integer(prefs, "connection", "reconnect", NULL);
+    return values.reconnect;
 }
 
 void
 prefs_set_reconnect(gint value)
 {
+    values.reconnect = value;
     g_key_file_set_integer(prefs, "connection", "reconnect", value);
-    _save_prefs();
+    _changed(PREF_RECONNECT);
 }
 
 gint
 prefs_get_autoping(void)
 {
-    return g_key_file_get_integer(prefs, "connection", "autoping", NULL);
+    return values.autoping;
 }
 
 void
 prefs_set_autoping(gint value)
 {
+    values.autoping = value;
     g_key_file_set_integer(prefs, "connection", "autoping", value);
-    _save_prefs();
+    _changed(PREF_AUTOPING);
 }
 
 gboolean
 prefs_get_vercheck(void)
 {
-    return g_key_file_get_boolean(prefs, "ui", "vercheck", NULL);
+    return values.vercheck;
 }
 
 void
 prefs_set_vercheck(gboolean value)
 {
+    values.vercheck = value;
     g_key_file_set_boolean(prefs, "ui", "vercheck", value);
-    _save_prefs();
+    _changed(PREF_VERCHECK);
+}
+
+gint
+prefs_get_vercheck_interval(void)
+{
+    return values.vercheck_interval;
+}
+
+void
+prefs_set_vercheck_interval(gint value)
+{
+    values.vercheck_interval = value;
+    g_key_file_set_integer(prefs, "ui", "vercheck.interval", value);
+    _changed(PREF_VERCHECK_INTERVAL);
 }
 
 gboolean
 prefs_get_titlebarversion(void)
 {
-    return g_key_file_get_boolean(prefs, "ui", "titlebar.version", NULL);
+    return values.titlebarversion;
 }
 
 void
 prefs_set_titlebarversion(gboolean value)
 {
+    values.titlebarversion = value;
     g_key_file_set_boolean(prefs, "ui", "titlebar.version", value);
-    _save_prefs();
+    _changed(PREF_TITLEBARVERSION);
 }
 
 gboolean
 prefs_get_flash(void)
 {
-    return g_key_file_get_boolean(prefs, "ui", "flash", NULL);
+    return values.flash;
 }
 
 void
 prefs_set_flash(gboolean value)
 {
+    values.flash = value;
     g_key_file_set_boolean(prefs, "ui", "flash", value);
-    _save_prefs();
+    _changed(PREF_FLASH);
+}
+
+gboolean
+prefs_get_multiline(void)
+{
+    return values.multiline;
+}
+
+void
+prefs_set_multiline(gboolean value)
+{
+    values.multiline = value;
+    g_key_file_set_boolean(prefs, "ui", "multiline", value);
+    _changed(PREF_MULTILINE);
 }
 
 gboolean
 prefs_get_intype(void)
 {
-    return g_key_file_get_boolean(prefs, "ui", "intype", NULL);
+    return values.intype;
 }
 
 void
 prefs_set_intype(gboolean value)
 {
+    values.intype = value;
     g_key_file_set_boolean(prefs, "ui", "intype", value);
-    _save_prefs();
+    _changed(PREF_INTYPE);
 }
 
 gboolean
 prefs_get_chlog(void)
 {
-    return g_key_file_get_boolean(prefs, "logging", "chlog", NULL);
+    return values.chlog;
 }
 
 void
 prefs_set_chlog(gboolean value)
 {
+    values.chlog = value;
     g_key_file_set_boolean(prefs, "logging", "chlog", value);
-    _save_prefs();
+    _changed(PREF_CHLOG);
 }
 
 gboolean
 prefs_get_history(void)
 {
-    return g_key_file_get_boolean(prefs, "ui", "history", NULL);
+    return values.history;
 }
 
 void
 prefs_set_history(gboolean value)
 {
+    values.history = value;
     g_key_file_set_boolean(prefs, "ui", "history", value);
-    _save_prefs();
+    _changed(PREF_HISTORY);
 }
 
-gchar *
+gint
+prefs_get_histsize(void)
+{
+    return values.histsize;
+}
+
+void
+prefs_set_histsize(gint value)
+{
+    if (value < 1)
+        values.histsize = PREFS_DEF_HISTSIZE;
+    else
+        values.histsize = value;
+    g_key_file_set_integer(prefs, "ui", "histsize", value);
+    _changed(PREF_HISTSIZE);
+}
+
+/*
+ * The returned string belongs to the preferences and is valid until the
+ * mode is next set
+ */
+const gchar *
 prefs_get_autoaway_mode(void)
 {
-    gchar *result = g_key_file_get_string(prefs, "presence", "autoaway.mode", NULL);
-    if (result == NULL) {
-        return strdup("off");
-    } else {
-        return result;
-    }
+    return values.autoaway_mode;
 }
 
 void
 prefs_set_autoaway_mode(gchar *value)
 {
+    g_free(values.autoaway_mode);
+    values.autoaway_mode = g_strdup(value);
     g_key_file_set_string(prefs, "presence", "autoaway.mode", value);
-    _save_prefs();
+    _changed(PREF_AUTOAWAY_MODE);
 }
 
 gint
 prefs_get_autoaway_time(void)
 {
-    gint result = g_key_file_get_integer(prefs, "presence", "autoaway.time", NULL);
-
-    if (result == 0) {
-        return 15;
-    } else {
-        return result;
-    }
+    return values.autoaway_time;
 }
 
 void
 prefs_set_autoaway_time(gint value)
 {
+    if (value == 0)
+        values.autoaway_time = PREFS_DEF_AUTOAWAY_TIME;
+    else
+        values.autoaway_time = value;
     g_key_file_set_integer(prefs, "presence", "autoaway.time", value);
-    _save_prefs();
+    _changed(PREF_AUTOAWAY_TIME);
 }
 
-gchar *
+/*
+ * The returned string belongs to the preferences and is valid until the
+ * message is next set, NULL if there is no message
+ */
+const gchar *
 prefs_get_autoaway_message(void)
 {
-    return g_key_file_get_string(prefs, "presence", "autoaway.message", NULL);
+    return values.autoaway_message;
 }
 
 void
 prefs_set_autoaway_message(gchar *value)
 {
+    g_free(values.autoaway_message);
+    values.autoaway_message = g_strdup(value);
     if (value == NULL) {
         g_key_file_remove_key(prefs, "presence", "autoaway.message", NULL);
     } else {
         g_key_file_set_string(prefs, "presence", "autoaway.message", value);
     }
-    _save_prefs();
+    _changed(PREF_AUTOAWAY_MESSAGE);
 }
 
 gboolean
 prefs_get_autoaway_check(void)
 {
-    if (g_key_file_has_key(prefs, "presence", "autoaway.check", NULL)) {
-        return g_key_file_get_boolean(prefs, "presence", "autoaway.check", NULL);
-    } else {
-        return TRUE;
-    }
+    return values.autoaway_check;
 }
 
 void
 prefs_set_autoaway_check(gboolean value)
 {
+    values.autoaway_check = value;
     g_key_file_set_boolean(prefs, "presence", "autoaway.check", value);
-    _save_prefs();
+    _changed(PREF_AUTOAWAY_CHECK);
 }
 
 gboolean
 prefs_get_splash(void)
 {
-    return g_key_file_get_boolean(prefs, "ui", "splash", NULL);
+    return values.splash;
 }
 
 void
 prefs_set_splash(gboolean value)
 {
+    values.splash = value;
     g_key_file_set_boolean(prefs, "ui", "splash", value);
-    _save_prefs();
+    _changed(PREF_SPLASH);
 }
 
 gboolean
 prefs_get_statuses(void)
 {
-    if (g_key_file_has_key(prefs, "ui", "statuses", NULL)) {
-        return g_key_file_get_boolean(prefs, "ui", "statuses", NULL);
-    } else {
-        return TRUE;
-    }
+    return values.statuses;
 }
 
 void
 prefs_set_statuses(gboolean value)
 {
+    values.statuses = value;
     g_key_file_set_boolean(prefs, "ui", "statuses", value);
+    _changed(PREF_STATUSES);
+}
+
+static void
+_load_values(void)
+{
+    values.beep = _get_boolean("ui", "beep", FALSE);
+    values.flash = _get_boolean("ui", "flash", FALSE);
+    values.multiline = _get_boolean("ui", "multiline", FALSE);
+    values.chlog = _get_boolean("logging", "chlog", FALSE);
+    values.history = _get_boolean("ui", "history", FALSE);
+    values.splash = _get_boolean("ui", "splash", FALSE);
+    values.vercheck = _get_boolean("ui", "vercheck", FALSE);
+    values.titlebarversion = _get_boolean("ui", "titlebar.version", FALSE);
+    values.intype = _get_boolean("ui", "intype", FALSE);
+    values.states = _get_boolean("chatstates", "enabled", FALSE);
+    values.outtype = _get_boolean("chatstates", "outtype", FALSE);
+    values.gone = _get_integer("chatstates", "gone", 0);
+    values.theme = g_key_file_get_string(prefs, "ui", "theme", NULL);
+    values.statuses = _get_boolean("ui", "statuses", TRUE);
+    values.notify_message = _get_boolean("notifications", "message", FALSE);
+    values.notify_typing = _get_boolean("notifications", "typing", FALSE);
+    values.notify_remind = _get_integer("notifications", "remind", 0);
+    values.priority = _get_integer("presence", "priority", 0);
+    values.reconnect = _get_integer("connection", "reconnect", 0);
+    values.autoping = _get_integer("connection", "autoping", 0);
+    values.autoaway_message = g_key_file_get_string(prefs, "presence",
+        "autoaway.message", NULL);
+    values.autoaway_check = _get_boolean("presence", "autoaway.check", TRUE);
+
+    values.max_log_size = _get_integer("logging", "maxsize", 0);
+    if (values.max_log_size < PREFS_MIN_LOG_SIZE) {
+        values.max_log_size = PREFS_MAX_LOG_SIZE;
+    }
+
+    values.vercheck_interval = _get_integer("ui", "vercheck.interval",
+        PREFS_DEF_VERCHECK_INTERVAL);
+    if (values.vercheck_interval < 0) {
+        values.vercheck_interval = PREFS_DEF_VERCHECK_INTERVAL;
+    }
+
+    values.histsize = _get_integer("ui", "histsize", PREFS_DEF_HISTSIZE);
+    if (values.histsize < 1) {
+        values.histsize = PREFS_DEF_HISTSIZE;
+    }
+
+    values.autoaway_mode = g_key_file_get_string(prefs, "presence",
+        "autoaway.mode", NULL);
+    if (values.autoaway_mode == NULL) {
+        values.autoaway_mode = g_strdup("off");
+    }
+
+    values.autoaway_time = _get_integer("presence", "autoaway.time", 0);
+    if (values.autoaway_time == 0) {
+        values.autoaway_time = PREFS_DEF_AUTOAWAY_TIME;
+    }
+}
+
+static void
+_free_values(void)
+{
+    g_free(values.theme);
+    values.theme = NULL;
+    g_free(values.autoaway_mode);
+    values.autoaway_mode = NULL;
+    g_free(values.autoaway_message);
+    values.autoaway_message = NULL;
+}
+
+static gboolean
+_get_boolean(const char * const group, const char * const key, gboolean def)
+{
+    if (g_key_file_has_key(prefs, group, key, NULL)) {
+        return g_key_file_get_boolean(prefs, group, key, NULL);
+    } else {
+        return def;
+    }
+}
+
+static gint
+_get_integer(const char * const group, const char * const key, gint def)
+{
+    if (g_key_file_has_key(prefs, group, key, NULL)) {
+        return g_key_file_get_integer(prefs, group, key, NULL);
+    } else {
+        return def;
+    }
+}
+
+// save the file and tell the listeners
+static void
+_changed(preference_t pref)
+{
     _save_prefs();
+
+    GSList *curr = listeners;
+    while (curr != NULL) {
+        prefs_listener_t listener = curr->data;
+        curr = g_slist_next(curr);
+        listener(pref);
+    }
 }
 
+// the file is written in the background, see prof_file_writer.c
 static void
 _save_prefs(void)
 {
     gsize g_data_size;
     char *g_prefs_data = g_key_file_to_data(prefs, &g_data_size, NULL);
-    g_file_set_contents(prefs_loc, g_prefs_data, g_data_size, NULL);
+    p_file_writer_write(prefs_writer, g_prefs_data, g_data_size);
 }
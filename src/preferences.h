@@ -35,9 +35,47 @@
 
 #define PREFS_MIN_LOG_SIZE 64
 #define PREFS_MAX_LOG_SIZE 1048580
+#define PREFS_DEF_HISTSIZE 1000
+#define PREFS_MAX_HISTSIZE 1000000
+#define PREFS_DEF_VERCHECK_INTERVAL 24
+#define PREFS_MAX_VERCHECK_INTERVAL 8760
+
+typedef enum {
+    PREF_BEEP,
+    PREF_FLASH,
+    PREF_MULTILINE,
+    PREF_CHLOG,
+    PREF_HISTORY,
+    PREF_HISTSIZE,
+    PREF_SPLASH,
+    PREF_VERCHECK,
+    PREF_VERCHECK_INTERVAL,
+    PREF_TITLEBARVERSION,
+    PREF_INTYPE,
+    PREF_STATES,
+    PREF_OUTTYPE,
+    PREF_GONE,
+    PREF_THEME,
+    PREF_STATUSES,
+    PREF_NOTIFY_MESSAGE,
+    PREF_NOTIFY_TYPING,
+    PREF_NOTIFY_REMIND,
+    PREF_MAX_LOG_SIZE,
+    PREF_PRIORITY,
+    PREF_RECONNECT,
+    PREF_AUTOPING,
+    PREF_AUTOAWAY_MODE,
+    PREF_AUTOAWAY_TIME,
+    PREF_AUTOAWAY_MESSAGE,
+    PREF_AUTOAWAY_CHECK
+} preference_t;
+
+typedef void (*prefs_listener_t)(preference_t pref);
 
 void prefs_load(void);
 void prefs_close(void);
+void prefs_add_listener(prefs_listener_t listener);
+void prefs_remove_listener(prefs_listener_t listener);
 
 char * prefs_find_login(char *prefix);
 void prefs_reset_login_search(void);
@@ -48,14 +86,20 @@ gboolean prefs_get_beep(void);
 void prefs_set_beep(gboolean value);
 gboolean prefs_get_flash(void);
 void prefs_set_flash(gboolean value);
+gboolean prefs_get_multiline(void);
+void prefs_set_multiline(gboolean value);
 gboolean prefs_get_chlog(void);
 void prefs_set_chlog(gboolean value);
 gboolean prefs_get_history(void);
 void prefs_set_history(gboolean value);
+gint prefs_get_histsize(void);
+void prefs_set_histsize(gint value);
 gboolean prefs_get_splash(void);
 void prefs_set_splash(gboolean value);
 gboolean prefs_get_vercheck(void);
 void prefs_set_vercheck(gboolean value);
+gint prefs_get_vercheck_interval(void);
+void prefs_set_vercheck_interval(gint value);
 gboolean prefs_get_titlebarversion(void);
 void prefs_set_titlebarversion(gboolean value);
 gboolean prefs_get_intype(void);
@@ -86,11 +130,11 @@ gint prefs_get_reconnect(void);
 void prefs_set_autoping(gint value);
 gint prefs_get_autoping(void);
 
-gchar* prefs_get_autoaway_mode(void);
+const gchar* prefs_get_autoaway_mode(void);
 void prefs_set_autoaway_mode(gchar *value);
 gint prefs_get_autoaway_time(void);
 void prefs_set_autoaway_time(gint value);
-gchar* prefs_get_autoaway_message(void);
+const gchar* prefs_get_autoaway_message(void);
 void prefs_set_autoaway_message(gchar *value);
 gboolean prefs_get_autoaway_check(void);
 void prefs_set_autoaway_check(gboolean value);
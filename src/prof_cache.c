@@ -0,0 +1,212 @@
+/*
+ * prof_cache.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "prof_cache.h"
+
+// entries are kept in a queue, most recently used at the head, with an
+// index from key to queue link.  Each entry expires ttl seconds after it
+// was put, and the least recently used entry is dropped when the cache
+// holds more than max_size
+
+typedef struct cache_entry_t {
+    char *key;
+    char *value;
+    gint64 expires;
+} CacheEntry;
+
+struct p_cache_t {
+    GQueue *entries;
+    GHashTable *index;
+    guint max_size;
+};
+
+static void _remove(PCache cache, GList *link);
+static void _entry_free(CacheEntry *entry);
+
+PCache
+p_cache_new(guint max_size)
+{
+    PCache new_cache = malloc(sizeof(struct p_cache_t));
+    new_cache->entries = g_queue_new();
+    new_cache->index = g_hash_table_new(g_str_hash, g_str_equal);
+    new_cache->max_size = max_size;
+
+    return new_cache;
+}
+
+void
+p_cache_free(PCache cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    while (!g_queue_is_empty(cache->entries)) {
+        _entry_free(g_queue_pop_head(cache->entries));
+    }
+    g_queue_free(cache->entries);
+    g_hash_table_destroy(cache->index);
+    free(cache);
+}
+
+/*
+ * The value for key, or NULL if there is none or it has expired.  The
+ * returned string belongs to the cache and is valid until the next put
+ */
+const char *
+p_cache_get(PCache cache, const char * const key)
+{
+    GList *link = g_hash_table_lookup(cache->index, key);
+    if (link == NULL) {
+        return NULL;
+    }
+
+    CacheEntry *entry = link->data;
+    if (entry->expires <= time(NULL)) {
+        _remove(cache, link);
+        return NULL;
+    }
+
+    g_queue_unlink(cache->entries, link);
+    g_queue_push_head_link(cache->entries, link);
+
+    return entry->value;
+}
+
+/*
+ * Store value for key for ttl seconds, replacing any previous value
+ */
+void
+p_cache_put(PCache cache, const char * const key, const char * const value,
+    gint64 ttl)
+{
+    gint64 expires = time(NULL) + ttl;
+    GList *link = g_hash_table_lookup(cache->index, key);
+
+    if (link != NULL) {
+        CacheEntry *entry = link->data;
+        free(entry->value);
+        entry->value = strdup(value);
+        entry->expires = expires;
+        g_queue_unlink(cache->entries, link);
+        g_queue_push_head_link(cache->entries, link);
+        return;
+    }
+
+    CacheEntry *entry = malloc(sizeof(CacheEntry));
+    entry->key = strdup(key);
+    entry->value = strdup(value);
+    entry->expires = expires;
+    g_queue_push_head(cache->entries, entry);
+    g_hash_table_insert(cache->index, entry->key, cache->entries->head);
+
+    while (g_queue_get_length(cache->entries) > cache->max_size) {
+        _remove(cache, cache->entries->tail);
+    }
+}
+
+guint
+p_cache_length(PCache cache)
+{
+    return g_queue_get_length(cache->entries);
+}
+
+/*
+ * The entries that have not expired, one per line, least recently used
+ * first, as read by p_cache_load()
+ */
+gchar *
+p_cache_serialise(PCache cache)
+{
+    GString *result = g_string_new("");
+    gint64 now = time(NULL);
+    GList *curr = cache->entries->tail;
+
+    while (curr != NULL) {
+        CacheEntry *entry = curr->data;
+        if (entry->expires > now) {
+            gchar *key = g_strescape(entry->key, NULL);
+            gchar *value = g_strescape(entry->value, NULL);
+            g_string_append_printf(result, "%" G_GINT64_FORMAT "\t%s\t%s\n",
+                entry->expires, key, value);
+            g_free(key);
+            g_free(value);
+        }
+        curr = g_list_previous(curr);
+    }
+
+    return g_string_free(result, FALSE);
+}
+
+/*
+ * Add the entries in data, as written by p_cache_serialise(), lines that
+ * cannot be read and entries that have expired are skipped
+ */
+void
+p_cache_load(PCache cache, const char * const data)
+{
+    gint64 now = time(NULL);
+    gchar **lines = g_strsplit(data, "\n", -1);
+    int i;
+
+    for (i = 0; lines[i] != NULL; i++) {
+        gchar **fields = g_strsplit(lines[i], "\t", 3);
+
+        if (g_strv_length(fields) == 3) {
+            char *end;
+            gint64 expires = g_ascii_strtoll(fields[0], &end, 10);
+            if (*end == '\0' && end != fields[0] && expires > now) {
+                gchar *key = g_strcompress(fields[1]);
+                gchar *value = g_strcompress(fields[2]);
+                p_cache_put(cache, key, value, expires - now);
+                g_free(key);
+                g_free(value);
+            }
+        }
+
+        g_strfreev(fields);
+    }
+
+    g_strfreev(lines);
+}
+
+static void
+_remove(PCache cache, GList *link)
+{
+    CacheEntry *entry = link->data;
+    g_hash_table_remove(cache->index, entry->key);
+    g_queue_delete_link(cache->entries, link);
+    _entry_free(entry);
+}
+
+static void
+_entry_free(CacheEntry *entry)
+{
+    free(entry->key);
+    free(entry->value);
+    free(entry);
+}
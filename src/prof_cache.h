@@ -0,0 +1,38 @@
+/*
+ * prof_cache.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef PROF_CACHE_H
+#define PROF_CACHE_H
+
+#include <glib.h>
+
+typedef struct p_cache_t *PCache;
+
+PCache p_cache_new(guint max_size);
+void p_cache_free(PCache cache);
+const char * p_cache_get(PCache cache, const char * const key);
+void p_cache_put(PCache cache, const char * const key,
+    const char * const value, gint64 ttl);
+guint p_cache_length(PCache cache);
+gchar * p_cache_serialise(PCache cache);
+void p_cache_load(PCache cache, const char * const data);
+
+#endif
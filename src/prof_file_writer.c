@@ -0,0 +1,220 @@
+/*
+ * prof_file_writer.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "prof_file_writer.h"
+
+// Contents are handed to a thread that writes them to a temporary file and
+// renames it over the real one, so a crash leaves either the old or the new
+// file.  Contents given while a write is waiting replace it, so a burst of
+// changes costs one write, made at most delay_ms after the first change.
+struct p_file_writer_t {
+    char *path;
+    char *tmp_path;
+    int mode;
+    gint64 delay;
+    GThread *thread;
+    GMutex lock;
+    GCond cond;
+
+    // protected by lock
+    gchar *pending;
+    gsize pending_len;
+    gint64 due;
+    guint64 queued;
+    guint64 written;
+    gboolean flushing;
+    gboolean closing;
+    gboolean failed;
+};
+
+static gpointer _writer_thread(gpointer data);
+static gboolean _write_file(PFileWriter writer, const gchar * const data,
+    gsize len);
+
+PFileWriter
+p_file_writer_new(const char * const path, int mode, guint delay_ms)
+{
+    PFileWriter writer = malloc(sizeof(struct p_file_writer_t));
+    writer->path = strdup(path);
+    writer->tmp_path = g_strdup_printf("%s.tmp", path);
+    writer->mode = mode;
+    writer->delay = (gint64)delay_ms * 1000;
+    writer->pending = NULL;
+    writer->pending_len = 0;
+    writer->due = 0;
+    writer->queued = 0;
+    writer->written = 0;
+    writer->flushing = FALSE;
+    writer->closing = FALSE;
+    writer->failed = FALSE;
+    g_mutex_init(&writer->lock);
+    g_cond_init(&writer->cond);
+    writer->thread = g_thread_new("writer", _writer_thread, writer);
+
+    return writer;
+}
+
+/*
+ * Write anything pending and stop the writer
+ */
+void
+p_file_writer_free(PFileWriter writer)
+{
+    if (writer != NULL) {
+        g_mutex_lock(&writer->lock);
+        writer->closing = TRUE;
+        g_cond_broadcast(&writer->cond);
+        g_mutex_unlock(&writer->lock);
+
+        g_thread_join(writer->thread);
+        g_mutex_clear(&writer->lock);
+        g_cond_clear(&writer->cond);
+        g_free(writer->pending);
+        free(writer->path);
+        g_free(writer->tmp_path);
+        free(writer);
+    }
+}
+
+/*
+ * Replace the file with data, the writer takes ownership of data which
+ * must have been allocated with g_malloc
+ */
+void
+p_file_writer_write(PFileWriter writer, gchar *data, gsize len)
+{
+    g_mutex_lock(&writer->lock);
+    if (writer->pending == NULL) {
+        writer->due = g_get_monotonic_time() + writer->delay;
+    } else {
+        g_free(writer->pending);
+    }
+    writer->pending = data;
+    writer->pending_len = len;
+    writer->queued++;
+    g_cond_broadcast(&writer->cond);
+    g_mutex_unlock(&writer->lock);
+}
+
+/*
+ * Write any pending contents now and wait for them to be written, returns
+ * FALSE if the last write failed
+ */
+gboolean
+p_file_writer_flush(PFileWriter writer)
+{
+    g_mutex_lock(&writer->lock);
+    writer->flushing = TRUE;
+    g_cond_broadcast(&writer->cond);
+    while (writer->written < writer->queued) {
+        g_cond_wait(&writer->cond, &writer->lock);
+    }
+    writer->flushing = FALSE;
+    gboolean result = !writer->failed;
+    g_mutex_unlock(&writer->lock);
+
+    return result;
+}
+
+static gpointer
+_writer_thread(gpointer data)
+{
+    PFileWriter writer = data;
+
+    g_mutex_lock(&writer->lock);
+    while (TRUE) {
+        if (writer->pending == NULL) {
+            if (writer->closing) {
+                break;
+            }
+            g_cond_wait(&writer->cond, &writer->lock);
+            continue;
+        }
+
+        // wait for more changes, unless asked to write now
+        if (!writer->flushing && !writer->closing &&
+                (g_get_monotonic_time() < writer->due)) {
+            g_cond_wait_until(&writer->cond, &writer->lock, writer->due);
+            continue;
+        }
+
+        gchar *contents = writer->pending;
+        gsize len = writer->pending_len;
+        guint64 seq = writer->queued;
+        writer->pending = NULL;
+        g_mutex_unlock(&writer->lock);
+
+        gboolean ok = _write_file(writer, contents, len);
+        g_free(contents);
+
+        g_mutex_lock(&writer->lock);
+        writer->failed = !ok;
+        writer->written = seq;
+        g_cond_broadcast(&writer->cond);
+    }
+    g_mutex_unlock(&writer->lock);
+
+    return NULL;
+}
+
+static gboolean
+_write_file(PFileWriter writer, const gchar * const data, gsize len)
+{
+    int fd = open(writer->tmp_path, O_WRONLY | O_CREAT | O_TRUNC, writer->mode);
+    if (fd == -1) {
+        return FALSE;
+    }
+
+    gsize done = 0;
+    while (done < len) {
+        ssize_t result = write(fd, data + done, len - done);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            unlink(writer->tmp_path);
+            return FALSE;
+        }
+        done += result;
+    }
+
+    if ((fsync(fd) != 0) || (close(fd) != 0)) {
+        unlink(writer->tmp_path);
+        return FALSE;
+    }
+
+    if (rename(writer->tmp_path, writer->path) != 0) {
+        unlink(writer->tmp_path);
+        return FALSE;
+    }
+
+    return TRUE;
+}
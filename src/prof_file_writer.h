@@ -0,0 +1,35 @@
+/*
+ * prof_file_writer.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef PROF_FILE_WRITER_H
+#define PROF_FILE_WRITER_H
+
+#include <glib.h>
+
+typedef struct p_file_writer_t *PFileWriter;
+
+PFileWriter p_file_writer_new(const char * const path, int mode,
+    guint delay_ms);
+void p_file_writer_free(PFileWriter writer);
+void p_file_writer_write(PFileWriter writer, gchar *data, gsize len);
+gboolean p_file_writer_flush(PFileWriter writer);
+
+#endif
@@ -0,0 +1,344 @@
+/*
+ * prof_gap_buffer.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "prof_gap_buffer.h"
+
+#define INITIAL_SIZE 64
+
+// The text is held in buf with a gap of unused bytes, edits happen at the
+// gap so inserting or deleting at the cursor does not shift the whole line.
+// Offsets into the text are byte offsets ignoring the gap.
+struct p_gap_buffer_t {
+    char *buf;
+    gsize alloc;
+    gsize gap_start;
+    gsize gap_end;
+    gsize cursor;
+    glong length;
+    glong width;
+    glong cursor_col;
+};
+
+static gsize _text_size(PGapBuffer gb);
+static char * _ptr_at(PGapBuffer gb, gsize offset);
+static gsize _prev_char(PGapBuffer gb, gsize offset);
+static void _move_gap(PGapBuffer gb, gsize offset);
+static void _ensure_gap(PGapBuffer gb, gsize needed);
+static int _char_width(gunichar ch);
+
+PGapBuffer
+p_gap_buffer_new(void)
+{
+    PGapBuffer gb = malloc(sizeof(struct p_gap_buffer_t));
+    gb->buf = malloc(INITIAL_SIZE);
+    gb->alloc = INITIAL_SIZE;
+    p_gap_buffer_clear(gb);
+
+    return gb;
+}
+
+void
+p_gap_buffer_free(PGapBuffer gb)
+{
+    if (gb != NULL) {
+        free(gb->buf);
+        free(gb);
+    }
+}
+
+void
+p_gap_buffer_clear(PGapBuffer gb)
+{
+    gb->gap_start = 0;
+    gb->gap_end = gb->alloc;
+    gb->cursor = 0;
+    gb->length = 0;
+    gb->width = 0;
+    gb->cursor_col = 0;
+}
+
+void
+p_gap_buffer_set(PGapBuffer gb, const char * const str)
+{
+    p_gap_buffer_clear(gb);
+    if (str != NULL) {
+        p_gap_buffer_insert(gb, str, strlen(str));
+    }
+}
+
+/*
+ * Insert len bytes of UTF-8 at the cursor, leaving the cursor after them
+ */
+void
+p_gap_buffer_insert(PGapBuffer gb, const char * const str, gsize len)
+{
+    _move_gap(gb, gb->cursor);
+    _ensure_gap(gb, len + 1);
+
+    memcpy(gb->buf + gb->gap_start, str, len);
+    gb->gap_start += len;
+    gb->cursor += len;
+
+    const char *curr = str;
+    while (curr < str + len) {
+        int width = _char_width(g_utf8_get_char(curr));
+        gb->length++;
+        gb->width += width;
+        gb->cursor_col += width;
+        curr = g_utf8_next_char(curr);
+    }
+}
+
+/*
+ * Remove the character before the cursor, returns FALSE if at the start
+ */
+gboolean
+p_gap_buffer_backspace(PGapBuffer gb)
+{
+    if (gb->cursor == 0) {
+        return FALSE;
+    }
+
+    gsize start = _prev_char(gb, gb->cursor);
+    int width = _char_width(g_utf8_get_char(_ptr_at(gb, start)));
+
+    _move_gap(gb, gb->cursor);
+    gb->gap_start = start;
+    gb->cursor = start;
+    gb->length--;
+    gb->width -= width;
+    gb->cursor_col -= width;
+
+    return TRUE;
+}
+
+/*
+ * Remove the character under the cursor, returns FALSE if at the end
+ */
+gboolean
+p_gap_buffer_delete(PGapBuffer gb)
+{
+    if (gb->cursor == _text_size(gb)) {
+        return FALSE;
+    }
+
+    _move_gap(gb, gb->cursor);
+    char *curr = gb->buf + gb->gap_end;
+    int width = _char_width(g_utf8_get_char(curr));
+
+    gb->gap_end += g_utf8_next_char(curr) - curr;
+    gb->length--;
+    gb->width -= width;
+
+    return TRUE;
+}
+
+gboolean
+p_gap_buffer_left(PGapBuffer gb)
+{
+    if (gb->cursor == 0) {
+        return FALSE;
+    }
+
+    gb->cursor = _prev_char(gb, gb->cursor);
+    gb->cursor_col -= _char_width(g_utf8_get_char(_ptr_at(gb, gb->cursor)));
+
+    return TRUE;
+}
+
+gboolean
+p_gap_buffer_right(PGapBuffer gb)
+{
+    if (gb->cursor == _text_size(gb)) {
+        return FALSE;
+    }
+
+    char *curr = _ptr_at(gb, gb->cursor);
+    gb->cursor += g_utf8_next_char(curr) - curr;
+    gb->cursor_col += _char_width(g_utf8_get_char(curr));
+
+    return TRUE;
+}
+
+void
+p_gap_buffer_home(PGapBuffer gb)
+{
+    gb->cursor = 0;
+    gb->cursor_col = 0;
+}
+
+void
+p_gap_buffer_end(PGapBuffer gb)
+{
+    gb->cursor = _text_size(gb);
+    gb->cursor_col = gb->width;
+}
+
+/*
+ * Return the whole line as a null terminated string, owned by the buffer
+ * and only valid until it is next changed
+ */
+const char *
+p_gap_buffer_contents(PGapBuffer gb)
+{
+    _move_gap(gb, _text_size(gb));
+    _ensure_gap(gb, 1);
+    gb->buf[gb->gap_start] = '\0';
+
+    return gb->buf;
+}
+
+/*
+ * Return the text after the cursor and its size in bytes, not null
+ * terminated, owned by the buffer and only valid until it is next changed
+ */
+const char *
+p_gap_buffer_tail(PGapBuffer gb, gsize *len)
+{
+    _move_gap(gb, gb->cursor);
+    *len = gb->alloc - gb->gap_end;
+
+    return gb->buf + gb->gap_end;
+}
+
+gboolean
+p_gap_buffer_has_prefix(PGapBuffer gb, const char * const prefix)
+{
+    gsize len = strlen(prefix);
+    if (len > _text_size(gb)) {
+        return FALSE;
+    }
+
+    gsize i;
+    for (i = 0; i < len; i++) {
+        if (*_ptr_at(gb, i) != prefix[i]) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+gsize
+p_gap_buffer_size(PGapBuffer gb)
+{
+    return _text_size(gb);
+}
+
+glong
+p_gap_buffer_length(PGapBuffer gb)
+{
+    return gb->length;
+}
+
+glong
+p_gap_buffer_width(PGapBuffer gb)
+{
+    return gb->width;
+}
+
+glong
+p_gap_buffer_cursor(PGapBuffer gb)
+{
+    return gb->cursor_col;
+}
+
+static gsize
+_text_size(PGapBuffer gb)
+{
+    return gb->alloc - (gb->gap_end - gb->gap_start);
+}
+
+static char *
+_ptr_at(PGapBuffer gb, gsize offset)
+{
+    if (offset < gb->gap_start) {
+        return gb->buf + offset;
+    } else {
+        return gb->buf + offset + (gb->gap_end - gb->gap_start);
+    }
+}
+
+// characters never straddle the gap, so stepping back over continuation
+// bytes finds the start of the previous character
+static gsize
+_prev_char(PGapBuffer gb, gsize offset)
+{
+    do {
+        offset--;
+    } while (offset > 0 && (*_ptr_at(gb, offset) & 0xC0) == 0x80);
+
+    return offset;
+}
+
+static void
+_move_gap(PGapBuffer gb, gsize offset)
+{
+    if (offset < gb->gap_start) {
+        gsize count = gb->gap_start - offset;
+        memmove(gb->buf + gb->gap_end - count, gb->buf + offset, count);
+        gb->gap_start -= count;
+        gb->gap_end -= count;
+    } else if (offset > gb->gap_start) {
+        gsize count = offset - gb->gap_start;
+        memmove(gb->buf + gb->gap_start, gb->buf + gb->gap_end, count);
+        gb->gap_start += count;
+        gb->gap_end += count;
+    }
+}
+
+static void
+_ensure_gap(PGapBuffer gb, gsize needed)
+{
+    if (gb->gap_end - gb->gap_start >= needed) {
+        return;
+    }
+
+    gsize text_size = _text_size(gb);
+    gsize new_alloc = gb->alloc * 2;
+    while (new_alloc - text_size < needed) {
+        new_alloc *= 2;
+    }
+
+    gsize after = gb->alloc - gb->gap_end;
+    gb->buf = realloc(gb->buf, new_alloc);
+    memmove(gb->buf + new_alloc - after, gb->buf + gb->gap_end, after);
+    gb->gap_end = new_alloc - after;
+    gb->alloc = new_alloc;
+}
+
+static int
+_char_width(gunichar ch)
+{
+    if (g_unichar_iszerowidth(ch)) {
+        return 0;
+    } else if (g_unichar_iswide(ch)) {
+        return 2;
+    } else {
+        return 1;
+    }
+}
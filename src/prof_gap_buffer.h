@@ -0,0 +1,49 @@
+/*
+ * prof_gap_buffer.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PROF_GAP_BUFFER_H
+#define PROF_GAP_BUFFER_H
+
+#include <glib.h>
+
+typedef struct p_gap_buffer_t *PGapBuffer;
+
+PGapBuffer p_gap_buffer_new(void);
+void p_gap_buffer_free(PGapBuffer gb);
+void p_gap_buffer_clear(PGapBuffer gb);
+void p_gap_buffer_set(PGapBuffer gb, const char * const str);
+void p_gap_buffer_insert(PGapBuffer gb, const char * const str, gsize len);
+gboolean p_gap_buffer_backspace(PGapBuffer gb);
+gboolean p_gap_buffer_delete(PGapBuffer gb);
+gboolean p_gap_buffer_left(PGapBuffer gb);
+gboolean p_gap_buffer_right(PGapBuffer gb);
+void p_gap_buffer_home(PGapBuffer gb);
+void p_gap_buffer_end(PGapBuffer gb);
+const char * p_gap_buffer_contents(PGapBuffer gb);
+const char * p_gap_buffer_tail(PGapBuffer gb, gsize *len);
+gboolean p_gap_buffer_has_prefix(PGapBuffer gb, const char * const prefix);
+gsize p_gap_buffer_size(PGapBuffer gb);
+glong p_gap_buffer_length(PGapBuffer gb);
+glong p_gap_buffer_width(PGapBuffer gb);
+glong p_gap_buffer_cursor(PGapBuffer gb);
+
+#endif
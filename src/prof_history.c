@@ -19,7 +19,6 @@
  * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
-
 #include <stdlib.h>
 #include <string.h>
 
@@ -27,241 +26,541 @@
 
 #include "prof_history.h"
 
+// history items are kept in a ring, the oldest at items[first], and every
+// item gets a sequence number when appended, so positions can be found from
+// the index without walking the ring.  The ring starts small and doubles as
+// items are added, until it holds max_size items
+
+#define RING_INITIAL_SIZE 16
+
+// number of dead entries at the front of a posting list before it is compacted
+#define POSTING_COMPACT 32
+
+#define TRIGRAM(s) GUINT_TO_POINTER(((guint)(guchar)(s)[0] << 16) | \
+    ((guint)(guchar)(s)[1] << 8) | (guint)(guchar)(s)[2])
+
+// sequence numbers of the items containing a trigram, in ascending order,
+// entries before head have been evicted
+typedef struct posting_t {
+    GArray *seqs;
+    guint head;
+} Posting;
+
+// edits made while moving through the history, keyed by position, the
+// position one past the last item holds the line being typed
 struct p_history_session_t {
-    GList *items;
-    GList *sess_curr;
-    GList *sess_new;
-    GList *orig_curr;
+    GHashTable *edits;
+    guint curr;
 };
 
 struct p_history_t {
-    GList *items;
+    char **items;
+    guint ring_size;
     guint max_size;
+    guint first;
+    guint count;
+    guint next_seq;
+    GHashTable *index;
     struct p_history_session_t session;
 };
 
-static void _replace_history_with_session(PHistory history);
-static gboolean _adding_new(PHistory history);
-static void _reset_session(PHistory history);
+static char * _item(PHistory history, guint pos);
+static void _push(PHistory history, char *item);
+static void _drop_oldest(PHistory history);
+static void _resize_ring(PHistory history, guint ring_size);
+static void _replace(PHistory history, guint pos, char *item);
+static void _clear_items(PHistory history);
 static gboolean _has_session(PHistory history);
-static void _remove_first(PHistory history);
-static void _update_current_session_item(PHistory history, char *item);
-static void _add_to_history(PHistory history, char *item);
-static void _remove_last_session_item(PHistory history);
-static void _replace_current_with_original(PHistory history);
-static void _create_session(PHistory history);
-static void _session_previous(PHistory history);
-static void _session_next(PHistory history);
+static void _start_session(PHistory history);
+static void _end_session(PHistory history);
+static const char * _session_value(PHistory history, guint pos);
+static void _session_update(PHistory history, guint pos, char *item);
+static void _apply_session(PHistory history);
+static Posting * _posting_new(void);
+static void _posting_free(Posting *posting);
+static guint _posting_length(Posting *posting);
+static guint _posting_search(Posting *posting, guint seq);
+static void _posting_insert(Posting *posting, guint seq);
+static void _posting_remove(Posting *posting, guint seq);
+static void _index_add(PHistory history, const char * const item, guint seq);
+static void _index_remove(PHistory history, const char * const item,
+    guint seq);
 
 PHistory
 p_history_new(unsigned int size)
 {
     PHistory new_history = malloc(sizeof(struct p_history_t));
-    new_history->items = NULL;
+    if (size == 0) {
+        size = 1;
+    }
+    new_history->ring_size = MIN(size, RING_INITIAL_SIZE);
+    new_history->items = calloc(new_history->ring_size, sizeof(char *));
     new_history->max_size = size;
-
-    _reset_session(new_history);
+    new_history->first = 0;
+    new_history->count = 0;
+    new_history->next_seq = 0;
+    new_history->index = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+        NULL, (GDestroyNotify)_posting_free);
+    new_history->session.edits = NULL;
+    new_history->session.curr = 0;
 
     return new_history;
 }
 
 void
-p_history_append(PHistory history, char *item)
+p_history_free(PHistory history)
 {
-    char *copied = "";
-    if (item != NULL) {
-        copied = strdup(item);
+    if (history != NULL) {
+        _end_session(history);
+        _clear_items(history);
+        g_hash_table_destroy(history->index);
+        free(history->items);
+        free(history);
     }
+}
 
-    if (history->items == NULL) {
-        _add_to_history(history, copied);
+void
+p_history_resize(PHistory history, unsigned int size)
+{
+    if (size == 0) {
+        size = 1;
+    }
+    if (size == history->max_size) {
         return;
     }
 
-    if (!_has_session(history)) {
-        if (g_list_length(history->items) == history->max_size) {
-            _remove_first(history);
-        }
+    _end_session(history);
 
-        _add_to_history(history, copied);
+    // keep the newest items
+    while (history->count > size) {
+        _drop_oldest(history);
+    }
 
-    } else {
-        _update_current_session_item(history, copied);
+    history->max_size = size;
+    _resize_ring(history, MAX(MIN(size, RING_INITIAL_SIZE), history->count));
+}
 
-        if (_adding_new(history)) {
-            if (strcmp(history->session.sess_curr->data, "") == 0) {
-                _remove_last_session_item(history);
-            }
+// forget the edits made while moving through the history
+void
+p_history_end_session(PHistory history)
+{
+    _end_session(history);
+}
 
-            _replace_history_with_session(history);
+void
+p_history_append(PHistory history, char *item)
+{
+    char *copied = strdup(item == NULL ? "" : item);
 
-        } else {
-            _remove_last_session_item(history);
+    if (!_has_session(history)) {
+        _push(history, copied);
+        return;
+    }
 
-            char *new = strdup(history->session.sess_curr->data);
-            history->session.items = g_list_append(history->session.items, new);
+    guint curr = history->session.curr;
+    _session_update(history, curr, copied);
 
-            _replace_current_with_original(history);
-            _replace_history_with_session(history);
+    if (curr == history->count) {
+        // submitting the new line, keep it unless it is empty
+        char *new_line = strdup(_session_value(history, curr));
+        g_hash_table_remove(history->session.edits, GUINT_TO_POINTER(curr));
+        _apply_session(history);
+        if (strcmp(new_line, "") != 0) {
+            _push(history, new_line);
+        } else {
+            free(new_line);
         }
+    } else {
+        // submitting an older item, it goes on the end and the original
+        // stays where it was
+        char *line = strdup(_session_value(history, curr));
+        g_hash_table_remove(history->session.edits, GUINT_TO_POINTER(curr));
+        g_hash_table_remove(history->session.edits,
+            GUINT_TO_POINTER(history->count));
+        _apply_session(history);
+        _push(history, line);
     }
+
+    _end_session(history);
 }
 
 char *
 p_history_previous(PHistory history, char *item)
 {
     // no history
-    if (history->items == NULL) {
+    if (history->count == 0) {
         return NULL;
     }
 
-    char *copied = "";
-    if (item != NULL) {
-        copied = strdup(item);
-    }
+    char *copied = strdup(item == NULL ? "" : item);
 
     if (!_has_session(history)) {
-        _create_session(history);
-
-        // add the new item
-        history->session.items = g_list_append(history->session.items, copied);
-        history->session.sess_new = g_list_last(history->session.items);
-
-        char *result = strdup(history->session.sess_curr->data);
-        return result;
+        _start_session(history);
+        _session_update(history, history->count, copied);
+        history->session.curr = history->count - 1;
     } else {
-        _update_current_session_item(history, copied);
-        _session_previous(history);
+        _session_update(history, history->session.curr, copied);
+        if (history->session.curr > 0) {
+            history->session.curr--;
+        }
     }
 
-    char *result = strdup(history->session.sess_curr->data);
-    return result;
+    return strdup(_session_value(history, history->session.curr));
 }
 
 char *
 p_history_next(PHistory history, char *item)
 {
     // no history, or no session, return NULL
-    if ((history->items == NULL) || (history->session.items == NULL)) {
+    if ((history->count == 0) || !_has_session(history)) {
+        return NULL;
+    }
+
+    char *copied = strdup(item == NULL ? "" : item);
+
+    _session_update(history, history->session.curr, copied);
+    if (history->session.curr < history->count) {
+        history->session.curr++;
+    }
+
+    return strdup(_session_value(history, history->session.curr));
+}
+
+guint
+p_history_length(PHistory history)
+{
+    return history->count;
+}
+
+const char *
+p_history_get(PHistory history, int index)
+{
+    if ((index < 0) || ((guint)index >= history->count)) {
         return NULL;
     }
 
-    char *copied = "";
-    if (item != NULL) {
-        copied = strdup(item);
+    return _item(history, index);
+}
+
+int
+p_history_search(PHistory history, const char * const query, int from)
+{
+    if ((history->count == 0) || (query == NULL) || (query[0] == '\0')) {
+        return -1;
+    }
+    if ((from < 0) || ((guint)from >= history->count)) {
+        from = history->count - 1;
+    }
+
+    size_t len = strlen(query);
+    int i;
+
+    // too short to use the index
+    if (len < 3) {
+        for (i = from; i >= 0; i--) {
+            if (strstr(_item(history, i), query) != NULL) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // every match contains all of the query's trigrams, so only the items
+    // listed for the rarest one need checking
+    Posting *rarest = NULL;
+    size_t pos;
+    for (pos = 0; pos + 2 < len; pos++) {
+        Posting *posting = g_hash_table_lookup(history->index,
+            TRIGRAM(query + pos));
+        if (posting == NULL) {
+            return -1;
+        }
+        if ((rarest == NULL) ||
+                (_posting_length(posting) < _posting_length(rarest))) {
+            rarest = posting;
+        }
     }
 
-    _update_current_session_item(history, copied);
-    _session_next(history);
+    guint first_seq = history->next_seq - history->count;
+    guint last_seq = first_seq + from;
+    guint entry = _posting_search(rarest, last_seq + 1);
+    while (entry > rarest->head) {
+        entry--;
+        guint seq = g_array_index(rarest->seqs, guint, entry);
+        if (seq < first_seq) {
+            break;
+        }
+        if (strstr(_item(history, seq - first_seq), query) != NULL) {
+            return seq - first_seq;
+        }
+    }
 
-    char *result = strdup(history->session.sess_curr->data);
-    return result;
+    return -1;
+}
+
+static char *
+_item(PHistory history, guint pos)
+{
+    return history->items[(history->first + pos) % history->ring_size];
+}
+
+static void
+_push(PHistory history, char *item)
+{
+    if (history->count == history->max_size) {
+        _drop_oldest(history);
+    } else if (history->count == history->ring_size) {
+        _resize_ring(history, MIN(history->ring_size * 2, history->max_size));
+    }
+
+    guint slot = (history->first + history->count) % history->ring_size;
+    history->items[slot] = item;
+    _index_add(history, item, history->next_seq);
+    history->next_seq++;
+    history->count++;
 }
 
 static void
-_replace_history_with_session(PHistory history)
+_drop_oldest(PHistory history)
 {
-    g_list_free(history->items);
-    history->items = g_list_copy(history->session.items);
+    char *oldest = history->items[history->first];
+    _index_remove(history, oldest, history->next_seq - history->count);
+    free(oldest);
+    history->items[history->first] = NULL;
+    history->first = (history->first + 1) % history->ring_size;
+    history->count--;
+}
 
-    if (g_list_length(history->items) > history->max_size) {
-        _remove_first(history);
+// copy the items to a new ring, with the oldest first
+static void
+_resize_ring(PHistory history, guint ring_size)
+{
+    if (ring_size == history->ring_size) {
+        return;
     }
 
-    _reset_session(history);
+    char **items = calloc(ring_size, sizeof(char *));
+    guint i;
+    for (i = 0; i < history->count; i++) {
+        items[i] = _item(history, i);
+    }
+    free(history->items);
+    history->items = items;
+    history->ring_size = ring_size;
+    history->first = 0;
 }
 
-static gboolean
-_adding_new(PHistory history)
+static void
+_replace(PHistory history, guint pos, char *item)
 {
-    return (history->session.sess_curr ==
-        g_list_last(history->session.items));
+    guint slot = (history->first + pos) % history->ring_size;
+    guint seq = history->next_seq - history->count + pos;
+
+    _index_remove(history, history->items[slot], seq);
+    free(history->items[slot]);
+    history->items[slot] = item;
+    _index_add(history, item, seq);
 }
 
 static void
-_reset_session(PHistory history)
+_clear_items(PHistory history)
 {
-    history->session.items = NULL;
-    history->session.sess_curr = NULL;
-    history->session.sess_new = NULL;
-    history->session.orig_curr = NULL;
+    guint i;
+    for (i = 0; i < history->count; i++) {
+        guint slot = (history->first + i) % history->ring_size;
+        free(history->items[slot]);
+        history->items[slot] = NULL;
+    }
+    history->count = 0;
+    history->first = 0;
+    g_hash_table_remove_all(history->index);
 }
 
 static gboolean
 _has_session(PHistory history)
 {
-    return (history->session.items != NULL);
+    return (history->session.edits != NULL);
 }
 
 static void
-_remove_first(PHistory history)
+_start_session(PHistory history)
 {
-    GList *first = g_list_first(history->items);
-    char *first_item = first->data;
-    history->items = g_list_remove(history->items, first_item);
+    history->session.edits = g_hash_table_new_full(g_direct_hash,
+        g_direct_equal, NULL, free);
+    history->session.curr = history->count;
 }
 
 static void
-_update_current_session_item(PHistory history, char *item)
+_end_session(PHistory history)
+{
+    if (history->session.edits != NULL) {
+        g_hash_table_destroy(history->session.edits);
+        history->session.edits = NULL;
+    }
+    history->session.curr = 0;
+}
+
+static const char *
+_session_value(PHistory history, guint pos)
 {
-    history->session.sess_curr->data = item;
+    char *edited = g_hash_table_lookup(history->session.edits,
+        GUINT_TO_POINTER(pos));
+    if (edited != NULL) {
+        return edited;
+    } else if (pos < history->count) {
+        return _item(history, pos);
+    } else {
+        return "";
+    }
 }
 
 static void
-_add_to_history(PHistory history, char *item)
+_session_update(PHistory history, guint pos, char *item)
 {
-    history->items = g_list_append(history->items, item);
+    // only keep a copy of items that differ from the history
+    if ((pos < history->count) && (strcmp(_item(history, pos), item) == 0)) {
+        g_hash_table_remove(history->session.edits, GUINT_TO_POINTER(pos));
+        free(item);
+    } else {
+        g_hash_table_replace(history->session.edits, GUINT_TO_POINTER(pos),
+            item);
+    }
 }
 
 static void
-_remove_last_session_item(PHistory history)
+_apply_session(PHistory history)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&iter, history->session.edits);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        guint pos = GPOINTER_TO_UINT(key);
+        if (pos < history->count) {
+            g_hash_table_iter_steal(&iter);
+            _replace(history, pos, value);
+        }
+    }
+}
+
+static Posting *
+_posting_new(void)
 {
-    history->session.items = g_list_reverse(history->session.items);
-    GList *first = g_list_first(history->session.items);
-    history->session.items =
-        g_list_remove(history->session.items, first->data);
-    history->session.items = g_list_reverse(history->session.items);
+    Posting *posting = malloc(sizeof(Posting));
+    posting->seqs = g_array_new(FALSE, FALSE, sizeof(guint));
+    posting->head = 0;
+
+    return posting;
 }
 
 static void
-_replace_current_with_original(PHistory history)
+_posting_free(Posting *posting)
 {
-    history->session.sess_curr->data = strdup(history->session.orig_curr->data);
+    if (posting != NULL) {
+        g_array_free(posting->seqs, TRUE);
+        free(posting);
+    }
+}
+
+static guint
+_posting_length(Posting *posting)
+{
+    return posting->seqs->len - posting->head;
+}
+
+// position of the first entry not less than seq
+static guint
+_posting_search(Posting *posting, guint seq)
+{
+    guint low = posting->head;
+    guint high = posting->seqs->len;
+
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        if (g_array_index(posting->seqs, guint, mid) < seq) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
 }
 
 static void
-_create_session(PHistory history)
+_posting_insert(Posting *posting, guint seq)
 {
-    history->session.items = g_list_copy(history->items);
-    history->session.sess_curr = g_list_last(history->session.items);
-    history->session.orig_curr = g_list_last(history->items);
+    guint len = posting->seqs->len;
+
+    // appending the newest item is the usual case
+    if ((len == posting->head) ||
+            (g_array_index(posting->seqs, guint, len - 1) < seq)) {
+        g_array_append_val(posting->seqs, seq);
+        return;
+    }
+
+    guint entry = _posting_search(posting, seq);
+    if ((entry == len) || (g_array_index(posting->seqs, guint, entry) != seq)) {
+        g_array_insert_val(posting->seqs, entry, seq);
+    }
 }
 
 static void
-_session_previous(PHistory history)
+_posting_remove(Posting *posting, guint seq)
 {
-    history->session.sess_curr =
-        g_list_previous(history->session.sess_curr);
-    if (history->session.orig_curr == NULL)
-        history->session.orig_curr = g_list_last(history->items);
-    else
-        history->session.orig_curr =
-            g_list_previous(history->session.orig_curr);
-
-    if (history->session.sess_curr == NULL) {
-        history->session.sess_curr = g_list_first(history->session.items);
-        history->session.orig_curr = g_list_first(history->items);
+    if (_posting_length(posting) == 0) {
+        return;
+    }
+
+    // evicting the oldest item is the usual case
+    if (g_array_index(posting->seqs, guint, posting->head) == seq) {
+        posting->head++;
+        if ((posting->head >= POSTING_COMPACT) &&
+                (posting->head * 2 >= posting->seqs->len)) {
+            g_array_remove_range(posting->seqs, 0, posting->head);
+            posting->head = 0;
+        }
+        return;
+    }
+
+    guint entry = _posting_search(posting, seq);
+    if ((entry < posting->seqs->len) &&
+            (g_array_index(posting->seqs, guint, entry) == seq)) {
+        g_array_remove_index(posting->seqs, entry);
     }
 }
 
 static void
-_session_next(PHistory history)
+_index_add(PHistory history, const char * const item, guint seq)
 {
-    history->session.sess_curr = g_list_next(history->session.sess_curr);
-    history->session.orig_curr = g_list_next(history->session.orig_curr);
+    size_t len = strlen(item);
+    size_t pos;
+
+    for (pos = 0; pos + 2 < len; pos++) {
+        gpointer key = TRIGRAM(item + pos);
+        Posting *posting = g_hash_table_lookup(history->index, key);
+        if (posting == NULL) {
+            posting = _posting_new();
+            g_hash_table_insert(history->index, key, posting);
+        }
+        _posting_insert(posting, seq);
+    }
+}
 
-    if (history->session.sess_curr == NULL) {
-        history->session.sess_curr = g_list_last(history->session.items);
-        history->session.orig_curr = NULL;
+static void
+_index_remove(PHistory history, const char * const item, guint seq)
+{
+    size_t len = strlen(item);
+    size_t pos;
+
+    for (pos = 0; pos + 2 < len; pos++) {
+        gpointer key = TRIGRAM(item + pos);
+        Posting *posting = g_hash_table_lookup(history->index, key);
+        if (posting != NULL) {
+            _posting_remove(posting, seq);
+            if (_posting_length(posting) == 0) {
+                g_hash_table_remove(history->index, key);
+            }
+        }
     }
 }
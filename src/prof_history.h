@@ -19,15 +19,22 @@
  * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
-
 #ifndef PROF_HISTORY_H
 #define PROF_HISTORY_H
 
+#include <glib.h>
+
 typedef struct p_history_t  *PHistory;
 
 PHistory p_history_new(unsigned int size);
+void p_history_free(PHistory history);
+void p_history_resize(PHistory history, unsigned int size);
 char * p_history_previous(PHistory history, char *item);
 char * p_history_next(PHistory history, char *item);
 void p_history_append(PHistory history, char *item);
+void p_history_end_session(PHistory history);
+guint p_history_length(PHistory history);
+const char * p_history_get(PHistory history, int index);
+int p_history_search(PHistory history, const char * const query, int from);
 
 #endif
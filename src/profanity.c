@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include <locale.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
@@ -30,51 +31,63 @@
 #include <glib.h>
 
 #include "accounts.h"
+#include "batch.h"
+#include "cache.h"
 #include "chat_log.h"
 #include "chat_session.h"
 #include "command.h"
 #include "common.h"
 #include "contact.h"
 #include "contact_list.h"
+#include "dispatch.h"
 #include "files.h"
 #include "history.h"
+#include "jid.h"
+#include "http.h"
 #include "log.h"
 #include "preferences.h"
 #include "profanity.h"
 #include "muc.h"
 #include "theme.h"
+#include "trace.h"
 #include "jabber.h"
 #include "ui.h"
 
+// how long the batch loop waits for a command before handling events again
+#define BATCH_POLL_MS 10
+
 static log_level_t _get_log_level(char *log_level);
 static gboolean _process_input(char *inp);
 static void _handle_idle_time(void);
-static void _init(const int disable_tls, char *log_level);
+static void _handle_connecting(void);
+static void _init(const int disable_tls, char *log_level,
+    gboolean headless);
 static void _shutdown(void);
+static void _send_chat_state(const char * const recipient,
+    chat_state_t state);
+static void _batch_subscription(const char * const from,
+    jabber_subscr_t type);
 
 static gboolean idle = FALSE;
 
 void
 prof_run(const int disable_tls, char *log_level)
 {
-    _init(disable_tls, log_level);
+    _init(disable_tls, log_level, FALSE);
     log_info("Starting main event loop");
     inp_non_block();
     GTimer *timer = g_timer_new();
     gboolean cmd_result = TRUE;
 
-    char inp[INP_WIN_MAX];
-    int size = 0;
-
     while(cmd_result == TRUE) {
         wint_t ch = ERR;
-        size = 0;
 
         while(ch != '\n') {
 
             if (jabber_get_connection_status() == JABBER_CONNECTED) {
                 _handle_idle_time();
             }
+            _handle_connecting();
 
             gdouble elapsed = g_timer_elapsed(timer, NULL);
 
@@ -89,63 +102,150 @@ prof_run(const int disable_tls, char *log_level)
             ui_handle_special_keys(&ch);
 
             if (ch == KEY_RESIZE) {
-                ui_resize(ch, inp, size);
+                ui_resize(ch);
             }
 
             ui_refresh();
             jabber_process_events();
+            http_process_events();
 
-            ch = inp_get_char(inp, &size);
+            ch = inp_get_char();
 
             if (ch != ERR) {
                 ui_reset_idle_time();
             }
         }
 
-        inp[size++] = '\0';
+        char *inp = inp_get_line();
         cmd_result = _process_input(inp);
+        free(inp);
     }
 
     g_timer_destroy(timer);
 }
 
+/*
+ * Run without a terminal, reading commands from a batch file, standard input
+ * if batch_file is "-", or a UNIX socket at socket_path. Incoming events are
+ * written to standard output as JSON, one per line.
+ */
 void
-prof_handle_typing(char *from)
+prof_run_batch(const int disable_tls, char *log_level,
+    const char * const batch_file, const char * const socket_path)
 {
-    ui_show_typing(from);
-    win_current_page_off();
+    _init(disable_tls, log_level, TRUE);
+
+    gboolean opened;
+    if (socket_path != NULL) {
+        opened = batch_open_socket(socket_path);
+    } else {
+        opened = batch_open_file(batch_file);
+    }
+    if (!opened) {
+        exit(1);
+    }
+
+    log_info("Starting batch event loop");
+    gboolean cmd_result = TRUE;
+
+    while (cmd_result == TRUE) {
+        jabber_process_events();
+        http_process_events();
+
+        if (prefs_get_states()) {
+            prof_handle_idle();
+        }
+
+        char *inp = batch_read_line(BATCH_POLL_MS);
+        if (inp != NULL) {
+            cmd_result = _process_input(inp);
+            free(inp);
+        }
+    }
 }
 
+/*
+ * Feed a recorded trace through the stanza handlers without connecting,
+ * waiting between stanzas as they originally arrived unless fast is set.
+ * The UI is drawn to /dev/null, and the time spent in each handler and in
+ * drawing is written to standard output at the end, followed by the
+ * stanza dispatch table.
+ */
 void
-prof_handle_incoming_message(char *from, char *message, gboolean priv)
+prof_run_replay(char *log_level, const char * const trace_file,
+    gboolean fast)
 {
-    ui_show_incoming_msg(from, message, NULL, priv);
-    win_current_page_off();
+    _init(FALSE, log_level, TRUE);
 
-    if (prefs_get_chlog()) {
-        char from_cpy[strlen(from) + 1];
-        strcpy(from_cpy, from);
-        char *short_from = strtok(from_cpy, "/");
-        const char *jid = jabber_get_jid();
+    if (!trace_replay_open(trace_file)) {
+        log_error("Could not open trace file %s", trace_file);
+        exit(1);
+    }
+
+    log_info("Replaying %s", trace_file);
+    jabber_replay_start();
+
+    char *stanza;
+    gulong delay_ms;
+    while ((stanza = trace_replay_next(&delay_ms)) != NULL) {
+        if (!fast && delay_ms > 0) {
+            g_usleep(delay_ms * 1000);
+        }
+
+        if (jabber_replay_stanza(trace_replay_jid(), stanza)) {
+            trace_stat_start();
+            ui_refresh();
+            trace_stat_end("render");
+        } else {
+            trace_stat_skipped();
+        }
+        free(stanza);
+    }
+
+    jabber_replay_end();
+    trace_replay_close();
+    trace_stat_report(stdout);
+    fprintf(stdout, "\n");
+    dispatch_report(stdout);
+    trace_stat_clear();
+}
+
+void
+prof_handle_typing(const char * const from)
+{
+    ui_show_typing(from);
+    win_current_page_off();
 
-        chat_log_chat(jid, short_from, message, PROF_IN_LOG, NULL);
+    if (batch_active()) {
+        batch_event("typing", "from", from, NULL);
     }
 }
 
 void
-prof_handle_delayed_message(char *from, char *message, GTimeVal tv_stamp,
-    gboolean priv)
+prof_handle_incoming_message(const ProfMessage * const message)
 {
-    ui_show_incoming_msg(from, message, &tv_stamp, priv);
+    ui_show_incoming_msg(message);
     win_current_page_off();
 
+    if (batch_active()) {
+        const char *type = message->priv ? "private" : "chat";
+        if (message->delayed) {
+            GTimeVal tv_stamp;
+            g_date_time_to_timeval(message->timestamp, &tv_stamp);
+            gchar *stamp = g_time_val_to_iso8601(&tv_stamp);
+            batch_event("message", "type", type, "from", message->from,
+                "body", message->body, "delay", stamp, NULL);
+            g_free(stamp);
+        } else {
+            batch_event("message", "type", type, "from", message->from,
+                "body", message->body, NULL);
+        }
+    }
+
     if (prefs_get_chlog()) {
-        char from_cpy[strlen(from) + 1];
-        strcpy(from_cpy, from);
-        char *short_from = strtok(from_cpy, "/");
         const char *jid = jabber_get_jid();
-
-        chat_log_chat(jid, short_from, message, PROF_IN_LOG, &tv_stamp);
+        chat_log_chat(jid, message->from_jid->barejid, message->body,
+            PROF_IN_LOG, message->timestamp);
     }
 }
 
@@ -159,11 +259,19 @@ prof_handle_error_message(const char *from, const char *err_msg)
     }
 
     win_show_error_msg(from, err_msg);
+
+    if (batch_active()) {
+        batch_event("error", "from", from, "message", err_msg, NULL);
+    }
 }
 
 void
 prof_handle_subscription(const char *from, jabber_subscr_t type)
 {
+    if (batch_active()) {
+        _batch_subscription(from, type);
+    }
+
     switch (type) {
     case PRESENCE_SUBSCRIBE:
         /* TODO: auto-subscribe if needed */
@@ -203,6 +311,10 @@ prof_handle_login_account_success(char *account_name)
     status_bar_print_message(account->jid);
     status_bar_refresh();
 
+    if (batch_active()) {
+        batch_event("login", "jid", account->jid, NULL);
+    }
+
     accounts_free_account(account);
 }
 
@@ -217,6 +329,10 @@ prof_handle_login_success(const char *jid, const char *altdomain)
     status_bar_print_message(jid);
     status_bar_refresh();
 
+    if (batch_active()) {
+        batch_event("login", "jid", jid, NULL);
+    }
+
     accounts_add_login(jid, altdomain);
 }
 
@@ -225,6 +341,10 @@ prof_handle_gone(const char * const from)
 {
     win_show_gone(from);
     win_current_page_off();
+
+    if (batch_active()) {
+        batch_event("gone", "from", from, NULL);
+    }
 }
 
 void
@@ -232,10 +352,20 @@ prof_handle_lost_connection(void)
 {
     cons_bad_show("Lost connection.");
     log_info("Lost connection");
-    contact_list_clear();
+
+    // keep the contacts for when the connection comes back
+    if (prefs_get_reconnect() != 0) {
+        contact_list_set_all_offline();
+    } else {
+        contact_list_clear();
+    }
     ui_disconnected();
     win_current_page_off();
     log_info("disconnected");
+
+    if (batch_active()) {
+        batch_event("lost_connection", NULL);
+    }
 }
 
 void
@@ -245,6 +375,10 @@ prof_handle_failed_login(void)
     log_info("Login failed");
     win_current_page_off();
     log_info("disconnected");
+
+    if (batch_active()) {
+        batch_event("login_failed", NULL);
+    }
 }
 
 void
@@ -260,6 +394,10 @@ prof_handle_disconnect(const char * const jid)
     status_bar_refresh();
     cons_show("%s logged out successfully.", jid);
     win_current_page_off();
+
+    if (batch_active()) {
+        batch_event("logout", "jid", jid, NULL);
+    }
 }
 
 void
@@ -268,6 +406,13 @@ prof_handle_room_history(const char * const room_jid, const char * const nick,
 {
     win_show_room_history(room_jid, nick, tv_stamp, message);
     win_current_page_off();
+
+    if (batch_active()) {
+        gchar *stamp = g_time_val_to_iso8601(&tv_stamp);
+        batch_event("room_message", "room", room_jid, "nick", nick,
+            "body", message, "delay", stamp, NULL);
+        g_free(stamp);
+    }
 }
 
 void
@@ -276,6 +421,11 @@ prof_handle_room_message(const char * const room_jid, const char * const nick,
 {
     win_show_room_message(room_jid, nick, message);
     win_current_page_off();
+
+    if (batch_active()) {
+        batch_event("room_message", "room", room_jid, "nick", nick,
+            "body", message, NULL);
+    }
 }
 
 void
@@ -283,6 +433,10 @@ prof_handle_room_subject(const char * const room_jid, const char * const subject
 {
     win_show_room_subject(room_jid, subject);
     win_current_page_off();
+
+    if (batch_active()) {
+        batch_event("room_subject", "room", room_jid, "subject", subject, NULL);
+    }
 }
 
 void
@@ -291,6 +445,10 @@ prof_handle_room_broadcast(const char *const room_jid,
 {
     win_show_room_broadcast(room_jid, message);
     win_current_page_off();
+
+    if (batch_active()) {
+        batch_event("room_broadcast", "room", room_jid, "body", message, NULL);
+    }
 }
 
 void
@@ -321,6 +479,11 @@ prof_handle_room_member_online(const char * const room, const char * const nick,
     muc_add_to_roster(room, nick, show, status);
     win_show_room_member_online(room, nick, show, status);
     win_current_page_off();
+
+    if (batch_active()) {
+        batch_event("room_join", "room", room, "nick", nick, "show", show,
+            "status", status, NULL);
+    }
 }
 
 void
@@ -330,6 +493,10 @@ prof_handle_room_member_offline(const char * const room, const char * const nick
     muc_remove_from_roster(room, nick);
     win_show_room_member_offline(room, nick);
     win_current_page_off();
+
+    if (batch_active()) {
+        batch_event("room_leave", "room", room, "nick", nick, NULL);
+    }
 }
 
 void
@@ -350,6 +517,12 @@ prof_handle_contact_online(char *contact, char *show, char *status,
             if (strcmp(p_contact_subscription(result), "none") != 0) {
                 ui_contact_online(contact, show, status, last_activity);
                 win_current_page_off();
+
+                if (batch_active()) {
+                    batch_event("presence", "contact", contact,
+                        "show", show != NULL ? show : "online",
+                        "status", status, NULL);
+                }
             }
         }
     }
@@ -366,6 +539,11 @@ prof_handle_contact_offline(char *contact, char *show, char *status)
             if (strcmp(p_contact_subscription(result), "none") != 0) {
                 ui_contact_offline(contact, show, status);
                 win_current_page_off();
+
+                if (batch_active()) {
+                    batch_event("presence", "contact", contact,
+                        "show", "offline", "status", status, NULL);
+                }
             }
         }
     }
@@ -392,7 +570,7 @@ prof_handle_idle(void)
 {
     jabber_conn_status_t status = jabber_get_connection_status();
     if (status == JABBER_CONNECTED) {
-        ui_idle();
+        chat_sessions_check(_send_chat_state);
     }
 }
 
@@ -403,15 +581,60 @@ prof_handle_activity(void)
     if (status == JABBER_CONNECTED) {
         if (win_current_is_chat()) {
             char *recipient = win_current_get_recipient();
-            chat_session_set_composing(recipient);
-            if (!chat_session_get_sent(recipient) ||
-                    chat_session_is_paused(recipient)) {
+            if (!chat_session_exists(recipient)) {
+                chat_session_start(recipient, TRUE);
+            }
+            if (chat_session_on_activity(recipient)) {
                 jabber_send_composing(recipient);
             }
         }
     }
 }
 
+// called when a chat session changes state by itself, private chats in
+// rooms are left alone
+static void
+_send_chat_state(const char * const recipient, chat_state_t state)
+{
+    if (muc_room_is_active(recipient)) {
+        return;
+    }
+
+    switch (state) {
+    case CHAT_STATE_GONE:
+        jabber_send_gone(recipient);
+        break;
+    case CHAT_STATE_INACTIVE:
+        jabber_send_inactive(recipient);
+        break;
+    case CHAT_STATE_PAUSED:
+        if (prefs_get_outtype()) {
+            jabber_send_paused(recipient);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+_batch_subscription(const char * const from, jabber_subscr_t type)
+{
+    switch (type) {
+    case PRESENCE_SUBSCRIBE:
+        batch_event("subscription", "from", from, "type", "subscribe", NULL);
+        break;
+    case PRESENCE_SUBSCRIBED:
+        batch_event("subscription", "from", from, "type", "subscribed", NULL);
+        break;
+    case PRESENCE_UNSUBSCRIBED:
+        batch_event("subscription", "from", from, "type", "unsubscribed", NULL);
+        break;
+    default:
+        break;
+    }
+}
+
 static log_level_t
 _get_log_level(char *log_level)
 {
@@ -437,11 +660,15 @@ _process_input(char *inp)
     gboolean result = FALSE;
     g_strstrip(inp);
 
-    // add line to history if something typed
-    if (strlen(inp) > 0) {
+    // add line to history if something typed, batch input is not typed
+    if ((strlen(inp) > 0) && !batch_active()) {
         history_append(inp);
     }
 
+    // clear the input first, a command that switches window shows the draft
+    // of the new window
+    inp_win_reset();
+
     // just carry on if no input
     if (strlen(inp) == 0) {
         result = TRUE;
@@ -458,7 +685,6 @@ _process_input(char *inp)
         result = cmd_execute_default(inp);
     }
 
-    inp_win_reset();
     contact_list_reset_search_attempts();
     win_current_page_off();
 
@@ -517,8 +743,31 @@ _handle_idle_time()
     }
 }
 
+// a connection is set up in the background, show it is still going
+static void
+_handle_connecting(void)
+{
+    static gboolean connecting = FALSE;
+    jabber_conn_status_t status = jabber_get_connection_status();
+
+    if (status == JABBER_CONNECTING) {
+        char *msg = g_strdup_printf("Connecting as %s", jabber_get_jid());
+        status_bar_progress(msg);
+        g_free(msg);
+        connecting = TRUE;
+
+    // login success shows the jid instead
+    } else if (connecting) {
+        connecting = FALSE;
+        if (status != JABBER_CONNECTED) {
+            status_bar_clear_message();
+            status_bar_refresh();
+        }
+    }
+}
+
 static void
-_init(const int disable_tls, char *log_level)
+_init(const int disable_tls, char *log_level, gboolean headless)
 {
     setlocale(LC_ALL, "");
     // ignore SIGPIPE
@@ -533,7 +782,13 @@ _init(const int disable_tls, char *log_level)
     gchar *theme = prefs_get_theme();
     theme_init(theme);
     g_free(theme);
-    ui_init();
+    http_init();
+    cache_init();
+    if (headless) {
+        ui_init_headless();
+    } else {
+        ui_init();
+    }
     jabber_init(disable_tls);
     cmd_init();
     log_info("Initialising contact list");
@@ -545,6 +800,11 @@ static void
 _shutdown(void)
 {
     jabber_disconnect();
+    jabber_shutdown();
+    dispatch_close();
+    jid_cache_clear();
+    http_close();
+    cache_close();
     contact_list_free();
     ui_close();
     chat_log_close();
@@ -552,5 +812,7 @@ _shutdown(void)
     theme_close();
     accounts_close();
     cmd_close();
+    batch_close();
+    trace_record_close();
     log_close();
 }
@@ -26,19 +26,21 @@
 #include "jabber.h"
 
 void prof_run(const int disable_tls, char *log_level);
+void prof_run_batch(const int disable_tls, char *log_level,
+    const char * const batch_file, const char * const socket_path);
+void prof_run_replay(char *log_level, const char * const trace_file,
+    gboolean fast);
 
 void prof_handle_login_success(const char *jid, const char *altdomain);
 void prof_handle_login_account_success(char *account_name);
 void prof_handle_lost_connection(void);
 void prof_handle_disconnect(const char * const jid);
 void prof_handle_failed_login(void);
-void prof_handle_typing(char *from);
+void prof_handle_typing(const char * const from);
 void prof_handle_contact_online(char *contact, char *show, char *status,
     GDateTime *last_activity);
 void prof_handle_contact_offline(char *contact, char *show, char *status);
-void prof_handle_incoming_message(char *from, char *message, gboolean priv);
-void prof_handle_delayed_message(char *from, char *message, GTimeVal tv_stamp,
-    gboolean priv);
+void prof_handle_incoming_message(const ProfMessage * const message);
 void prof_handle_error_message(const char *from, const char *err_msg);
 void prof_handle_subscription(const char *from, jabber_subscr_t type);
 void prof_handle_roster(GSList *roster);
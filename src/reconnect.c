@@ -0,0 +1,145 @@
+/*
+ * reconnect.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <glib.h>
+
+#include "reconnect.h"
+
+// when the connection is lost, attempts are made after a random wait of
+// up to RECONNECT_BASE_MS, doubling after each failure until it reaches the
+// maximum, so the first retry is quick and clients that lost the same
+// server spread out rather than reconnecting together.  Times are in
+// milliseconds on a monotonic clock
+
+#define RECONNECT_BASE_MS 1000
+
+// doublings before the wait is certainly past any maximum
+#define RECONNECT_MAX_SHIFT 30
+
+static struct {
+    reconnect_state_t state;
+    guint attempts;
+    gint64 next_attempt;
+    gint64 max_ms;
+} reconnect;
+
+static void _schedule(gint64 now);
+
+/*
+ * The longest wait between attempts, 0 stops reconnecting
+ */
+void
+reconnect_set_max(gint64 max_ms)
+{
+    reconnect.max_ms = max_ms;
+    if (max_ms == 0) {
+        reconnect_stop();
+    }
+}
+
+/*
+ * The connection was lost, schedule the first attempt
+ */
+void
+reconnect_lost(gint64 now)
+{
+    reconnect.attempts = 0;
+    if (reconnect.max_ms == 0) {
+        reconnect.state = RECONNECT_IDLE;
+    } else {
+        _schedule(now);
+    }
+}
+
+/*
+ * Whether it is time for the next attempt, if so the attempt is counted
+ * as in progress until reconnect_failed() or reconnect_connected()
+ */
+gboolean
+reconnect_due(gint64 now)
+{
+    if ((reconnect.state == RECONNECT_WAITING) &&
+            (now >= reconnect.next_attempt)) {
+        reconnect.state = RECONNECT_CONNECTING;
+        reconnect.attempts++;
+        return TRUE;
+    } else {
+        return FALSE;
+    }
+}
+
+void
+reconnect_failed(gint64 now)
+{
+    if (reconnect.state != RECONNECT_CONNECTING) {
+        return;
+    }
+
+    if (reconnect.max_ms == 0) {
+        reconnect.state = RECONNECT_IDLE;
+    } else {
+        _schedule(now);
+    }
+}
+
+void
+reconnect_connected(void)
+{
+    reconnect_stop();
+}
+
+void
+reconnect_stop(void)
+{
+    reconnect.state = RECONNECT_IDLE;
+    reconnect.attempts = 0;
+    reconnect.next_attempt = 0;
+}
+
+reconnect_state_t
+reconnect_get_state(void)
+{
+    return reconnect.state;
+}
+
+gint64
+reconnect_get_next_attempt(void)
+{
+    return reconnect.next_attempt;
+}
+
+guint
+reconnect_get_attempts(void)
+{
+    return reconnect.attempts;
+}
+
+// full jitter, a random wait up to the capped exponential delay
+static void
+_schedule(gint64 now)
+{
+    guint shift = MIN(reconnect.attempts, RECONNECT_MAX_SHIFT);
+    gint64 ceiling = MIN((gint64)RECONNECT_BASE_MS << shift, reconnect.max_ms);
+    gint64 wait = (gint64)g_random_double_range(0, ceiling);
+
+    reconnect.next_attempt = now + wait;
+    reconnect.state = RECONNECT_WAITING;
+}
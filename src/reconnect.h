@@ -0,0 +1,43 @@
+/*
+ * reconnect.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#include <glib.h>
+
+typedef enum {
+    RECONNECT_IDLE,
+    RECONNECT_WAITING,
+    RECONNECT_CONNECTING
+} reconnect_state_t;
+
+void reconnect_set_max(gint64 max_ms);
+void reconnect_lost(gint64 now);
+gboolean reconnect_due(gint64 now);
+void reconnect_failed(gint64 now);
+void reconnect_connected(void);
+void reconnect_stop(void);
+reconnect_state_t reconnect_get_state(void);
+gint64 reconnect_get_next_attempt(void);
+guint reconnect_get_attempts(void);
+
+#endif
@@ -21,59 +21,89 @@
  */
 
 #include <stdlib.h>
-#include <string.h>
 
 #include <glib.h>
-#include <curl/curl.h>
-#include <curl/easy.h>
 
-struct curl_data_t
-{
-    char *buffer;
-    size_t size;
-};
+#include "cache.h"
+#include "http.h"
+#include "preferences.h"
+#include "release.h"
+
+#define RELEASE_URL "http://www.profanity.im/profanity_version.txt"
+#define RELEASE_TIMEOUT 5
+#define RELEASE_CACHE_KEY "release"
+
+typedef struct release_request_t {
+    http_callback_t callback;
+    void *userdata;
+} ReleaseRequest;
 
-static size_t _data_callback(void *ptr, size_t size, size_t nmemb, void *data);
+static void _release_done(const char * const release, void *userdata);
+static const char * _release_cached(void);
 
-char *
-release_get_latest()
+/*
+ * Fetch the latest release number in the background, callback is called
+ * with it, or NULL if it could not be fetched.  When use_cache is set, a
+ * release fetched within the last /vercheck interval is used instead, and
+ * callback is called straight away.  The cache holds the time it was fetched
+ * too, so a shorter interval, or 0, applies to a release already cached
+ */
+void
+release_get_latest(gboolean use_cache, http_callback_t callback,
+    void *userdata)
 {
-    char *url = "http://www.profanity.im/profanity_version.txt";
+    if (use_cache) {
+        const char *cached = _release_cached();
+        if (cached != NULL) {
+            callback(cached, userdata);
+            return;
+        }
+    }
 
-    CURL *handle = curl_easy_init();
-    struct curl_data_t output;
-    output.buffer = NULL;
-    output.size = 0;
+    ReleaseRequest *request = malloc(sizeof(ReleaseRequest));
+    request->callback = callback;
+    request->userdata = userdata;
 
-    curl_easy_setopt(handle, CURLOPT_URL, url);
-    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, _data_callback);
-    curl_easy_setopt(handle, CURLOPT_TIMEOUT, 2);
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, (void *)&output);
+    http_get(RELEASE_URL, RELEASE_TIMEOUT, _release_done, request);
+}
 
-    curl_easy_perform(handle);
-    curl_easy_cleanup(handle);
+static void
+_release_done(const char * const release, void *userdata)
+{
+    ReleaseRequest *request = userdata;
+    gint interval = prefs_get_vercheck_interval();
 
-    if (output.buffer != NULL) {
-        output.buffer[output.size++] = '\0';
-        return output.buffer;
-    } else {
-        return NULL;
+    if (release != NULL && interval > 0) {
+        gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+        char *value = g_strdup_printf("%" G_GINT64_FORMAT " %s", now, release);
+        cache_put(RELEASE_CACHE_KEY, value, (gint64)interval * 60 * 60);
+        g_free(value);
     }
+    request->callback(release, request->userdata);
+
+    free(request);
 }
 
-static size_t
-_data_callback(void *ptr, size_t size, size_t nmemb, void *data)
+// the cached release, if it was fetched within the current interval
+static const char *
+_release_cached(void)
 {
-    size_t realsize = size * nmemb;
-    struct curl_data_t *mem = (struct curl_data_t *) data;
-    mem->buffer = realloc(mem->buffer, mem->size + realsize + 1);
-
-    if ( mem->buffer )
-    {
-        memcpy( &( mem->buffer[ mem->size ] ), ptr, realsize );
-        mem->size += realsize;
-        mem->buffer[ mem->size ] = 0;
+    const char *cached = cache_get(RELEASE_CACHE_KEY);
+    if (cached == NULL) {
+        return NULL;
+    }
+
+    char *release;
+    gint64 fetched = g_ascii_strtoll(cached, &release, 10);
+    if ((release == cached) || (*release != ' ')) {
+        return NULL;
+    }
+
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    gint64 max_age = (gint64)prefs_get_vercheck_interval() * 60 * 60;
+    if (now - fetched >= max_age) {
+        return NULL;
     }
 
-    return realsize;
+    return release + 1;
 }
@@ -25,6 +25,9 @@
 
 #include <glib.h>
 
-char * release_get_latest(void);
+#include "http.h"
+
+void release_get_latest(gboolean use_cache, http_callback_t callback,
+    void *userdata);
 
 #endif
@@ -0,0 +1,148 @@
+/*
+ * send_queue.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "send_queue.h"
+
+// stanzas waiting to be written, as text, in a queue for each priority.
+// Stanzas of the same priority keep their order.  Persistent stanzas, the
+// messages, are kept when the connection is lost and sent after the
+// reconnect, the rest only make sense on the connection they were made for
+
+#define SEND_PRIORITIES (SEND_PRIORITY_CHAT_STATE + 1)
+
+typedef struct send_item_t {
+    char *text;
+    gboolean persist;
+} SendItem;
+
+static GQueue queues[SEND_PRIORITIES] = {
+    G_QUEUE_INIT, G_QUEUE_INIT, G_QUEUE_INIT
+};
+
+static void _item_free(SendItem *item);
+
+void
+send_queue_add(send_priority_t priority, const char * const text,
+    gboolean persist)
+{
+    SendItem *item = malloc(sizeof(SendItem));
+    item->text = strdup(text);
+    item->persist = persist;
+    g_queue_push_tail(&queues[priority], item);
+}
+
+/*
+ * Put back persistent stanzas that were sent but may not have arrived,
+ * oldest first, ahead of the other stanzas of their priority.  Frees texts
+ */
+void
+send_queue_requeue(GList *texts)
+{
+    GList *curr = g_list_last(texts);
+    while (curr != NULL) {
+        SendItem *item = malloc(sizeof(SendItem));
+        item->text = strdup(curr->data);
+        item->persist = TRUE;
+        g_queue_push_head(&queues[SEND_PRIORITY_STANZA], item);
+        curr = g_list_previous(curr);
+    }
+
+    g_list_free_full(texts, g_free);
+}
+
+/*
+ * The next stanza to send, or NULL if there are none.  The caller frees
+ * the text
+ */
+char *
+send_queue_pop(gboolean *persist)
+{
+    int i;
+    for (i = 0; i < SEND_PRIORITIES; i++) {
+        SendItem *item = g_queue_pop_head(&queues[i]);
+        if (item != NULL) {
+            char *text = item->text;
+            *persist = item->persist;
+            free(item);
+            return text;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Drop everything but the persistent stanzas, called when the connection
+ * is lost
+ */
+void
+send_queue_drop_transient(void)
+{
+    int i;
+    for (i = 0; i < SEND_PRIORITIES; i++) {
+        GList *curr = queues[i].head;
+        while (curr != NULL) {
+            GList *next = g_list_next(curr);
+            SendItem *item = curr->data;
+            if (!item->persist) {
+                g_queue_delete_link(&queues[i], curr);
+                _item_free(item);
+            }
+            curr = next;
+        }
+    }
+}
+
+void
+send_queue_clear(void)
+{
+    int i;
+    for (i = 0; i < SEND_PRIORITIES; i++) {
+        SendItem *item;
+        while ((item = g_queue_pop_head(&queues[i])) != NULL) {
+            _item_free(item);
+        }
+    }
+}
+
+guint
+send_queue_length(void)
+{
+    guint result = 0;
+    int i;
+    for (i = 0; i < SEND_PRIORITIES; i++) {
+        result += g_queue_get_length(&queues[i]);
+    }
+
+    return result;
+}
+
+static void
+_item_free(SendItem *item)
+{
+    free(item->text);
+    free(item);
+}
@@ -0,0 +1,42 @@
+/*
+ * send_queue.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef SEND_QUEUE_H
+#define SEND_QUEUE_H
+
+#include <glib.h>
+
+// highest priority first
+typedef enum {
+    SEND_PRIORITY_PING,
+    SEND_PRIORITY_STANZA,
+    SEND_PRIORITY_CHAT_STATE
+} send_priority_t;
+
+void send_queue_add(send_priority_t priority, const char * const text,
+    gboolean persist);
+void send_queue_requeue(GList *texts);
+char * send_queue_pop(gboolean *persist);
+void send_queue_drop_transient(void);
+void send_queue_clear(void);
+guint send_queue_length(void);
+
+#endif
@@ -20,6 +20,7 @@
  *
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -29,6 +30,21 @@
 #include "common.h"
 #include "stanza.h"
 
+// state while building a stanza from text, open elements innermost first
+typedef struct stanza_builder_t {
+    xmpp_ctx_t *ctx;
+    xmpp_stanza_t *root;
+    GSList *open;
+} StanzaBuilder;
+
+static void _builder_start(GMarkupParseContext *context,
+    const gchar *name, const gchar **attr_names, const gchar **attr_values,
+    gpointer user_data, GError **error);
+static void _builder_end(GMarkupParseContext *context, const gchar *name,
+    gpointer user_data, GError **error);
+static void _builder_text(GMarkupParseContext *context, const gchar *text,
+    gsize text_len, gpointer user_data, GError **error);
+
 xmpp_stanza_t *
 stanza_create_chat_state(xmpp_ctx_t *ctx, const char * const recipient,
     const char * const state)
@@ -161,7 +177,7 @@ stanza_create_presence(xmpp_ctx_t *ctx, const char * const show,
 }
 
 xmpp_stanza_t *
-stanza_create_roster_iq(xmpp_ctx_t *ctx)
+stanza_create_roster_iq(xmpp_ctx_t *ctx, const char * const ver)
 {
     xmpp_stanza_t *iq = xmpp_stanza_new(ctx);
     xmpp_stanza_set_name(iq, STANZA_NAME_IQ);
@@ -172,20 +188,34 @@ stanza_create_roster_iq(xmpp_ctx_t *ctx)
     xmpp_stanza_set_name(query, STANZA_NAME_QUERY);
     xmpp_stanza_set_ns(query, XMPP_NS_ROSTER);
 
+    // XEP-0237, the server only sends the roster if it has changed
+    if (ver != NULL) {
+        xmpp_stanza_set_attribute(query, STANZA_ATTR_VER, ver);
+    }
+
     xmpp_stanza_add_child(iq, query);
     xmpp_stanza_release(query);
 
     return iq;
 }
 
-gboolean
-stanza_contains_chat_state(xmpp_stanza_t *stanza)
+/*
+ * The name of the chat state element in stanza, e.g. "composing", or NULL
+ * if it has none
+ */
+char *
+stanza_get_chat_state(xmpp_stanza_t * const stanza)
 {
-    return ((xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_ACTIVE) != NULL) ||
-            (xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_COMPOSING) != NULL) ||
-            (xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_PAUSED) != NULL) ||
-            (xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_GONE) != NULL) ||
-            (xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_INACTIVE) != NULL));
+    xmpp_stanza_t *child = xmpp_stanza_get_children(stanza);
+    while (child != NULL) {
+        char *ns = xmpp_stanza_get_attribute(child, STANZA_ATTR_XMLNS);
+        if (g_strcmp0(ns, STANZA_NS_CHATSTATES) == 0) {
+            return xmpp_stanza_get_name(child);
+        }
+        child = xmpp_stanza_get_next(child);
+    }
+
+    return NULL;
 }
 
 xmpp_stanza_t *
@@ -207,6 +237,40 @@ stanza_create_ping_iq(xmpp_ctx_t *ctx)
     return iq;
 }
 
+xmpp_stanza_t *
+stanza_create_sm_enable(xmpp_ctx_t *ctx)
+{
+    xmpp_stanza_t *enable = xmpp_stanza_new(ctx);
+    xmpp_stanza_set_name(enable, STANZA_NAME_ENABLE);
+    xmpp_stanza_set_ns(enable, STANZA_NS_SM);
+
+    return enable;
+}
+
+xmpp_stanza_t *
+stanza_create_sm_request(xmpp_ctx_t *ctx)
+{
+    xmpp_stanza_t *request = xmpp_stanza_new(ctx);
+    xmpp_stanza_set_name(request, STANZA_NAME_R);
+    xmpp_stanza_set_ns(request, STANZA_NS_SM);
+
+    return request;
+}
+
+xmpp_stanza_t *
+stanza_create_sm_ack(xmpp_ctx_t *ctx, guint32 handled)
+{
+    xmpp_stanza_t *ack = xmpp_stanza_new(ctx);
+    xmpp_stanza_set_name(ack, STANZA_NAME_A);
+    xmpp_stanza_set_ns(ack, STANZA_NS_SM);
+
+    char handled_str[11];
+    snprintf(handled_str, sizeof(handled_str), "%u", handled);
+    xmpp_stanza_set_attribute(ack, STANZA_ATTR_H, handled_str);
+
+    return ack;
+}
+
 gboolean
 stanza_get_delay(xmpp_stanza_t * const stanza, GTimeVal *tv_stamp)
 {
@@ -391,3 +455,87 @@ stanza_get_idle_time(xmpp_stanza_t * const stanza)
         return result;
     }
 }
+
+/*
+ * Build a stanza from its XML text, as written by xmpp_stanza_to_text().
+ * Returns NULL if the text is not a single complete element.
+ * Used to replay recorded traces, libstrophe has no public parser.
+ */
+xmpp_stanza_t *
+stanza_from_text(xmpp_ctx_t *ctx, const char * const text)
+{
+    static const GMarkupParser parser = {
+        _builder_start, _builder_end, _builder_text, NULL, NULL
+    };
+
+    StanzaBuilder builder = { ctx, NULL, NULL };
+    GMarkupParseContext *context =
+        g_markup_parse_context_new(&parser, 0, &builder, NULL);
+
+    gboolean parsed = g_markup_parse_context_parse(context, text, -1, NULL)
+        && g_markup_parse_context_end_parse(context, NULL);
+    g_markup_parse_context_free(context);
+    g_slist_free(builder.open);
+
+    if (!parsed && builder.root != NULL) {
+        xmpp_stanza_release(builder.root);
+        builder.root = NULL;
+    }
+
+    return builder.root;
+}
+
+static void
+_builder_start(GMarkupParseContext *context, const gchar *name,
+    const gchar **attr_names, const gchar **attr_values, gpointer user_data,
+    GError **error)
+{
+    StanzaBuilder *builder = user_data;
+    xmpp_stanza_t *stanza = xmpp_stanza_new(builder->ctx);
+    xmpp_stanza_set_name(stanza, name);
+
+    int i;
+    for (i = 0; attr_names[i] != NULL; i++) {
+        xmpp_stanza_set_attribute(stanza, attr_names[i], attr_values[i]);
+    }
+
+    // the parent keeps its own reference
+    if (builder->open != NULL) {
+        xmpp_stanza_add_child(builder->open->data, stanza);
+        xmpp_stanza_release(stanza);
+    } else if (builder->root == NULL) {
+        builder->root = stanza;
+    } else {
+        xmpp_stanza_release(stanza);
+        g_set_error(error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+            "More than one stanza");
+        return;
+    }
+
+    builder->open = g_slist_prepend(builder->open, stanza);
+}
+
+static void
+_builder_end(GMarkupParseContext *context, const gchar *name,
+    gpointer user_data, GError **error)
+{
+    StanzaBuilder *builder = user_data;
+    builder->open = g_slist_delete_link(builder->open, builder->open);
+}
+
+static void
+_builder_text(GMarkupParseContext *context, const gchar *text,
+    gsize text_len, gpointer user_data, GError **error)
+{
+    StanzaBuilder *builder = user_data;
+    if (builder->open == NULL || text_len == 0) {
+        return;
+    }
+
+    char *copy = g_strndup(text, text_len);
+    xmpp_stanza_t *text_stanza = xmpp_stanza_new(builder->ctx);
+    xmpp_stanza_set_text(text_stanza, copy);
+    xmpp_stanza_add_child(builder->open->data, text_stanza);
+    xmpp_stanza_release(text_stanza);
+    g_free(copy);
+}
@@ -47,6 +47,11 @@
 #define STANZA_NAME_TEXT "text"
 #define STANZA_NAME_SUBJECT "subject"
 #define STANZA_NAME_ITEM "item"
+#define STANZA_NAME_ENABLE "enable"
+#define STANZA_NAME_ENABLED "enabled"
+#define STANZA_NAME_FAILED "failed"
+#define STANZA_NAME_R "r"
+#define STANZA_NAME_A "a"
 
 #define STANZA_TYPE_CHAT "chat"
 #define STANZA_TYPE_GROUPCHAT "groupchat"
@@ -72,6 +77,8 @@
 #define STANZA_ATTR_ASK "ask"
 #define STANZA_ATTR_ID "id"
 #define STANZA_ATTR_SECONDS "seconds"
+#define STANZA_ATTR_H "h"
+#define STANZA_ATTR_VER "ver"
 
 #define STANZA_TEXT_AWAY "away"
 #define STANZA_TEXT_DND "dnd"
@@ -84,6 +91,8 @@
 #define STANZA_NS_MUC_USER "http://jabber.org/protocol/muc#user"
 #define STANZA_NS_PING "urn:xmpp:ping"
 #define STANZA_NS_LASTACTIVITY "jabber:iq:last"
+#define STANZA_NS_SM "urn:xmpp:sm:3"
+#define STANZA_NS_ROSTERVER "urn:xmpp:features:rosterver"
 
 xmpp_stanza_t* stanza_create_chat_state(xmpp_ctx_t *ctx,
     const char * const recipient, const char * const state);
@@ -104,10 +113,15 @@ xmpp_stanza_t* stanza_create_room_leave_presence(xmpp_ctx_t *ctx,
 xmpp_stanza_t* stanza_create_presence(xmpp_ctx_t *ctx, const char * const show,
     const char * const status);
 
-xmpp_stanza_t* stanza_create_roster_iq(xmpp_ctx_t *ctx);
+xmpp_stanza_t* stanza_create_roster_iq(xmpp_ctx_t *ctx,
+    const char * const ver);
 xmpp_stanza_t* stanza_create_ping_iq(xmpp_ctx_t *ctx);
 
-gboolean stanza_contains_chat_state(xmpp_stanza_t *stanza);
+xmpp_stanza_t* stanza_create_sm_enable(xmpp_ctx_t *ctx);
+xmpp_stanza_t* stanza_create_sm_request(xmpp_ctx_t *ctx);
+xmpp_stanza_t* stanza_create_sm_ack(xmpp_ctx_t *ctx, guint32 handled);
+
+char* stanza_get_chat_state(xmpp_stanza_t * const stanza);
 
 gboolean stanza_get_delay(xmpp_stanza_t * const stanza, GTimeVal *tv_stamp);
 
@@ -119,4 +133,6 @@ char* stanza_get_new_nick(xmpp_stanza_t * const stanza);
 
 int stanza_get_idle_time(xmpp_stanza_t * const stanza);
 
+xmpp_stanza_t* stanza_from_text(xmpp_ctx_t *ctx, const char * const text);
+
 #endif
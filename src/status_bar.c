@@ -36,12 +36,17 @@
 
 static WINDOW *status_bar;
 static char *message = NULL;
+// only the first 10 windows have a slot, later windows are not shown
 static char _active[31] = "[ ][ ][ ][ ][ ][ ][ ][ ][ ][ ]";
 static int is_active[10];
 static int is_new[10];
 static int dirty;
 static GDateTime *last_time;
 
+// the spinner shown after a progress message, a frame every quarter second
+static const char *progress_frames = "|/-\\";
+#define PROGRESS_FRAME_US 250000
+
 static void _status_bar_update_time(void);
 
 void
@@ -120,6 +125,9 @@ status_bar_resize(void)
 void
 status_bar_inactive(const int win)
 {
+    if (win >= 10)
+        return;
+
     is_active[win] = FALSE;
     is_new[win] = FALSE;
 
@@ -135,6 +143,9 @@ status_bar_inactive(const int win)
 void
 status_bar_active(const int win)
 {
+    if (win >= 10)
+        return;
+
     is_active[win] = TRUE;
     is_new[win] = FALSE;
 
@@ -155,6 +166,9 @@ status_bar_active(const int win)
 void
 status_bar_new(const int win)
 {
+    if (win >= 10)
+        return;
+
     is_active[win] = TRUE;
     is_new[win] = TRUE;
 
@@ -212,6 +226,25 @@ status_bar_print_message(const char * const msg)
     dirty = TRUE;
 }
 
+/*
+ * Show msg with a spinner after it, call repeatedly while the operation is
+ * in progress.  The bar is only redrawn when the spinner moves on
+ */
+void
+status_bar_progress(const char * const msg)
+{
+    gint64 frame = g_get_monotonic_time() / PROGRESS_FRAME_US;
+    char *text = g_strdup_printf("%s %c", msg,
+        progress_frames[frame % strlen(progress_frames)]);
+
+    if (g_strcmp0(text, message) != 0) {
+        status_bar_print_message(text);
+        status_bar_refresh();
+    }
+
+    g_free(text);
+}
+
 void
 status_bar_clear(void)
 {
@@ -0,0 +1,174 @@
+/*
+ * stream_mgmt.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "stream_mgmt.h"
+
+// XEP-0198 stream management counts.  We count the stanzas we send from the
+// time we ask the server to enable it, and keep them until the server says
+// it has handled them, and count the stanzas we receive from the time the
+// server agrees.  Counts are modulo 2^32, as in the XEP
+
+static struct {
+    gboolean tracking;
+    gboolean enabled;
+    guint32 handled;
+    guint32 acked;
+    GQueue *unacked;
+} sm;
+
+/*
+ * Start counting sent stanzas, called when <enable/> is sent
+ */
+void
+stream_mgmt_start(void)
+{
+    stream_mgmt_stop();
+    sm.tracking = TRUE;
+    sm.unacked = g_queue_new();
+}
+
+/*
+ * Start counting received stanzas, called when <enabled/> is received
+ */
+void
+stream_mgmt_enabled(void)
+{
+    if (sm.tracking) {
+        sm.enabled = TRUE;
+        sm.handled = 0;
+    }
+}
+
+/*
+ * Stop counting, and forget any stanzas not yet acknowledged
+ */
+void
+stream_mgmt_stop(void)
+{
+    if (sm.unacked != NULL) {
+        g_queue_free_full(sm.unacked, g_free);
+        sm.unacked = NULL;
+    }
+    sm.tracking = FALSE;
+    sm.enabled = FALSE;
+    sm.handled = 0;
+    sm.acked = 0;
+}
+
+gboolean
+stream_mgmt_is_tracking(void)
+{
+    return sm.tracking;
+}
+
+gboolean
+stream_mgmt_is_enabled(void)
+{
+    return sm.enabled;
+}
+
+/*
+ * Count a sent stanza, stanza is the text to send again if the connection
+ * is lost before the server handles it, or NULL if it should not be sent
+ * again
+ */
+void
+stream_mgmt_sent(const char * const stanza)
+{
+    if (sm.tracking) {
+        g_queue_push_tail(sm.unacked, g_strdup(stanza));
+    }
+}
+
+void
+stream_mgmt_received(void)
+{
+    if (sm.enabled) {
+        sm.handled++;
+    }
+}
+
+guint32
+stream_mgmt_get_handled(void)
+{
+    return sm.handled;
+}
+
+/*
+ * The server has handled the first handled stanzas we sent.  Returns FALSE
+ * if that is more than we have sent
+ */
+gboolean
+stream_mgmt_acked(guint32 handled)
+{
+    if (!sm.tracking) {
+        return TRUE;
+    }
+
+    guint32 count = handled - sm.acked;
+    if (count > g_queue_get_length(sm.unacked)) {
+        return FALSE;
+    }
+
+    while (count-- > 0) {
+        g_free(g_queue_pop_head(sm.unacked));
+    }
+    sm.acked = handled;
+
+    return TRUE;
+}
+
+guint
+stream_mgmt_unacked(void)
+{
+    if (sm.unacked == NULL) {
+        return 0;
+    }
+
+    return g_queue_get_length(sm.unacked);
+}
+
+/*
+ * The stanzas sent but not acknowledged that should be sent again, oldest
+ * first, and stop counting.  Free the list with g_list_free_full(list, g_free)
+ */
+GList *
+stream_mgmt_take_unacked(void)
+{
+    GList *result = NULL;
+
+    if (sm.unacked != NULL) {
+        while (!g_queue_is_empty(sm.unacked)) {
+            char *stanza = g_queue_pop_head(sm.unacked);
+            if (stanza != NULL) {
+                result = g_list_prepend(result, stanza);
+            }
+        }
+    }
+    stream_mgmt_stop();
+
+    return g_list_reverse(result);
+}
@@ -0,0 +1,39 @@
+/*
+ * stream_mgmt.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef STREAM_MGMT_H
+#define STREAM_MGMT_H
+
+#include <glib.h>
+
+void stream_mgmt_start(void);
+void stream_mgmt_enabled(void);
+void stream_mgmt_stop(void);
+gboolean stream_mgmt_is_tracking(void);
+gboolean stream_mgmt_is_enabled(void);
+void stream_mgmt_sent(const char * const stanza);
+void stream_mgmt_received(void);
+guint32 stream_mgmt_get_handled(void);
+gboolean stream_mgmt_acked(guint32 handled);
+guint stream_mgmt_unacked(void);
+GList * stream_mgmt_take_unacked(void);
+
+#endif
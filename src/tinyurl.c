@@ -24,65 +24,75 @@
 #include <string.h>
 
 #include <glib.h>
-#include <curl/curl.h>
-#include <curl/easy.h>
 
-struct curl_data_t
-{
-    char *buffer;
-    size_t size;
-};
+#include "cache.h"
+#include "http.h"
+#include "tinyurl.h"
+
+#define TINYURL_TIMEOUT 10
+
+// short urls do not change, so they are kept for a month
+#define TINYURL_TTL (30 * 24 * 60 * 60)
+
+typedef struct tinyurl_request_t {
+    char *key;
+    http_callback_t callback;
+    void *userdata;
+} TinyurlRequest;
 
-static size_t _data_callback(void *ptr, size_t size, size_t nmemb, void *data);
+static void _tinyurl_done(const char * const tiny, void *userdata);
 
 gboolean
-tinyurl_valid(char *url)
+tinyurl_valid(const char * const url)
 {
     return (g_str_has_prefix(url, "http://") ||
         g_str_has_prefix(url, "https://"));
 }
 
-char *
-tinyurl_get(char *url)
+/*
+ * Ask tinyurl.com for a short url in the background, callback is called
+ * with the short url, or NULL if it could not be fetched.  Urls shortened
+ * before are taken from the cache, and callback is called straight away
+ */
+void
+tinyurl_get(char *url, http_callback_t callback, void *userdata)
 {
-    GString *full_url = g_string_new("http://tinyurl.com/api-create.php?url=");
-    g_string_append(full_url, url);
+    char *key = g_strconcat("tinyurl ", url, NULL);
+    const char *cached = cache_get(key);
 
-    CURL *handle = curl_easy_init();
-    struct curl_data_t output;
-    output.buffer = NULL;
-    output.size = 0;
+    if (cached != NULL) {
+        callback(cached, userdata);
+        g_free(key);
+        return;
+    }
 
-    curl_easy_setopt(handle, CURLOPT_URL, full_url->str);
-    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, _data_callback);
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, (void *)&output);
+    TinyurlRequest *request = malloc(sizeof(TinyurlRequest));
+    request->key = key;
+    request->callback = callback;
+    request->userdata = userdata;
 
-    curl_easy_perform(handle);
-    curl_easy_cleanup(handle);
+    GString *full_url = g_string_new("http://tinyurl.com/api-create.php?url=");
+    char *escaped = g_uri_escape_string(url, NULL, FALSE);
+    g_string_append(full_url, escaped);
 
-    g_string_free(full_url, TRUE);
+    http_get(full_url->str, TINYURL_TIMEOUT, _tinyurl_done, request);
 
-    if (output.buffer != NULL) {
-        output.buffer[output.size++] = '\0';
-        return output.buffer;
-    } else {
-        return NULL;
-    }
+    g_free(escaped);
+    g_string_free(full_url, TRUE);
 }
 
-static size_t
-_data_callback(void *ptr, size_t size, size_t nmemb, void *data)
+static void
+_tinyurl_done(const char * const tiny, void *userdata)
 {
-    size_t realsize = size * nmemb;
-    struct curl_data_t *mem = (struct curl_data_t *) data;
-    mem->buffer = realloc(mem->buffer, mem->size + realsize + 1);
-
-    if ( mem->buffer )
-    {
-        memcpy( &( mem->buffer[ mem->size ] ), ptr, realsize );
-        mem->size += realsize;
-        mem->buffer[ mem->size ] = 0;
+    TinyurlRequest *request = userdata;
+
+    if (tiny != NULL && tinyurl_valid(tiny)) {
+        cache_put(request->key, tiny, TINYURL_TTL);
+        request->callback(tiny, request->userdata);
+    } else {
+        request->callback(NULL, request->userdata);
     }
 
-    return realsize;
+    g_free(request->key);
+    free(request);
 }
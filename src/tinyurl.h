@@ -25,7 +25,9 @@
 
 #include <glib.h>
 
-gboolean tinyurl_valid(char *url);
-char * tinyurl_get(char *url);
+#include "http.h"
+
+gboolean tinyurl_valid(const char * const url);
+void tinyurl_get(char *url, http_callback_t callback, void *userdata);
 
 #endif
@@ -0,0 +1,360 @@
+/*
+ * trace.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+
+#include <glib.h>
+
+#include "common.h"
+#include "trace.h"
+
+/*
+ * A trace is a text file with one inbound stanza per line, as received by
+ * libstrophe, preceded by the milliseconds since the previous one:
+ *
+ *     # profanity trace
+ *     jid someone@server.org/profanity
+ *     +0 <iq id="roster" type="result">...</iq>
+ *     +153 <message type="chat" from="...">...</message>
+ *
+ * Line breaks within a stanza are written as character references so every
+ * stanza stays on one line.  A jid line is written whenever the connected
+ * account changes.
+ */
+
+typedef struct stat_t {
+    guint count;
+    gdouble total;
+    GArray *samples;
+    glong heap;
+} Stat;
+
+static FILE *record_file = NULL;
+static GTimer *record_timer = NULL;
+static char *record_jid = NULL;
+
+static FILE *replay_file = NULL;
+static char *replay_jid = NULL;
+
+static GHashTable *stats = NULL;
+static GTimer *stat_timer = NULL;
+static GTimer *replay_timer = NULL;
+static glong stat_heap = 0;
+static guint replayed = 0;
+static guint skipped = 0;
+
+static glong _heap_used(void);
+static void _stat_free(Stat *stat);
+static gint _compare_doubles(gconstpointer a, gconstpointer b);
+static gdouble _percentile(GArray *samples, int pct);
+
+gboolean
+trace_record_open(const char * const path)
+{
+    trace_record_close();
+
+    record_file = fopen(path, "w");
+    if (record_file == NULL) {
+        return FALSE;
+    }
+
+    fputs("# profanity trace\n", record_file);
+    record_timer = g_timer_new();
+
+    return TRUE;
+}
+
+gboolean
+trace_recording(void)
+{
+    return (record_file != NULL);
+}
+
+/*
+ * Append a stanza received on the connection for jid
+ */
+void
+trace_record(const char * const jid, const char * const stanza)
+{
+    if (record_file == NULL) {
+        return;
+    }
+
+    if (jid != NULL && g_strcmp0(jid, record_jid) != 0) {
+        free(record_jid);
+        record_jid = strdup(jid);
+        fprintf(record_file, "jid %s\n", jid);
+    }
+
+    gulong delay_ms = g_timer_elapsed(record_timer, NULL) * 1000;
+    g_timer_start(record_timer);
+    fprintf(record_file, "+%lu ", delay_ms);
+
+    const char *curr;
+    for (curr = stanza; *curr != '\0'; curr++) {
+        if (*curr == '\n') {
+            fputs("&#10;", record_file);
+        } else if (*curr == '\r') {
+            fputs("&#13;", record_file);
+        } else {
+            fputc(*curr, record_file);
+        }
+    }
+    fputc('\n', record_file);
+
+    // a trace is most useful when something went wrong, so don't lose it
+    fflush(record_file);
+}
+
+void
+trace_record_close(void)
+{
+    if (record_file != NULL) {
+        fclose(record_file);
+        record_file = NULL;
+    }
+    if (record_timer != NULL) {
+        g_timer_destroy(record_timer);
+        record_timer = NULL;
+    }
+    FREE_SET_NULL(record_jid);
+}
+
+gboolean
+trace_replay_open(const char * const path)
+{
+    trace_replay_close();
+
+    replay_file = fopen(path, "r");
+    if (replay_file == NULL) {
+        return FALSE;
+    }
+
+    replay_timer = g_timer_new();
+
+    return TRUE;
+}
+
+/*
+ * Return the next stanza in the trace and the milliseconds it arrived
+ * after the previous one, or NULL at the end.  The caller frees the result.
+ */
+char *
+trace_replay_next(gulong *delay_ms)
+{
+    if (replay_file == NULL) {
+        return NULL;
+    }
+
+    char *line;
+    while ((line = prof_getline(replay_file)) != NULL) {
+        if (line[0] == '+') {
+            char *stanza = NULL;
+            *delay_ms = strtoul(line + 1, &stanza, 10);
+            if (*stanza == ' ') {
+                char *result = strdup(stanza + 1);
+                free(line);
+                replayed++;
+                return result;
+            }
+        } else if (strncmp(line, "jid ", 4) == 0) {
+            free(replay_jid);
+            replay_jid = strdup(line + 4);
+        }
+
+        free(line);
+    }
+
+    return NULL;
+}
+
+/*
+ * The jid the last stanza returned was received for
+ */
+const char *
+trace_replay_jid(void)
+{
+    return replay_jid;
+}
+
+void
+trace_replay_close(void)
+{
+    if (replay_file != NULL) {
+        fclose(replay_file);
+        replay_file = NULL;
+    }
+    FREE_SET_NULL(replay_jid);
+}
+
+/*
+ * Time, and measure the heap growth of, the code between trace_stat_start
+ * and trace_stat_end, adding it to the statistics for name
+ */
+void
+trace_stat_start(void)
+{
+    if (stats == NULL) {
+        stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            (GDestroyNotify)_stat_free);
+        stat_timer = g_timer_new();
+    }
+
+    stat_heap = _heap_used();
+    g_timer_start(stat_timer);
+}
+
+void
+trace_stat_end(const char * const name)
+{
+    gdouble elapsed = g_timer_elapsed(stat_timer, NULL);
+    glong heap = _heap_used() - stat_heap;
+
+    Stat *stat = g_hash_table_lookup(stats, name);
+    if (stat == NULL) {
+        stat = malloc(sizeof(Stat));
+        stat->count = 0;
+        stat->total = 0;
+        stat->samples = g_array_new(FALSE, FALSE, sizeof(gdouble));
+        stat->heap = 0;
+        g_hash_table_insert(stats, g_strdup(name), stat);
+    }
+
+    stat->count++;
+    stat->total += elapsed;
+    stat->heap += heap;
+    g_array_append_val(stat->samples, elapsed);
+}
+
+/*
+ * Count a stanza that no handler took
+ */
+void
+trace_stat_skipped(void)
+{
+    skipped++;
+}
+
+void
+trace_stat_report(FILE *stream)
+{
+    GList *names = NULL;
+    if (stats != NULL) {
+        names = g_list_sort(g_hash_table_get_keys(stats),
+            (GCompareFunc)g_strcmp0);
+    }
+
+    gdouble wall = 0;
+    if (replay_timer != NULL) {
+        wall = g_timer_elapsed(replay_timer, NULL);
+    }
+    fprintf(stream, "Replayed %u stanzas in %.2f s, %u not handled\n\n",
+        replayed, wall, skipped);
+
+    fprintf(stream, "%-24s %8s %10s %9s %9s %9s %9s %10s\n", "handler",
+        "count", "total ms", "mean us", "p50 us", "p99 us", "max us",
+        "heap kB");
+
+    GList *curr = names;
+    while (curr != NULL) {
+        Stat *stat = g_hash_table_lookup(stats, curr->data);
+        g_array_sort(stat->samples, _compare_doubles);
+        fprintf(stream, "%-24s %8u %10.2f %9.1f %9.1f %9.1f %9.1f %+10.1f\n",
+            (char *)curr->data, stat->count, stat->total * 1e3,
+            stat->total * 1e6 / stat->count,
+            _percentile(stat->samples, 50) * 1e6,
+            _percentile(stat->samples, 99) * 1e6,
+            _percentile(stat->samples, 100) * 1e6,
+            stat->heap / 1024.0);
+        curr = g_list_next(curr);
+    }
+
+    g_list_free(names);
+}
+
+void
+trace_stat_clear(void)
+{
+    if (stats != NULL) {
+        g_hash_table_destroy(stats);
+        stats = NULL;
+        g_timer_destroy(stat_timer);
+        stat_timer = NULL;
+    }
+    if (replay_timer != NULL) {
+        g_timer_destroy(replay_timer);
+        replay_timer = NULL;
+    }
+    replayed = 0;
+    skipped = 0;
+}
+
+// bytes allocated on the heap, 0 where the C library can't tell us
+static glong
+_heap_used(void)
+{
+#if defined(HAVE_MALLINFO2)
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#elif defined(HAVE_MALLINFO)
+    struct mallinfo info = mallinfo();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static void
+_stat_free(Stat *stat)
+{
+    g_array_free(stat->samples, TRUE);
+    free(stat);
+}
+
+static gint
+_compare_doubles(gconstpointer a, gconstpointer b)
+{
+    gdouble da = *(const gdouble *)a;
+    gdouble db = *(const gdouble *)b;
+
+    return (da > db) - (da < db);
+}
+
+// samples must be sorted
+static gdouble
+_percentile(GArray *samples, int pct)
+{
+    if (samples->len == 0) {
+        return 0;
+    }
+
+    guint index = (samples->len - 1) * pct / 100;
+    return g_array_index(samples, gdouble, index);
+}
@@ -0,0 +1,46 @@
+/*
+ * trace.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+
+#include <glib.h>
+
+gboolean trace_record_open(const char * const path);
+gboolean trace_recording(void);
+void trace_record(const char * const jid, const char * const stanza);
+void trace_record_close(void);
+
+gboolean trace_replay_open(const char * const path);
+char * trace_replay_next(gulong *delay_ms);
+const char * trace_replay_jid(void);
+void trace_replay_close(void);
+
+void trace_stat_start(void);
+void trace_stat_end(const char * const name);
+void trace_stat_skipped(void);
+void trace_stat_report(FILE *stream);
+void trace_stat_clear(void);
+
+#endif
@@ -37,7 +37,6 @@
 
 #include "jabber.h"
 
-#define INP_WIN_MAX 1000
 #define PAD_SIZE 1000
 
 typedef enum {
@@ -60,15 +59,13 @@ struct prof_win {
 
 // gui startup and shutdown, resize
 void ui_init(void);
+void ui_init_headless(void);
 void ui_load_colours(void);
 void ui_refresh(void);
 void ui_close(void);
-void ui_resize(const int ch, const char * const input,
-    const int size);
+void ui_resize(const int ch);
 void ui_show_typing(const char * const from);
-void ui_idle(void);
-void ui_show_incoming_msg(const char * const from, const char * const message,
-    GTimeVal *tv_stamp, gboolean priv);
+void ui_show_incoming_msg(const ProfMessage * const message);
 void ui_contact_online(const char * const from, const char * const show,
     const char * const status, GDateTime *last_activity);
 void ui_contact_offline(const char * const from, const char * const show,
@@ -76,7 +73,7 @@ void ui_contact_offline(const char * const from, const char * const show,
 void ui_disconnected(void);
 void ui_handle_special_keys(const wint_t * const ch);
 void ui_switch_win(const int i);
-gboolean ui_windows_full(void);
+gboolean ui_win_exists(const int index);
 unsigned long ui_get_idle_time(void);
 void ui_reset_idle_time(void);
 
@@ -166,20 +163,23 @@ void status_bar_clear(void);
 void status_bar_clear_message(void);
 void status_bar_get_password(void);
 void status_bar_print_message(const char * const msg);
+void status_bar_progress(const char * const msg);
 void status_bar_inactive(const int win);
 void status_bar_active(const int win);
 void status_bar_new(const int win);
 void status_bar_update_time(void);
 
 // input window actions
-wint_t inp_get_char(char *input, int *size);
+wint_t inp_get_char(void);
+char * inp_get_line(void);
 void inp_win_reset(void);
-void inp_win_resize(const char * input, const int size);
+void inp_win_resize(void);
 void inp_put_back(void);
 void inp_non_block(void);
 void inp_block(void);
 void inp_get_password(char *passwd);
-void inp_replace_input(char *input, const char * const new_input, int *size);
+void inp_replace_input(const char * const new_input);
+void inp_close(void);
 
 void notify_remind(void);
 #endif
@@ -38,6 +38,19 @@
 
 #define CONS_WIN_TITLE "_cons"
 
+// output held back while the window is not being displayed
+typedef struct pending_out_t {
+    int attrs;
+    char *str;
+    GDateTime *time;
+    int lines;
+} PendingOut;
+
+static void _defer(ProfWin *window, PendingOut *out);
+static void _print(WINDOW *win, int attrs, const char * const str);
+static void _print_time(WINDOW *win, GDateTime *time);
+static void _free_pending_out(PendingOut *out);
+
 ProfWin*
 window_create(const char * const title, int cols, win_type_t type)
 {
@@ -50,6 +63,10 @@ window_create(const char * const title, int cols, win_type_t type)
     new_win->unread = 0;
     new_win->history_shown = 0;
     new_win->type = type;
+    new_win->deferred = 0;
+    new_win->pending = g_queue_new();
+    new_win->pending_lines = 0;
+    new_win->draft = NULL;
     scrollok(new_win->win, TRUE);
 
     return new_win;
@@ -62,6 +79,123 @@ window_free(ProfWin* window)
     free(window->from);
     window->from = NULL;
     window->win = NULL;
+    g_queue_free_full(window->pending, (GDestroyNotify)_free_pending_out);
+    window->pending = NULL;
+    free(window->draft);
+    window->draft = NULL;
     free(window);
     window = NULL;
 }
+
+void
+window_print(ProfWin *window, int attrs, const char * const msg, ...)
+{
+    va_list arg;
+    va_start(arg, msg);
+    GString *fmt_msg = g_string_new(NULL);
+    g_string_vprintf(fmt_msg, msg, arg);
+    va_end(arg);
+
+    if (window->deferred) {
+        PendingOut *out = malloc(sizeof(PendingOut));
+        out->attrs = attrs;
+        out->time = NULL;
+        out->lines = 0;
+        char *pos = fmt_msg->str;
+        while ((pos = strchr(pos, '\n')) != NULL) {
+            out->lines++;
+            pos++;
+        }
+        out->str = g_string_free(fmt_msg, FALSE);
+        _defer(window, out);
+    } else {
+        _print(window->win, attrs, fmt_msg->str);
+        g_string_free(fmt_msg, TRUE);
+    }
+}
+
+void
+window_print_time(ProfWin *window, GDateTime *time)
+{
+    if (window->deferred) {
+        PendingOut *out = malloc(sizeof(PendingOut));
+        out->attrs = 0;
+        out->str = NULL;
+        out->time = g_date_time_ref(time);
+        out->lines = 0;
+        _defer(window, out);
+    } else {
+        _print_time(window->win, time);
+    }
+}
+
+/*
+ * Windows not being displayed are deferred, output is queued rather than
+ * drawn to the pad. Clearing the flag draws the queued output.
+ */
+void
+window_set_deferred(ProfWin *window, int deferred)
+{
+    if (!deferred) {
+        PendingOut *out;
+        while ((out = g_queue_pop_head(window->pending)) != NULL) {
+            if (out->time != NULL) {
+                _print_time(window->win, out->time);
+            } else {
+                _print(window->win, out->attrs, out->str);
+            }
+            _free_pending_out(out);
+        }
+        window->pending_lines = 0;
+    }
+
+    window->deferred = deferred;
+}
+
+static void
+_defer(ProfWin *window, PendingOut *out)
+{
+    g_queue_push_tail(window->pending, out);
+    window->pending_lines += out->lines;
+
+    // anything more than a pad full would scroll out before being seen
+    while (window->pending_lines > PAD_SIZE) {
+        PendingOut *oldest = g_queue_pop_head(window->pending);
+        window->pending_lines -= oldest->lines;
+        _free_pending_out(oldest);
+    }
+}
+
+static void
+_print(WINDOW *win, int attrs, const char * const str)
+{
+    if (attrs != 0) {
+        wattron(win, attrs);
+    }
+    wprintw(win, "%s", str);
+    if (attrs != 0) {
+        wattroff(win, attrs);
+    }
+}
+
+static void
+_print_time(WINDOW *win, GDateTime *time)
+{
+    gchar *date_fmt = g_date_time_format(time, "%H:%M:%S");
+    wattron(win, COLOUR_TIME);
+    wprintw(win, "%s - ", date_fmt);
+    wattroff(win, COLOUR_TIME);
+    g_free(date_fmt);
+}
+
+static void
+_free_pending_out(PendingOut *out)
+{
+    if (out != NULL) {
+        g_free(out->str);
+        if (out->time != NULL) {
+            g_date_time_unref(out->time);
+        }
+        free(out);
+    }
+}
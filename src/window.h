@@ -23,6 +23,8 @@
 #ifndef WINDOW_H
 #define WINDOW_H
 
+#include <glib.h>
+
 #include "ui.h"
 
 typedef struct prof_win_t {
@@ -33,10 +35,17 @@ typedef struct prof_win_t {
     int paged;
     int unread;
     int history_shown;
+    int deferred;
+    GQueue *pending;
+    int pending_lines;
+    char *draft;
 } ProfWin;
 
 
 ProfWin* window_create(const char * const title, int cols, win_type_t type);
 void window_free(ProfWin *window);
+void window_print(ProfWin *window, int attrs, const char * const msg, ...);
+void window_print_time(ProfWin *window, GDateTime *time);
+void window_set_deferred(ProfWin *window, int deferred);
 
 #endif
@@ -22,6 +22,7 @@
 
 #include "config.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -45,7 +46,6 @@
 #endif
 
 #include "chat_log.h"
-#include "chat_session.h"
 #include "command.h"
 #include "common.h"
 #include "contact.h"
@@ -53,6 +53,7 @@
 #include "jid.h"
 #include "log.h"
 #include "preferences.h"
+#include "reconnect.h"
 #include "release.h"
 #include "muc.h"
 #include "theme.h"
@@ -60,10 +61,17 @@
 #include "window.h"
 
 #define CONS_WIN_TITLE "_cons"
-#define NUM_WINS 10
+#define WIN_NOT_FOUND -1
 
-// holds console at index 0 and chat wins 1 through to 9
-static ProfWin* windows[NUM_WINS];
+// holds console at index 0 and chat wins from index 1, the slot of a closed
+// window is set to NULL and reused by the next new window
+static GPtrArray *windows;
+
+// recipient -> window index, so incoming stanzas are routed without scanning
+static GHashTable *win_indexes;
+
+// sum of unread messages in all windows
+static gint unread_total = 0;
 
 // the window currently being displayed
 static int current_index = 0;
@@ -84,19 +92,26 @@ static Display *display;
 
 static GTimer *ui_idle_time;
 
+static void _ui_setup(void);
 static void _set_current(int index);
+static void _swap_draft(ProfWin *old_win, ProfWin *new_win);
 static void _create_windows(void);
 static void _cons_splash_logo(void);
 static void _cons_show_basic_help(void);
 static void _cons_show_contact(PContact contact);
 static int _find_prof_win_index(const char * const contact);
 static int _new_prof_win(const char * const contact, win_type_t type);
+static ProfWin * _get_prof_win(const int index);
+static void _win_inc_unread(ProfWin *window);
+static void _win_clear_unread(ProfWin *window);
 static void _current_window_refresh(void);
 static void _win_show_time(WINDOW *win);
-static void _win_show_user(WINDOW *win, const char * const user, const int colour);
-static void _win_show_message(WINDOW *win, const char * const message);
-static void _win_show_error_msg(WINDOW *win, const char * const message);
-static void _show_status_string(WINDOW *win, const char * const from,
+static void _win_print_time(ProfWin *window, GTimeVal *tv_stamp);
+static void _win_show_user(ProfWin *window, const char * const user, const int colour);
+static void _win_show_message(ProfWin *window, const char * const message);
+static void _win_show_error_msg(ProfWin *window, const char * const message);
+static int _presence_colour(const char * const show);
+static void _show_status_string(ProfWin *window, const char * const from,
     const char * const show, const char * const status,
     GDateTime *last_activity, const char * const pre,
     const char * const default_show);
@@ -107,9 +122,10 @@ static void _win_handle_switch(const wint_t * const ch);
 static void _win_handle_page(const wint_t * const ch);
 static void _win_resize_all(void);
 static gint _win_get_unread(void);
-static void _win_show_history(WINDOW *win, int win_index,
-    const char * const contact);
-static gboolean _new_release(char *found_version);
+static void _win_show_history(ProfWin *window, const char * const contact);
+static gboolean _new_release(const char * const found_version);
+static void _cons_version_done(const char * const latest_release,
+    void *userdata);
 static void _ui_draw_win_title(void);
 
 static void _notify(const char * const message, int timeout,
@@ -123,6 +139,28 @@ ui_init(void)
 {
     log_info("Initialising UI");
     initscr();
+    _ui_setup();
+}
+
+/*
+ * Initialise the UI for batch mode, the windows are kept up to date but
+ * drawn to /dev/null, so no terminal is needed
+ */
+void
+ui_init_headless(void)
+{
+    log_info("Initialising UI without a terminal");
+    FILE *null = fopen("/dev/null", "r+");
+    if ((null == NULL) || (newterm("dumb", null, null) == NULL)) {
+        log_error("Could not initialise UI without a terminal");
+        exit(1);
+    }
+    _ui_setup();
+}
+
+static void
+_ui_setup(void)
+{
     raw();
     keypad(stdscr, TRUE);
     mousemask(ALL_MOUSE_EVENTS, NULL);
@@ -232,17 +270,18 @@ ui_close(void)
         notify_uninit();
     }
 #endif
+    inp_close();
     endwin();
 }
 
 void
-ui_resize(const int ch, const char * const input, const int size)
+ui_resize(const int ch)
 {
     log_info("Resizing UI");
     title_bar_resize();
     status_bar_resize();
     _win_resize_all();
-    inp_win_resize(input, size);
+    inp_win_resize();
     dirty = TRUE;
 }
 
@@ -257,16 +296,9 @@ ui_load_colours(void)
 }
 
 gboolean
-ui_windows_full(void)
+ui_win_exists(const int index)
 {
-    int i;
-    for (i = 1; i < NUM_WINS; i++) {
-        if (windows[i] == NULL) {
-            return FALSE;
-        }
-    }
-
-    return TRUE;
+    return (_get_prof_win(index) != NULL);
 }
 
 void
@@ -276,7 +308,7 @@ ui_show_typing(const char * const from)
 
     if (prefs_get_intype()) {
         // no chat window for user
-        if (win_index == NUM_WINS) {
+        if (win_index == WIN_NOT_FOUND) {
             _cons_show_typing(from);
 
         // have chat window but not currently in it
@@ -299,171 +331,71 @@ ui_show_typing(const char * const from)
 }
 
 void
-ui_idle(void)
+ui_show_incoming_msg(const ProfMessage * const message)
 {
-    int i;
-
-    // loop through regular chat windows and update states
-    for (i = 1; i < NUM_WINS; i++) {
-        if ((windows[i] != NULL) && (windows[i]->type == WIN_CHAT)) {
-            char *recipient = windows[i]->from;
-            chat_session_no_activity(recipient);
-
-            if (chat_session_is_gone(recipient) &&
-                    !chat_session_get_sent(recipient)) {
-                jabber_send_gone(recipient);
-            } else if (chat_session_is_inactive(recipient) &&
-                    !chat_session_get_sent(recipient)) {
-                jabber_send_inactive(recipient);
-            } else if (prefs_get_outtype() &&
-                    chat_session_is_paused(recipient) &&
-                    !chat_session_get_sent(recipient)) {
-                jabber_send_paused(recipient);
-            }
-        }
-    }
-}
-
-void
-ui_show_incoming_msg(const char * const from, const char * const message,
-    GTimeVal *tv_stamp, gboolean priv)
-{
-    char *display_from;
+    const char *from = message->from;
+    const char *display_from;
     win_type_t win_type;
-    if (priv) {
+    if (message->priv) {
         win_type = WIN_PRIVATE;
-        display_from = get_nick_from_full_jid(from);
+        display_from = message->from_jid->resourcepart;
     } else {
         win_type = WIN_CHAT;
-        display_from = strdup(from);
+        display_from = from;
     }
 
     int win_index = _find_prof_win_index(from);
-    if (win_index == NUM_WINS)
+    if (win_index == WIN_NOT_FOUND)
         win_index = _new_prof_win(from, win_type);
 
-    // no spare windows left
-    if (win_index == 0) {
-        if (tv_stamp == NULL) {
-            _win_show_time(console->win);
-        } else {
-            GDateTime *time = g_date_time_new_from_timeval_utc(tv_stamp);
-            gchar *date_fmt = g_date_time_format(time, "%H:%M:%S");
-            wattron(console->win, COLOUR_TIME);
-            wprintw(console->win, "%s - ", date_fmt);
-            wattroff(console->win, COLOUR_TIME);
-            g_date_time_unref(time);
-            g_free(date_fmt);
-        }
+    ProfWin *window = _get_prof_win(win_index);
 
-        if (strncmp(message, "/me ", 4) == 0) {
-            wattron(console->win, COLOUR_THEM);
-            wprintw(console->win, "*%s ", from);
-            wprintw(console->win, message + 4);
-            wprintw(console->win, "\n");
-            wattroff(console->win, COLOUR_THEM);
-        } else {
-            _win_show_user(console->win, from, 1);
-            _win_show_message(console->win, message);
-        }
+    // currently viewing chat window with sender
+    if (win_index == current_index) {
+        title_bar_set_typing(FALSE);
+        title_bar_draw();
+        status_bar_active(win_index);
+        dirty = TRUE;
 
-        cons_bad_show("Windows all used, close a window to respond.");
+    // not currently viewing chat window with sender
+    } else {
+        status_bar_new(win_index);
+        _cons_show_incoming_message(from, win_index);
+        if (prefs_get_flash())
+            flash();
 
-        if (current_index == 0) {
-           dirty = TRUE;
-        } else {
-            status_bar_new(0);
+        _win_inc_unread(window);
+        if (prefs_get_chlog() && prefs_get_history()) {
+            _win_show_history(window, from);
         }
+    }
 
-    // window found or created
+    window_print_time(window, message->timestamp);
+    if (strncmp(message->body, "/me ", 4) == 0) {
+        window_print(window, COLOUR_THEM, "*%s %s\n", display_from,
+            message->body + 4);
     } else {
-        WINDOW *win = windows[win_index]->win;
-
-        // currently viewing chat window with sender
-        if (win_index == current_index) {
-            if (tv_stamp == NULL) {
-                _win_show_time(win);
-            } else {
-                GDateTime *time = g_date_time_new_from_timeval_utc(tv_stamp);
-                gchar *date_fmt = g_date_time_format(time, "%H:%M:%S");
-                wattron(win, COLOUR_TIME);
-                wprintw(win, "%s - ", date_fmt);
-                wattroff(win, COLOUR_TIME);
-                g_date_time_unref(time);
-                g_free(date_fmt);
-            }
-
-            if (strncmp(message, "/me ", 4) == 0) {
-                wattron(win, COLOUR_THEM);
-                wprintw(win, "*%s ", display_from);
-                wprintw(win, message + 4);
-                wprintw(win, "\n");
-                wattroff(win, COLOUR_THEM);
-            } else {
-                _win_show_user(win, display_from, 1);
-                _win_show_message(win, message);
-            }
-            title_bar_set_typing(FALSE);
-            title_bar_draw();
-            status_bar_active(win_index);
-            dirty = TRUE;
-
-        // not currently viewing chat window with sender
-        } else {
-            status_bar_new(win_index);
-            _cons_show_incoming_message(from, win_index);
-            if (prefs_get_flash())
-                flash();
-
-            windows[win_index]->unread++;
-            if (prefs_get_chlog() && prefs_get_history()) {
-                _win_show_history(win, win_index, from);
-            }
-
-            if (tv_stamp == NULL) {
-                _win_show_time(win);
-            } else {
-                GDateTime *time = g_date_time_new_from_timeval_utc(tv_stamp);
-                gchar *date_fmt = g_date_time_format(time, "%H:%M:%S");
-                wattron(win, COLOUR_TIME);
-                wprintw(win, "%s - ", date_fmt);
-                wattroff(win, COLOUR_TIME);
-                g_date_time_unref(time);
-                g_free(date_fmt);
-            }
-
-            if (strncmp(message, "/me ", 4) == 0) {
-                wattron(win, COLOUR_THEM);
-                wprintw(win, "*%s ", display_from);
-                wprintw(win, message + 4);
-                wprintw(win, "\n");
-                wattroff(win, COLOUR_THEM);
-            } else {
-                _win_show_user(win, display_from, 1);
-                _win_show_message(win, message);
-            }
-        }
+        _win_show_user(window, display_from, 1);
+        _win_show_message(window, message->body);
     }
 
     if (prefs_get_beep())
         beep();
     if (prefs_get_notify_message())
         _notify_message(display_from);
-
-    g_free(display_from);
 }
 
 void
 ui_contact_online(const char * const from, const char * const show,
     const char * const status, GDateTime *last_activity)
 {
-    _show_status_string(console->win, from, show, status, last_activity, "++",
+    _show_status_string(console, from, show, status, last_activity, "++",
         "online");
 
     int win_index = _find_prof_win_index(from);
-    if (win_index != NUM_WINS) {
-        WINDOW *win = windows[win_index]->win;
-        _show_status_string(win, from, show, status, last_activity, "++",
+    if (win_index != WIN_NOT_FOUND) {
+        ProfWin *window = _get_prof_win(win_index);
+        _show_status_string(window, from, show, status, last_activity, "++",
             "online");
     }
 
@@ -475,12 +407,12 @@ void
 ui_contact_offline(const char * const from, const char * const show,
     const char * const status)
 {
-    _show_status_string(console->win, from, show, status, NULL, "--", "offline");
+    _show_status_string(console, from, show, status, NULL, "--", "offline");
 
     int win_index = _find_prof_win_index(from);
-    if (win_index != NUM_WINS) {
-        WINDOW *win = windows[win_index]->win;
-        _show_status_string(win, from, show, status, NULL, "--", "offline");
+    if (win_index != WIN_NOT_FOUND) {
+        ProfWin *window = _get_prof_win(win_index);
+        _show_status_string(window, from, show, status, NULL, "--", "offline");
     }
 
     if (win_index == current_index)
@@ -492,13 +424,11 @@ ui_disconnected(void)
 {
     int i;
     // show message in all active chats
-    for (i = 1; i < NUM_WINS; i++) {
-        if (windows[i] != NULL) {
-            WINDOW *win = windows[i]->win;
-            _win_show_time(win);
-            wattron(win, COLOUR_ERROR);
-            wprintw(win, "%s\n", "Lost connection.");
-            wattroff(win, COLOUR_ERROR);
+    for (i = 1; i < windows->len; i++) {
+        ProfWin *window = g_ptr_array_index(windows, i);
+        if (window != NULL) {
+            _win_print_time(window, NULL);
+            window_print(window, COLOUR_ERROR, "%s\n", "Lost connection.");
 
             // if current win, set dirty
             if (i == current_index) {
@@ -519,12 +449,17 @@ void
 ui_switch_win(const int i)
 {
     win_current_page_off();
-    if (windows[i] != NULL) {
+    if (_get_prof_win(i) != NULL) {
+        if (current->type != WIN_CONSOLE) {
+            window_set_deferred(current, TRUE);
+        }
+        _swap_draft(current, _get_prof_win(i));
         current_index = i;
-        current = windows[current_index];
+        current = _get_prof_win(current_index);
+        window_set_deferred(current, FALSE);
         win_current_page_off();
 
-        current->unread = 0;
+        _win_clear_unread(current);
 
         if (i == 0) {
             title_bar_title();
@@ -542,13 +477,24 @@ ui_switch_win(const int i)
 void
 win_current_close(void)
 {
+    _win_clear_unread(current);
+    if (current->type != WIN_CONSOLE) {
+        g_hash_table_remove(win_indexes, current->from);
+    }
     window_free(current);
-    windows[current_index] = NULL;
+    g_ptr_array_index(windows, current_index) = NULL;
+
+    // drop unused slots from the end so new windows take the lowest numbers
+    while (windows->len > 1 &&
+            g_ptr_array_index(windows, windows->len - 1) == NULL) {
+        g_ptr_array_remove_index(windows, windows->len - 1);
+    }
 
     // set it as inactive in the status bar
     status_bar_inactive(current_index);
 
     // go back to console window
+    _swap_draft(NULL, console);
     _set_current(0);
     status_bar_active(0);
     title_bar_title();
@@ -617,7 +563,7 @@ void
 win_current_page_off(void)
 {
     int rows = getmaxy(stdscr);
-    ProfWin *window = windows[current_index];
+    ProfWin *window = _get_prof_win(current_index);
 
     window->paged = 0;
 
@@ -636,17 +582,17 @@ void
 win_show_error_msg(const char * const from, const char *err_msg)
 {
     int win_index;
-    WINDOW *win;
+    ProfWin *window;
 
     if (from == NULL || err_msg == NULL)
         return;
 
     win_index = _find_prof_win_index(from);
     // chat window exists
-    if (win_index < NUM_WINS) {
-        win = windows[win_index]->win;
-        _win_show_time(win);
-        _win_show_error_msg(win, err_msg);
+    if (win_index != WIN_NOT_FOUND) {
+        window = _get_prof_win(win_index);
+        _win_print_time(window, NULL);
+        _win_show_error_msg(window, err_msg);
         if (win_index == current_index) {
             dirty = TRUE;
         }
@@ -657,7 +603,7 @@ void
 win_show_system_msg(const char * const from, const char *message)
 {
     int win_index;
-    WINDOW *win;
+    ProfWin *window;
     char from_cpy[strlen(from) + 1];
     char *bare_jid;
 
@@ -668,15 +614,15 @@ win_show_system_msg(const char * const from, const char *message)
     bare_jid = strtok(from_cpy, "/");
 
     win_index = _find_prof_win_index(bare_jid);
-    if (win_index == NUM_WINS) {
+    if (win_index == WIN_NOT_FOUND) {
         win_index = _new_prof_win(bare_jid, WIN_CHAT);
         status_bar_active(win_index);
         dirty = TRUE;
     }
-    win = windows[win_index]->win;
+    window = _get_prof_win(win_index);
 
-    _win_show_time(win);
-    wprintw(win, "*%s %s\n", bare_jid, message);
+    _win_print_time(window, NULL);
+    window_print(window, 0, "*%s %s\n", bare_jid, message);
 
     // this is the current window
     if (win_index == current_index) {
@@ -688,21 +634,18 @@ void
 win_show_gone(const char * const from)
 {
     int win_index;
-    WINDOW *win;
+    ProfWin *window;
 
     if (from == NULL)
         return;
 
     win_index = _find_prof_win_index(from);
     // chat window exists
-    if (win_index < NUM_WINS) {
-        win = windows[win_index]->win;
-        _win_show_time(win);
-        wattron(win, COLOUR_GONE);
-        wprintw(win, "*%s ", from);
-        wprintw(win, "has left the conversation.");
-        wprintw(win, "\n");
-        wattroff(win, COLOUR_GONE);
+    if (win_index != WIN_NOT_FOUND) {
+        window = _get_prof_win(win_index);
+        _win_print_time(window, NULL);
+        window_print(window, COLOUR_GONE, "*%s has left the conversation.\n",
+            from);
         if (win_index == current_index) {
             dirty = TRUE;
         }
@@ -715,28 +658,23 @@ win_new_chat_win(const char * const to)
     // if the contact is offline, show a message
     PContact contact = contact_list_get_contact(to);
     int win_index = _find_prof_win_index(to);
-    WINDOW *win = NULL;
 
     // create new window
-    if (win_index == NUM_WINS) {
+    if (win_index == WIN_NOT_FOUND) {
         win_index = _new_prof_win(to, WIN_CHAT);
-        win = windows[win_index]->win;
+        ProfWin *window = _get_prof_win(win_index);
 
         if (prefs_get_chlog() && prefs_get_history()) {
-            _win_show_history(win, win_index, to);
+            _win_show_history(window, to);
         }
 
         if (contact != NULL) {
             if (strcmp(p_contact_presence(contact), "offline") == 0) {
                 const char const *show = p_contact_presence(contact);
                 const char const *status = p_contact_status(contact);
-                _show_status_string(win, to, show, status, NULL, "--", "offline");
+                _show_status_string(window, to, show, status, NULL, "--", "offline");
             }
         }
-
-    // use existing window
-    } else {
-        win = windows[win_index]->win;
     }
 
     ui_switch_win(win_index);
@@ -749,10 +687,10 @@ win_show_outgoing_msg(const char * const from, const char * const to,
     // if the contact is offline, show a message
     PContact contact = contact_list_get_contact(to);
     int win_index = _find_prof_win_index(to);
-    WINDOW *win = NULL;
+    ProfWin *window = NULL;
 
     // create new window
-    if (win_index == NUM_WINS) {
+    if (win_index == WIN_NOT_FOUND) {
 
         if (muc_room_is_active(to)) {
             win_index = _new_prof_win(to, WIN_PRIVATE);
@@ -760,35 +698,31 @@ win_show_outgoing_msg(const char * const from, const char * const to,
             win_index = _new_prof_win(to, WIN_CHAT);
         }
 
-        win = windows[win_index]->win;
+        window = _get_prof_win(win_index);
 
         if (prefs_get_chlog() && prefs_get_history()) {
-            _win_show_history(win, win_index, to);
+            _win_show_history(window, to);
         }
 
         if (contact != NULL) {
             if (strcmp(p_contact_presence(contact), "offline") == 0) {
                 const char const *show = p_contact_presence(contact);
                 const char const *status = p_contact_status(contact);
-                _show_status_string(win, to, show, status, NULL, "--", "offline");
+                _show_status_string(window, to, show, status, NULL, "--", "offline");
             }
         }
 
     // use existing window
     } else {
-        win = windows[win_index]->win;
+        window = _get_prof_win(win_index);
     }
 
-    _win_show_time(win);
+    _win_print_time(window, NULL);
     if (strncmp(message, "/me ", 4) == 0) {
-        wattron(win, COLOUR_ME);
-        wprintw(win, "*%s ", from);
-        wprintw(win, message + 4);
-        wprintw(win, "\n");
-        wattroff(win, COLOUR_ME);
+        window_print(window, COLOUR_ME, "*%s %s\n", from, message + 4);
     } else {
-        _win_show_user(win, from, 0);
-        _win_show_message(win, message);
+        _win_show_user(window, from, 0);
+        _win_show_message(window, message);
     }
     ui_switch_win(win_index);
 }
@@ -799,7 +733,7 @@ win_join_chat(const char * const room, const char * const nick)
     int win_index = _find_prof_win_index(room);
 
     // create new window
-    if (win_index == NUM_WINS) {
+    if (win_index == WIN_NOT_FOUND) {
         win_index = _new_prof_win(room, WIN_MUC);
     }
 
@@ -810,64 +744,30 @@ void
 win_show_room_roster(const char * const room)
 {
     int win_index = _find_prof_win_index(room);
-    WINDOW *win = windows[win_index]->win;
+    ProfWin *window = _get_prof_win(win_index);
 
     GList *roster = muc_get_roster(room);
 
     if ((roster == NULL) || (g_list_length(roster) == 0)) {
-        wattron(win, COLOUR_ROOMINFO);
-        wprintw(win, "You are alone!\n");
-        wattroff(win, COLOUR_ROOMINFO);
+        window_print(window, COLOUR_ROOMINFO, "You are alone!\n");
     } else {
-        wattron(win, COLOUR_ROOMINFO);
-        wprintw(win, "Room occupants:\n");
-        wattroff(win, COLOUR_ROOMINFO);
-        wattron(win, COLOUR_ONLINE);
+        window_print(window, COLOUR_ROOMINFO, "Room occupants:\n");
 
         while (roster != NULL) {
             PContact member = roster->data;
             const char const *name = p_contact_jid(member);
             const char const *show = p_contact_presence(member);
 
-            if (strcmp(show, "away") == 0) {
-                wattron(win, COLOUR_AWAY);
-            } else if (strcmp(show, "chat") == 0) {
-                wattron(win, COLOUR_CHAT);
-            } else if (strcmp(show, "dnd") == 0) {
-                wattron(win, COLOUR_DND);
-            } else if (strcmp(show, "xa") == 0) {
-                wattron(win, COLOUR_XA);
-            } else if (strcmp(show, "online") == 0) {
-                wattron(win, COLOUR_ONLINE);
-            } else {
-                wattron(win, COLOUR_OFFLINE);
-            }
-
-            wprintw(win, "%s", name);
-
-            if (strcmp(show, "away") == 0) {
-                wattroff(win, COLOUR_AWAY);
-            } else if (strcmp(show, "chat") == 0) {
-                wattroff(win, COLOUR_CHAT);
-            } else if (strcmp(show, "dnd") == 0) {
-                wattroff(win, COLOUR_DND);
-            } else if (strcmp(show, "xa") == 0) {
-                wattroff(win, COLOUR_XA);
-            } else if (strcmp(show, "online") == 0) {
-                wattroff(win, COLOUR_ONLINE);
-            } else {
-                wattroff(win, COLOUR_OFFLINE);
-            }
+            window_print(window, _presence_colour(show), "%s", name);
 
             if (roster->next != NULL) {
-                wprintw(win, ", ");
+                window_print(window, COLOUR_ONLINE, ", ");
             }
 
             roster = g_list_next(roster);
         }
 
-        wprintw(win, "\n");
-        wattroff(win, COLOUR_ONLINE);
+        window_print(window, COLOUR_ONLINE, "\n");
     }
 
     if (win_index == current_index)
@@ -878,12 +778,10 @@ void
 win_show_room_member_offline(const char * const room, const char * const nick)
 {
     int win_index = _find_prof_win_index(room);
-    WINDOW *win = windows[win_index]->win;
+    ProfWin *window = _get_prof_win(win_index);
 
-    _win_show_time(win);
-    wattron(win, COLOUR_OFFLINE);
-    wprintw(win, "-- %s has left the room.\n", nick);
-    wattroff(win, COLOUR_OFFLINE);
+    _win_print_time(window, NULL);
+    window_print(window, COLOUR_OFFLINE, "-- %s has left the room.\n", nick);
 
     if (win_index == current_index)
         dirty = TRUE;
@@ -894,12 +792,10 @@ win_show_room_member_online(const char * const room, const char * const nick,
     const char * const show, const char * const status)
 {
     int win_index = _find_prof_win_index(room);
-    WINDOW *win = windows[win_index]->win;
+    ProfWin *window = _get_prof_win(win_index);
 
-    _win_show_time(win);
-    wattron(win, COLOUR_ONLINE);
-    wprintw(win, "++ %s has joined the room.\n", nick);
-    wattroff(win, COLOUR_ONLINE);
+    _win_print_time(window, NULL);
+    window_print(window, COLOUR_ONLINE, "++ %s has joined the room.\n", nick);
 
     if (win_index == current_index)
         dirty = TRUE;
@@ -910,9 +806,9 @@ win_show_room_member_presence(const char * const room, const char * const nick,
     const char * const show, const char * const status)
 {
     int win_index = _find_prof_win_index(room);
-    if (win_index != NUM_WINS) {
-        WINDOW *win = windows[win_index]->win;
-        _show_status_string(win, nick, show, status, NULL, "++", "online");
+    if (win_index != WIN_NOT_FOUND) {
+        ProfWin *window = _get_prof_win(win_index);
+        _show_status_string(window, nick, show, status, NULL, "++", "online");
     }
 
     if (win_index == current_index)
@@ -924,12 +820,11 @@ win_show_room_member_nick_change(const char * const room,
     const char * const old_nick, const char * const nick)
 {
     int win_index = _find_prof_win_index(room);
-    WINDOW *win = windows[win_index]->win;
+    ProfWin *window = _get_prof_win(win_index);
 
-    _win_show_time(win);
-    wattron(win, COLOUR_THEM);
-    wprintw(win, "** %s is now known as %s\n", old_nick, nick);
-    wattroff(win, COLOUR_THEM);
+    _win_print_time(window, NULL);
+    window_print(window, COLOUR_THEM, "** %s is now known as %s\n", old_nick,
+        nick);
 
     if (win_index == current_index)
         dirty = TRUE;
@@ -939,12 +834,10 @@ void
 win_show_room_nick_change(const char * const room, const char * const nick)
 {
     int win_index = _find_prof_win_index(room);
-    WINDOW *win = windows[win_index]->win;
+    ProfWin *window = _get_prof_win(win_index);
 
-    _win_show_time(win);
-    wattron(win, COLOUR_ME);
-    wprintw(win, "** You are now known as %s\n", nick);
-    wattroff(win, COLOUR_ME);
+    _win_print_time(window, NULL);
+    window_print(window, COLOUR_ME, "** You are now known as %s\n", nick);
 
     if (win_index == current_index)
         dirty = TRUE;
@@ -955,21 +848,19 @@ win_show_room_history(const char * const room_jid, const char * const nick,
     GTimeVal tv_stamp, const char * const message)
 {
     int win_index = _find_prof_win_index(room_jid);
-    WINDOW *win = windows[win_index]->win;
+    ProfWin *window = _get_prof_win(win_index);
 
     GDateTime *time = g_date_time_new_from_timeval_utc(&tv_stamp);
     gchar *date_fmt = g_date_time_format(time, "%H:%M:%S");
-    wprintw(win, "%s - ", date_fmt);
+    window_print(window, 0, "%s - ", date_fmt);
     g_date_time_unref(time);
     g_free(date_fmt);
 
     if (strncmp(message, "/me ", 4) == 0) {
-        wprintw(win, "*%s ", nick);
-        wprintw(win, message + 4);
-        wprintw(win, "\n");
+        window_print(window, 0, "*%s %s\n", nick, message + 4);
     } else {
-        wprintw(win, "%s: ", nick);
-        _win_show_message(win, message);
+        window_print(window, 0, "%s: ", nick);
+        _win_show_message(window, message);
     }
 
     if (win_index == current_index)
@@ -981,31 +872,23 @@ win_show_room_message(const char * const room_jid, const char * const nick,
     const char * const message)
 {
     int win_index = _find_prof_win_index(room_jid);
-    WINDOW *win = windows[win_index]->win;
+    ProfWin *window = _get_prof_win(win_index);
 
-    _win_show_time(win);
+    _win_print_time(window, NULL);
     if (strcmp(nick, muc_get_room_nick(room_jid)) != 0) {
         if (strncmp(message, "/me ", 4) == 0) {
-            wattron(win, COLOUR_THEM);
-            wprintw(win, "*%s ", nick);
-            wprintw(win, message + 4);
-            wprintw(win, "\n");
-            wattroff(win, COLOUR_THEM);
+            window_print(window, COLOUR_THEM, "*%s %s\n", nick, message + 4);
         } else {
-            _win_show_user(win, nick, 1);
-            _win_show_message(win, message);
+            _win_show_user(window, nick, 1);
+            _win_show_message(window, message);
         }
 
     } else {
         if (strncmp(message, "/me ", 4) == 0) {
-            wattron(win, COLOUR_ME);
-            wprintw(win, "*%s ", nick);
-            wprintw(win, message + 4);
-            wprintw(win, "\n");
-            wattroff(win, COLOUR_ME);
+            window_print(window, COLOUR_ME, "*%s %s\n", nick, message + 4);
         } else {
-            _win_show_user(win, nick, 0);
-            _win_show_message(win, message);
+            _win_show_user(window, nick, 0);
+            _win_show_message(window, message);
         }
     }
 
@@ -1028,7 +911,7 @@ win_show_room_message(const char * const room_jid, const char * const nick,
             }
         }
 
-        windows[win_index]->unread++;
+        _win_inc_unread(window);
     }
 
     if (strcmp(nick, muc_get_room_nick(room_jid)) != 0) {
@@ -1045,12 +928,10 @@ void
 win_show_room_subject(const char * const room_jid, const char * const subject)
 {
     int win_index = _find_prof_win_index(room_jid);
-    WINDOW *win = windows[win_index]->win;
+    ProfWin *window = _get_prof_win(win_index);
 
-    wattron(win, COLOUR_ROOMINFO);
-    wprintw(win, "Room subject: ");
-    wattroff(win, COLOUR_ROOMINFO);
-    wprintw(win, "%s\n", subject);
+    window_print(window, COLOUR_ROOMINFO, "Room subject: ");
+    window_print(window, 0, "%s\n", subject);
 
     // currently in groupchat window
     if (win_index == current_index) {
@@ -1067,12 +948,10 @@ void
 win_show_room_broadcast(const char * const room_jid, const char * const message)
 {
     int win_index = _find_prof_win_index(room_jid);
-    WINDOW *win = windows[win_index]->win;
+    ProfWin *window = _get_prof_win(win_index);
 
-    wattron(win, COLOUR_ROOMINFO);
-    wprintw(win, "Room message: ");
-    wattroff(win, COLOUR_ROOMINFO);
-    wprintw(win, "%s\n", message);
+    window_print(window, COLOUR_ROOMINFO, "Room message: ");
+    window_print(window, 0, "%s\n", message);
 
     // currently in groupchat window
     if (win_index == current_index) {
@@ -1096,16 +975,16 @@ cons_show_wins(void)
     _win_show_time(console->win);
     wprintw(console->win, "1: Console\n");
 
-    for (i = 1; i < NUM_WINS; i++) {
-        if (windows[i] != NULL) {
+    for (i = 1; i < windows->len; i++) {
+        if (g_ptr_array_index(windows, i) != NULL) {
             count++;
         }
     }
 
     if (count != 0) {
-        for (i = 1; i < NUM_WINS; i++) {
-            if (windows[i] != NULL) {
-                ProfWin *window = windows[i];
+        for (i = 1; i < windows->len; i++) {
+            if (g_ptr_array_index(windows, i) != NULL) {
+                ProfWin *window = g_ptr_array_index(windows, i);
                 _win_show_time(console->win);
 
                 switch (window->type)
@@ -1208,6 +1087,11 @@ cons_show_ui_prefs(void)
     else
         cons_show("Terminal flash (/flash)      : OFF");
 
+    if (prefs_get_multiline())
+        cons_show("Multi line paste (/multiline): ON");
+    else
+        cons_show("Multi line paste (/multiline): OFF");
+
     if (prefs_get_intype())
         cons_show("Show typing (/intype)        : ON");
     else
@@ -1223,11 +1107,16 @@ cons_show_ui_prefs(void)
     else
         cons_show("Chat history (/history)      : OFF");
 
+    cons_show("Input history (/histsize)    : %d lines", prefs_get_histsize());
+
     if (prefs_get_vercheck())
         cons_show("Version checking (/vercheck) : ON");
     else
         cons_show("Version checking (/vercheck) : OFF");
 
+    cons_show("Version check interval       : %d hours",
+        prefs_get_vercheck_interval());
+
     if (prefs_get_statuses())
         cons_show("Status (/statuses)           : ON");
     else
@@ -1338,11 +1227,28 @@ cons_show_connection_prefs(void)
 
     gint reconnect_interval = prefs_get_reconnect();
     if (reconnect_interval == 0) {
-        cons_show("Reconnect interval (/reconnect) : OFF");
+        cons_show("Reconnect max wait (/reconnect) : OFF");
     } else if (reconnect_interval == 1) {
-        cons_show("Reconnect interval (/reconnect) : 1 second");
+        cons_show("Reconnect max wait (/reconnect) : 1 second");
     } else {
-        cons_show("Reconnect interval (/reconnect) : %d seconds", reconnect_interval);
+        cons_show("Reconnect max wait (/reconnect) : %d seconds", reconnect_interval);
+    }
+
+    guint attempts = reconnect_get_attempts();
+    gint64 now = g_get_monotonic_time() / 1000;
+    gint64 wait = reconnect_get_next_attempt() - now;
+    switch (reconnect_get_state())
+    {
+        case RECONNECT_WAITING:
+            cons_show("Reconnect state                 : attempt %u in %" G_GINT64_FORMAT " seconds",
+                attempts + 1, (MAX(wait, 0) + 999) / 1000);
+            break;
+        case RECONNECT_CONNECTING:
+            cons_show("Reconnect state                 : attempt %u connecting", attempts);
+            break;
+        default:
+            cons_show("Reconnect state                 : idle");
+            break;
     }
 
     gint autoping_interval = prefs_get_autoping();
@@ -1501,7 +1407,9 @@ cons_navigation_help(void)
     cons_show("Alt-2..Alt-0             : Chat windows.");
     cons_show("F1                       : This console window.");
     cons_show("F2..F10                  : Chat windows.");
+    cons_show("/win num                 : Any window, see /wins for numbers.");
     cons_show("UP, DOWN                 : Navigate input history.");
+    cons_show("CTRL-R                   : Search input history.");
     cons_show("LEFT, RIGHT, HOME, END   : Edit current input.");
     cons_show("ESC                      : Clear current input.");
     cons_show("TAB                      : Autocomplete command/recipient/login.");
@@ -1652,7 +1560,15 @@ cons_about(void)
 void
 cons_check_version(gboolean not_available_msg)
 {
-    char *latest_release = release_get_latest();
+    // an explicit check always asks the server
+    release_get_latest(!not_available_msg, _cons_version_done,
+        GINT_TO_POINTER(not_available_msg));
+}
+
+static void
+_cons_version_done(const char * const latest_release, void *userdata)
+{
+    gboolean not_available_msg = GPOINTER_TO_INT(userdata);
 
     if (latest_release != NULL) {
         gboolean relase_valid = g_regex_match_simple("^\\d+\\.\\d+\\.\\d+$", latest_release, 0, 0);
@@ -1663,7 +1579,6 @@ cons_check_version(gboolean not_available_msg)
                 wprintw(console->win, "A new version of Profanity is available: %s", latest_release);
                 _win_show_time(console->win);
                 wprintw(console->win, "Check <http://www.profanity.im> for details.\n");
-                free(latest_release);
                 _win_show_time(console->win);
                 wprintw(console->win, "\n");
             } else {
@@ -1780,14 +1695,16 @@ _create_windows(void)
 {
     int cols = getmaxx(stdscr);
     max_cols = cols;
-    windows[0] = window_create(CONS_WIN_TITLE, cols, WIN_CONSOLE);
-    console = windows[0];
+    windows = g_ptr_array_new();
+    win_indexes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    console = window_create(CONS_WIN_TITLE, cols, WIN_CONSOLE);
+    g_ptr_array_add(windows, console);
     current = console;
     cons_about();
 }
 
 static gboolean
-_new_release(char *found_version)
+_new_release(const char * const found_version)
 {
     int curr_maj, curr_min, curr_patch, found_maj, found_min, found_patch;
 
@@ -1866,35 +1783,65 @@ _cons_splash_logo(void)
 static int
 _find_prof_win_index(const char * const contact)
 {
-    int i;
-    for (i = 1; i < NUM_WINS; i++) {
-        if ((windows[i] != NULL) && (strcmp(windows[i]->from, contact) == 0)) {
-            break;
-        }
-    }
+    gpointer index;
 
-    return i;
+    if (g_hash_table_lookup_extended(win_indexes, contact, NULL, &index)) {
+        return GPOINTER_TO_INT(index);
+    } else {
+        return WIN_NOT_FOUND;
+    }
 }
 
 static int
 _new_prof_win(const char * const contact, win_type_t type)
 {
+    // reuse the lowest free slot, so F-key and Alt-number navigation stays
+    // compact, otherwise grow the table
     int i;
-    for (i = 1; i < NUM_WINS; i++) {
-        if (windows[i] == NULL) {
+    for (i = 1; i < windows->len; i++) {
+        if (g_ptr_array_index(windows, i) == NULL) {
             break;
         }
     }
 
-    if (i != NUM_WINS) {
-        int cols = getmaxx(stdscr);
-        windows[i] = window_create(contact, cols, type);
-        return i;
+    int cols = getmaxx(stdscr);
+    ProfWin *new_win = window_create(contact, cols, type);
+    window_set_deferred(new_win, TRUE);
+
+    if (i == windows->len) {
+        g_ptr_array_add(windows, new_win);
+    } else {
+        g_ptr_array_index(windows, i) = new_win;
+    }
+    g_hash_table_insert(win_indexes, strdup(contact), GINT_TO_POINTER(i));
+
+    return i;
+}
+
+static ProfWin *
+_get_prof_win(const int index)
+{
+    if (index < 0 || index >= windows->len) {
+        return NULL;
     } else {
-        return 0;
+        return g_ptr_array_index(windows, index);
     }
 }
 
+static void
+_win_inc_unread(ProfWin *window)
+{
+    window->unread++;
+    unread_total++;
+}
+
+static void
+_win_clear_unread(ProfWin *window)
+{
+    unread_total -= window->unread;
+    window->unread = 0;
+}
+
 static void
 _win_show_time(WINDOW *win)
 {
@@ -1908,31 +1855,37 @@ _win_show_time(WINDOW *win)
 }
 
 static void
-_win_show_user(WINDOW *win, const char * const user, const int colour)
+_win_print_time(ProfWin *window, GTimeVal *tv_stamp)
+{
+    GDateTime *time;
+    if (tv_stamp == NULL) {
+        time = g_date_time_new_now_local();
+    } else {
+        time = g_date_time_new_from_timeval_utc(tv_stamp);
+    }
+    window_print_time(window, time);
+    g_date_time_unref(time);
+}
+
+static void
+_win_show_user(ProfWin *window, const char * const user, const int colour)
 {
     if (colour)
-        wattron(win, COLOUR_THEM);
-    else
-        wattron(win, COLOUR_ME);
-    wprintw(win, "%s: ", user);
-    if (colour)
-        wattroff(win, COLOUR_THEM);
+        window_print(window, COLOUR_THEM, "%s: ", user);
     else
-        wattroff(win, COLOUR_ME);
+        window_print(window, COLOUR_ME, "%s: ", user);
 }
 
 static void
-_win_show_message(WINDOW *win, const char * const message)
+_win_show_message(ProfWin *window, const char * const message)
 {
-    wprintw(win, "%s\n", message);
+    window_print(window, 0, "%s\n", message);
 }
 
 static void
-_win_show_error_msg(WINDOW *win, const char * const message)
+_win_show_error_msg(ProfWin *window, const char * const message)
 {
-    wattron(win, COLOUR_ERROR);
-    wprintw(win, "%s\n", message);
-    wattroff(win, COLOUR_ERROR);
+    window_print(window, COLOUR_ERROR, "%s\n", message);
 }
 
 static void
@@ -1955,9 +1908,10 @@ _win_resize_all(void)
         max_cols = cols;
 
         int i;
-        for (i = 0; i < NUM_WINS; i++) {
-            if (windows[i] != NULL) {
-                wresize(windows[i]->win, PAD_SIZE, cols);
+        for (i = 0; i < windows->len; i++) {
+            ProfWin *window = g_ptr_array_index(windows, i);
+            if (window != NULL) {
+                wresize(window->win, PAD_SIZE, cols);
             }
         }
     }
@@ -1965,8 +1919,26 @@ _win_resize_all(void)
     prefresh(current->win, current->y_pos, 0, 1, 0, rows-3, cols-1);
 }
 
+static int
+_presence_colour(const char * const show)
+{
+    if (strcmp(show, "away") == 0) {
+        return COLOUR_AWAY;
+    } else if (strcmp(show, "chat") == 0) {
+        return COLOUR_CHAT;
+    } else if (strcmp(show, "dnd") == 0) {
+        return COLOUR_DND;
+    } else if (strcmp(show, "xa") == 0) {
+        return COLOUR_XA;
+    } else if (strcmp(show, "online") == 0) {
+        return COLOUR_ONLINE;
+    } else {
+        return COLOUR_OFFLINE;
+    }
+}
+
 static void
-_show_status_string(WINDOW *win, const char * const from,
+_show_status_string(ProfWin *window, const char * const from,
     const char * const show, const char * const status,
     GDateTime *last_activity, const char * const pre,
     const char * const default_show)
@@ -1974,79 +1946,53 @@ _show_status_string(WINDOW *win, const char * const from,
     if (!prefs_get_statuses())
         return;
 
-    _win_show_time(win);
+    _win_print_time(window, NULL);
 
+    int colour;
     if (show != NULL) {
-        if (strcmp(show, "away") == 0) {
-            wattron(win, COLOUR_AWAY);
-        } else if (strcmp(show, "chat") == 0) {
-            wattron(win, COLOUR_CHAT);
-        } else if (strcmp(show, "dnd") == 0) {
-            wattron(win, COLOUR_DND);
-        } else if (strcmp(show, "xa") == 0) {
-            wattron(win, COLOUR_XA);
-        } else if (strcmp(show, "online") == 0) {
-            wattron(win, COLOUR_ONLINE);
-        } else {
-            wattron(win, COLOUR_OFFLINE);
-        }
+        colour = _presence_colour(show);
     } else if (strcmp(default_show, "online") == 0) {
-        wattron(win, COLOUR_ONLINE);
+        colour = COLOUR_ONLINE;
     } else {
-        wattron(win, COLOUR_OFFLINE);
+        colour = COLOUR_OFFLINE;
     }
 
-    wprintw(win, "%s %s", pre, from);
+    GString *line = g_string_new(NULL);
+    g_string_append_printf(line, "%s %s", pre, from);
 
     if (show != NULL)
-        wprintw(win, " is %s", show);
+        g_string_append_printf(line, " is %s", show);
     else
-        wprintw(win, " is %s", default_show);
+        g_string_append_printf(line, " is %s", default_show);
 
     if (last_activity != NULL) {
         GDateTime *now = g_date_time_new_now_local();
         GTimeSpan span = g_date_time_difference(now, last_activity);
+        g_date_time_unref(now);
 
-        wprintw(win, ", idle ");
+        g_string_append(line, ", idle ");
 
         int hours = span / G_TIME_SPAN_HOUR;
         span = span - hours * G_TIME_SPAN_HOUR;
         if (hours > 0) {
-            wprintw(win, "%dh", hours);
+            g_string_append_printf(line, "%dh", hours);
         }
 
         int minutes = span / G_TIME_SPAN_MINUTE;
         span = span - minutes * G_TIME_SPAN_MINUTE;
-        wprintw(win, "%dm", minutes);
+        g_string_append_printf(line, "%dm", minutes);
 
         int seconds = span / G_TIME_SPAN_SECOND;
-        wprintw(win, "%ds", seconds);
+        g_string_append_printf(line, "%ds", seconds);
     }
 
     if (status != NULL)
-        wprintw(win, ", \"%s\"", status);
+        g_string_append_printf(line, ", \"%s\"", status);
 
-    wprintw(win, "\n");
+    g_string_append(line, "\n");
 
-    if (show != NULL) {
-        if (strcmp(show, "away") == 0) {
-            wattroff(win, COLOUR_AWAY);
-        } else if (strcmp(show, "chat") == 0) {
-            wattroff(win, COLOUR_CHAT);
-        } else if (strcmp(show, "dnd") == 0) {
-            wattroff(win, COLOUR_DND);
-        } else if (strcmp(show, "xa") == 0) {
-            wattroff(win, COLOUR_XA);
-        } else if (strcmp(show, "online") == 0) {
-            wattroff(win, COLOUR_ONLINE);
-        } else {
-            wattroff(win, COLOUR_OFFLINE);
-        }
-    } else if (strcmp(default_show, "online") == 0) {
-        wattroff(win, COLOUR_ONLINE);
-    } else {
-        wattroff(win, COLOUR_OFFLINE);
-    }
+    window_print(window, colour, "%s", line->str);
+    g_string_free(line, TRUE);
 }
 
 static void
@@ -2241,27 +2187,21 @@ _win_handle_page(const wint_t * const ch)
 static gint
 _win_get_unread(void)
 {
-    int i;
-    gint result = 0;
-    for (i = 0; i < NUM_WINS; i++) {
-        if (windows[i] != NULL) {
-            result += windows[i]->unread;
-        }
-    }
-    return result;
+    return unread_total;
 }
 
 static void
-_win_show_history(WINDOW *win, int win_index, const char * const contact)
+_win_show_history(ProfWin *window, const char * const contact)
 {
-    if (!windows[win_index]->history_shown) {
+    if (!window->history_shown) {
         GSList *history = NULL;
         history = chat_log_get_previous(jabber_get_jid(), contact, history);
-        while (history != NULL) {
-            wprintw(win, "%s\n", history->data);
-            history = g_slist_next(history);
+        GSList *curr = history;
+        while (curr != NULL) {
+            window_print(window, 0, "%s\n", curr->data);
+            curr = g_slist_next(curr);
         }
-        windows[win_index]->history_shown = 1;
+        window->history_shown = 1;
 
         g_slist_free_full(history, free);
     }
@@ -2271,6 +2211,34 @@ void
 _set_current(int index)
 {
     current_index = index;
-    current = windows[current_index];
+    current = _get_prof_win(current_index);
+}
+
+// keep any unsent input with the window being left, and show the draft of
+// the window being switched to, old_win is NULL when it is being closed
+static void
+_swap_draft(ProfWin *old_win, ProfWin *new_win)
+{
+    if (old_win == new_win) {
+        return;
+    }
+
+    char *line = inp_get_line();
+    gboolean typed = (line[0] != '\0');
+
+    if ((old_win != NULL) && typed) {
+        free(old_win->draft);
+        old_win->draft = line;
+    } else {
+        free(line);
+    }
+
+    if (new_win->draft != NULL) {
+        inp_replace_input(new_win->draft);
+        free(new_win->draft);
+        new_win->draft = NULL;
+    } else if (typed) {
+        inp_win_reset();
+    }
 }
 
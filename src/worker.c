@@ -0,0 +1,154 @@
+/*
+ * worker.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "worker.h"
+
+// a function run on its own thread, for work that would block the main
+// loop.  Only the main thread starts, checks, cancels and frees workers.
+// A cancelled worker is not waited for, it is kept with the others until
+// its function returns, and freed by worker_reap, so its data is never
+// freed while the thread still uses it
+
+struct worker_t {
+    GThread *thread;
+    worker_func_t func;
+    void *data;
+    GDestroyNotify free_data;
+    gint cancelled;
+    gint finished;
+};
+
+static GSList *cancelled = NULL;
+
+static gpointer _worker_run(gpointer data);
+
+/*
+ * Run func with data on a new thread, free_data is called on the main
+ * thread when the worker is freed.  Returns NULL if the thread could not be
+ * started, data is then still the caller's
+ */
+Worker *
+worker_start(const char * const name, worker_func_t func, void *data,
+    GDestroyNotify free_data)
+{
+    Worker *worker = malloc(sizeof(Worker));
+    worker->func = func;
+    worker->data = data;
+    worker->free_data = free_data;
+    worker->cancelled = FALSE;
+    worker->finished = FALSE;
+
+    worker->thread = g_thread_try_new(name, _worker_run, worker, NULL);
+    if (worker->thread == NULL) {
+        free(worker);
+        return NULL;
+    }
+
+    return worker;
+}
+
+/*
+ * Called from the worker's function, whether it should give up
+ */
+gboolean
+worker_cancelled(Worker *worker)
+{
+    return g_atomic_int_get(&worker->cancelled);
+}
+
+/*
+ * Whether the worker's function has returned, its thread is joined the
+ * first time it has, after which its data is the main thread's
+ */
+gboolean
+worker_finished(Worker *worker)
+{
+    if (!g_atomic_int_get(&worker->finished)) {
+        return FALSE;
+    }
+
+    if (worker->thread != NULL) {
+        g_thread_join(worker->thread);
+        worker->thread = NULL;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Free the worker and its data, waiting for its function to return
+ */
+void
+worker_free(Worker *worker)
+{
+    if (worker->thread != NULL) {
+        g_thread_join(worker->thread);
+    }
+    if (worker->free_data != NULL) {
+        worker->free_data(worker->data);
+    }
+    free(worker);
+}
+
+/*
+ * Ask the worker to give up, it is freed by worker_reap once it has
+ */
+void
+worker_cancel(Worker *worker)
+{
+    g_atomic_int_set(&worker->cancelled, TRUE);
+    cancelled = g_slist_prepend(cancelled, worker);
+}
+
+/*
+ * Free the cancelled workers that have finished, or all of them if wait is
+ * set.  Returns the number still running
+ */
+guint
+worker_reap(gboolean wait)
+{
+    GSList *curr = cancelled;
+    while (curr != NULL) {
+        GSList *next = g_slist_next(curr);
+        Worker *worker = curr->data;
+        if (wait || worker_finished(worker)) {
+            worker_free(worker);
+            cancelled = g_slist_delete_link(cancelled, curr);
+        }
+        curr = next;
+    }
+
+    return g_slist_length(cancelled);
+}
+
+static gpointer
+_worker_run(gpointer data)
+{
+    Worker *worker = data;
+    worker->func(worker, worker->data);
+    g_atomic_int_set(&worker->finished, TRUE);
+
+    return NULL;
+}
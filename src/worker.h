@@ -0,0 +1,40 @@
+/*
+ * worker.h
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <glib.h>
+
+typedef struct worker_t Worker;
+
+// run on the worker's thread, should return soon after worker_cancelled()
+typedef void (*worker_func_t)(Worker *worker, void *data);
+
+Worker * worker_start(const char * const name, worker_func_t func,
+    void *data, GDestroyNotify free_data);
+gboolean worker_cancelled(Worker *worker);
+gboolean worker_finished(Worker *worker);
+void worker_free(Worker *worker);
+void worker_cancel(Worker *worker);
+guint worker_reap(gboolean wait);
+
+#endif
@@ -0,0 +1,710 @@
+/*
+ * bench.c
+ *
+ * Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Microbenchmarks for the core data structures, run with "make bench".
+ *
+ * Each benchmark runs at sizes from 10 to 100000, the size being the number
+ * of items in the structure or the length of the input string.  Results go
+ * to stdout as tab separated lines:
+ *
+ *     name    size    ns_per_op
+ *
+ * with "-" for sizes skipped because the previous size was already over the
+ * time budget.  Given a baseline file in the same format (-b), the growth of
+ * each result relative to the smallest size is compared with the baseline's,
+ * so a change from linear to quadratic is caught whatever the speed of the
+ * machine.  The exit status is 1 if anything regressed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "common.h"
+#include "contact_list.h"
+#include "jid.h"
+#include "parser.h"
+#include "prof_autocomplete.h"
+#include "prof_history.h"
+
+#define MIN_TIME 0.2
+#define SKIPPED -1.0
+
+// calls per run for benchmarks timing a single operation, so the timer
+// is not read around every tiny call
+#define CALLS(size) MAX(1, 10000 / (size))
+
+typedef struct bench_t {
+    const char *name;
+    gboolean per_call;
+    void * (*setup)(int size);
+    int (*run)(void *data, int size);
+    void (*teardown)(void *data);
+} Bench;
+
+typedef struct strings_t {
+    char **items;
+    int size;
+    void *target;
+} Strings;
+
+static const int sizes[] = { 10, 100, 1000, 10000, 100000 };
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static gchar *baseline_file = NULL;
+static gchar *filter = NULL;
+static gdouble threshold = 3.0;
+static gdouble budget = 2.0;
+static gint max_size = 100000;
+
+static Strings * _strings_new(const char * const format, int size,
+    gboolean shuffle);
+static void _strings_free(Strings *strings);
+static char * _repeat(const char * const pattern, int size);
+static double _measure(Bench *bench, int size, double *wall);
+static gboolean _over_budget(Bench *bench, int s, double *results,
+    double wall);
+static GHashTable * _load_baseline(const char * const path);
+static int _compare(GHashTable *baseline, const char * const name,
+    double *results);
+
+// p_autocomplete_add / p_autocomplete_complete
+
+static void *
+_ac_add_setup(int size)
+{
+    Strings *strings = _strings_new("contact%07d@example.com", size, TRUE);
+    strings->target = p_autocomplete_new();
+    return strings;
+}
+
+static int
+_ac_add_run(void *data, int size)
+{
+    Strings *strings = data;
+    int i;
+    for (i = 0; i < size; i++) {
+        p_autocomplete_add(strings->target, strings->items[i]);
+        strings->items[i] = NULL;
+    }
+    return size;
+}
+
+static void
+_ac_add_teardown(void *data)
+{
+    Strings *strings = data;
+    p_autocomplete_free(strings->target);
+    _strings_free(strings);
+}
+
+static void *
+_ac_complete_setup(int size)
+{
+    PAutocomplete ac = p_autocomplete_new();
+    char item[64];
+    int i;
+
+    // in reverse so each add inserts at the head of the list
+    for (i = size - 1; i >= 0; i--) {
+        g_snprintf(item, sizeof(item), "contact%07d@example.com", i);
+        p_autocomplete_add(ac, strdup(item));
+    }
+    return ac;
+}
+
+static int
+_ac_complete_run(void *data, int size)
+{
+    char search[64];
+    int calls = CALLS(size);
+    int i;
+
+    // the last item, so the whole list is searched
+    g_snprintf(search, sizeof(search), "contact%07d", size - 1);
+    for (i = 0; i < calls; i++) {
+        p_autocomplete_reset(data);
+        p_autocomplete_complete(data, search);
+    }
+    return calls;
+}
+
+static void
+_ac_complete_teardown(void *data)
+{
+    p_autocomplete_free(data);
+}
+
+// p_history_append / p_history_previous / p_history_search
+
+static void *
+_history_append_setup(int size)
+{
+    Strings *strings = _strings_new("message number %d", size, FALSE);
+    strings->target = p_history_new(size);
+    return strings;
+}
+
+static int
+_history_append_run(void *data, int size)
+{
+    Strings *strings = data;
+    int i;
+
+    // twice round, so the oldest items are dropped
+    for (i = 0; i < size * 2; i++) {
+        p_history_append(strings->target, strings->items[i % size]);
+    }
+    return size * 2;
+}
+
+static void
+_history_teardown(void *data)
+{
+    Strings *strings = data;
+    p_history_free(strings->target);
+    _strings_free(strings);
+}
+
+static void *
+_history_previous_setup(int size)
+{
+    Strings *strings = _history_append_setup(size);
+    int i;
+    for (i = 0; i < size; i++) {
+        p_history_append(strings->target, strings->items[i]);
+    }
+    return strings;
+}
+
+static int
+_history_previous_run(void *data, int size)
+{
+    Strings *strings = data;
+    int i;
+    for (i = 0; i < size; i++) {
+        free(p_history_previous(strings->target, strings->items[i]));
+    }
+    return size;
+}
+
+static int
+_history_search_run(void *data, int size)
+{
+    Strings *strings = data;
+    int i;
+    for (i = 0; i < size; i++) {
+        p_history_search(strings->target, strings->items[i], -1);
+    }
+    return size;
+}
+
+// contact_list_add / contact_list_update_contact / get_contact_list
+
+static void *
+_contacts_setup(int size)
+{
+    contact_list_clear();
+    return _strings_new("contact%07d@example.com", size, TRUE);
+}
+
+static int
+_contacts_add_run(void *data, int size)
+{
+    Strings *strings = data;
+    int i;
+    for (i = 0; i < size; i++) {
+        contact_list_add(strings->items[i], NULL, "online", NULL, "both",
+            FALSE);
+    }
+    return size;
+}
+
+static void *
+_contacts_populated_setup(int size)
+{
+    Strings *strings = _contacts_setup(size);
+    char jid[64];
+    int i;
+    for (i = size - 1; i >= 0; i--) {
+        g_snprintf(jid, sizeof(jid), "contact%07d@example.com", i);
+        contact_list_add(jid, NULL, "online", NULL, "both", FALSE);
+    }
+    return strings;
+}
+
+static int
+_contacts_update_run(void *data, int size)
+{
+    Strings *strings = data;
+    int i;
+    for (i = 0; i < size; i++) {
+        contact_list_update_contact(strings->items[i], "away", "Lunch", NULL);
+    }
+    return size;
+}
+
+static int
+_contacts_get_run(void *data, int size)
+{
+    int calls = CALLS(size);
+    int i;
+    for (i = 0; i < calls; i++) {
+        g_slist_free(get_contact_list());
+    }
+    return calls;
+}
+
+static void
+_contacts_teardown(void *data)
+{
+    _strings_free(data);
+    contact_list_clear();
+}
+
+// parse_args, size is the number of arguments
+
+static void *
+_parse_args_setup(int size)
+{
+    GString *inp = g_string_new("/command");
+    int i;
+    for (i = 0; i < size; i++) {
+        g_string_append_printf(inp, " arg%d", i);
+    }
+    return g_string_free(inp, FALSE);
+}
+
+static int
+_parse_args_run(void *data, int size)
+{
+    int calls = CALLS(size);
+    int i;
+    for (i = 0; i < calls; i++) {
+        g_strfreev(parse_args(data, size, size));
+    }
+    return calls;
+}
+
+// jid_create / jid_lookup, size is the length of the resource
+
+static void *
+_jid_setup(int size)
+{
+    char *resource = _repeat("r", size);
+    char *jid = g_strdup_printf("someone@example.com/%s", resource);
+    free(resource);
+    return jid;
+}
+
+static int
+_jid_run(void *data, int size)
+{
+    int calls = CALLS(size);
+    int i;
+    for (i = 0; i < calls; i++) {
+        jid_destroy(jid_create(data));
+    }
+    return calls;
+}
+
+static int
+_jid_lookup_run(void *data, int size)
+{
+    int calls = CALLS(size);
+    int i;
+    for (i = 0; i < calls; i++) {
+        jid_destroy(jid_lookup(data));
+    }
+    jid_cache_clear();
+    return calls;
+}
+
+// str_replace / encode_xml, size is the length of the input
+
+static void *
+_xml_setup(int size)
+{
+    return _repeat("a <b> & c ", size);
+}
+
+static int
+_str_replace_run(void *data, int size)
+{
+    int calls = CALLS(size);
+    int i;
+    for (i = 0; i < calls; i++) {
+        free(str_replace(data, "&", "&amp;"));
+    }
+    return calls;
+}
+
+static int
+_encode_xml_run(void *data, int size)
+{
+    int calls = CALLS(size);
+    int i;
+    for (i = 0; i < calls; i++) {
+        free(encode_xml(data));
+    }
+    return calls;
+}
+
+// encode_xml of text with nothing to escape, size is the length
+
+static void *
+_plain_setup(int size)
+{
+    return _repeat("plain text ", size);
+}
+
+// prof_getline, size is the length of the line
+
+static void *
+_getline_setup(int size)
+{
+    FILE *stream = tmpfile();
+    char *line = _repeat("0123456789", size);
+    fprintf(stream, "%s\n", line);
+    free(line);
+    return stream;
+}
+
+static int
+_getline_run(void *data, int size)
+{
+    int calls = CALLS(size);
+    int i;
+    for (i = 0; i < calls; i++) {
+        rewind(data);
+        free(prof_getline(data));
+    }
+    return calls;
+}
+
+static void
+_getline_teardown(void *data)
+{
+    fclose(data);
+}
+
+static Bench benches[] = {
+    { "p_autocomplete_add", FALSE, _ac_add_setup, _ac_add_run,
+        _ac_add_teardown },
+    { "p_autocomplete_complete", TRUE, _ac_complete_setup, _ac_complete_run,
+        _ac_complete_teardown },
+    { "p_history_append", FALSE, _history_append_setup, _history_append_run,
+        _history_teardown },
+    { "p_history_previous", FALSE, _history_previous_setup,
+        _history_previous_run,
+        _history_teardown },
+    { "p_history_search", FALSE, _history_previous_setup, _history_search_run,
+        _history_teardown },
+    { "contact_list_add", FALSE, _contacts_setup, _contacts_add_run,
+        _contacts_teardown },
+    { "contact_list_update_contact", FALSE, _contacts_populated_setup,
+        _contacts_update_run, _contacts_teardown },
+    { "get_contact_list", TRUE, _contacts_populated_setup, _contacts_get_run,
+        _contacts_teardown },
+    { "parse_args", TRUE, _parse_args_setup, _parse_args_run, g_free },
+    { "jid_create", TRUE, _jid_setup, _jid_run, g_free },
+    { "jid_lookup", TRUE, _jid_setup, _jid_lookup_run, g_free },
+    { "str_replace", TRUE, _xml_setup, _str_replace_run, free },
+    { "encode_xml", TRUE, _xml_setup, _encode_xml_run, free },
+    { "encode_xml_plain", TRUE, _plain_setup, _encode_xml_run, free },
+    { "prof_getline", TRUE, _getline_setup, _getline_run, _getline_teardown },
+};
+
+int
+main(int argc, char **argv)
+{
+    GOptionEntry entries[] =
+    {
+        { "baseline", 'b', 0, G_OPTION_ARG_FILENAME, &baseline_file,
+            "Compare with results in FILE", "FILE" },
+        { "threshold", 't', 0, G_OPTION_ARG_DOUBLE, &threshold,
+            "Growth over the baseline that counts as a regression", NULL },
+        { "budget", 'B', 0, G_OPTION_ARG_DOUBLE, &budget,
+            "Seconds a size may take before larger sizes are skipped", NULL },
+        { "max-size", 'm', 0, G_OPTION_ARG_INT, &max_size,
+            "Largest size to run", NULL },
+        { "filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+            "Only run benchmarks whose name contains STR", "STR" },
+        { NULL }
+    };
+
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new(NULL);
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        fprintf(stderr, "%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    GHashTable *baseline = NULL;
+    if (baseline_file != NULL) {
+        baseline = _load_baseline(baseline_file);
+        if (baseline == NULL) {
+            fprintf(stderr, "Could not read baseline %s\n", baseline_file);
+            return 1;
+        }
+    }
+
+    contact_list_init();
+
+    int regressions = 0;
+    unsigned int b, s;
+    printf("# name\tsize\tns_per_op\n");
+    for (b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+        Bench *bench = &benches[b];
+        if (filter != NULL && strstr(bench->name, filter) == NULL) {
+            continue;
+        }
+
+        double results[NUM_SIZES];
+        double wall = 0.0;
+        for (s = 0; s < NUM_SIZES; s++) {
+            if (sizes[s] > max_size ||
+                    _over_budget(bench, s, results, wall)) {
+                results[s] = SKIPPED;
+                printf("%s\t%d\t-\n", bench->name, sizes[s]);
+            } else {
+                results[s] = _measure(bench, sizes[s], &wall);
+                printf("%s\t%d\t%.1f\n", bench->name, sizes[s], results[s]);
+            }
+            fflush(stdout);
+        }
+
+        if (baseline != NULL) {
+            regressions += _compare(baseline, bench->name, results);
+        }
+    }
+
+    contact_list_free();
+
+    if (baseline != NULL) {
+        fprintf(stderr, "%d regression%s against %s\n", regressions,
+            regressions == 1 ? "" : "s", baseline_file);
+        g_hash_table_destroy(baseline);
+    }
+
+    return regressions > 0 ? 1 : 0;
+}
+
+/*
+ * Run the benchmark at the given size until at least MIN_TIME has been
+ * timed, returning nanoseconds per operation.  wall is set to the time of
+ * one whole run including setup.
+ */
+static double
+_measure(Bench *bench, int size, double *wall)
+{
+    GTimer *total = g_timer_new();
+    GTimer *timer = g_timer_new();
+    double timed = 0.0;
+    long ops = 0;
+    int runs = 0;
+
+    while (timed < MIN_TIME) {
+        void *data = bench->setup(size);
+        g_timer_start(timer);
+        ops += bench->run(data, size);
+        timed += g_timer_elapsed(timer, NULL);
+        bench->teardown(data);
+        runs++;
+
+        // one run of a large size can be enough
+        if (g_timer_elapsed(total, NULL) > budget) {
+            break;
+        }
+    }
+
+    *wall = g_timer_elapsed(total, NULL) / runs;
+    g_timer_destroy(timer);
+    g_timer_destroy(total);
+
+    return timed * 1e9 / ops;
+}
+
+/*
+ * Whether size index s is expected to take longer than the budget, either
+ * because a whole run of the last size, scaled linearly, already would, or
+ * because the cost per operation keeps growing as it did between the last
+ * two sizes.
+ */
+static gboolean
+_over_budget(Bench *bench, int s, double *results, double wall)
+{
+    if (s == 0) {
+        return FALSE;
+    }
+    if (results[s - 1] == SKIPPED) {
+        return TRUE;
+    }
+
+    double ratio = (double)sizes[s] / sizes[s - 1];
+    if (wall * ratio > budget) {
+        return TRUE;
+    }
+
+    double growth = 1.0;
+    if (s > 1 && results[s - 2] > 0) {
+        growth = MAX(1.0, results[s - 1] / results[s - 2]);
+    }
+    int ops = bench->per_call ? CALLS(sizes[s]) : sizes[s];
+
+    return results[s - 1] * growth * ops / 1e9 > budget;
+}
+
+/*
+ * Flag any size whose time, relative to the smallest size, grew by more
+ * than threshold over the baseline's, or which ran in the baseline but was
+ * skipped now.
+ */
+static int
+_compare(GHashTable *baseline, const char * const name, double *results)
+{
+    int regressions = 0;
+    unsigned int s;
+
+    char key[128];
+    g_snprintf(key, sizeof(key), "%s\t%d", name, sizes[0]);
+    double *base_first = g_hash_table_lookup(baseline, key);
+    if (base_first == NULL || *base_first <= 0 || results[0] <= 0) {
+        return 0;
+    }
+
+    for (s = 1; s < NUM_SIZES; s++) {
+        g_snprintf(key, sizeof(key), "%s\t%d", name, sizes[s]);
+        double *base = g_hash_table_lookup(baseline, key);
+        if (base == NULL || *base == SKIPPED || sizes[s] > max_size) {
+            continue;
+        }
+
+        if (results[s] == SKIPPED) {
+            fprintf(stderr, "REGRESSION %s at %d: skipped, baseline %.1f ns\n",
+                name, sizes[s], *base);
+            regressions++;
+            continue;
+        }
+
+        double growth = results[s] / results[0];
+        double base_growth = *base / *base_first;
+        if (growth > base_growth * threshold) {
+            fprintf(stderr, "REGRESSION %s at %d: %.1fx the cost at %d, "
+                "baseline %.1fx\n", name, sizes[s], growth, sizes[0],
+                base_growth);
+            regressions++;
+        }
+    }
+
+    return regressions;
+}
+
+static GHashTable *
+_load_baseline(const char * const path)
+{
+    FILE *stream = fopen(path, "r");
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    GHashTable *baseline = g_hash_table_new_full(g_str_hash, g_str_equal,
+        g_free, g_free);
+    char *line;
+    while ((line = prof_getline(stream)) != NULL) {
+        gchar **fields = g_strsplit(line, "\t", 3);
+        if (line[0] != '#' && g_strv_length(fields) == 3) {
+            double *value = g_malloc(sizeof(double));
+            if (strcmp(fields[2], "-") == 0) {
+                *value = SKIPPED;
+            } else {
+                *value = g_ascii_strtod(fields[2], NULL);
+            }
+            g_hash_table_insert(baseline,
+                g_strdup_printf("%s\t%s", fields[0], fields[1]), value);
+        }
+        g_strfreev(fields);
+        free(line);
+    }
+    fclose(stream);
+
+    return baseline;
+}
+
+static Strings *
+_strings_new(const char * const format, int size, gboolean shuffle)
+{
+    Strings *strings = malloc(sizeof(Strings));
+    strings->items = malloc(size * sizeof(char *));
+    strings->size = size;
+    strings->target = NULL;
+
+    int i;
+    for (i = 0; i < size; i++) {
+        strings->items[i] = g_strdup_printf(format, i);
+    }
+
+    // fixed seed, so every run adds in the same order
+    if (shuffle) {
+        GRand *rand = g_rand_new_with_seed(size);
+        for (i = size - 1; i > 0; i--) {
+            int j = g_rand_int_range(rand, 0, i + 1);
+            char *tmp = strings->items[i];
+            strings->items[i] = strings->items[j];
+            strings->items[j] = tmp;
+        }
+        g_rand_free(rand);
+    }
+
+    return strings;
+}
+
+static void
+_strings_free(Strings *strings)
+{
+    int i;
+    for (i = 0; i < strings->size; i++) {
+        g_free(strings->items[i]);
+    }
+    free(strings->items);
+    free(strings);
+}
+
+// a string of length size made of pattern repeated
+static char *
+_repeat(const char * const pattern, int size)
+{
+    int len = strlen(pattern);
+    char *result = malloc(size + 1);
+    int i;
+    for (i = 0; i < size; i++) {
+        result[i] = pattern[i % len];
+    }
+    result[size] = '\0';
+
+    return result;
+}
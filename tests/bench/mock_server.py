@@ -0,0 +1,454 @@
+#!/usr/bin/env python3
+#
+# mock_server.py
+#
+# Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+#
+# This file is part of Profanity.
+#
+# Profanity is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# Profanity is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+"""
+A local stand in for an XMPP server, for testing and benchmarking Profanity
+without a network.  It speaks just enough of the protocol for one client at a
+time: plain text stream (connect with -d), SASL PLAIN accepting any password,
+resource binding, roster, presence, chat messages, MUC and ping.
+
+After the client sends its initial presence, every roster contact is sent as
+online.  Joining any room on the conference domain gets the configured number
+of occupants, a subject and then room messages.  Messages are sent at the
+requested rate, spread over the contacts and rooms, with the body
+"bench <seq>" so a driver can match them up.
+
+Usage, then in profanity "/connect bench@localhost 127.0.0.1" with -d:
+
+    tests/bench/mock_server.py --contacts 100 --rooms 5 --rate 50
+
+A script file can be given with --script, each line is either
+"sleep <seconds>" or a raw stanza to send, with {jid} replaced by the client's
+full jid.  The script runs once the client's initial presence arrives.
+"""
+
+import argparse
+import asyncio
+import base64
+import itertools
+import sys
+import time
+import xml.etree.ElementTree as ET
+from xml.sax.saxutils import escape, quoteattr
+
+NS_CLIENT = "jabber:client"
+NS_STREAM = "http://etherx.jabber.org/streams"
+NS_SASL = "urn:ietf:params:xml:ns:xmpp-sasl"
+NS_BIND = "urn:ietf:params:xml:ns:xmpp-bind"
+NS_SESSION = "urn:ietf:params:xml:ns:xmpp-session"
+NS_ROSTER = "jabber:iq:roster"
+NS_PING = "urn:xmpp:ping"
+NS_MUC = "http://jabber.org/protocol/muc"
+NS_MUC_USER = "http://jabber.org/protocol/muc#user"
+NS_STANZAS = "urn:ietf:params:xml:ns:xmpp-stanzas"
+
+SHOWS = ["chat", "away", "xa", "dnd", None]
+
+
+def _local(tag):
+    return tag.rsplit("}", 1)[-1]
+
+
+def _ns(tag):
+    return tag[1:].split("}", 1)[0] if tag.startswith("{") else None
+
+
+def _child(elem, name, ns=None):
+    for child in elem:
+        if _local(child.tag) == name and (ns is None or _ns(child.tag) == ns):
+            return child
+    return None
+
+
+class Load(object):
+    """What the server sends once the client is ready."""
+
+    def __init__(self, contacts=10, rooms=0, occupants=10, rate=0.0,
+            messages=0, room_share=0.5, ping_interval=0.0, script=None):
+        self.contacts = contacts
+        self.rooms = rooms
+        self.occupants = occupants
+        self.rate = rate
+        self.messages = messages
+        self.room_share = room_share
+        self.ping_interval = ping_interval
+        self.script = script
+
+
+class Stats(object):
+    """Filled in as the server runs, read by the benchmark driver."""
+
+    def __init__(self):
+        self.connected_at = None
+        self.bound_at = None
+        self.ready_at = None
+        self.stanzas_in = 0
+        self.stanzas_out = 0
+        self.pings_answered = 0
+        self.rooms_joined = set()
+        self.sent_at = {}
+        self.load_done = None
+
+
+class Session(object):
+
+    def __init__(self, server, reader, writer):
+        self.server = server
+        self.load = server.load
+        self.stats = server.stats
+        self.domain = server.domain
+        self.reader = reader
+        self.writer = writer
+        self.jid = None
+        self.user = None
+        self.authenticated = False
+        self.closed = False
+        self.ready = False
+        self.ids = itertools.count(1)
+        self.tasks = []
+        self._new_parser()
+
+    def _new_parser(self):
+        self.parser = ET.XMLPullParser(events=("start", "end"))
+        self.depth = 0
+        self.restart = False
+
+    def send(self, data):
+        if not self.closed:
+            self.writer.write(data.encode("utf-8"))
+            self.stats.stanzas_out += 1
+
+    async def run(self):
+        self.stats.connected_at = time.monotonic()
+        try:
+            while not self.closed:
+                data = await self.reader.read(65536)
+                if not data:
+                    break
+                self._feed(data)
+                await self.writer.drain()
+        except (ConnectionError, ET.ParseError) as e:
+            print("mock_server: {0}".format(e), file=sys.stderr)
+        finally:
+            self.closed = True
+            for task in self.tasks:
+                task.cancel()
+            self.writer.close()
+
+    def _feed(self, data):
+        self.parser.feed(data)
+        for event, elem in self.parser.read_events():
+            if event == "start":
+                self.depth += 1
+                if self.depth == 1:
+                    self._stream_start()
+            else:
+                self.depth -= 1
+                if self.depth == 0:
+                    self._stream_end()
+                    return
+                if self.depth == 1:
+                    self.stats.stanzas_in += 1
+                    self._stanza(elem)
+                    if self.restart:
+                        self._new_parser()
+                        return
+
+    def _stream_start(self):
+        header = ("<?xml version='1.0'?><stream:stream xmlns='{0}' "
+            "xmlns:stream='{1}' from='{2}' id='{3}' version='1.0'>").format(
+            NS_CLIENT, NS_STREAM, self.domain, next(self.ids))
+        if self.authenticated:
+            features = ("<stream:features><bind xmlns='{0}'/>"
+                "<session xmlns='{1}'/></stream:features>").format(
+                NS_BIND, NS_SESSION)
+        else:
+            features = ("<stream:features><mechanisms xmlns='{0}'>"
+                "<mechanism>PLAIN</mechanism></mechanisms>"
+                "</stream:features>").format(NS_SASL)
+        self.send(header + features)
+
+    def _stream_end(self):
+        self.send("</stream:stream>")
+        self.closed = True
+
+    def _stanza(self, elem):
+        name = _local(elem.tag)
+        if name == "auth":
+            self._auth(elem)
+        elif name == "iq":
+            self._iq(elem)
+        elif name == "presence":
+            self._presence(elem)
+        elif name == "message":
+            pass
+
+    def _auth(self, elem):
+        try:
+            creds = base64.b64decode(elem.text or "").split(b"\0")
+            self.user = creds[1].decode("utf-8")
+        except (ValueError, IndexError):
+            self.send("<failure xmlns='{0}'><not-authorized/></failure>"
+                .format(NS_SASL))
+            return
+
+        self.authenticated = True
+        self.send("<success xmlns='{0}'/>".format(NS_SASL))
+
+        # the client restarts the stream after success
+        self.restart = True
+
+    def _iq(self, elem):
+        iq_id = elem.get("id", "")
+        iq_type = elem.get("type")
+
+        if _child(elem, "bind", NS_BIND) is not None:
+            bind = _child(elem, "bind", NS_BIND)
+            resource = _child(bind, "resource")
+            res = resource.text if resource is not None else "mock"
+            if "@" in self.user:
+                self.jid = "{0}/{1}".format(self.user, res)
+            else:
+                self.jid = "{0}@{1}/{2}".format(self.user, self.domain, res)
+            self.stats.bound_at = time.monotonic()
+            self.send(("<iq type='result' id={0}><bind xmlns='{1}'>"
+                "<jid>{2}</jid></bind></iq>").format(
+                quoteattr(iq_id), NS_BIND, escape(self.jid)))
+
+        elif _child(elem, "session", NS_SESSION) is not None:
+            self.send("<iq type='result' id={0}/>".format(quoteattr(iq_id)))
+
+        elif (_child(elem, "query", NS_ROSTER) is not None and
+                iq_type == "get"):
+            items = "".join(
+                "<item jid='contact{0}@{1}' name='Contact {0}' "
+                "subscription='both'/>".format(i, self.domain)
+                for i in range(self.load.contacts))
+            self.send("<iq type='result' id={0} to={1}><query xmlns='{2}'>"
+                "{3}</query></iq>".format(quoteattr(iq_id),
+                quoteattr(self.jid), NS_ROSTER, items))
+
+        elif _child(elem, "ping", NS_PING) is not None:
+            self.stats.pings_answered += 1
+            self.send("<iq type='result' id={0} from='{1}' to={2}/>".format(
+                quoteattr(iq_id), self.domain, quoteattr(self.jid)))
+
+        elif iq_type in ("get", "set"):
+            self.send(("<iq type='error' id={0}><error type='cancel'>"
+                "<service-unavailable xmlns='{1}'/></error></iq>").format(
+                quoteattr(iq_id), NS_STANZAS))
+
+    def _presence(self, elem):
+        to = elem.get("to")
+
+        # initial presence
+        if to is None:
+            if not self.ready:
+                self.ready = True
+                self._contacts_online()
+                self._start_load()
+
+        # room join
+        elif (_child(elem, "x", NS_MUC) is not None and
+                elem.get("type") != "unavailable"):
+            room, _, nick = to.partition("/")
+            self._join_room(room, nick)
+
+        # room leave
+        elif elem.get("type") == "unavailable" and "/" in to:
+            room, _, nick = to.partition("/")
+            self.send(("<presence from={0} to={1} type='unavailable'>"
+                "<x xmlns='{2}'><item affiliation='member' role='none'/>"
+                "<status code='110'/></x></presence>").format(
+                quoteattr(to), quoteattr(self.jid), NS_MUC_USER))
+            self.stats.rooms_joined.discard(room)
+
+    def _contacts_online(self):
+        for i in range(self.load.contacts):
+            show = SHOWS[i % len(SHOWS)]
+            show_elem = "<show>{0}</show>".format(show) if show else ""
+            self.send(("<presence from='contact{0}@{1}/mock' to={2}>{3}"
+                "<status>Status of contact {0}</status></presence>").format(
+                i, self.domain, quoteattr(self.jid), show_elem))
+
+    def _join_room(self, room, nick):
+        for i in range(self.load.occupants):
+            self.send(("<presence from={0} to={1}><x xmlns='{2}'>"
+                "<item affiliation='member' role='participant'/></x>"
+                "</presence>").format(quoteattr("{0}/user{1}".format(room, i)),
+                quoteattr(self.jid), NS_MUC_USER))
+        self.send(("<presence from={0} to={1}><x xmlns='{2}'>"
+            "<item affiliation='member' role='participant'/>"
+            "<status code='110'/></x></presence>").format(
+            quoteattr("{0}/{1}".format(room, nick)), quoteattr(self.jid),
+            NS_MUC_USER))
+        self.send(("<message type='groupchat' from={0} to={1}>"
+            "<subject>Benchmark room</subject></message>").format(
+            quoteattr(room), quoteattr(self.jid)))
+        self.stats.rooms_joined.add(room)
+
+    def _start_load(self):
+        loop = asyncio.get_event_loop()
+        if self.load.script is not None:
+            self.tasks.append(loop.create_task(self._run_script()))
+        if self.load.ping_interval > 0:
+            self.tasks.append(loop.create_task(self._ping()))
+        if self.load.rate > 0:
+            self.tasks.append(loop.create_task(self._messages()))
+
+    async def _run_script(self):
+        with open(self.load.script) as script:
+            for line in script:
+                line = line.strip()
+                if not line or line.startswith("#"):
+                    continue
+                if line.startswith("sleep "):
+                    await asyncio.sleep(float(line.split()[1]))
+                else:
+                    self.send(line.replace("{jid}", self.jid))
+                    await self.writer.drain()
+
+    async def _ping(self):
+        while not self.closed:
+            await asyncio.sleep(self.load.ping_interval)
+            self.send(("<iq type='get' id='ping{0}' from='{1}' to={2}>"
+                "<ping xmlns='{3}'/></iq>").format(next(self.ids),
+                self.domain, quoteattr(self.jid), NS_PING))
+
+    async def _messages(self):
+        # wait for the rooms to be joined, so room messages have somewhere
+        # to go
+        while (len(self.stats.rooms_joined) < self.load.rooms and
+                not self.closed):
+            await asyncio.sleep(0.01)
+
+        self.stats.ready_at = time.monotonic()
+        start = time.monotonic()
+        rooms = sorted(self.stats.rooms_joined)
+        seq = 0
+
+        while not self.closed:
+            if self.load.messages and seq >= self.load.messages:
+                break
+
+            # send everything due by now, then sleep until the next one
+            due = int((time.monotonic() - start) * self.load.rate) + 1
+            if self.load.messages:
+                due = min(due, self.load.messages)
+            while seq < due:
+                self._message(seq, rooms)
+                seq += 1
+            await self.writer.drain()
+            await asyncio.sleep(max(0.0,
+                start + seq / self.load.rate - time.monotonic()))
+
+        self.stats.load_done = time.monotonic()
+
+    def _message(self, seq, rooms):
+        # spread room messages evenly through the chat messages
+        share = self.load.room_share
+        use_room = rooms and (self.load.contacts == 0 or
+            int((seq + 1) * share) > int(seq * share))
+        body = "bench {0}".format(seq)
+        if use_room:
+            room = rooms[seq % len(rooms)]
+            sender = "user{0}".format(
+                (seq // len(rooms)) % max(1, self.load.occupants))
+            stanza = ("<message type='groupchat' from={0} to={1}>"
+                "<body>{2}</body></message>").format(
+                quoteattr("{0}/{1}".format(room, sender)), quoteattr(self.jid),
+                body)
+        else:
+            contact = seq % max(1, self.load.contacts)
+            stanza = ("<message type='chat' from='contact{0}@{1}/mock' to={2}>"
+                "<body>{3}</body></message>").format(contact, self.domain,
+                quoteattr(self.jid), body)
+
+        self.stats.sent_at[seq] = time.monotonic()
+        self.send(stanza)
+
+
+class MockServer(object):
+
+    def __init__(self, load, host="127.0.0.1", port=5222, domain="localhost"):
+        self.load = load
+        self.host = host
+        self.port = port
+        self.domain = domain
+        self.stats = Stats()
+        self.server = None
+
+    async def _client(self, reader, writer):
+        self.stats = Stats()
+        await Session(self, reader, writer).run()
+
+    async def start(self):
+        self.server = await asyncio.start_server(self._client, self.host,
+            self.port)
+
+    def close(self):
+        if self.server is not None:
+            self.server.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Local mock XMPP server")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=5222)
+    parser.add_argument("--domain", default="localhost")
+    parser.add_argument("--contacts", type=int, default=10,
+        help="number of roster contacts")
+    parser.add_argument("--rooms", type=int, default=0,
+        help="number of rooms to wait for before sending messages")
+    parser.add_argument("--occupants", type=int, default=10,
+        help="occupants in each room")
+    parser.add_argument("--rate", type=float, default=0.0,
+        help="messages per second, 0 for none")
+    parser.add_argument("--messages", type=int, default=0,
+        help="stop after this many messages, 0 to keep going")
+    parser.add_argument("--room-share", type=float, default=0.5,
+        help="fraction of messages sent to rooms")
+    parser.add_argument("--ping-interval", type=float, default=0.0,
+        help="seconds between pings to the client, 0 for none")
+    parser.add_argument("--script", help="file of stanzas to send")
+    args = parser.parse_args()
+
+    load = Load(contacts=args.contacts, rooms=args.rooms,
+        occupants=args.occupants, rate=args.rate, messages=args.messages,
+        room_share=args.room_share, ping_interval=args.ping_interval,
+        script=args.script)
+    server = MockServer(load, args.host, args.port, args.domain)
+
+    loop = asyncio.new_event_loop()
+    asyncio.set_event_loop(loop)
+    loop.run_until_complete(server.start())
+    print("mock_server: listening on {0}:{1}".format(args.host, args.port),
+        file=sys.stderr)
+    try:
+        loop.run_forever()
+    except KeyboardInterrupt:
+        pass
+    server.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,334 @@
+#!/usr/bin/env python3
+#
+# xmpp_bench.py
+#
+# Copyright (C) 2012, 2013 James Booth <boothj5@gmail.com>
+#
+# This file is part of Profanity.
+#
+# Profanity is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# Profanity is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+"""
+End to end benchmark, runs profanity in batch mode against mock_server.py and
+reports:
+
+    connect     time from /connect to the login event
+    rate        messages handled per second while the load was running
+    p50/p99     time from the server writing a message to profanity
+                reporting it on stdout
+    peak rss    VmHWM of the profanity process
+
+Everything runs on 127.0.0.1 with a throwaway HOME, so it needs no network
+and leaves no files behind.  Profanity always connects to port 5222, so that
+port must be free.
+
+    tests/bench/xmpp_bench.py --contacts 500 --rooms 5 --rate 200 \\
+        --messages 5000
+
+Use --json for one line of machine readable results.
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import queue
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from mock_server import Load, MockServer
+
+MESSAGE_EVENTS = ("message", "room_message")
+
+
+class ServerThread(threading.Thread):
+    """Runs the mock server on its own event loop."""
+
+    def __init__(self, server):
+        threading.Thread.__init__(self, daemon=True)
+        self.server = server
+        self.loop = asyncio.new_event_loop()
+        self.started = threading.Event()
+        self.error = None
+
+    def run(self):
+        asyncio.set_event_loop(self.loop)
+        try:
+            self.loop.run_until_complete(self.server.start())
+        except OSError as e:
+            self.error = e
+            self.started.set()
+            return
+        self.started.set()
+        self.loop.run_forever()
+        self.server.close()
+        pending = asyncio.all_tasks(self.loop)
+        for task in pending:
+            task.cancel()
+        self.loop.run_until_complete(
+            asyncio.gather(*pending, return_exceptions=True))
+        self.loop.close()
+
+    def stop(self):
+        self.loop.call_soon_threadsafe(self.loop.stop)
+        self.join(5)
+
+
+class Client(object):
+    """A profanity process in batch mode, reading commands from stdin."""
+
+    def __init__(self, binary, home):
+        env = dict(os.environ)
+        env["HOME"] = home
+        env["XDG_CONFIG_HOME"] = os.path.join(home, ".config")
+        env["XDG_DATA_HOME"] = os.path.join(home, ".local", "share")
+        self.proc = subprocess.Popen([binary, "-d", "--batch", "-"],
+            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL, env=env, universal_newlines=True)
+        self.events = queue.Queue()
+        self.reader = threading.Thread(target=self._read, daemon=True)
+        self.reader.start()
+
+    def _read(self):
+        for line in self.proc.stdout:
+            now = time.monotonic()
+            try:
+                event = json.loads(line)
+            except ValueError:
+                continue
+            self.events.put((now, event))
+        self.events.put((time.monotonic(), None))
+
+    def send(self, line):
+        self.proc.stdin.write(line + "\n")
+        self.proc.stdin.flush()
+
+    def wait_for(self, name, timeout):
+        """Return the time of the next event called name, skipping others."""
+        deadline = time.monotonic() + timeout
+        while True:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return None, None
+            try:
+                at, event = self.events.get(timeout=remaining)
+            except queue.Empty:
+                return None, None
+            if event is None:
+                return None, None
+            if event.get("event") == name:
+                return at, event
+
+    def peak_rss_kb(self):
+        try:
+            with open("/proc/{0}/status".format(self.proc.pid)) as status:
+                for line in status:
+                    if line.startswith("VmHWM:"):
+                        return int(line.split()[1])
+        except (IOError, OSError):
+            pass
+        return None
+
+    def quit(self):
+        try:
+            self.send("/quit")
+            self.proc.stdin.close()
+        except (IOError, OSError):
+            pass
+        try:
+            self.proc.wait(5)
+        except subprocess.TimeoutExpired:
+            self.proc.kill()
+            self.proc.wait()
+
+
+def _percentile(values, pct):
+    if not values:
+        return None
+    ordered = sorted(values)
+    index = min(len(ordered) - 1, int(round(pct / 100.0 * (len(ordered) - 1))))
+    return ordered[index]
+
+
+def _message_seq(event):
+    body = event.get("body", "")
+    if event.get("event") in MESSAGE_EVENTS and body.startswith("bench ") \
+            and "delay" not in event:
+        try:
+            return int(body[6:])
+        except ValueError:
+            pass
+    return None
+
+
+def run(args):
+    load = Load(contacts=args.contacts, rooms=args.rooms,
+        occupants=args.occupants, rate=args.rate, messages=args.messages,
+        room_share=args.room_share, ping_interval=args.ping_interval,
+        script=args.script)
+    server = MockServer(load, "127.0.0.1", 5222, "localhost")
+    server_thread = ServerThread(server)
+    server_thread.start()
+    server_thread.started.wait()
+    if server_thread.error is not None:
+        sys.exit("xmpp_bench: cannot listen on 127.0.0.1:5222: {0}".format(
+            server_thread.error))
+
+    home = tempfile.mkdtemp(prefix="prof-bench-")
+    client = Client(args.profanity, home)
+    results = {
+        "contacts": args.contacts,
+        "rooms": args.rooms,
+        "occupants": args.occupants,
+        "rate": args.rate,
+        "messages": args.messages,
+    }
+
+    try:
+        started = time.monotonic()
+        client.send("/connect bench@localhost 127.0.0.1")
+        client.send("bench")
+        logged_in, _ = client.wait_for("login", args.timeout)
+        if logged_in is None:
+            sys.exit("xmpp_bench: no login event within {0}s".format(
+                args.timeout))
+        results["connect_ms"] = (logged_in - started) * 1000.0
+
+        for room in range(args.rooms):
+            client.send("/join room{0}@conference.localhost".format(room))
+
+        # collect messages until all have arrived, or nothing has arrived
+        # for a while after the server finished sending
+        received = {}
+        idle_limit = args.timeout
+        while True:
+            try:
+                at, event = client.events.get(timeout=1.0)
+            except queue.Empty:
+                stats = server.stats
+                if stats.load_done is not None and \
+                        time.monotonic() - stats.load_done > idle_limit:
+                    break
+                if stats.load_done is None and args.messages == 0 and \
+                        stats.ready_at is not None and \
+                        time.monotonic() - stats.ready_at > args.duration:
+                    break
+                continue
+            if event is None:
+                break
+            seq = _message_seq(event)
+            if seq is not None:
+                received[seq] = at
+            if args.messages and len(received) >= args.messages:
+                break
+            if args.messages == 0 and server.stats.ready_at is not None and \
+                    at - server.stats.ready_at > args.duration:
+                break
+
+        results["peak_rss_kb"] = client.peak_rss_kb()
+    finally:
+        client.quit()
+        server_thread.stop()
+        shutil.rmtree(home, ignore_errors=True)
+
+    stats = server.stats
+    latencies = [(at - stats.sent_at[seq]) * 1000.0
+        for seq, at in received.items() if seq in stats.sent_at]
+    results["sent"] = len(stats.sent_at)
+    results["received"] = len(received)
+    results["stanzas_in"] = stats.stanzas_in
+    results["stanzas_out"] = stats.stanzas_out
+    results["p50_ms"] = _percentile(latencies, 50)
+    results["p99_ms"] = _percentile(latencies, 99)
+    results["max_ms"] = max(latencies) if latencies else None
+
+    if len(received) > 1 and stats.sent_at:
+        first = min(stats.sent_at.values())
+        last = max(received.values())
+        results["msgs_per_sec"] = len(received) / max(last - first, 1e-6)
+    else:
+        results["msgs_per_sec"] = None
+
+    return results
+
+
+def _fmt(value, unit=""):
+    if value is None:
+        return "-"
+    if isinstance(value, float):
+        return "{0:.2f}{1}".format(value, unit)
+    return "{0}{1}".format(value, unit)
+
+
+def report(results):
+    print("load:      {0} contacts, {1} rooms x {2} occupants, {3} msg/s".format(
+        results["contacts"], results["rooms"], results["occupants"],
+        results["rate"]))
+    print("connect:   {0}".format(_fmt(results["connect_ms"], " ms")))
+    print("messages:  {0} received of {1} sent".format(results["received"],
+        results["sent"]))
+    print("stanzas:   {0} in, {1} out (server side)".format(
+        results["stanzas_in"], results["stanzas_out"]))
+    print("rate:      {0}".format(_fmt(results["msgs_per_sec"], " msg/s")))
+    print("latency:   p50 {0}, p99 {1}, max {2}".format(
+        _fmt(results["p50_ms"], " ms"), _fmt(results["p99_ms"], " ms"),
+        _fmt(results["max_ms"], " ms")))
+    print("peak rss:  {0}".format(_fmt(results["peak_rss_kb"], " kB")))
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    default_binary = os.path.join(here, "..", "..", "profanity")
+
+    parser = argparse.ArgumentParser(
+        description="Benchmark profanity against a local mock server")
+    parser.add_argument("--profanity", default=default_binary,
+        help="profanity binary to run")
+    parser.add_argument("--contacts", type=int, default=100)
+    parser.add_argument("--rooms", type=int, default=2)
+    parser.add_argument("--occupants", type=int, default=20)
+    parser.add_argument("--rate", type=float, default=100.0,
+        help="messages per second")
+    parser.add_argument("--messages", type=int, default=1000,
+        help="messages to send, 0 to run for --duration")
+    parser.add_argument("--duration", type=float, default=10.0,
+        help="seconds to run when --messages is 0")
+    parser.add_argument("--room-share", type=float, default=0.5)
+    parser.add_argument("--ping-interval", type=float, default=0.0)
+    parser.add_argument("--script", help="extra stanzas, see mock_server.py")
+    parser.add_argument("--timeout", type=float, default=10.0,
+        help="seconds to wait for login or for stragglers")
+    parser.add_argument("--json", action="store_true",
+        help="print results as one JSON object")
+    args = parser.parse_args()
+
+    if not os.access(args.profanity, os.X_OK):
+        sys.exit("xmpp_bench: {0} is not executable, build it first or use "
+            "--profanity".format(args.profanity))
+
+    results = run(args)
+    if args.json:
+        print(json.dumps(results, sort_keys=True))
+    else:
+        report(results)
+
+
+if __name__ == "__main__":
+    main()
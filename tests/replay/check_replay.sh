@@ -0,0 +1,27 @@
+#!/bin/sh
+# Replay each recorded trace through the stanza handlers, failing if
+# profanity does not exit cleanly or a stanza was not handled.
+
+srcdir=${srcdir:-.}
+failed=0
+
+home=`mktemp -d`
+trap 'rm -rf "$home"' EXIT
+
+for trace in "$srcdir"/tests/replay/*.trace; do
+    out=`HOME="$home" XDG_CONFIG_HOME="$home" XDG_DATA_HOME="$home" \
+        ./profanity --replay "$trace" --fast 2>&1`
+    if [ $? -ne 0 ]; then
+        echo "FAIL: $trace"
+        echo "$out"
+        failed=1
+    elif ! echo "$out" | grep -q ", 0 not handled"; then
+        echo "FAIL: $trace, stanzas not handled"
+        echo "$out"
+        failed=1
+    else
+        echo "PASS: $trace"
+    fi
+done
+
+exit $failed
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <head-unit.h>
+#include <glib.h>
 #include "common.h"
 
 void replace_one_substr(void)
@@ -146,6 +147,117 @@ void replace_when_new_null(void)
     assert_string_equals("hello", result);
 }
 
+void replace_many_substr(void)
+{
+    char *string = "a&b&&c&";
+    char *sub = "&";
+    char *new = "&amp;";
+
+    char *result = str_replace(string, sub, new);
+
+    assert_string_equals("a&amp;b&amp;&amp;c&amp;", result);
+    free(result);
+}
+
+void replace_with_longer_containing_substr(void)
+{
+    char *string = "aaa";
+    char *sub = "a";
+    char *new = "aa";
+
+    char *result = str_replace(string, sub, new);
+
+    assert_string_equals("aaaaaa", result);
+    free(result);
+}
+
+void replace_with_shorter(void)
+{
+    char *string = "one, two, three";
+    char *sub = ", ";
+    char *new = ",";
+
+    char *result = str_replace(string, sub, new);
+
+    assert_string_equals("one,two,three", result);
+    free(result);
+}
+
+void replace_overlapping_matches_left_first(void)
+{
+    char *string = "aaaa";
+    char *sub = "aa";
+    char *new = "b";
+
+    char *result = str_replace(string, sub, new);
+
+    assert_string_equals("bb", result);
+    free(result);
+}
+
+void encode_xml_escapes_specials(void)
+{
+    char *result = encode_xml("<a href=\"x\">b & c</a>");
+
+    assert_string_equals("&lt;a href=\"x\"&gt;b &amp; c&lt;/a&gt;", result);
+    free(result);
+}
+
+void encode_xml_plain_unchanged(void)
+{
+    char *result = encode_xml("just some text");
+
+    assert_string_equals("just some text", result);
+    free(result);
+}
+
+void encode_xml_only_specials(void)
+{
+    char *result = encode_xml("&&<>");
+
+    assert_string_equals("&amp;&amp;&lt;&gt;", result);
+    free(result);
+}
+
+void encode_xml_does_not_escape_twice(void)
+{
+    char *result = encode_xml("&amp;");
+
+    assert_string_equals("&amp;amp;", result);
+    free(result);
+}
+
+void encode_xml_empty(void)
+{
+    char *result = encode_xml("");
+
+    assert_string_equals("", result);
+    free(result);
+}
+
+void encode_xml_null_returns_null(void)
+{
+    assert_is_null(encode_xml(NULL));
+}
+
+void encode_xml_long_input(void)
+{
+    GString *input = g_string_new("");
+    GString *expected = g_string_new("");
+    int i;
+    for (i = 0; i < 1000; i++) {
+        g_string_append(input, "if (a < b && c > d) ");
+        g_string_append(expected, "if (a &lt; b &amp;&amp; c &gt; d) ");
+    }
+
+    char *result = encode_xml(input->str);
+
+    assert_string_equals(expected->str, result);
+    free(result);
+    g_string_free(input, TRUE);
+    g_string_free(expected, TRUE);
+}
+
 void register_common_tests(void)
 {
     TEST_MODULE("common tests");
@@ -162,4 +274,15 @@ void register_common_tests(void)
     TEST(replace_when_sub_null);
     TEST(replace_when_new_empty);
     TEST(replace_when_new_null);
+    TEST(replace_many_substr);
+    TEST(replace_with_longer_containing_substr);
+    TEST(replace_with_shorter);
+    TEST(replace_overlapping_matches_left_first);
+    TEST(encode_xml_escapes_specials);
+    TEST(encode_xml_plain_unchanged);
+    TEST(encode_xml_only_specials);
+    TEST(encode_xml_does_not_escape_twice);
+    TEST(encode_xml_empty);
+    TEST(encode_xml_null_returns_null);
+    TEST(encode_xml_long_input);
 }
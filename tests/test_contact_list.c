@@ -236,6 +236,22 @@ static void set_status_to_null(void)
     assert_is_null(p_contact_status(james));
 }
 
+static void set_all_offline_keeps_contacts(void)
+{
+    contact_list_add("James", NULL, "away", "Gone to lunch", NULL, FALSE);
+    contact_list_add("Dave", NULL, "dnd", NULL, NULL, FALSE);
+    contact_list_set_all_offline();
+    GSList *list = get_contact_list();
+
+    assert_int_equals(2, g_slist_length(list));
+    PContact first = list->data;
+    PContact second = (g_slist_next(list))->data;
+    assert_string_equals("offline", p_contact_presence(first));
+    assert_is_null(p_contact_status(first));
+    assert_string_equals("offline", p_contact_presence(second));
+    assert_is_null(p_contact_status(second));
+}
+
 static void find_first_exists(void)
 {
     contact_list_add("James", NULL, NULL, NULL, NULL, FALSE);
@@ -367,6 +383,7 @@ void register_contact_list_tests(void)
     TEST(set_show_to_null);
     TEST(update_status);
     TEST(set_status_to_null);
+    TEST(set_all_offline_keeps_contacts);
     TEST(find_first_exists);
     TEST(find_second_exists);
     TEST(find_third_exists);
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <string.h>
+#include <head-unit.h>
+#include <glib.h>
+#include <strophe.h>
+#include "dispatch.h"
+
+static char *called = NULL;
+
+static int
+_chat(xmpp_stanza_t * const stanza)
+{
+    called = "chat";
+    return 1;
+}
+
+static int
+_any(xmpp_stanza_t * const stanza)
+{
+    called = "any";
+    return 1;
+}
+
+static int
+_ping(xmpp_stanza_t * const stanza)
+{
+    called = "ping";
+    return 1;
+}
+
+static void beforetest(void)
+{
+    called = NULL;
+}
+
+static void aftertest(void)
+{
+    dispatch_close();
+}
+
+void call_with_no_handlers_returns_false(void)
+{
+    assert_false(dispatch_call("message", "chat", NULL, NULL));
+    assert_is_null(called);
+}
+
+void call_finds_handler_for_type(void)
+{
+    dispatch_add("chat", "message", "chat", NULL, _chat);
+
+    assert_true(dispatch_call("message", "chat", NULL, NULL));
+    assert_string_equals("chat", called);
+}
+
+void call_other_type_returns_false(void)
+{
+    dispatch_add("chat", "message", "chat", NULL, _chat);
+
+    assert_false(dispatch_call("message", "groupchat", NULL, NULL));
+    assert_is_null(called);
+}
+
+void call_other_name_returns_false(void)
+{
+    dispatch_add("chat", "message", "chat", NULL, _chat);
+
+    assert_false(dispatch_call("presence", "chat", NULL, NULL));
+}
+
+void type_preferred_over_any_type(void)
+{
+    dispatch_add("any", "presence", NULL, NULL, _any);
+    dispatch_add("chat", "presence", "subscribe", NULL, _chat);
+
+    dispatch_call("presence", "subscribe", NULL, NULL);
+
+    assert_string_equals("chat", called);
+}
+
+void any_type_matches_missing_type(void)
+{
+    dispatch_add("any", "presence", NULL, NULL, _any);
+
+    assert_true(dispatch_call("presence", NULL, NULL, NULL));
+    assert_string_equals("any", called);
+}
+
+void call_matches_namespace(void)
+{
+    dispatch_add("any", "iq", "get", NULL, _any);
+    dispatch_add("ping", "iq", "get", "urn:xmpp:ping", _ping);
+
+    dispatch_call("iq", "get", "urn:xmpp:ping", NULL);
+
+    assert_string_equals("ping", called);
+}
+
+void call_other_namespace_returns_false(void)
+{
+    dispatch_add("ping", "iq", "get", "urn:xmpp:ping", _ping);
+
+    assert_false(dispatch_call("iq", "get", "jabber:iq:version", NULL));
+    assert_false(dispatch_call("iq", "get", NULL, NULL));
+}
+
+void add_again_replaces_handler(void)
+{
+    dispatch_add("chat", "message", "chat", NULL, _chat);
+    dispatch_add("any", "message", "chat", NULL, _any);
+
+    dispatch_call("message", "chat", NULL, NULL);
+
+    assert_string_equals("any", called);
+}
+
+void count_is_per_label(void)
+{
+    dispatch_add("chat", "message", "chat", NULL, _chat);
+    dispatch_add("chat", "message", "normal", NULL, _chat);
+    dispatch_add("ping", "iq", "get", "urn:xmpp:ping", _ping);
+
+    dispatch_call("message", "chat", NULL, NULL);
+    dispatch_call("message", "normal", NULL, NULL);
+    dispatch_call("message", "chat", NULL, NULL);
+    dispatch_call("message", "headline", NULL, NULL);
+
+    assert_int_equals(3, dispatch_get_count("chat"));
+    assert_int_equals(0, dispatch_get_count("ping"));
+    assert_int_equals(0, dispatch_get_count("unknown"));
+}
+
+void close_removes_handlers(void)
+{
+    dispatch_add("chat", "message", "chat", NULL, _chat);
+
+    dispatch_close();
+
+    assert_false(dispatch_call("message", "chat", NULL, NULL));
+    assert_int_equals(0, dispatch_get_count("chat"));
+}
+
+void register_dispatch_tests(void)
+{
+    TEST_MODULE("dispatch tests");
+    BEFORETEST(beforetest);
+    AFTERTEST(aftertest);
+    TEST(call_with_no_handlers_returns_false);
+    TEST(call_finds_handler_for_type);
+    TEST(call_other_type_returns_false);
+    TEST(call_other_name_returns_false);
+    TEST(type_preferred_over_any_type);
+    TEST(any_type_matches_missing_type);
+    TEST(call_matches_namespace);
+    TEST(call_other_namespace_returns_false);
+    TEST(add_again_replaces_handler);
+    TEST(count_is_per_label);
+    TEST(close_removes_handlers);
+}
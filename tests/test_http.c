@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <head-unit.h>
+#include <glib.h>
+#include "http.h"
+
+// a server that answers one request with a canned response, or with nothing
+// if response is NULL
+typedef struct server_t {
+    int sock;
+    int port;
+    const char *response;
+    GThread *thread;
+} Server;
+
+typedef struct result_t {
+    gboolean done;
+    char *body;
+} Result;
+
+static gpointer
+_serve(gpointer data)
+{
+    Server *server = data;
+    int conn = accept(server->sock, NULL, NULL);
+    if (conn < 0) {
+        return NULL;
+    }
+
+    GString *request = g_string_new("");
+    char buf[512];
+    while (strstr(request->str, "\r\n\r\n") == NULL) {
+        ssize_t n = read(conn, buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        g_string_append_len(request, buf, n);
+    }
+    g_string_free(request, TRUE);
+
+    if (server->response != NULL) {
+        write(conn, server->response, strlen(server->response));
+    } else {
+        // wait for the client to give up
+        while (read(conn, buf, sizeof(buf)) > 0);
+    }
+    close(conn);
+
+    return NULL;
+}
+
+static Server *
+_server_start(const char * const response)
+{
+    Server *server = malloc(sizeof(Server));
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    server->sock = socket(AF_INET, SOCK_STREAM, 0);
+    bind(server->sock, (struct sockaddr *)&addr, sizeof(addr));
+    listen(server->sock, 1);
+    getsockname(server->sock, (struct sockaddr *)&addr, &len);
+    server->port = ntohs(addr.sin_port);
+    server->response = response;
+    server->thread = g_thread_new("http test", _serve, server);
+
+    return server;
+}
+
+static void
+_server_stop(Server *server)
+{
+    g_thread_join(server->thread);
+    close(server->sock);
+    free(server);
+}
+
+static void
+_done(const char * const body, void *userdata)
+{
+    Result *result = userdata;
+    result->done = TRUE;
+    result->body = g_strdup(body);
+}
+
+static void
+_get(int port, long timeout, Result *result)
+{
+    char *url = g_strdup_printf("http://127.0.0.1:%d/", port);
+    result->done = FALSE;
+    result->body = NULL;
+
+    http_init();
+    http_get(url, timeout, _done, result);
+    while (!result->done) {
+        http_process_events();
+        g_usleep(1000);
+    }
+    http_close();
+
+    g_free(url);
+}
+
+void get_returns_body(void)
+{
+    Server *server = _server_start("HTTP/1.0 200 OK\r\n"
+        "Content-Length: 5\r\n\r\n0.2.0");
+    Result result;
+
+    _get(server->port, 5, &result);
+    _server_stop(server);
+
+    assert_string_equals("0.2.0", result.body);
+    g_free(result.body);
+}
+
+void get_error_status_returns_null(void)
+{
+    Server *server = _server_start("HTTP/1.0 500 Internal Server Error\r\n"
+        "Content-Length: 5\r\n\r\nerror");
+    Result result;
+
+    _get(server->port, 5, &result);
+    _server_stop(server);
+
+    assert_is_null(result.body);
+}
+
+void get_refused_returns_null(void)
+{
+    Server *server = _server_start(NULL);
+    int port = server->port;
+    shutdown(server->sock, SHUT_RDWR);
+    _server_stop(server);
+    Result result;
+
+    _get(port, 5, &result);
+
+    assert_is_null(result.body);
+}
+
+void get_timeout_returns_null(void)
+{
+    Server *server = _server_start(NULL);
+    Result result;
+
+    _get(server->port, 1, &result);
+    _server_stop(server);
+
+    assert_is_null(result.body);
+}
+
+void pending_counts_requests(void)
+{
+    Server *server = _server_start("HTTP/1.0 200 OK\r\n"
+        "Content-Length: 2\r\n\r\nok");
+    char *url = g_strdup_printf("http://127.0.0.1:%d/", server->port);
+    Result result = { FALSE, NULL };
+
+    http_init();
+    http_get(url, 5, _done, &result);
+    guint before = http_pending();
+    while (!result.done) {
+        http_process_events();
+        g_usleep(1000);
+    }
+    guint after = http_pending();
+    http_close();
+    _server_stop(server);
+
+    assert_int_equals(1, before);
+    assert_int_equals(0, after);
+
+    g_free(url);
+    g_free(result.body);
+}
+
+void close_calls_pending_with_null(void)
+{
+    Server *server = _server_start(NULL);
+    char *url = g_strdup_printf("http://127.0.0.1:%d/", server->port);
+    Result result = { FALSE, "not called" };
+
+    http_init();
+    http_get(url, 5, _done, &result);
+    http_close();
+    shutdown(server->sock, SHUT_RDWR);
+    _server_stop(server);
+
+    assert_true(result.done);
+    assert_is_null(result.body);
+
+    g_free(url);
+}
+
+void register_http_tests(void)
+{
+    TEST_MODULE("http tests");
+    TEST(get_returns_body);
+    TEST(get_error_status_returns_null);
+    TEST(get_refused_returns_null);
+    TEST(get_timeout_returns_null);
+    TEST(pending_counts_requests);
+    TEST(close_calls_pending_with_null);
+}
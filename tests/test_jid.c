@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #include <head-unit.h>
 #include "jid.h"
 
@@ -119,6 +120,97 @@ void create_room_jid_returns_nick(void)
     assert_string_equals("myname", result->resourcepart);
 }
 
+void create_jid_resource_after_first_slash(void)
+{
+    Jid *result = jid_create("myuser@mydomain/laptop/work");
+
+    assert_string_equals("myuser@mydomain", result->barejid);
+    assert_string_equals("laptop/work", result->resourcepart);
+
+    jid_destroy(result);
+}
+
+void create_jid_with_leading_slash_returns_null(void)
+{
+    assert_is_null(jid_create("/laptop"));
+}
+
+void lookup_returns_parts(void)
+{
+    Jid *result = jid_lookup("myuser@mydomain/laptop");
+
+    assert_string_equals("myuser@mydomain/laptop", result->fulljid);
+    assert_string_equals("myuser@mydomain", result->barejid);
+    assert_string_equals("myuser", result->localpart);
+    assert_string_equals("mydomain", result->domainpart);
+    assert_string_equals("laptop", result->resourcepart);
+
+    jid_destroy(result);
+    jid_cache_clear();
+}
+
+void lookup_same_jid_returns_shared(void)
+{
+    Jid *first = jid_lookup("myuser@mydomain/laptop");
+    Jid *second = jid_lookup("myuser@mydomain/laptop");
+
+    assert_true(first == second);
+
+    jid_destroy(first);
+    jid_destroy(second);
+    jid_cache_clear();
+}
+
+void lookup_other_resource_returns_other(void)
+{
+    Jid *first = jid_lookup("myuser@mydomain/laptop");
+    Jid *second = jid_lookup("myuser@mydomain/phone");
+
+    assert_false(first == second);
+    assert_string_equals("phone", second->resourcepart);
+
+    jid_destroy(first);
+    jid_destroy(second);
+    jid_cache_clear();
+}
+
+void lookup_invalid_returns_null(void)
+{
+    assert_is_null(jid_lookup(NULL));
+    assert_is_null(jid_lookup(""));
+    assert_is_null(jid_lookup("myuser@"));
+}
+
+void lookup_result_kept_after_cache_cleared(void)
+{
+    Jid *result = jid_lookup("myuser@mydomain/laptop");
+
+    jid_cache_clear();
+
+    assert_string_equals("myuser@mydomain", result->barejid);
+    jid_destroy(result);
+}
+
+void lookup_result_kept_after_eviction(void)
+{
+    Jid *result = jid_lookup("myuser@mydomain/laptop");
+    int i;
+    for (i = 0; i < 100; i++) {
+        char buf[32];
+        sprintf(buf, "user%d@mydomain", i);
+        jid_destroy(jid_lookup(buf));
+    }
+
+    Jid *again = jid_lookup("myuser@mydomain/laptop");
+
+    assert_string_equals("laptop", result->resourcepart);
+    assert_false(result == again);
+
+    jid_destroy(result);
+    jid_destroy(again);
+    jid_cache_clear();
+}
+
 void register_jid_tests(void)
 {
     TEST_MODULE("jid tests");
@@ -141,4 +233,12 @@ void register_jid_tests(void)
     TEST(create_jid_from_bare_returns_domainpart);
     TEST(create_room_jid_returns_room);
     TEST(create_room_jid_returns_nick);
+    TEST(create_jid_resource_after_first_slash);
+    TEST(create_jid_with_leading_slash_returns_null);
+    TEST(lookup_returns_parts);
+    TEST(lookup_same_jid_returns_shared);
+    TEST(lookup_other_resource_returns_other);
+    TEST(lookup_invalid_returns_null);
+    TEST(lookup_result_kept_after_cache_cleared);
+    TEST(lookup_result_kept_after_eviction);
 }
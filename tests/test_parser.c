@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <head-unit.h>
@@ -180,6 +181,79 @@ parse_cmd_min_zero_with_freetext(void)
     g_strfreev(result);
 }
 
+void
+parse_cmd_quoted_arg(void)
+{
+    char *inp = "/cmd \"arg one\" arg2";
+    gchar **result = parse_args(inp, 2, 2);
+
+    assert_int_equals(2, g_strv_length(result));
+    assert_string_equals("arg one", result[0]);
+    assert_string_equals("arg2", result[1]);
+    g_strfreev(result);
+}
+
+void
+parse_cmd_empty_quoted_arg(void)
+{
+    char *inp = "/cmd \"\" arg2";
+    gchar **result = parse_args(inp, 2, 2);
+
+    assert_int_equals(2, g_strv_length(result));
+    assert_string_equals("", result[0]);
+    assert_string_equals("arg2", result[1]);
+    g_strfreev(result);
+}
+
+void
+parse_cmd_escaped_quote_and_backslash(void)
+{
+    char *inp = "/cmd say\\\"hi\\\" C:\\dir";
+    gchar **result = parse_args(inp, 2, 2);
+
+    assert_int_equals(2, g_strv_length(result));
+    assert_string_equals("say\"hi\"", result[0]);
+    assert_string_equals("C:\\dir", result[1]);
+    g_strfreev(result);
+}
+
+void
+parse_cmd_unclosed_quote_returns_null(void)
+{
+    char *inp = "/cmd \"arg one";
+    gchar **result = parse_args(inp, 1, 2);
+
+    assert_is_null(result);
+}
+
+void
+parse_cmd_quoted_arg_with_freetext(void)
+{
+    char *inp = "/cmd \"arg one\" some \"free\" text";
+    gchar **result = parse_args_with_freetext(inp, 1, 2);
+
+    assert_int_equals(2, g_strv_length(result));
+    assert_string_equals("arg one", result[0]);
+    assert_string_equals("some \"free\" text", result[1]);
+    g_strfreev(result);
+}
+
+void
+parse_cmd_long_input(void)
+{
+    char inp[1024];
+    char arg[1001];
+    memset(arg, 'a', 1000);
+    arg[1000] = '\0';
+    sprintf(inp, "/cmd %s arg2", arg);
+    gchar **result = parse_args(inp, 2, 2);
+
+    assert_int_equals(2, g_strv_length(result));
+    assert_string_equals(arg, result[0]);
+    assert_string_equals("arg2", result[1]);
+    g_strfreev(result);
+}
+
 void
 register_parser_tests(void)
 {
@@ -200,4 +274,10 @@ register_parser_tests(void)
     TEST(parse_cmd_with_too_many_returns_null);
     TEST(parse_cmd_min_zero);
     TEST(parse_cmd_min_zero_with_freetext);
+    TEST(parse_cmd_quoted_arg);
+    TEST(parse_cmd_empty_quoted_arg);
+    TEST(parse_cmd_escaped_quote_and_backslash);
+    TEST(parse_cmd_unclosed_quote_returns_null);
+    TEST(parse_cmd_quoted_arg_with_freetext);
+    TEST(parse_cmd_long_input);
 }
@@ -0,0 +1,129 @@
+#include <stdlib.h>
+#include <string.h>
+#include <head-unit.h>
+#include <glib.h>
+#include "prof_cache.h"
+
+void get_missing_returns_null(void)
+{
+    PCache cache = p_cache_new(10);
+
+    assert_is_null(p_cache_get(cache, "a"));
+
+    p_cache_free(cache);
+}
+
+void get_returns_put_value(void)
+{
+    PCache cache = p_cache_new(10);
+
+    p_cache_put(cache, "a", "one", 60);
+
+    assert_string_equals("one", p_cache_get(cache, "a"));
+
+    p_cache_free(cache);
+}
+
+void put_replaces_value(void)
+{
+    PCache cache = p_cache_new(10);
+
+    p_cache_put(cache, "a", "one", 60);
+    p_cache_put(cache, "a", "two", 60);
+
+    assert_string_equals("two", p_cache_get(cache, "a"));
+    assert_int_equals(1, p_cache_length(cache));
+
+    p_cache_free(cache);
+}
+
+void get_expired_returns_null(void)
+{
+    PCache cache = p_cache_new(10);
+
+    p_cache_put(cache, "a", "one", 0);
+
+    assert_is_null(p_cache_get(cache, "a"));
+    assert_int_equals(0, p_cache_length(cache));
+
+    p_cache_free(cache);
+}
+
+void full_cache_drops_least_recently_used(void)
+{
+    PCache cache = p_cache_new(2);
+
+    p_cache_put(cache, "a", "one", 60);
+    p_cache_put(cache, "b", "two", 60);
+    p_cache_get(cache, "a");
+    p_cache_put(cache, "c", "three", 60);
+
+    assert_string_equals("one", p_cache_get(cache, "a"));
+    assert_is_null(p_cache_get(cache, "b"));
+    assert_string_equals("three", p_cache_get(cache, "c"));
+
+    p_cache_free(cache);
+}
+
+void load_reads_serialised(void)
+{
+    PCache cache = p_cache_new(10);
+    p_cache_put(cache, "http://a.com/?x=1\tb", "one\ntwo", 60);
+    p_cache_put(cache, "b", "two", 60);
+    gchar *data = p_cache_serialise(cache);
+    PCache loaded = p_cache_new(10);
+
+    p_cache_load(loaded, data);
+
+    assert_int_equals(2, p_cache_length(loaded));
+    assert_string_equals("one\ntwo", p_cache_get(loaded, "http://a.com/?x=1\tb"));
+    assert_string_equals("two", p_cache_get(loaded, "b"));
+
+    g_free(data);
+    p_cache_free(cache);
+    p_cache_free(loaded);
+}
+
+void load_keeps_recently_used_order(void)
+{
+    PCache cache = p_cache_new(10);
+    p_cache_put(cache, "a", "one", 60);
+    p_cache_put(cache, "b", "two", 60);
+    p_cache_get(cache, "a");
+    gchar *data = p_cache_serialise(cache);
+    PCache loaded = p_cache_new(1);
+
+    p_cache_load(loaded, data);
+
+    assert_string_equals("one", p_cache_get(loaded, "a"));
+    assert_is_null(p_cache_get(loaded, "b"));
+
+    g_free(data);
+    p_cache_free(cache);
+    p_cache_free(loaded);
+}
+
+void load_skips_expired_and_bad_lines(void)
+{
+    PCache cache = p_cache_new(10);
+
+    p_cache_load(cache, "1\ta\tone\nnonsense\n99999999999\tb\ttwo\nx\tc\tthree\n");
+
+    assert_int_equals(1, p_cache_length(cache));
+    assert_string_equals("two", p_cache_get(cache, "b"));
+
+    p_cache_free(cache);
+}
+
+void register_prof_cache_tests(void)
+{
+    TEST_MODULE("prof_cache tests");
+    TEST(get_missing_returns_null);
+    TEST(get_returns_put_value);
+    TEST(put_replaces_value);
+    TEST(get_expired_returns_null);
+    TEST(full_cache_drops_least_recently_used);
+    TEST(load_reads_serialised);
+    TEST(load_keeps_recently_used_order);
+    TEST(load_skips_expired_and_bad_lines);
+}
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <head-unit.h>
+#include <glib.h>
+#include "prof_file_writer.h"
+
+static char *
+_writer_path(void)
+{
+    char *path = g_build_filename(g_get_tmp_dir(), "prof_test_XXXXXX", NULL);
+    int fd = g_mkstemp(path);
+    close(fd);
+    unlink(path);
+    return path;
+}
+
+static char *
+_contents(const char * const path)
+{
+    char *contents = NULL;
+    g_file_get_contents(path, &contents, NULL, NULL);
+    return contents;
+}
+
+void flush_writes_contents(void)
+{
+    char *path = _writer_path();
+    PFileWriter writer = p_file_writer_new(path, 0600, 60000);
+
+    p_file_writer_write(writer, g_strdup("one"), 3);
+    gboolean result = p_file_writer_flush(writer);
+    char *contents = _contents(path);
+
+    assert_true(result);
+    assert_string_equals("one", contents);
+
+    p_file_writer_free(writer);
+    g_free(contents);
+    unlink(path);
+    g_free(path);
+}
+
+void nothing_written_before_delay(void)
+{
+    char *path = _writer_path();
+    PFileWriter writer = p_file_writer_new(path, 0600, 60000);
+
+    p_file_writer_write(writer, g_strdup("one"), 3);
+
+    assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+
+    p_file_writer_free(writer);
+    unlink(path);
+    g_free(path);
+}
+
+void last_write_wins(void)
+{
+    char *path = _writer_path();
+    PFileWriter writer = p_file_writer_new(path, 0600, 60000);
+
+    p_file_writer_write(writer, g_strdup("one"), 3);
+    p_file_writer_write(writer, g_strdup("two"), 3);
+    p_file_writer_write(writer, g_strdup("three"), 5);
+    p_file_writer_flush(writer);
+    char *contents = _contents(path);
+
+    assert_string_equals("three", contents);
+
+    p_file_writer_free(writer);
+    g_free(contents);
+    unlink(path);
+    g_free(path);
+}
+
+void free_writes_pending(void)
+{
+    char *path = _writer_path();
+    PFileWriter writer = p_file_writer_new(path, 0600, 60000);
+
+    p_file_writer_write(writer, g_strdup("pending"), 7);
+    p_file_writer_free(writer);
+    char *contents = _contents(path);
+
+    assert_string_equals("pending", contents);
+
+    g_free(contents);
+    unlink(path);
+    g_free(path);
+}
+
+void written_after_delay(void)
+{
+    char *path = _writer_path();
+    PFileWriter writer = p_file_writer_new(path, 0600, 10);
+
+    p_file_writer_write(writer, g_strdup("later"), 5);
+    int tries = 0;
+    while (!g_file_test(path, G_FILE_TEST_EXISTS) && tries < 200) {
+        g_usleep(5000);
+        tries++;
+    }
+    char *contents = _contents(path);
+
+    assert_string_equals("later", contents);
+
+    p_file_writer_free(writer);
+    g_free(contents);
+    unlink(path);
+    g_free(path);
+}
+
+void file_created_with_mode(void)
+{
+    char *path = _writer_path();
+    PFileWriter writer = p_file_writer_new(path, 0600, 60000);
+
+    p_file_writer_write(writer, g_strdup("secret"), 6);
+    p_file_writer_flush(writer);
+    struct stat st;
+    stat(path, &st);
+
+    assert_int_equals(0600, st.st_mode & 0777);
+
+    p_file_writer_free(writer);
+    unlink(path);
+    g_free(path);
+}
+
+void flush_fails_when_directory_missing(void)
+{
+    char *dir = _writer_path();
+    char *path = g_build_filename(dir, "file", NULL);
+    PFileWriter writer = p_file_writer_new(path, 0600, 60000);
+
+    p_file_writer_write(writer, g_strdup("lost"), 4);
+    gboolean result = p_file_writer_flush(writer);
+
+    assert_false(result);
+
+    p_file_writer_free(writer);
+    g_free(path);
+    g_free(dir);
+}
+
+void register_prof_file_writer_tests(void)
+{
+    TEST_MODULE("prof_file_writer tests");
+    TEST(flush_writes_contents);
+    TEST(nothing_written_before_delay);
+    TEST(last_write_wins);
+    TEST(free_writes_pending);
+    TEST(written_after_delay);
+    TEST(file_created_with_mode);
+    TEST(flush_fails_when_directory_missing);
+}
@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <string.h>
+#include <head-unit.h>
+#include "prof_gap_buffer.h"
+
+void new_buffer_is_empty(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+
+    assert_string_equals("", p_gap_buffer_contents(gb));
+    assert_int_equals(0, p_gap_buffer_size(gb));
+    assert_int_equals(0, p_gap_buffer_cursor(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void insert_appends_at_cursor(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_insert(gb, "hello", 5);
+    p_gap_buffer_insert(gb, " world", 6);
+
+    assert_string_equals("hello world", p_gap_buffer_contents(gb));
+    assert_int_equals(11, p_gap_buffer_cursor(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void insert_in_middle(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "helo");
+    p_gap_buffer_left(gb);
+    p_gap_buffer_insert(gb, "l", 1);
+
+    assert_string_equals("hello", p_gap_buffer_contents(gb));
+    assert_int_equals(4, p_gap_buffer_cursor(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void contents_keeps_cursor(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "abd");
+    p_gap_buffer_left(gb);
+    p_gap_buffer_contents(gb);
+    p_gap_buffer_insert(gb, "c", 1);
+
+    assert_string_equals("abcd", p_gap_buffer_contents(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void backspace_removes_before_cursor(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "abcd");
+    p_gap_buffer_left(gb);
+    gboolean result = p_gap_buffer_backspace(gb);
+
+    assert_true(result);
+    assert_string_equals("abd", p_gap_buffer_contents(gb));
+    assert_int_equals(2, p_gap_buffer_cursor(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void backspace_at_start_does_nothing(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "abc");
+    p_gap_buffer_home(gb);
+    gboolean result = p_gap_buffer_backspace(gb);
+
+    assert_false(result);
+    assert_string_equals("abc", p_gap_buffer_contents(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void delete_removes_under_cursor(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "abcd");
+    p_gap_buffer_home(gb);
+    p_gap_buffer_right(gb);
+    gboolean result = p_gap_buffer_delete(gb);
+
+    assert_true(result);
+    assert_string_equals("acd", p_gap_buffer_contents(gb));
+    assert_int_equals(1, p_gap_buffer_cursor(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void delete_at_end_does_nothing(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "abc");
+    gboolean result = p_gap_buffer_delete(gb);
+
+    assert_false(result);
+    assert_string_equals("abc", p_gap_buffer_contents(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void tail_returns_text_after_cursor(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "abcdef");
+    p_gap_buffer_home(gb);
+    p_gap_buffer_right(gb);
+    p_gap_buffer_right(gb);
+
+    gsize len;
+    const char *tail = p_gap_buffer_tail(gb, &len);
+
+    assert_int_equals(4, len);
+    assert_true(strncmp("cdef", tail, len) == 0);
+
+    p_gap_buffer_free(gb);
+}
+
+void utf8_counts_characters_not_bytes(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "h\xc3\xa9llo");
+
+    assert_int_equals(6, p_gap_buffer_size(gb));
+    assert_int_equals(5, p_gap_buffer_length(gb));
+    assert_int_equals(5, p_gap_buffer_width(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void utf8_backspace_removes_whole_character(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "h\xc3\xa9");
+    p_gap_buffer_backspace(gb);
+
+    assert_string_equals("h", p_gap_buffer_contents(gb));
+    assert_int_equals(1, p_gap_buffer_cursor(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void wide_characters_take_two_columns(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "a\xe4\xbd\xa0" "b");
+
+    assert_int_equals(3, p_gap_buffer_length(gb));
+    assert_int_equals(4, p_gap_buffer_width(gb));
+
+    p_gap_buffer_left(gb);
+    assert_int_equals(3, p_gap_buffer_cursor(gb));
+    p_gap_buffer_left(gb);
+    assert_int_equals(1, p_gap_buffer_cursor(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void grows_past_initial_size(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    char line[5001];
+    memset(line, 'x', 5000);
+    line[5000] = '\0';
+
+    int i;
+    for (i = 0; i < 5000; i++) {
+        p_gap_buffer_insert(gb, "x", 1);
+        if (i == 2500) {
+            p_gap_buffer_home(gb);
+        }
+    }
+
+    assert_string_equals(line, p_gap_buffer_contents(gb));
+    assert_int_equals(5000, p_gap_buffer_width(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void has_prefix_checks_start(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "/msg bob");
+    p_gap_buffer_home(gb);
+
+    assert_true(p_gap_buffer_has_prefix(gb, "/"));
+    assert_true(p_gap_buffer_has_prefix(gb, "/msg "));
+    assert_false(p_gap_buffer_has_prefix(gb, "msg"));
+    assert_false(p_gap_buffer_has_prefix(gb, "/msg bob and more"));
+
+    p_gap_buffer_free(gb);
+}
+
+void clear_empties_buffer(void)
+{
+    PGapBuffer gb = p_gap_buffer_new();
+    p_gap_buffer_set(gb, "something");
+    p_gap_buffer_clear(gb);
+
+    assert_string_equals("", p_gap_buffer_contents(gb));
+    assert_int_equals(0, p_gap_buffer_width(gb));
+    assert_int_equals(0, p_gap_buffer_cursor(gb));
+
+    p_gap_buffer_free(gb);
+}
+
+void register_prof_gap_buffer_tests(void)
+{
+    TEST_MODULE("prof_gap_buffer tests");
+    TEST(new_buffer_is_empty);
+    TEST(insert_appends_at_cursor);
+    TEST(insert_in_middle);
+    TEST(contents_keeps_cursor);
+    TEST(backspace_removes_before_cursor);
+    TEST(backspace_at_start_does_nothing);
+    TEST(delete_removes_under_cursor);
+    TEST(delete_at_end_does_nothing);
+    TEST(tail_returns_text_after_cursor);
+    TEST(utf8_counts_characters_not_bytes);
+    TEST(utf8_backspace_removes_whole_character);
+    TEST(wide_characters_take_two_columns);
+    TEST(grows_past_initial_size);
+    TEST(has_prefix_checks_start);
+    TEST(clear_empties_buffer);
+}
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <head-unit.h>
 #include "prof_history.h"
 
@@ -214,6 +215,169 @@ void start_session_add_new_submit_previous(void)
     p_history_append(history, item3);
 }
 
+void oldest_dropped_when_full(void)
+{
+    PHistory history = p_history_new(3);
+    p_history_append(history, "one");
+    p_history_append(history, "two");
+    p_history_append(history, "three");
+    p_history_append(history, "four");
+
+    assert_int_equals(3, p_history_length(history));
+    assert_string_equals("two", p_history_get(history, 0));
+    assert_string_equals("four", p_history_get(history, 2));
+}
+
+void previous_stops_at_oldest_after_wrap(void)
+{
+    PHistory history = p_history_new(2);
+    p_history_append(history, "one");
+    p_history_append(history, "two");
+    p_history_append(history, "three");
+
+    char *item1 = p_history_previous(history, NULL);
+    char *item2 = p_history_previous(history, item1);
+    char *item3 = p_history_previous(history, item2);
+
+    assert_string_equals("three", item1);
+    assert_string_equals("two", item2);
+    assert_string_equals("two", item3);
+}
+
+void resize_keeps_newest(void)
+{
+    PHistory history = p_history_new(5);
+    p_history_append(history, "one");
+    p_history_append(history, "two");
+    p_history_append(history, "three");
+
+    p_history_resize(history, 2);
+    p_history_append(history, "four");
+
+    assert_int_equals(2, p_history_length(history));
+    assert_string_equals("three", p_history_get(history, 0));
+    assert_string_equals("four", p_history_get(history, 1));
+}
+
+void keeps_all_items_below_size(void)
+{
+    PHistory history = p_history_new(100);
+    char item[20];
+    int i;
+    for (i = 0; i < 50; i++) {
+        sprintf(item, "item %d", i);
+        p_history_append(history, item);
+    }
+
+    assert_int_equals(50, p_history_length(history));
+    assert_string_equals("item 0", p_history_get(history, 0));
+    assert_string_equals("item 49", p_history_get(history, 49));
+}
+
+void append_after_end_session_adds_item(void)
+{
+    PHistory history = p_history_new(10);
+    p_history_append(history, "one");
+    p_history_append(history, "two");
+
+    char *item1 = p_history_previous(history, "typed");
+    char *item2 = p_history_previous(history, item1);
+    p_history_end_session(history);
+    p_history_append(history, "three");
+
+    assert_int_equals(3, p_history_length(history));
+    assert_string_equals("one", p_history_get(history, 0));
+    assert_string_equals("three", p_history_get(history, 2));
+    free(item1);
+    free(item2);
+}
+
+void search_finds_newest_match(void)
+{
+    PHistory history = p_history_new(10);
+    p_history_append(history, "/msg bob hello");
+    p_history_append(history, "/join room");
+    p_history_append(history, "/msg alice hello");
+
+    int index = p_history_search(history, "hello", -1);
+
+    assert_int_equals(2, index);
+}
+
+void search_from_finds_older_match(void)
+{
+    PHistory history = p_history_new(10);
+    p_history_append(history, "/msg bob hello");
+    p_history_append(history, "/join room");
+    p_history_append(history, "/msg alice hello");
+
+    int index = p_history_search(history, "hello", 1);
+
+    assert_int_equals(0, index);
+}
+
+void search_checks_whole_query(void)
+{
+    PHistory history = p_history_new(10);
+    p_history_append(history, "abcd xyz");
+    p_history_append(history, "abc xyzd");
+
+    int index = p_history_search(history, "abcd", -1);
+
+    assert_int_equals(0, index);
+}
+
+void search_short_query(void)
+{
+    PHistory history = p_history_new(10);
+    p_history_append(history, "/who");
+    p_history_append(history, "/quit");
+
+    int index = p_history_search(history, "wh", -1);
+
+    assert_int_equals(0, index);
+}
+
+void search_no_match_returns_minus_one(void)
+{
+    PHistory history = p_history_new(10);
+    p_history_append(history, "/who");
+
+    int index = p_history_search(history, "/connect", -1);
+
+    assert_int_equals(-1, index);
+}
+
+void search_does_not_find_dropped(void)
+{
+    PHistory history = p_history_new(2);
+    p_history_append(history, "/connect me@server.org");
+    p_history_append(history, "/who");
+    p_history_append(history, "/quit");
+
+    int index = p_history_search(history, "connect", -1);
+
+    assert_int_equals(-1, index);
+}
+
+void search_finds_edited_item(void)
+{
+    PHistory history = p_history_new(10);
+    p_history_append(history, "first");
+    p_history_append(history, "second");
+
+    char *item1 = p_history_previous(history, "new");
+    char *item2 = p_history_previous(history, item1);
+    char *item3 = p_history_next(history, "changed");
+    char *item4 = p_history_next(history, item3);
+    p_history_append(history, item4);
+
+    assert_string_equals("changed", p_history_get(history, 0));
+    assert_int_equals(0, p_history_search(history, "changed", -1));
+    assert_int_equals(-1, p_history_search(history, "first", -1));
+    assert_int_equals(2, p_history_search(history, "new", -1));
+}
+
 void register_prof_history_tests(void)
 {
     TEST_MODULE("prof_history tests");
@@ -230,4 +394,16 @@ void register_prof_history_tests(void)
     TEST(edit_item_mid_history);
     TEST(edit_previous_and_append);
     TEST(start_session_add_new_submit_previous);
+    TEST(oldest_dropped_when_full);
+    TEST(previous_stops_at_oldest_after_wrap);
+    TEST(resize_keeps_newest);
+    TEST(keeps_all_items_below_size);
+    TEST(append_after_end_session_adds_item);
+    TEST(search_finds_newest_match);
+    TEST(search_from_finds_older_match);
+    TEST(search_checks_whole_query);
+    TEST(search_short_query);
+    TEST(search_no_match_returns_minus_one);
+    TEST(search_does_not_find_dropped);
+    TEST(search_finds_edited_item);
 }
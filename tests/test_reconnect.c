@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+#include <head-unit.h>
+#include <glib.h>
+#include "reconnect.h"
+
+static void beforetest(void)
+{
+    reconnect_set_max(60000);
+    reconnect_stop();
+}
+
+void idle_when_not_lost(void)
+{
+    assert_int_equals(RECONNECT_IDLE, reconnect_get_state());
+    assert_false(reconnect_due(1000000));
+}
+
+void lost_waits_for_first_attempt(void)
+{
+    reconnect_lost(1000);
+
+    assert_int_equals(RECONNECT_WAITING, reconnect_get_state());
+    assert_int_equals(0, reconnect_get_attempts());
+}
+
+void first_attempt_within_a_second(void)
+{
+    int i;
+    for (i = 0; i < 100; i++) {
+        reconnect_lost(1000);
+        gint64 next = reconnect_get_next_attempt();
+        assert_true(next >= 1000);
+        assert_true(next <= 2000);
+    }
+}
+
+void not_due_before_next_attempt(void)
+{
+    reconnect_lost(1000);
+    gint64 next = reconnect_get_next_attempt();
+
+    if (next > 1000) {
+        assert_false(reconnect_due(next - 1));
+    }
+    assert_int_equals(RECONNECT_WAITING, reconnect_get_state());
+}
+
+void due_starts_attempt(void)
+{
+    reconnect_lost(1000);
+
+    assert_true(reconnect_due(reconnect_get_next_attempt()));
+    assert_int_equals(RECONNECT_CONNECTING, reconnect_get_state());
+    assert_int_equals(1, reconnect_get_attempts());
+    assert_false(reconnect_due(reconnect_get_next_attempt()));
+}
+
+void failed_waits_longer(void)
+{
+    int i;
+    for (i = 0; i < 100; i++) {
+        reconnect_lost(0);
+        reconnect_due(1000);
+        reconnect_failed(1000);
+        reconnect_due(3000);
+        reconnect_failed(3000);
+
+        // third attempt waits up to 4 seconds
+        gint64 next = reconnect_get_next_attempt();
+        assert_int_equals(RECONNECT_WAITING, reconnect_get_state());
+        assert_int_equals(2, reconnect_get_attempts());
+        assert_true(next >= 3000);
+        assert_true(next <= 7000);
+    }
+}
+
+void wait_limited_by_max(void)
+{
+    reconnect_set_max(5000);
+    reconnect_lost(0);
+
+    gint64 now = 0;
+    int i;
+    for (i = 0; i < 40; i++) {
+        now = reconnect_get_next_attempt();
+        reconnect_due(now);
+        reconnect_failed(now);
+        assert_true(reconnect_get_next_attempt() - now <= 5000);
+    }
+
+    assert_int_equals(40, reconnect_get_attempts());
+}
+
+void connected_returns_to_idle(void)
+{
+    reconnect_lost(1000);
+    reconnect_due(reconnect_get_next_attempt());
+    reconnect_connected();
+
+    assert_int_equals(RECONNECT_IDLE, reconnect_get_state());
+    assert_int_equals(0, reconnect_get_attempts());
+}
+
+void lost_when_disabled_stays_idle(void)
+{
+    reconnect_set_max(0);
+    reconnect_lost(1000);
+
+    assert_int_equals(RECONNECT_IDLE, reconnect_get_state());
+}
+
+void disabling_stops_waiting(void)
+{
+    reconnect_lost(1000);
+    reconnect_set_max(0);
+
+    assert_int_equals(RECONNECT_IDLE, reconnect_get_state());
+    assert_false(reconnect_due(1000000));
+}
+
+void failed_when_not_connecting_ignored(void)
+{
+    reconnect_failed(1000);
+
+    assert_int_equals(RECONNECT_IDLE, reconnect_get_state());
+}
+
+void register_reconnect_tests(void)
+{
+    TEST_MODULE("reconnect tests");
+    BEFORETEST(beforetest);
+    TEST(idle_when_not_lost);
+    TEST(lost_waits_for_first_attempt);
+    TEST(first_attempt_within_a_second);
+    TEST(not_due_before_next_attempt);
+    TEST(due_starts_attempt);
+    TEST(failed_waits_longer);
+    TEST(wait_limited_by_max);
+    TEST(connected_returns_to_idle);
+    TEST(lost_when_disabled_stays_idle);
+    TEST(disabling_stops_waiting);
+    TEST(failed_when_not_connecting_ignored);
+}
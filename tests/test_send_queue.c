@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+#include <head-unit.h>
+#include <glib.h>
+#include "send_queue.h"
+
+static void aftertest(void)
+{
+    send_queue_clear();
+}
+
+static void
+_assert_pop(const char * const expected)
+{
+    gboolean persist;
+    char *text = send_queue_pop(&persist);
+    assert_string_equals(expected, text);
+    free(text);
+}
+
+void pop_empty_returns_null(void)
+{
+    gboolean persist;
+
+    assert_is_null(send_queue_pop(&persist));
+}
+
+void pop_keeps_order_within_priority(void)
+{
+    send_queue_add(SEND_PRIORITY_STANZA, "<message>1</message>", TRUE);
+    send_queue_add(SEND_PRIORITY_STANZA, "<presence/>", FALSE);
+    send_queue_add(SEND_PRIORITY_STANZA, "<message>2</message>", TRUE);
+
+    _assert_pop("<message>1</message>");
+    _assert_pop("<presence/>");
+    _assert_pop("<message>2</message>");
+}
+
+void pop_highest_priority_first(void)
+{
+    send_queue_add(SEND_PRIORITY_CHAT_STATE, "<composing/>", FALSE);
+    send_queue_add(SEND_PRIORITY_STANZA, "<message/>", TRUE);
+    send_queue_add(SEND_PRIORITY_PING, "<ping/>", FALSE);
+
+    _assert_pop("<ping/>");
+    _assert_pop("<message/>");
+    _assert_pop("<composing/>");
+}
+
+void pop_returns_persist(void)
+{
+    gboolean persist = FALSE;
+    send_queue_add(SEND_PRIORITY_STANZA, "<message/>", TRUE);
+
+    char *text = send_queue_pop(&persist);
+
+    assert_true(persist);
+    free(text);
+}
+
+void drop_transient_keeps_persistent(void)
+{
+    send_queue_add(SEND_PRIORITY_PING, "<ping/>", FALSE);
+    send_queue_add(SEND_PRIORITY_STANZA, "<message>1</message>", TRUE);
+    send_queue_add(SEND_PRIORITY_STANZA, "<presence/>", FALSE);
+    send_queue_add(SEND_PRIORITY_STANZA, "<message>2</message>", TRUE);
+    send_queue_add(SEND_PRIORITY_CHAT_STATE, "<composing/>", FALSE);
+
+    send_queue_drop_transient();
+
+    assert_int_equals(2, send_queue_length());
+    _assert_pop("<message>1</message>");
+    _assert_pop("<message>2</message>");
+}
+
+void requeue_goes_ahead_of_queued(void)
+{
+    send_queue_add(SEND_PRIORITY_STANZA, "<message>3</message>", TRUE);
+    GList *texts = NULL;
+    texts = g_list_append(texts, g_strdup("<message>1</message>"));
+    texts = g_list_append(texts, g_strdup("<message>2</message>"));
+
+    send_queue_requeue(texts);
+
+    assert_int_equals(3, send_queue_length());
+    _assert_pop("<message>1</message>");
+    _assert_pop("<message>2</message>");
+    _assert_pop("<message>3</message>");
+}
+
+void clear_removes_all(void)
+{
+    send_queue_add(SEND_PRIORITY_PING, "<ping/>", FALSE);
+    send_queue_add(SEND_PRIORITY_STANZA, "<message/>", TRUE);
+
+    send_queue_clear();
+
+    assert_int_equals(0, send_queue_length());
+}
+
+void register_send_queue_tests(void)
+{
+    TEST_MODULE("send_queue tests");
+    AFTERTEST(aftertest);
+    TEST(pop_empty_returns_null);
+    TEST(pop_keeps_order_within_priority);
+    TEST(pop_highest_priority_first);
+    TEST(pop_returns_persist);
+    TEST(drop_transient_keeps_persistent);
+    TEST(requeue_goes_ahead_of_queued);
+    TEST(clear_removes_all);
+}
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <string.h>
+#include <head-unit.h>
+#include <glib.h>
+#include "stream_mgmt.h"
+
+static void aftertest(void)
+{
+    stream_mgmt_stop();
+}
+
+void sent_not_counted_before_start(void)
+{
+    stream_mgmt_sent("<message/>");
+
+    assert_false(stream_mgmt_is_tracking());
+    assert_int_equals(0, stream_mgmt_unacked());
+}
+
+void sent_counted_after_start(void)
+{
+    stream_mgmt_start();
+    stream_mgmt_sent("<message/>");
+    stream_mgmt_sent(NULL);
+
+    assert_int_equals(2, stream_mgmt_unacked());
+}
+
+void received_not_counted_before_enabled(void)
+{
+    stream_mgmt_start();
+    stream_mgmt_received();
+
+    assert_false(stream_mgmt_is_enabled());
+    assert_int_equals(0, stream_mgmt_get_handled());
+}
+
+void received_counted_after_enabled(void)
+{
+    stream_mgmt_start();
+    stream_mgmt_enabled();
+    stream_mgmt_received();
+    stream_mgmt_received();
+    stream_mgmt_received();
+
+    assert_true(stream_mgmt_is_enabled());
+    assert_int_equals(3, stream_mgmt_get_handled());
+}
+
+void ack_removes_handled(void)
+{
+    stream_mgmt_start();
+    stream_mgmt_sent("<message>1</message>");
+    stream_mgmt_sent("<message>2</message>");
+    stream_mgmt_sent("<message>3</message>");
+
+    assert_true(stream_mgmt_acked(2));
+    assert_int_equals(1, stream_mgmt_unacked());
+
+    assert_true(stream_mgmt_acked(3));
+    assert_int_equals(0, stream_mgmt_unacked());
+}
+
+void repeated_ack_removes_nothing(void)
+{
+    stream_mgmt_start();
+    stream_mgmt_sent("<message>1</message>");
+    stream_mgmt_sent("<message>2</message>");
+
+    stream_mgmt_acked(1);
+    assert_true(stream_mgmt_acked(1));
+
+    assert_int_equals(1, stream_mgmt_unacked());
+}
+
+void ack_more_than_sent_fails(void)
+{
+    stream_mgmt_start();
+    stream_mgmt_sent("<message>1</message>");
+
+    assert_false(stream_mgmt_acked(2));
+    assert_int_equals(1, stream_mgmt_unacked());
+}
+
+void take_unacked_returns_unhandled_messages(void)
+{
+    stream_mgmt_start();
+    stream_mgmt_sent("<message>1</message>");
+    stream_mgmt_sent(NULL);
+    stream_mgmt_sent("<message>2</message>");
+    stream_mgmt_sent(NULL);
+    stream_mgmt_sent("<message>3</message>");
+    stream_mgmt_acked(1);
+
+    GList *unacked = stream_mgmt_take_unacked();
+
+    assert_int_equals(2, g_list_length(unacked));
+    assert_string_equals("<message>2</message>", unacked->data);
+    assert_string_equals("<message>3</message>", g_list_next(unacked)->data);
+    assert_false(stream_mgmt_is_tracking());
+    assert_int_equals(0, stream_mgmt_unacked());
+
+    g_list_free_full(unacked, g_free);
+}
+
+void start_again_resets_counts(void)
+{
+    stream_mgmt_start();
+    stream_mgmt_enabled();
+    stream_mgmt_sent("<message>1</message>");
+    stream_mgmt_received();
+    stream_mgmt_start();
+
+    assert_int_equals(0, stream_mgmt_unacked());
+    assert_int_equals(0, stream_mgmt_get_handled());
+    assert_false(stream_mgmt_is_enabled());
+}
+
+void register_stream_mgmt_tests(void)
+{
+    TEST_MODULE("stream_mgmt tests");
+    AFTERTEST(aftertest);
+    TEST(sent_not_counted_before_start);
+    TEST(sent_counted_after_start);
+    TEST(received_not_counted_before_enabled);
+    TEST(received_counted_after_enabled);
+    TEST(ack_removes_handled);
+    TEST(repeated_ack_removes_nothing);
+    TEST(ack_more_than_sent_fails);
+    TEST(take_unacked_returns_unhandled_messages);
+    TEST(start_again_resets_counts);
+}
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <head-unit.h>
+#include <glib.h>
+#include "trace.h"
+
+static char *
+_trace_path(void)
+{
+    char *path = g_build_filename(g_get_tmp_dir(), "prof_test_XXXXXX", NULL);
+    int fd = g_mkstemp(path);
+    close(fd);
+    return path;
+}
+
+void replay_returns_recorded_stanzas(void)
+{
+    char *path = _trace_path();
+    trace_record_open(path);
+    trace_record("me@server/res", "<iq type='result' id='roster'/>");
+    trace_record("me@server/res", "<message><body>hi</body></message>");
+    trace_record_close();
+
+    gulong delay;
+    trace_replay_open(path);
+    char *first = trace_replay_next(&delay);
+    char *second = trace_replay_next(&delay);
+    char *end = trace_replay_next(&delay);
+    trace_replay_close();
+
+    assert_string_equals("<iq type='result' id='roster'/>", first);
+    assert_string_equals("<message><body>hi</body></message>", second);
+    assert_is_null(end);
+
+    free(first);
+    free(second);
+    unlink(path);
+    g_free(path);
+}
+
+void replay_keeps_stanza_on_one_line(void)
+{
+    char *path = _trace_path();
+    trace_record_open(path);
+    trace_record("me@server/res", "<message><body>one\r\ntwo</body></message>");
+    trace_record_close();
+
+    gulong delay;
+    trace_replay_open(path);
+    char *stanza = trace_replay_next(&delay);
+    trace_replay_close();
+
+    assert_string_equals("<message><body>one&#13;&#10;two</body></message>",
+        stanza);
+
+    free(stanza);
+    unlink(path);
+    g_free(path);
+}
+
+void replay_tracks_jid(void)
+{
+    char *path = _trace_path();
+    trace_record_open(path);
+    trace_record("me@server/res", "<presence/>");
+    trace_record("other@server/res", "<presence/>");
+    trace_record_close();
+
+    gulong delay;
+    trace_replay_open(path);
+    free(trace_replay_next(&delay));
+    assert_string_equals("me@server/res", trace_replay_jid());
+    free(trace_replay_next(&delay));
+    assert_string_equals("other@server/res", trace_replay_jid());
+    trace_replay_close();
+
+    unlink(path);
+    g_free(path);
+}
+
+void replay_missing_file_fails(void)
+{
+    assert_false(trace_replay_open("/nonexistent/prof_trace"));
+}
+
+void register_trace_tests(void)
+{
+    TEST_MODULE("trace tests");
+    TEST(replay_returns_recorded_stanzas);
+    TEST(replay_keeps_stanza_on_one_line);
+    TEST(replay_tracks_jid);
+    TEST(replay_missing_file_fails);
+}
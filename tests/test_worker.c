@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <string.h>
+#include <head-unit.h>
+#include <glib.h>
+#include "worker.h"
+
+typedef struct job_t {
+    gint release;
+    gint saw_cancel;
+    int freed;
+} Job;
+
+static void
+_job_free(void *data)
+{
+    Job *job = data;
+    job->freed++;
+}
+
+static void
+_return_now(Worker *worker, void *data)
+{
+}
+
+// runs until released, whether cancelled or not
+static void
+_wait_for_release(Worker *worker, void *data)
+{
+    Job *job = data;
+    while (!g_atomic_int_get(&job->release)) {
+        g_usleep(1000);
+    }
+}
+
+static void
+_wait_for_cancel(Worker *worker, void *data)
+{
+    Job *job = data;
+    while (!worker_cancelled(worker)) {
+        g_usleep(1000);
+    }
+    g_atomic_int_set(&job->saw_cancel, TRUE);
+}
+
+static void
+_wait_finished(Worker *worker)
+{
+    while (!worker_finished(worker)) {
+        g_usleep(1000);
+    }
+}
+
+void finished_after_func_returns(void)
+{
+    Job job = { FALSE, FALSE, 0 };
+    Worker *worker = worker_start("test", _return_now, &job, _job_free);
+
+    _wait_finished(worker);
+    worker_free(worker);
+
+    assert_int_equals(1, job.freed);
+}
+
+void not_finished_while_running(void)
+{
+    Job job = { FALSE, FALSE, 0 };
+    Worker *worker = worker_start("test", _wait_for_release, &job, _job_free);
+
+    assert_false(worker_finished(worker));
+
+    g_atomic_int_set(&job.release, TRUE);
+    _wait_finished(worker);
+    worker_free(worker);
+
+    assert_int_equals(1, job.freed);
+}
+
+void cancel_seen_by_func(void)
+{
+    Job job = { FALSE, FALSE, 0 };
+    Worker *worker = worker_start("test", _wait_for_cancel, &job, _job_free);
+
+    worker_cancel(worker);
+    guint left = worker_reap(TRUE);
+
+    assert_int_equals(0, left);
+    assert_true(job.saw_cancel);
+    assert_int_equals(1, job.freed);
+}
+
+void reap_keeps_running_worker(void)
+{
+    Job job = { FALSE, FALSE, 0 };
+    Worker *worker = worker_start("test", _wait_for_release, &job, _job_free);
+
+    worker_cancel(worker);
+    guint running = worker_reap(FALSE);
+    int freed = job.freed;
+
+    g_atomic_int_set(&job.release, TRUE);
+    guint left = worker_reap(TRUE);
+
+    assert_int_equals(1, running);
+    assert_int_equals(0, freed);
+    assert_int_equals(0, left);
+    assert_int_equals(1, job.freed);
+}
+
+void cancel_after_finished_frees_once(void)
+{
+    Job job = { FALSE, FALSE, 0 };
+    Worker *worker = worker_start("test", _return_now, &job, _job_free);
+
+    _wait_finished(worker);
+    worker_cancel(worker);
+    guint left = worker_reap(FALSE);
+
+    assert_int_equals(0, left);
+    assert_int_equals(1, job.freed);
+}
+
+// cancelled while the function may be returning
+void cancel_racing_finish_frees_once(void)
+{
+    Job job = { FALSE, FALSE, 0 };
+    int i;
+
+    for (i = 0; i < 200; i++) {
+        Worker *worker = worker_start("test", _return_now, &job, _job_free);
+        if (i % 2 == 0) {
+            worker_finished(worker);
+        }
+        worker_cancel(worker);
+        worker_reap(FALSE);
+    }
+    guint left = worker_reap(TRUE);
+
+    assert_int_equals(0, left);
+    assert_int_equals(200, job.freed);
+}
+
+void register_worker_tests(void)
+{
+    TEST_MODULE("worker tests");
+    TEST(finished_after_func_returns);
+    TEST(not_finished_while_running);
+    TEST(cancel_seen_by_func);
+    TEST(reap_keeps_running_worker);
+    TEST(cancel_after_finished_frees_once);
+    TEST(cancel_racing_finish_frees_once);
+}
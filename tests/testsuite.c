@@ -9,6 +9,16 @@ int main(void)
     register_prof_autocomplete_tests();
     register_parser_tests();
     register_jid_tests();
+    register_prof_gap_buffer_tests();
+    register_trace_tests();
+    register_prof_file_writer_tests();
+    register_http_tests();
+    register_prof_cache_tests();
+    register_stream_mgmt_tests();
+    register_reconnect_tests();
+    register_send_queue_tests();
+    register_dispatch_tests();
+    register_worker_tests();
     run_suite();
     return 0;
 }
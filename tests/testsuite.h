@@ -7,5 +7,15 @@ void register_common_tests(void);
 void register_prof_autocomplete_tests(void);
 void register_parser_tests(void);
 void register_jid_tests(void);
+void register_prof_gap_buffer_tests(void);
+void register_trace_tests(void);
+void register_prof_file_writer_tests(void);
+void register_http_tests(void);
+void register_prof_cache_tests(void);
+void register_stream_mgmt_tests(void);
+void register_reconnect_tests(void);
+void register_send_queue_tests(void);
+void register_dispatch_tests(void);
+void register_worker_tests(void);
 
 #endif